@@ -19,6 +19,7 @@
 #include "config.h"
 #include "args.h"
 #include "solvers.h"
+#include "file.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -63,6 +64,10 @@ error_t parse_opt(int key, char *arg, struct argp_state *state)
     // solvers
     case 's':
     {
+      if (strncmp(arg, "auto", 5) == 0) {
+        args->solver = SOLVER_AUTO;
+        break;
+      }
       args->solver = lookup_solver_by_shortname(arg);
       if (args->solver < 0) {
         fprintf( stderr, "invalid solver (-s)\n");
@@ -70,6 +75,9 @@ error_t parse_opt(int key, char *arg, struct argp_state *state)
       }
     }
       break;
+    case -7:
+      args->history = arg;
+      break;
     // Repetitions of calculation
     case 'r':
     {
@@ -83,6 +91,20 @@ error_t parse_opt(int key, char *arg, struct argp_state *state)
       args->rep = i;
     }
       break;
+    // input options
+    case -3:
+      args->load_flags |= MC_LOAD_MERGE_DUPLICATES;
+      break;
+    case -4:
+      args->load_flags |= MC_LOAD_SINGLE;
+      break;
+    case -5:
+      args->load_flags |= MC_LOAD_POOL;
+      break;
+    case -8:
+      args->cache_enabled = 1;
+      args->cache_dir = arg;  // NULL: next to the input
+      break;
     // file I/O
     case 'i':
       args->input = arg;
@@ -133,6 +155,17 @@ error_t parse_opt(int key, char *arg, struct argp_state *state)
       }
     }
       break;
+    // Residual
+    case -6:
+      args->residual_enabled = 1;
+      if (arg != NULL) {
+        int err = sscanf(arg, "%lf", &(args->residual_tolerance));  // convert string -> double
+        if ((err != 1) || (args->residual_tolerance < 0)) {
+          fprintf( stderr, "bad residual tolerance (must be a non-negative floating point number)\n");
+          exit( EXIT_FAILURE);
+        }
+      }
+      break;
     // Output
     case 'o':
       args->output = arg;
@@ -171,9 +204,12 @@ heterogeneous solvers (generally using SMP).\n\
 Matrices are available through the Harwell-Boeing sparse matrix\n\
 collection and the University of Florida sparse matrix collection.\n\
 \n\
-Limitations: currently only 'Matrix Market' format (*.mm) and\n\
-  Matlab format (*.mat) are supported (if enabled).\n\
-  (The Rutherford/Harwell-Boeing format loader is broken. *.hb, *.rb)\n\
+Limitations: currently only 'Matrix Market' format (*.mm),\n\
+  Harwell-Boeing (*.hb) and Rutherford-Boeing (*.rb) formats,\n\
+  Matlab format (*.mat) (if enabled) and the binary cache (*.mcb) are supported.\n\
+  Matrix Market files may be compressed (*.mtx.gz, *.mtx.zst, *.mtx.xz) or\n\
+  archived as by SuiteSparse (*.tar.gz: the Name/Name.mtx member is read).\n\
+  Elemental Harwell-Boeing matrices are not supported.\n\
 \n\
 Options:";
 // TODO automatically list off available solvers and their version info?
@@ -184,9 +220,16 @@ Options:";
         { "usage", -1, 0, 0, "Show usage information", -1 },
         { "version", 'V', 0, 0, "Show version information", -1 },
         { "input", 'i', "FILE", 0, "Input matrix from FILE (A)", 10 },
+        { "merge-duplicates", -3, 0, 0, "Sum repeated entries when loading matrices", 10 },
+        { "single", -4, 0, 0, "Store the matrix and right-hand side in single precision", 10 },
+        { "pool", -5, 0, 0, "Allocate matrix storage from a buffer pool, reused between conversions", 10 },
+        { "cache-dir", -8, "DIR", OPTION_ARG_OPTIONAL,
+          "Keep a binary copy of the loaded input matrix in DIR (default: next to it) and load that while it is up to date", 10 },
         { "right-hand-side", 'b', "FILE", 0, "RHS matrix from FILE (b)", 11 },
         { "expected-answer", 'e', "FILE", 0, "Expected matrix as a FILE (x)", 12 },
         { "precision", 'p', "<float>", 0, "Precision of comparison with expectation (a floating point number)", 12 },
+        { "residual", -6, "<float>", OPTION_ARG_OPTIONAL,
+          "Check x by its relative residual ||b-Ax||/(||A|| ||x||+||b||), failing above <float> (default 1e-10)", 12 },
         { "output", 'o', "FILE", 0, "Output matrix to FILE (x) ('-' is stdout)", 13 },
         { "verbose", 'v', 0, 0, "Increase verbosity", 20 },
         // TODO add note to man page: -v, -vv, -vvv, etc for more detail
@@ -194,7 +237,8 @@ Options:";
         // -vv: more detail(?), -vvv: max debug
         { "timing", 't', 0, 0, "Show/increase timing information", 21 },
         { "repeat", 'r', "N", 0, "Repeat calculations N times", 6 },
-        { "solver", 's', "SOLVER", 0, "Select SOLVER", 5 },
+        { "solver", 's', "SOLVER", 0, "Select SOLVER ('auto' picks one for the problem)", 5 },
+        { "history", -7, "FILE", 0, "Record solve times in FILE, and choose the fastest from it with '-s auto'", 5 },
         { "list-solvers", -2, 0, 0, "List available SOLVERs (-vv for more details)", 5 },
         // TODO add note to man page: -t, -tt, -ttt for more detail
         // none: no output, -t: single-line (csv), -tt: chart, -ttt: greater detail
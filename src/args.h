@@ -33,11 +33,17 @@ struct parse_args
   char* rhs;                      ///< right-hand side b
   char* expected;                 ///< Expected solution vector x to compare solution from meagre-crowd against
   double expected_precision;      ///< Expected precision of solution x
+  unsigned int residual_enabled;  ///< Check the solution x by its residual ||b-Ax||
+  double residual_tolerance;      ///< Largest acceptable relative residual
   unsigned int timing_enabled;    ///< Enable timing functionality
   unsigned int verbosity;         ///< Verbosity
   unsigned int rep;               ///< Number of repetitions to solve the system
   int mpi_rank;                   ///< Set by meagre-crowd
-  int solver;                     ///< Solver to use
+  int solver;                     ///< Solver to use (SOLVER_AUTO: chosen once A is loaded)
+  char* history;                  ///< Past solve times (see select_solver)
+  unsigned int load_flags;        ///< Options for loading matrices (see load_matrix_flags_t)
+  unsigned int cache_enabled;     ///< Load the input matrix through a binary cache (see load_matrix_cached)
+  char* cache_dir;                ///< Where the cache goes (NULL: next to the input)
 };
 
 int parse_args(int argc, char** argv, struct parse_args* args);
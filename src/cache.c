@@ -0,0 +1,340 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <stddef.h> // offsetof
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <libgen.h> // basename
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <assert.h>
+#include "cache.h"
+
+#define MC_CACHE_MAGIC "MCMATRIX"
+#define MC_CACHE_VERSION 2
+#define MC_CACHE_BYTE_ORDER 0x01020304u
+#define MC_CACHE_ALIGN 64 // bytes: a cache line, and an AVX-512 vector
+
+// the sections after the header
+enum { MC_CACHE_DD = 0, MC_CACHE_II, MC_CACHE_JJ, MC_CACHE_STATS, MC_CACHE_SECTIONS };
+
+// all fixed width, so the layout only changes with the version
+struct matrix_cache_header_t {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_bytes; // sizeof(struct matrix_cache_header_t)
+  uint32_t byte_order;   // MC_CACHE_BYTE_ORDER, as written
+  uint32_t stats_bytes;  // sizeof(struct matrix_stats_t)
+  uint64_t m, n, nz;
+  uint32_t base, format, sym, location, data_type, index_width, complex_storage, flags, block_size;
+  uint32_t load_flags;
+  uint64_t source_size;
+  int64_t source_mtime;
+  uint64_t source_dev, source_ino;
+  uint64_t offset[MC_CACHE_SECTIONS]; // from the start of the file
+  uint64_t bytes[MC_CACHE_SECTIONS];
+  uint64_t checksum;        // of the sections
+  uint64_t header_checksum; // of the header, up to here
+};
+
+char const* matrix_cache_strerror( int err ) {
+  switch ( err ) {
+    case 0:
+      return "success";
+    case -1:
+      return "memory allocation failure";
+    case -2:
+      return "can't open, read or write the file";
+    case -3:
+      return "unsupported matrix format";
+    case -4:
+      return "not a matrix cache, or from another version";
+    case -5:
+      return "out of date, the source has changed (or was loaded differently)";
+    case -6:
+      return "corrupt, checksum or sizes don't match";
+    default:
+      return "unknown";
+  }
+}
+
+int is_matrix_cache_file( char const* filename ) {
+  const size_t len = strlen( filename );
+  const size_t ext = strlen( MC_CACHE_EXT );
+  return ( len > ext ) && ( strcmp( filename + len - ext, MC_CACHE_EXT ) == 0 );
+}
+
+char* matrix_cache_path( char const* source, char const* dir ) {
+  char* name = strdup( source );
+  if ( name == NULL )
+    return NULL;
+  char const* const base = ( dir == NULL ) ? source : basename( name );
+  const size_t len = (( dir == NULL ) ? 0 : strlen( dir ) + 1 ) + strlen( base ) + strlen( MC_CACHE_EXT ) + 1;
+  char* const path = malloc( len );
+  if ( path != NULL ) {
+    if ( dir == NULL )
+      snprintf( path, len, "%s%s", base, MC_CACHE_EXT );
+    else
+      snprintf( path, len, "%s/%s%s", dir, base, MC_CACHE_EXT );
+  }
+  free( name );
+  return path;
+}
+
+int matrix_cache_key( char const* source, unsigned int load_flags, struct matrix_cache_key_t* key ) {
+  struct stat st;
+  if ( stat( source, &st ) != 0 )
+    return -2;
+  key->source_size = st.st_size;
+  key->source_mtime = ( int64_t ) st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+  key->load_flags = load_flags;
+  key->source_dev = st.st_dev;
+  key->source_ino = st.st_ino;
+  return 0;
+}
+
+// 64-bit checksum: four interleaved FNV-1a style lanes over 8-byte words, so
+// it keeps up with memory bandwidth
+static uint64_t _checksum( void const* p, const size_t len, uint64_t h ) {
+  const uint64_t prime = 0x100000001b3ULL;
+  uint64_t lane[4] = { h ^ 0x9e3779b97f4a7c15ULL, h ^ 0xbf58476d1ce4e5b9ULL, h ^ 0x94d049bb133111ebULL, h };
+  unsigned char const* c = p;
+  size_t i = 0;
+  for ( ; i + 32 <= len; i += 32 ) {
+    for ( int l = 0; l < 4; l++ ) {
+      uint64_t w;
+      memcpy( &w, c + i + 8 * l, 8 );
+      lane[l] = ( lane[l] ^ w ) * prime;
+    }
+  }
+  for ( ; i < len; i++ )
+    lane[i % 4] = ( lane[i % 4] ^ c[i] ) * prime;
+  h = len;
+  for ( int l = 0; l < 4; l++ )
+    h = ( h ^ lane[l] ^ ( lane[l] >> 29 ) ) * prime;
+  return h;
+}
+
+static inline uint64_t _align( const uint64_t x ) {
+  return ( x + MC_CACHE_ALIGN - 1 ) / MC_CACHE_ALIGN * MC_CACHE_ALIGN;
+}
+
+// bytes in A's dd, ii, jj arrays
+static void _section_bytes( matrix_t const* A, uint64_t bytes[MC_CACHE_SECTIONS] ) {
+  size_t ni, nj;
+  _index_lengths( A, &ni, &nj );
+  const size_t iw = ( A->index_width == MC_INDEX_64 ) ? sizeof( uint64_t ) : sizeof( unsigned int );
+  const size_t entries = (( A->format == DROW ) || ( A->format == DCOL ) ) ? A->m * A->n : A->nz;
+  bytes[MC_CACHE_DD] = ( A->dd == NULL ) ? 0 : entries * _data_width( A->data_type );
+  bytes[MC_CACHE_II] = ni * iw;
+  bytes[MC_CACHE_JJ] = nj * iw;
+  bytes[MC_CACHE_STATS] = sizeof( struct matrix_stats_t );
+}
+
+int matrix_cache_write( char const* filename, matrix_t* A, struct matrix_stats_t const* s,
+                        struct matrix_cache_key_t const* key ) {
+  assert( A != NULL );
+  if ( A->format == INVALID )
+    return -3;
+
+  struct matrix_stats_t stats;
+  if ( s == NULL ) {
+    const int ret = matrix_stats( A, &stats );
+    if ( ret != 0 )
+      return ( ret == -2 ) ? -1 : -3;
+    s = &stats;
+  }
+
+  struct matrix_cache_header_t h;
+  memset( &h, 0, sizeof( h ) );  // padding too: it is checksummed
+  memcpy( h.magic, MC_CACHE_MAGIC, sizeof( h.magic ) );
+  h.version = MC_CACHE_VERSION;
+  h.header_bytes = sizeof( h );
+  h.byte_order = MC_CACHE_BYTE_ORDER;
+  h.stats_bytes = sizeof( struct matrix_stats_t );
+  h.m = A->m;
+  h.n = A->n;
+  h.nz = A->nz;
+  h.base = A->base;
+  h.format = A->format;
+  h.sym = A->sym;
+  h.location = A->location;
+  h.data_type = A->data_type;
+  h.index_width = A->index_width;
+  h.complex_storage = A->complex_storage;
+  h.flags = A->flags;
+  h.block_size = A->block_size;
+  if ( key != NULL ) {
+    h.load_flags = key->load_flags;
+    h.source_size = key->source_size;
+    h.source_mtime = key->source_mtime;
+    h.source_dev = key->source_dev;
+    h.source_ino = key->source_ino;
+  }
+
+  void const* const section[MC_CACHE_SECTIONS] = {
+    A->dd,
+    ( A->index_width == MC_INDEX_64 ) ? ( void const* ) A->ii64 : ( void const* ) A->ii,
+    ( A->index_width == MC_INDEX_64 ) ? ( void const* ) A->jj64 : ( void const* ) A->jj,
+    s
+  };
+  _section_bytes( A, h.bytes );
+  uint64_t offset = _align( sizeof( h ) );
+  h.checksum = 0;
+  for ( int i = 0; i < MC_CACHE_SECTIONS; i++ ) {
+    h.offset[i] = offset;
+    offset = _align( offset + h.bytes[i] );
+    h.checksum = _checksum( section[i], h.bytes[i], h.checksum );
+  }
+  h.header_checksum = _checksum( &h, offsetof( struct matrix_cache_header_t, header_checksum ), 0 );
+
+  // write under a temporary name, then rename into place
+  const size_t len = strlen( filename ) + 8;
+  char* const tmp = malloc( len );
+  if ( tmp == NULL )
+    return -1;
+  snprintf( tmp, len, "%s.XXXXXX", filename );
+  const int fd = mkstemp( tmp );
+  if ( fd < 0 ) {
+    free( tmp );
+    return -2;
+  }
+  FILE* f = fdopen( fd, "w" );
+  int ok = ( f != NULL ) && ( fwrite( &h, sizeof( h ), 1, f ) == 1 );
+  uint64_t at = sizeof( h );
+  static const char zeros[MC_CACHE_ALIGN] = { 0 };
+  for ( int i = 0; ok && ( i < MC_CACHE_SECTIONS ); i++ ) {
+    ok = ( fwrite( zeros, 1, h.offset[i] - at, f ) == h.offset[i] - at ) &&
+         (( h.bytes[i] == 0 ) || ( fwrite( section[i], 1, h.bytes[i], f ) == h.bytes[i] ) );
+    at = h.offset[i] + h.bytes[i];
+  }
+  if ( f != NULL )
+    ok = ( fclose( f ) == 0 ) && ok;
+  else
+    close( fd );
+  // mkstemp() makes it private, a cache is as readable as any other file
+  ok = ok && ( chmod( tmp, 0644 ) == 0 ) && ( rename( tmp, filename ) == 0 );
+  if ( !ok )
+    unlink( tmp );
+  free( tmp );
+  return ok ? 0 : -2;
+}
+
+int matrix_cache_read( char const* filename, matrix_t* A, struct matrix_stats_t* s,
+                       struct matrix_cache_key_t const* key ) {
+  assert( A != NULL );
+  const int fd = open( filename, O_RDONLY );
+  if ( fd < 0 )
+    return -2;
+  struct stat st;
+  if ( fstat( fd, &st ) != 0 ) {
+    close( fd );
+    return -2;
+  }
+  if ( st.st_size < ( off_t ) sizeof( struct matrix_cache_header_t ) ) {
+    close( fd );
+    return -4;
+  }
+  const size_t size = st.st_size;
+  // private and writable: copy-on-write, should anything write to the arrays
+  char* const p = mmap( NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+  close( fd );
+  if ( p == MAP_FAILED )
+    return -2;
+
+  int ret = 0;
+  struct matrix_cache_header_t h;
+  memcpy( &h, p, sizeof( h ) );
+  if (( memcmp( h.magic, MC_CACHE_MAGIC, sizeof( h.magic ) ) != 0 ) || ( h.version != MC_CACHE_VERSION ) ||
+      ( h.header_bytes != sizeof( h ) ) || ( h.byte_order != MC_CACHE_BYTE_ORDER ) ||
+      ( h.stats_bytes != sizeof( struct matrix_stats_t ) ) )
+    ret = -4;
+  else if ( h.header_checksum != _checksum( &h, offsetof( struct matrix_cache_header_t, header_checksum ), 0 ) )
+    ret = -6;
+  else if (( key != NULL ) && (( h.source_size != key->source_size ) || ( h.source_mtime != key->source_mtime ) ||
+                               ( h.load_flags != key->load_flags ) || ( h.source_dev != key->source_dev ) ||
+                               ( h.source_ino != key->source_ino ) ) )
+    ret = -5;
+
+  matrix_t a = { 0 };
+  if ( ret == 0 ) {
+    a.m = h.m;
+    a.n = h.n;
+    a.nz = h.nz;
+    a.base = h.base;
+    a.format = h.format;
+    a.sym = h.sym;
+    a.location = h.location;
+    a.data_type = h.data_type;
+    a.index_width = h.index_width;
+    a.complex_storage = h.complex_storage;
+    a.flags = h.flags;
+    a.block_size = h.block_size;
+    a.owner = MC_OWN_BORROWED;
+    if (( a.format == INVALID ) || ( a.format > SM_BCSR ) || ( a.data_type > SM_PATTERN ) ||
+        (( a.format == SM_BCSR ) && ( a.block_size == 0 ) ) )
+      ret = -6;
+  }
+  if ( ret == 0 ) {
+    // the sizes must be what the header's matrix needs, and inside the file
+    uint64_t bytes[MC_CACHE_SECTIONS];
+    a.dd = ( h.bytes[MC_CACHE_DD] == 0 ) ? NULL : p;  // only tested for NULL
+    _section_bytes( &a, bytes );
+    uint64_t checksum = 0;
+    for ( int i = 0; ( ret == 0 ) && ( i < MC_CACHE_SECTIONS ); i++ ) {
+      if (( bytes[i] != h.bytes[i] ) || ( h.offset[i] % MC_CACHE_ALIGN != 0 ) || ( h.offset[i] > size ) ||
+          ( h.bytes[i] > size - h.offset[i] ) )
+        ret = -6;
+      else
+        checksum = _checksum( p + h.offset[i], h.bytes[i], checksum );
+    }
+    if (( ret == 0 ) && ( checksum != h.checksum ) )
+      ret = -6;
+  }
+  if ( ret != 0 ) {
+    munmap( p, size );
+    return ret;
+  }
+
+  void* const section[MC_CACHE_SECTIONS] = {
+    ( h.bytes[MC_CACHE_DD] == 0 ) ? NULL : p + h.offset[MC_CACHE_DD],
+    ( h.bytes[MC_CACHE_II] == 0 ) ? NULL : p + h.offset[MC_CACHE_II],
+    ( h.bytes[MC_CACHE_JJ] == 0 ) ? NULL : p + h.offset[MC_CACHE_JJ],
+    p + h.offset[MC_CACHE_STATS]
+  };
+  a.dd = section[MC_CACHE_DD];
+  if ( a.index_width == MC_INDEX_64 ) {
+    a.ii64 = section[MC_CACHE_II];
+    a.jj64 = section[MC_CACHE_JJ];
+  }
+  else {
+    a.ii = section[MC_CACHE_II];
+    a.jj = section[MC_CACHE_JJ];
+  }
+  if ( s != NULL )
+    memcpy( s, section[MC_CACHE_STATS], sizeof( struct matrix_stats_t ) );
+
+  clear_matrix( A );
+  *A = a;
+  return 0;
+}
@@ -0,0 +1,83 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+#include "config.h"
+#include <stdint.h>
+#include "matrix.h"
+#include "stats.h"
+
+// binary matrix cache (.mcb files)
+//
+// a matrix_t as it is in memory: a header (dimensions, format, base,
+// symmetry, flags, ...) then the dd, ii, jj (or ii64, jj64) arrays, each
+// 64-byte aligned, then the matrix_stats() of the matrix
+// the header carries a version and a checksum of itself and of the rest of
+// the file; values are in the byte order of the machine that wrote them
+//
+// reading maps the file into memory and points the matrix's arrays into it,
+// nothing is copied: the matrix is MC_OWN_BORROWED, so any conversion copies
+// the arrays first. The mapping is private (stray writes aren't written back)
+// and is kept until the program exits.
+
+#define MC_CACHE_EXT ".mcb"
+
+// what a cached matrix was made from: a cache is only used if the source
+// file hasn't changed and it was loaded the same way
+// the device and inode say which file it was: in a shared --cache-dir the
+// caches are named for the source's basename, which other directories reuse
+struct matrix_cache_key_t {
+  uint64_t source_size;
+  int64_t source_mtime; // nanoseconds
+  uint32_t load_flags;  // see load_matrix_flags_t
+  uint64_t source_dev, source_ino;
+};
+
+// 1 if 'filename' ends in MC_CACHE_EXT
+int is_matrix_cache_file( char const* filename );
+
+// malloc-ed name of the cache for 'source': in the directory 'dir', or next
+// to the source if dir is NULL ("source" MC_CACHE_EXT)
+// returns NULL on malloc failure
+char* matrix_cache_path( char const* source, char const* dir );
+
+// fill in 'key' for the file 'source' loaded with 'load_flags'
+// returns 0 on success, -2 can't stat the source
+int matrix_cache_key( char const* source, unsigned int load_flags, struct matrix_cache_key_t* key );
+
+// write A (and its statistics 's', found here if NULL) to 'filename'
+// the file is written under a temporary name and renamed into place, so a
+// reader never sees half a cache
+// key: stored to be checked by matrix_cache_read() (NULL: none)
+// returns 0 on success, <0 on failure (matrix_cache_strerror())
+int matrix_cache_write( char const* filename, matrix_t* A, struct matrix_stats_t const* s,
+                        struct matrix_cache_key_t const* key );
+
+// map the cache 'filename' into A (see above)
+// s: if not NULL, the stored statistics
+// key: if not NULL, the cache must have been written with the same key
+// returns 0 on success, <0 on failure (matrix_cache_strerror()), A is
+//   untouched on failure
+int matrix_cache_read( char const* filename, matrix_t* A, struct matrix_stats_t* s,
+                       struct matrix_cache_key_t const* key );
+
+char const* matrix_cache_strerror( int err );
+
+#endif
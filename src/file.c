@@ -18,12 +18,14 @@
  */
 #include "config.h"
 #include "file.h"
-#include <stdio.h> // fprintf, fopen, fclose, fgets
+#include <stdio.h> // fprintf
 #include <string.h> // strnlen, strcmp
-#include <ctype.h> // tolower
 #include <assert.h>
 
 #include "matrix.h"
+#include "readmm.h"
+#include "hb.h"
+#include "cache.h"
 
 #include <bebop/util/init.h>
 #include <bebop/util/enumerations.h>
@@ -51,629 +53,142 @@ int write_mat(char const * const filename, matrix_t * const A);
 //   Harwell-Boeing (CSC format),
 //   GAMFF (NASA Ames) (graphs, sparse matrices as HB?, dense matrices)
 
-// input FILE f
-// output object    is -1 unrecognized, 0 matrix
-//        format    is -1 unrecognized, 0 array, 1 coordinate
-//        datatype  is -1 unrecognized, 0 real, 1 integer, 2 complex, 3 pattern
-//        symmetry  is -1 unrecognized, 0 general, 1 symmetric, 2 skew-symmetric, 3 hermitian
-//        rows, cols, nz are dimensions of the matrix
-//        comments are malloc-ed copy of the comments from the file
-// returns  0 on success, <0 on failure (readmm_strerror(ret) for description)
-//         -1 if EOF before parsing header,
-//         -2 if not Matrix Market format
-//         -3 if long lines are encountered (MatrixMarket specifies max length of 1024)
-static inline int readmm_header(FILE* f, int* object, int* format, int* datatype, int* symmetry, int* rows, int* cols,
-                                int* nz, char** comments);
-static inline int readmm_data_dense(FILE* f, matrix_t* A, int datatype, int symmetry, int rows, int cols, int nz);
-static inline int readmm_data_sparse(FILE* f, matrix_t* A, int datatype, int symmetry, int rows, int cols, int nz);
-
-// read a MatrixMarket formatted file
-// input  'filename' to read
-//        'pref_dense_format'  - if the file turns out to be a dense matrix we'd prefer it to be stored in this format
-//           valid values: DCOL, DROW
-//        'pref_sparse_format' - if the file turns out to be a sparse matrix we'd prefer it to be stored in this format
-//           valid values: SM_COO, SM_CSC, SM_CSR
-// output '*A' is a pointer to the matrix structure to load the data into,
-//                   if NULL no data is loaded
-//        '**comments' is a pointer to a string that will be allocated, of all
-//                   comments collected from the file (for use with
-//                   structured comments, parsed by some other function,
-//                   if NULL, no comments are returned
-// returns  0 on success, <0 on failure
-//          readmm_error(ret) gives a string explaining the error
-int readmm(char const * const filename, matrix_t * const A, char** comments);
-
-char const * readmm_strerror(int err);
-
-char const * readmm_strerror(int err)
-{
-    char const * ret;
-    switch (err) {
-        case 0:
-            ret = "success";
-            break;
-        case -1:
-            ret = "memory allocation failure";
-            break;
-        case -2:
-            ret = "can't open file";
-            break;
-        case -3:
-            ret = "unexpected MatrixMarket header object (matrix)";
-            break;
-        case -4:
-            ret = "unrecognized MatrixMarket header format (coordinate or array)";
-            break;
-        case -5:
-            ret = "unrecognized MatrixMarket header data type";
-            break;
-        case -11:
-            ret = "EOF before header";
-            break;
-        case -12:
-            ret = "not MatrixMarket format, bad header";
-            break;
-        case -13:
-            ret = "lines exceeding 1024 characters";
-            break;
-        default:
-            ret = "unknown";
-            break;
-    }
-    return ret;
-}
+static int _identify_format_from_extension(char* n, enum sparse_matrix_file_format_t* ext, int is_input);
+static int _load_matrix_storage(matrix_t* A, unsigned int flags);
+static int _ends_with(char const* n, size_t s, char const* suffix);
 
-int readmm(char const * const filename, matrix_t * const A, char** comments)
+// load a matrix from file "n" into matrix A
+// returns 0: success, <0 failure
+int load_matrix(char* n, matrix_t* A, unsigned int flags)
 {
-    // references:
-    // [1] http://math.nist.gov/MatrixMarket/formats.html
-    // [2] The Matrix Market Exchange Formats: Initial Design,
-    //     R. F. Boisvert, R. Pozo, K. Remington,
-    //     Applied and Computational Mathematics Division, NIST
-    //     http://math.nist.gov/MatrixMarket/reports/MMformat.ps
-
-    // MatrixMarket format notes:
-    // sparse coordinate format: COO
-    // dense format: column-oriented (DCOL)
-    //   TODO to express a preference for DROW format, set that in the input matrix, 'A'
-    // type: real, complex, integer, pattern
-    // symmetry: general, symmetric, skew-symmetric, Hermitian
-    //   for symmetric types only the *lower triangular* portion is stored
-    //   for skew-symmetric matrices, diagonal is zero, so left out too
-
-    // require "%%MatrixMarket " as first 15 characters
-    // "%%MatrixMarket <object> <format> [qualifier ...]"
-    // object could be vector, matrix, directed graph
-    // format type is the storage format (coordinate, array)
-    // qualifiers are fields, symmetry, etc
-    // data is one entry per line
-    // additional restrictions:
-    //  * lines are limited 1024 characters
-    //  * blanks lines can appear in any line after the first
-    //  * data is separated by one or more "blanks" (spaces?)
-    //  * real data is floating-point decimal, optionally use E-format exponential
-    //  * all indices are 1-based
-    //  * text is case-insensitive
-
-    // expect sparse:
-    // "%%MatrixMarket matrix coordinate <datatype> <sym>"
-    // "%<comments>" -- zero or more lines
-    // "  <rows> <columns> <non-zeros>"
-    // "  <row> <col> <real>" -- indices are base-1, not base-0 REAL
-    // "  <row> <col> <real> <imag>" -- indices are base-1, not base-0 COMPLEX
-
-    // expect dense:
-    // "%%MatrixMarket matrix array <type> <sym>"
-    // "%<comments>" -- zero or more lines
-    // "<rows> <columns>"
-    // "<real>" -- REAL, column major order
-    // "<real> <imag>" -- COMPLEX
-
-    // additional restrictions: (kind of common-sense)
-    //  * for coordinate AND array, "Hermitian" matrix types can only be "complex"
-    //  * pattern matrices can only be coordinate format, and general or symmetric
-
-    // <format> = coordinate, array
-    // <datatype> = real, integer, complex, pattern
-    // <sym> = general, symmetric, skew-symmetric, hermitian
-
-    // Symmetry
-    // general: no symmetry
-    // symmetric A(i,j) = A(j,i)       (on or below diagonal) (square matrices)
-    // skew-symmetric A(i,j) = -A(j,i)       (below diagonal) (square matrices)
-    // hermitian      A(i,j) = A(j,i)* (on or below diagonal) (square matrices)
-
-    // extensions:
-    // * structured comments
-    // * format specializations (pretty printing?)
-    // * new object and format types
-    //    <object> = graphs, grids, vectors?
-    //    <format> = elemental (FEM), band, Toeplitz? (50% less storage or keen interest)
-
-    // example structured comments
-    //  "%%Harwell-Boeing collection"
-    //  "%"
-    //  "%HB FILE_NAME   abcd.mtx"
-    //  "%HB KEY         MMEXMPL1"
-    //  "%HB OBJECT      matrix"
-    //  "%HB FORMAT      coordinate"
-    //  "%HB QUALIFIRES  real general"
-    //  "%HB DESCRIPTION Unsymmetric matrix from example"
-    //  "%HB CONTRIBUTOR R. Boisvert (email@email.com)"
-    //  "%HB DATE        June 24, 1996"
-    //  "%HB PRECISION   4"
-    //  "%HB DATA_LINES  9"
-    //  "%"
-    //  "% some more comments"
-
-    // TODO could have verbose documentation about the format inside the file as comments
-
-    FILE* f = fopen(filename, "r");
-    if (f == NULL)
-        return -2;
-
-    int object, format, datatype, symmetry, rows, cols, nz;
-    int ret;
-    // NULL = ignoring comments
-    ret = readmm_header(f, &object, &format, &datatype, &symmetry, &rows, &cols, &nz, NULL);
-    if (ret < 0) {
-        fclose(f);
-        return ret - 10;
-    }
-    // output object    is -1 unrecognized, 0 matrix
-    //        format    is -1 unrecognized, 0 array, 1 coordinate
-    //        datatype  is -1 unrecognized, 0 real, 1 integer, 2 complex, 3 pattern
-    //        symmetry  is -1 unrecognized, 0 general, 1 symmetric, 2 skew-symmetric, 3 hermitian
-    //        rows, cols, nz are dimensions of the matrix
-    //        comments are malloc-ed copy of the comments from the file
-
-    // check we got the expected object type == matrix
-    if (object != 0) {
-        fclose(f);
-        return -3;
+    assert(A != NULL);
+    if (n == NULL) {
+        fprintf( stderr, "input error: No input specified (-i)\n");
+        return 1;  // failure
     }
-
+    // make sure we don't have a memory leak
     clear_matrix(A);
-    A->m = rows;
-    A->n = cols;
-    A->nz = nz;
-    A->base = FIRST_INDEX_ONE;
-    A->location = LOWER_TRIANGULAR;  // TODO test for this at the end and report error
-    switch (format) {
-        case 0:  // array
-            ret = readmm_data_dense(f, A, datatype, symmetry, rows, cols, nz);
-            break;
-        case 1:  // COO
-            ret = readmm_data_sparse(f, A, datatype, symmetry, rows, cols, nz);
-            break;
-        default:
-            ret = -4;
-    }
-
-    fclose(f);
-    return ret;
-}
 
-// consumes any leading spaces then reads the next avaiable int
-// input string ptr
-// outputs string ptr, first character after int
-//         integer i
-//         double k[2] = {real, imaginary}
-//         integer n, number of values: n = 1 for real, n = 2 for complex
-// returns 0 on success, -1 NaN, -2 not an int/double, -3 sscanf failure (conversion, errno has err code)
-static inline int convert_k(char const* const s, double* k, int* n);
-static inline int convert_ijk(char const * const s, int* i, int* j, double* k, int* n);
-static inline int convert_int(char const ** string, int* i);
-static inline int convert_float(char const ** string, double* i);
-
-int readmm_data_dense(FILE* f, matrix_t* A, int datatype, int symmetry, int rows, int cols, int nz)
-{
-    A->format = DCOL;
+    int ret;
+    // our own binary format: mapped rather than parsed, and stored after the
+    // flags, duplicates and symmetry were found
+    if (is_matrix_cache_file(n)) {
+        if ((ret = matrix_cache_read(n, A, NULL, NULL)) != 0) {
+            fprintf( stderr, "input error: %s: %s\n", n, matrix_cache_strerror(ret));
+            return ret;
+        }
+        if ((flags & MC_LOAD_MERGE_DUPLICATES) && !(A->flags & MC_MERGED)) {
+            if ((ret = merge_duplicate_entries(A)) != 0) {
+                fprintf( stderr, "input error: Failed to merge duplicate entries\n");
+                return ret;
+            }
+        }
+        return _load_matrix_storage(A, flags);
+    }
 
-    assert(symmetry == 0);  // TODO handle other symmetries, adjust nz
-    A->sym = SM_UNSYMMETRIC;
+    enum sparse_matrix_file_format_t ext;
+    if ((ret = _identify_format_from_extension(n, &ext, 1)) != 0)
+        return ret;
 
-    switch (datatype) {  // real, int, complex, pattern
-        case 0:
-            A->dd = malloc(nz * sizeof(double));
-            A->data_type = SM_REAL;
+    switch (ext) {
+        case MATRIX_MARKET:
+            ret = readmm(n, A, NULL);  // NULL = ignore comments
+            if (ret != 0)
+                fprintf( stderr, "input error: %s: %s\n", n, readmm_strerror(ret));
             break;
-        case 1:
-            A->dd = malloc(nz * sizeof(int));
-            assert(0);  // TODO can't handle int data
+        case MATLAB:
+            ret = read_mat(n, A);
             break;
-        case 2:
-            A->dd = malloc(nz * sizeof(double) * 2);
-            A->data_type = SM_COMPLEX;
+        case HARWELL_BOEING:
+            ret = readhb(n, A, NULL, NULL);  // NULL = ignore right-hand sides, solutions
+            if (ret != 0)
+                fprintf( stderr, "input error: %s: %s\n", n, hb_strerror(ret));
             break;
         default:
-            return -5;  // Note: can't have a dense format and pattern data type
-    }
-    if ((datatype != 3) && (A->dd == NULL)) {
-        return -1;  // malloc failure
-    }
-
-    // read in the data
-    double* d = A->dd;
-    const int CHARS = 1025;
-    char line[CHARS];
-    char* lp;
-    lp = "1";
-    while (lp != NULL) {
-        lp = fgets(line, CHARS, f);
+            fprintf( stderr, "input error: format not recognized");
     }
-
-    // get the data
-    int n;
-    int ret = convert_k(lp, d, &n);
-    if (ret != 0)
-        return ret - 20;  // bad data
-    if (((datatype == 0) && (n != 1)) || ((datatype == 2) && (n != 2)))
-        return -3;  //bad data (unexpected complex/real)
-
-    switch (datatype) {
-        case 0:  // real
-            d += 1;
-            break;
-        case 2:  // complex
-            d += 2;
-            break;
-        default:
-            assert(0);
-            break;
+    if (ret != 0) {
+        fprintf( stderr, "input error: Failed to load matrix\n");  // TODO move these printouts to main...
+        return ret;
     }
-    return 0;
-}
-
-// TODO refactor and merge with readmm_data_dense?
-int readmm_data_sparse(FILE* f, matrix_t* A, int datatype, int symmetry, int rows, int cols, int nz)
-{
-    A->format = SM_COO;
 
-    switch (symmetry) {  // 0 general, 1 symmetric, 2 skew-symmetric, 3 hermitian
-        case 0:
-            A->sym = SM_UNSYMMETRIC;
-            break;
-        case 1:
-            A->sym = SM_SYMMETRIC;
-            break;
-        case 2:
-            A->sym = SM_SKEW_SYMMETRIC;
-            break;
-        case 3:
-            A->sym = SM_HERMITIAN;
-            break;
-        default:
-            assert(0);  // shouldn't be able to get here (checked before now)
+    // one pass to find out what's already true, so the merge, symmetry
+    // detection and later conversions can skip sorting what is sorted
+    if ((ret = detect_matrix_flags(A)) != 0) {
+        fprintf( stderr, "input error: Failed to scan the matrix entries\n");
+        return ret;
     }
 
-    // allocate memory
-    A->ii = malloc(nz * sizeof(unsigned int));
-    A->jj = malloc(nz * sizeof(unsigned int));
-    switch (datatype) {  // real, int, complex, pattern
-        case 0:
-            A->dd = malloc(nz * sizeof(double));
-            A->data_type = SM_REAL;
-            break;
-        case 1:
-            A->dd = malloc(nz * sizeof(int));
-            assert(0);  // TODO can't handle int data
-            break;
-        case 2:
-            A->dd = malloc(nz * sizeof(double) * 2);
-            A->data_type = SM_COMPLEX;
-            break;
-        default:
-            return -5;  // Note: can't have a dense format and pattern data type
-    }
-    if ((A->ii == NULL) || (A->jj == NULL) || ((datatype != 3) && (A->dd == NULL)))
-        return -1;  // malloc failure
-
-    // read in the data
-    // TODO assert that its safe to cast these based on rows/cols/nz
-    int* ii = (int*) A->ii;
-    int* jj = (int*) A->jj;
-    double* d = A->dd;
-    const int CHARS = 1025;  //can only read 1024 chars per line
-    char line[CHARS];
-    char* lp = NULL;
-    int i;
-    for (i = 0; i < nz; i++) {
-        lp = fgets(line, CHARS, f);
-        if (lp == NULL)  // fgets returns NULL if assumed line is already beyond EOF
-            return -2;  // bad read
-
-        // get the data
-        int n;
-        int ret = convert_ijk(lp, ii, jj, d, &n);
-        if (ret != 0)
-            return ret - 20;  // bad data
-        if (((datatype == 0) && (n != 1)) || ((datatype == 2) && (n != 2)))
-            return -3;  //bad data (unexpected complex/real)
-
-        // advance the data pointers
-        ii++;
-        jj++;
-        switch (datatype) {
-            case 0:  // real
-                d += 1;
-                break;
-            case 2:  // complex
-                d += 2;
-                break;
-            default:
-                assert(0);
-                break;
+    // merge before looking for symmetry: duplicates could hide it
+    if (flags & MC_LOAD_MERGE_DUPLICATES) {
+        if ((ret = merge_duplicate_entries(A)) != 0) {
+            fprintf( stderr, "input error: Failed to merge duplicate entries\n");
+            return ret;
         }
     }
 
-    return 0;
+    if (A->sym == SM_UNSYMMETRIC)
+        detect_matrix_symmetry(A);
+
+    return _load_matrix_storage(A, flags);
 }
 
-static inline int is_eol(const char c);
-static inline int readmm_header(FILE* f, int* object, int* format, int* datatype, int* symmetry, int* rows, int* cols,
-                                int* nz, char** comments)
+// the last steps of loading: precision and ownership of the arrays
+static int _load_matrix_storage(matrix_t* A, unsigned int flags)
 {
-    assert(f != NULL);
-
-    // valid field types
-    const char* header[]     = { "%%matrixmarket", NULL };
-    const char* objects[]    = { "matrix", NULL };
-    const char* formats[]    = { "array", "coordinate", NULL };
-    const char* datatypes[]  = { "real", "integer", "complex", "pattern", NULL };
-    const char* symmetries[] = { "general", "symmetric", "skew-symmetric", "hermitian", NULL };
-
-    const int FIELDS = 5;
-    int dummy;
-    char const ** const fields[] = { header, objects, formats, datatypes, symmetries, NULL };
-    int * outputs[] = { &dummy, object, format, datatype, symmetry, NULL };
-
-    const int CHARS = 1025;
-    char line[CHARS];
-
-    // read the first line of the file (stops at EOF or newline, null terminated)
-    const char* lp = fgets(line, CHARS, f);
-    if (lp == NULL)
-        return -1;  // error or EOF w/ no characters
-
-    // initialize results
-    for (int i = 0; i < FIELDS; i++) {
-        *(outputs[i]) = -1;
-    }
-    *rows = *cols = *nz = 0;
-    if (comments != NULL) {
-        free(*comments);
-        *comments = NULL;
-    }
-
-    // loop through the strings to decode the header
-    int ret = 0;
-    char const **fp = fields[0];
-    int fi = 0;
-    lp = line;  // reset string ptr to start-of-line
-    while ((fp != NULL) && (ret == 0)) {
-        int sp = 0;
-        while ((fp[sp] != NULL) && (sp >= 0)) {
-            // compare the string
-            const size_t chars_in_string = strlen(fp[sp]);
-            if (strncasecmp(lp, fp[sp], chars_in_string) != 0) {
-                sp++;
-                continue;
-            }
-
-            // if it matches, check that the next character is ' ', '\n'
-            char const * const lpt = lp + chars_in_string;  // temporary pointer for looking ahead
-            if (!isspace(*lpt)) {
-                sp++;
-                continue;
-            }
-
-            // on match save result and set sp = -1 to break out of the loop
-            lp += chars_in_string;
-            *(outputs[fi]) = sp;
-            sp = -1;
+    int ret;
+    if (flags & MC_LOAD_SINGLE) {
+        const enum matrix_data_type_t t = (A->data_type == REAL_DOUBLE) ? REAL_SINGLE :
+                                          (A->data_type == COMPLEX_DOUBLE) ? COMPLEX_SINGLE : A->data_type;
+        if ((ret = convert_matrix_data_type(A, t)) != 0) {
+            fprintf( stderr, "input error: Failed to convert to single precision\n");
+            return ret;
         }
-        // see if we recognized this field, no need to go further if we're lost
-        if (*outputs[fi] == -1)
-            ret = -2;  // unrecognized format
-        fi++;
-        fp = fields[fi];
-
-        // and consume any leading spaces before looking at the next string
-        while (isblank(*lp))
-            lp++;
     }
-    // no need to go further if we're already confused
-    if (ret != 0)
-        return ret;
 
-    // store comments if requested
-    if (comments != NULL) {
-        assert(0);  // TODO unfinished code
-    }
-    else {  // just get past the comments
-        do {
-            // check for long lines which would screw up this parsing
-            // the first line ending aught to be in here somewhere...
-            while (isprint(*lp))
-                lp++;
-            if (!is_eol(*lp))
-                return -3;  // line too long
-
-            // read in the next line
-            lp = fgets(line, CHARS, f);
+    // later conversions then allocate from (and release to) the pool too
+    if (flags & MC_LOAD_POOL) {
+        if ((ret = convert_matrix_ownership(A, MC_OWN_POOL)) != 0) {
+            fprintf( stderr, "input error: Failed to move the matrix to the buffer pool\n");
+            return ret;
         }
-        while ((*lp == '%') || is_eol(*lp));
     }
-    // lp now points to the first non-blank line after the comments
-
-    // find matrix dimensions
-    if (*format == 0) {  // dense array, expecting "  <rows> <columns>"
-        int err1 = convert_int(&lp, rows);
-        int err2 = convert_int(&lp, cols);
-        *nz = (*rows) * (*cols);
 
-        if (err1 | err2)
-            return -2;
-    }
-    else {  // must be COO format, expecting "  <rows> <columns> <non-zeros>"
-        int err1 = convert_int(&lp, rows);
-        int err2 = convert_int(&lp, cols);
-        int err3 = convert_int(&lp, nz);
-
-        if (err1 | err2 | err3)
-            return -2;
-    }
-
-    // final check for end of line
-    while (isblank(*lp))
-        lp++;
-    if (!is_eol(*lp))
-        return -3;  // line too long
-
-    return ret;
-}
-
-int convert_k(char const * const s, double* k, int* n)
-{
-    int ret;
-    const char* sp = s;
-
-    // get the first value
-    *n = 1;
-    if ((ret = convert_float(&sp, k)) != 0)
-        return ret;
-
-    // see if there's more data on this line
-    while (isblank(*sp))
-        sp++;
-    if (is_eol(*sp))
-        return 0;
-
-    // must be another digit, assume we're dealing with complex data
-    *n = 2;
-    if ((ret = convert_float(&sp, k + 1)) != 0)
-        return ret;
-
-    // all done
-    return 0;
-}
-
-int convert_ijk(char const * const s, int* i, int* j, double* k, int* n)
-{
-    int ret;
-    const char* sp = s;
-
-    if ((ret = convert_int(&sp, i)) != 0)
-        return ret;
-
-    if ((ret = convert_int(&sp, j)) != 0)
-        return ret;
-
-    return convert_k(sp, k, n);
-}
-
-// assumes null terminated line!
-int convert_int(const char** s, int* i)
-{
-    // advance past any leading whitespace
-    while (isblank(**s))
-        *s += 1;
-
-    // check the next character is a digit
-    if (!isdigit(**s))
-        return -1;  // not a number
-
-    // check we then have only digits, followed by a space or line end
-    // otherwise it might be a float
-    char const * const sp = *s;  // save while we look-ahead
-    while (isdigit(**s))
-        *s += 1;
-    if (!isspace(**s))
-        return -2;  // not an int
-
-    // convert assuming we have an integer
-    const int n = sscanf(sp, "%d", i);
-    if (n == 1)
-        return 0;  // success
-    else
-        return -3;  // conversion failure (errno is set w/ info)
-}
-
-// assumes null terminated line!
-int convert_float(const char** s, double* i)
-{
-    // advance past any leading whitespace
-    while (isblank(**s))
-        *s += 1;
-
-    // check the next character is a digit
-    if ((!isdigit(**s)) && (**s != '-') && (**s != '+'))
-        return -1;  // not a number
-
-    // check we then have only digits, followed by a space or line end
-    // otherwise it might be a float
-    char const * const sp = *s;  // save while we look-ahead
-    while (isdigit(**s) || (**s == '.') || (**s == 'e') || (**s == 'E') || (**s == '-') || (**s == '+'))
-        *s += 1;
-    if (!isspace(**s))
-        return -2;  // not an int
-
-    // convert assuming we have an integer
-    const int n = sscanf(sp, "%lg", i);
-    if (n == 1)
-        return 0;  // success
-    else
-        return -3;  // conversion failure (errno is set w/ info)
-}
-
-int is_eol(const char c)
-{  // end of line excluding ' ' & \t
-    return isspace(c) && !isblank(c);
+    return 0;  // success
 }
 
-static int _identify_format_from_extension(char* n, enum sparse_matrix_file_format_t* ext, int is_input);
-
-// load a matrix from file "n" into matrix A
-// returns 0: success, <0 failure
-int load_matrix(char* n, matrix_t* A)
+int load_matrix_cached(char* n, matrix_t* A, unsigned int flags, char const* cache_dir, struct matrix_stats_t* stats)
 {
-    assert(A != NULL);
-    if (n == NULL) {
-        fprintf( stderr, "input error: No input specified (-i)\n");
-        return 1;  // failure
+    assert((A != NULL) && (stats != NULL));
+    if ((n == NULL) || is_matrix_cache_file(n)) {  // nothing to gain
+        int ret = load_matrix(n, A, flags);
+        return (ret != 0) ? ret : matrix_stats(A, stats);
     }
-    // make sure we don't have a memory leak
-    clear_matrix(A);
 
-    int ret;
-    enum sparse_matrix_file_format_t ext;
-    if ((ret = _identify_format_from_extension(n, &ext, 1)) != 0)
-        return ret;
+    // the pool is a choice of this run, not part of the cached matrix
+    const unsigned int cached_flags = flags & ~MC_LOAD_POOL;
+    struct matrix_cache_key_t key;
+    char* path = matrix_cache_path(n, cache_dir);
+    if ((path == NULL) || (matrix_cache_key(n, cached_flags, &key) != 0)) {
+        free(path);
+        return load_matrix(n, A, flags);  // reports the error
+    }
 
-    switch (ext) {
-        case MATRIX_MARKET:
-            ret = readmm(n, A, NULL);
-            break;  // NULL = ignore comments
-        case MATLAB:
-            ret = read_mat(n, A);
-            break;
-        case HARWELL_BOEING:
-            ret = 100;
-            assert(0);
-            break;  // shouldn't be able to get here
-        default:
-            fprintf( stderr, "input error: format not recognized");
+    int ret = matrix_cache_read(path, A, stats, &key);
+    if (ret == 0) {
+        free(path);
+        return _load_matrix_storage(A, flags);
     }
-    if (ret != 0) {
-        fprintf( stderr, "input error: Failed to load matrix\n");  // TODO move these printouts to main...
+
+    // missing or out of date: load the source and (re)write the cache
+    if (((ret = load_matrix(n, A, cached_flags)) != 0) || ((ret = matrix_stats(A, stats)) != 0)) {
+        free(path);
         return ret;
     }
-
-    if (A->sym == SM_UNSYMMETRIC)
-        detect_matrix_symmetry(A);
-
-    return 0;  // success
+    if ((ret = matrix_cache_write(path, A, stats, &key)) != 0)
+        fprintf( stderr, "warning: failed to write the cache %s: %s\n", path, matrix_cache_strerror(ret));
+    free(path);
+    return _load_matrix_storage(A, flags);
 }
 
 static inline
@@ -689,6 +204,12 @@ int save_matrix(matrix_t* AA, char* n)
     }
 
     int ret;
+    if (is_matrix_cache_file(n)) {
+        if ((ret = matrix_cache_write(n, AA, NULL, NULL)) != 0)
+            fprintf( stderr, "output error: %s: %s\n", n, matrix_cache_strerror(ret));
+        return ret;
+    }
+
     enum sparse_matrix_file_format_t ext;
     if ((ret = _identify_format_from_extension(n, &ext, 0)) != 0)
         return ret;
@@ -701,9 +222,10 @@ int save_matrix(matrix_t* AA, char* n)
             ret = write_mat(n, AA);
             break;
         case HARWELL_BOEING:
-            ret = 100;
-            assert(0);
-            break;  // shouldn't be able to get here
+            ret = writehb(n, AA, NULL, NULL, "created by " PACKAGE_STRING, NULL, _ends_with(n, strlen(n), ".rb"));
+            if (ret != 0)
+                fprintf( stderr, "output error: %s: %s\n", n, hb_strerror(ret));
+            break;
     }
     if (ret != 0)
         fprintf( stderr, "output error: Failed to store matrix\n");  // TODO move these printouts to main...
@@ -721,7 +243,13 @@ int writemm(char const* const filename, matrix_t* AA, char const * const comment
     assert(AA->base == FIRST_INDEX_ZERO);
 
     assert(AA->sym == SM_UNSYMMETRIC);
-    assert(AA->data_type == REAL_DOUBLE);
+    // single precision results are written as double, complex as (re, im) pairs
+    const int is_complex = (AA->data_type == COMPLEX_DOUBLE) || (AA->data_type == COMPLEX_SINGLE);
+    if ((ret = convert_matrix_data_type(AA, is_complex ? COMPLEX_DOUBLE : REAL_DOUBLE)) != 0)
+        return ret;
+    if ((ret = convert_matrix_complex_storage(AA, MC_COMPLEX_PAIRED)) != 0)
+        return ret;
+    assert((AA->data_type == REAL_DOUBLE) || (AA->data_type == COMPLEX_DOUBLE));
 
     // copy data into the BeBOP format
     struct sparse_matrix_t A;
@@ -736,7 +264,7 @@ int writemm(char const* const filename, matrix_t* AA, char const * const comment
     Acoo.val = AA->dd;
     Acoo.index_base = ZERO;
     Acoo.symmetry_type = UNSYMMETRIC;
-    Acoo.value_type = REAL;
+    Acoo.value_type = is_complex ? COMPLEX : REAL;
     Acoo.ownership = USER_DEALLOCATES;  // don't let BeBOP blow away our data
 
     save_sparse_matrix(filename, &A, ext);
@@ -751,34 +279,51 @@ inline unsigned int matrix_rows(const matrix_t* const A)
     return A->m;
 }
 
+// does n[0..s) end in 'suffix'?
+static int _ends_with(char const* n, size_t s, char const* suffix)
+{
+    const size_t l = strlen(suffix);
+    return (s > l) && (strncmp(n + s - l, suffix, l) == 0);
+}
+
 // identify the file format from the extension
 // return 0: success, 1: failure
 // Note: static -- only visible w/in this file
 static int _identify_format_from_extension(char* n, enum sparse_matrix_file_format_t* ext, int is_input)
 {
     size_t s = strnlen(n, 100);
+
+    // compressed MatrixMarket files, and tar archives of them such as
+    // SuiteSparse's Name.tar.gz (input only: see readmm.h)
+    int compressed = 0;
+    if (is_input) {
+        static char const* const suffix[] = { ".gz", ".zst", ".xz", NULL };
+        for (int i = 0; suffix[i] != NULL; i++) {
+            if (_ends_with(n, s, suffix[i])) {
+                s -= strlen(suffix[i]);
+                compressed = 1;
+                break;
+            }
+        }
+        if (_ends_with(n, s, ".tar") || _ends_with(n, s, ".tgz")) {
+            *ext = MATRIX_MARKET;
+            return 0;
+        }
+    }
     char *e = n + s - 4;
 
     // strcmp returned match
-    if ((s > 4) && (strncmp(e, ".mtx", 100) == 0)) {
+    if (_ends_with(n, s, ".mtx")) {
         *ext = MATRIX_MARKET;
         return 0;  // success
     }
-    else if ((s > 3) && (strncmp(e, ".hb", 100) == 0)) {
-        *ext = HARWELL_BOEING;
-        if (is_input)
-            fprintf( stderr, "input error: Sorry Harwell-Boeing reader is broken\n");
-        else
-            fprintf( stderr, "output error: Sorry Harwell-Boeing writer is broken\n");
-        return 1;  // failure
-    }
-    else if ((s > 3) && (strncmp(e, ".rb", 100) == 0)) {
-        *ext = HARWELL_BOEING;
-        if (is_input)
-            fprintf( stderr, "input error: Sorry Rutherford-Boeing reader is broken\n");
-        else
-            fprintf( stderr, "output error: Sorry Rutherford-Boeing writer is broken\n");
-        return 1;  // failure
+    else if (_ends_with(n, s, ".hb") || _ends_with(n, s, ".rb")) {
+        *ext = HARWELL_BOEING;  // Rutherford-Boeing too: see hb.h
+        if (compressed) {
+            fprintf( stderr, "input error: Compressed Harwell-Boeing and Rutherford-Boeing files are not supported\n");
+            return 1;  // failure
+        }
+        return 0;  // success
     }
     else if ((s > 4) && (strncmp(e - 1, ".mat", 100) == 0)) {
         *ext = MATLAB;
@@ -828,11 +373,25 @@ int write_mat(char const * const filename, matrix_t * const A)
         if (ret == 0) {
             // TODO check for integer overflow in cast from unsigned int -> int
             size_t dims[] = { A->m, A->n };
-            t = Mat_VarCreate("x", MAT_C_DOUBLE, MAT_T_DOUBLE, 2,  // always at least rank 2
-                              dims, A->dd, 0  // MAT_F_COMPLEX if complex, could avoid copying data: MAT_F_DONT_COPY_DATA if not sparse
-                              );
+            const int single = (A->data_type == REAL_SINGLE) || (A->data_type == COMPLEX_SINGLE);
+            const int is_complex = (A->data_type == COMPLEX_DOUBLE) || (A->data_type == COMPLEX_SINGLE);
+            // matio takes complex values split into real and imaginary parts
+            struct ComplexSplit z;
+            if (is_complex) {
+                if (convert_matrix_complex_storage(A, MC_COMPLEX_SPLIT) != 0)
+                    ret = 2;  // conversion failure
+                z.Re = A->dd;
+                z.Im = (char*) A->dd + A->nz * (_data_width(A->data_type) / 2);
+            }
+            if (ret == 0)
+                t = Mat_VarCreate("x", single ? MAT_C_SINGLE : MAT_C_DOUBLE, single ? MAT_T_SINGLE : MAT_T_DOUBLE, 2,  // always at least rank 2
+                                  dims, is_complex ? (void*) &z : A->dd, is_complex ? MAT_F_COMPLEX : 0  // could avoid copying data: MAT_F_DONT_COPY_DATA if not sparse
+                                  );
 
-            if (t == NULL) {
+            if (ret != 0) {
+                // conversion failure
+            }
+            else if (t == NULL) {
                 ret = 3;  // failed to malloc data for storage
             }
             else {
@@ -852,6 +411,24 @@ int write_mat(char const * const filename, matrix_t * const A)
 #endif
 }
 
+#ifdef HAVE_MATIO
+// matio holds complex values as separate real and imaginary arrays:
+// copy them into one allocation, split ("zomplex") storage
+// returns 0 on success
+static
+int read_mat_complex(matrix_t * const A, struct ComplexSplit const * const z)
+{
+    const size_t w = _data_width(A->data_type) / 2;  // one real
+    A->dd = malloc(2 * A->nz * w);
+    if ((A->dd == NULL) && (A->nz != 0))
+        return 5;  // malloc failure
+    memcpy(A->dd, z->Re, A->nz * w);
+    memcpy((char*) A->dd + A->nz * w, z->Im, A->nz * w);
+    A->complex_storage = MC_COMPLEX_SPLIT;
+    return 0;
+}
+#endif
+
 // load a .mat matlab matrix
 // will load the first matrix (sparse or dense) in the file
 // returns 0 on success
@@ -904,14 +481,11 @@ int read_mat(char const * const filename, matrix_t * const A)
     if (t->rank > 2 || t->rank <= 0) {  // number of dimensions
         ret = 2;
     }
-    else if (t->data_type != MAT_T_DOUBLE) {
+    else if ((t->data_type != MAT_T_DOUBLE) && ((t->data_type != MAT_T_SINGLE) || (t->class_type != MAT_C_SINGLE))) {
         if (LOCAL_DEBUG)
             printf("data_type=%d\n", t->data_type);
         ret = 3;
     }
-    else if (t->isComplex) {
-        ret = 10;  // TODO can't handle complex matrices yet
-    }
     else if (t->isLogical) {
         ret = 11;  // TODO can't handle logicals yet
     }
@@ -925,9 +499,11 @@ int read_mat(char const * const filename, matrix_t * const A)
             A->n = t->dims[1];  // cols
         }
         A->sym = SM_UNSYMMETRIC;
-        //if(t->data_type == MAT_T_DOUBLE) {
-        A->data_type = REAL_DOUBLE;
-        //} // TODO complex, single precision, various sized integers
+        if (t->isComplex)
+            A->data_type = (t->data_type == MAT_T_SINGLE) ? COMPLEX_SINGLE : COMPLEX_DOUBLE;
+        else
+            A->data_type = (t->data_type == MAT_T_SINGLE) ? REAL_SINGLE : REAL_DOUBLE;
+        // TODO various sized integers
 
         if (t->class_type == MAT_C_SPARSE) {  // t.data = sparse_t in CSC format
             // Note that Matlab will save('-v4'...) a sparse matrix
@@ -942,15 +518,23 @@ int read_mat(char const * const filename, matrix_t * const A)
             st->ir = NULL;
             A->jj = (unsigned int*) st->jc;
             st->jc = NULL;
-            A->dd = st->data;
-            st->data = NULL;
+            if (t->isComplex)
+                ret = read_mat_complex(A, st->data);
+            else {
+                A->dd = st->data;
+                st->data = NULL;
+            }
         }
-        else if (t->class_type == MAT_C_DOUBLE) {
+        else if ((t->class_type == MAT_C_DOUBLE) || (t->class_type == MAT_C_SINGLE)) {
             A->nz = A->m * A->n;
             A->format = DCOL;
-            // transfer the data pointer into our struct
-            A->dd = t->data;
-            t->data = NULL;
+            if (t->isComplex)
+                ret = read_mat_complex(A, t->data);
+            else {
+                // transfer the data pointer into our struct
+                A->dd = t->data;
+                t->data = NULL;
+            }
         }
         else {
             ret = 4;  // unknown class of data structure
@@ -21,10 +21,31 @@
 
 #include "config.h"
 #include "matrix.h"
+#include "stats.h"
+
+// options for load_matrix() (bit flags, may be or-ed together)
+enum load_matrix_flags_t {
+  MC_LOAD_DEFAULT = 0,
+  MC_LOAD_MERGE_DUPLICATES = 1, // sum repeated entries (ie. assembled FEM matrices)
+  MC_LOAD_SINGLE = 2,           // store values in single precision (REAL_SINGLE, COMPLEX_SINGLE)
+  MC_LOAD_POOL = 4              // keep the arrays in the buffer pool (MC_OWN_POOL, see mempool.h)
+};
 
 // load a matrix from file "n" into matrix A
+// ".mcb" files are binary caches (cache.h), written by save_matrix()
+// MatrixMarket files may be compressed (".mtx.gz", ".mtx.zst", ".mtx.xz")
+// or in a tar archive (".tar", ".tgz", ".tar.gz", ...): see readmm.h
+// ".hb" and ".rb" files are Harwell-Boeing and Rutherford-Boeing: see hb.h
+// flags: see load_matrix_flags_t
+// returns 0: success, <0: failure
+int load_matrix( char* n, matrix_t* A, unsigned int flags );
+
+// as load_matrix(), through a binary cache of the loaded matrix (cache.h):
+// "n".mcb in 'cache_dir', or next to "n" if cache_dir is NULL. A cache that
+// is missing or older than "n" is (re)written, otherwise it's mapped in
+// place of parsing "n". Also gives the matrix_stats() of A, cached with it.
 // returns 0: success, <0: failure
-int load_matrix( char* n, matrix_t* A );
+int load_matrix_cached( char* n, matrix_t* A, unsigned int flags, char const* cache_dir, struct matrix_stats_t* stats );
 
 // save a matrix into file "n" from matrix A
 // returns 0: success, 1: failure
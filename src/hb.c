@@ -0,0 +1,658 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include "hb.h"
+#include "readmm.h" // mm_buffer_open(), mm_parse_uint(), mm_parse_double()
+
+// references:
+// [1] I. S. Duff, R. G. Grimes, J. G. Lewis, "Users' Guide for the
+//     Harwell-Boeing Sparse Matrix Collection (Release I)", 1992
+// [2] I. S. Duff, R. G. Grimes, J. G. Lewis, "The Rutherford-Boeing Sparse
+//     Matrix Collection", RAL-TR-97-031, 1997
+
+// the header, one line ("card") each:
+//  1: title (A72), key (A8)
+//  2: totcrd, ptrcrd, indcrd, valcrd, rhscrd (5I14) -- Rutherford-Boeing has no rhscrd
+//  3: mxtype (A3), blank (11X), nrow, ncol, nnzero, neltvl (4I14)
+//  4: ptrfmt (A16), indfmt (A16), valfmt (A20), rhsfmt (A20) -- no valfmt for
+//     patterns, no rhsfmt for Rutherford-Boeing
+//  5: rhstyp (A3), blank (11X), nrhs, nrhsix (2I14) -- only if rhscrd > 0
+// then ptrcrd lines of column pointers, indcrd of row indices, valcrd of
+// values and rhscrd of right-hand sides, starting guesses and solutions,
+// each section starting on a new line
+//
+// mxtype: [RCPIQ] real, complex, pattern, integer (RB), pattern with the
+//                 values elsewhere (RB)
+//         [SUHZR] symmetric, unsymmetric, Hermitian, skew-symmetric,
+//                 rectangular
+//         [AE]    assembled, elemental
+// rhstyp: [FM] full or sparse (same pattern as the matrix)
+//         [G ] starting guesses follow the right-hand sides
+//         [X ] then the exact solutions
+
+#define HB_LINE 80 // columns
+
+// a Fortran format for one section: "([kP[,]]rCw[.d][Ee])" with C one of
+// I, E, D, F, G
+// width 0: a format we don't understand, so the fields are taken to be
+// separated by blanks
+struct hb_format_t {
+  int per_line;  // r
+  int width;     // w
+  int decimals;  // d: implied decimal places, for fields without a '.'
+  int scale;     // k: fields without an exponent are divided by 10^k
+};
+static const struct hb_format_t hb_free_format = { 0, 0, 0, 0 };
+
+char const* hb_strerror( int err ) {
+  switch ( err ) {
+    case 0:
+      return "success";
+    case -1:
+      return "memory allocation failure";
+    case -2:
+      return "can't open file";
+    case -3:
+      return "can't be written (Rutherford-Boeing right-hand sides, or mismatched sizes)";
+    case -6:
+      return "unexpected end of file, fewer values than the header promised";
+    case -11:
+      return "EOF before header";
+    case -12:
+      return "not Harwell-Boeing or Rutherford-Boeing format, bad header";
+    case -13:
+      return "unsupported matrix type (elemental)";
+    case -14:
+      return "unsupported right-hand side type (sparse)";
+    case -21:
+      return "not a number";
+    case -22:
+      return "malformed number or index out of range";
+    case -23:
+      return "column pointers out of order";
+    default:
+      return "unknown";
+  }
+}
+
+// the line at p: its length (without the newline or a '\r' before it),
+// and '*next' is the start of the line after it
+static size_t _line( char const* p, char const* end, char const** next ) {
+  char const* e = memchr( p, '\n', end - p );
+  *next = ( e == NULL ) ? end : e + 1;
+  if ( e == NULL )
+    e = end;
+  if (( e > p ) && ( e[-1] == '\r' ) )
+    e--;
+  return e - p;
+}
+
+// the start of the line n lines on from p
+static char const* _skip_lines( char const* p, char const* end, size_t n ) {
+  for ( ; ( n > 0 ) && ( p < end ); n-- )
+    _line( p, end, &p );
+  return p;
+}
+
+static inline int _is_blank( const char c ) {
+  return ( c == ' ' ) || ( c == '\t' ) || ( c == '\r' );
+}
+
+// up to 'n' unsigned integers separated by blanks in p[0..len)
+// returns how many there were
+static int _header_ints( char const* p, const size_t len, unsigned long long* v, const int n ) {
+  char const* const end = p + len;
+  int i = 0;
+  for ( ; i < n; i++ ) {
+    while (( p < end ) && _is_blank( *p ) )
+      p++;
+    if (( p == end ) || (( p = mm_parse_uint( p, end, 1ULL << 62, v + i ) ) == NULL ) )
+      break;
+  }
+  return i;
+}
+
+// parse the format in s[0..len) (between the parentheses)
+static void _parse_format( char const* s, const size_t len, struct hb_format_t* f ) {
+  *f = hb_free_format;
+  char b[32];
+  size_t n = 0;
+  for ( size_t i = 0; i < len; i++ ) {  // Fortran ignores blanks, and case
+    if ( _is_blank( s[i] ) )
+      continue;
+    if ( n == sizeof( b ) - 1 )
+      return;
+    b[n++] = toupper(( unsigned char ) s[i] );
+  }
+  b[n] = '\0';
+
+  char const* q = b;
+  char* e;
+  long x = strtol( q, &e, 10 );
+  int scale = 0;
+  if ( *e == 'P' ) {  // "kP" or "kP,"
+    scale = x;
+    q = e + 1 + ( e[1] == ',' );
+    x = strtol( q, &e, 10 );
+  }
+  const long r = ( e == q ) ? 1 : x;
+  q = e;
+  if (( *q == '\0' ) || ( strchr( "IEDFG", *q ) == NULL ) )
+    return;
+  const char c = *q++;
+  const long w = strtol( q, &e, 10 );
+  q = e;
+  long d = 0;
+  if ( *q == '.' ) {
+    d = strtol( q + 1, &e, 10 );
+    q = e;
+  }
+  if (( c != 'I' ) && ( *q == 'E' ) ) {  // exponent digits: no matter when reading
+    strtol( q + 1, &e, 10 );
+    q = e;
+  }
+  if (( *q != '\0' ) || ( r < 1 ) || ( r > HB_LINE ) || ( w < 1 ) || ( w > HB_LINE ) || ( d < 0 ) || ( d > w ) )
+    return;
+  f->per_line = r;
+  f->width = w;
+  f->decimals = ( c == 'I' ) ? 0 : d;
+  f->scale = scale;
+}
+
+// the formats on line 4: one per pair of parentheses
+static int _parse_formats( char const* p, const size_t len, struct hb_format_t* f, const int n ) {
+  char const* const end = p + len;
+  int i = 0;
+  for ( ; i < n; i++ ) {
+    char const* const s = memchr( p, '(', end - p );
+    char const* const e = ( s == NULL ) ? NULL : memchr( s, ')', end - s );
+    if ( e == NULL )
+      break;
+    _parse_format( s + 1, e - s - 1, f + i );
+    p = e + 1;
+  }
+  for ( int j = i; j < n; j++ )
+    f[j] = hb_free_format;
+  return i;
+}
+
+// one field, s[0..len): an integer (ii != NULL, 1..max) or a value (d,
+// either may be NULL to skip it)
+// blanks are ignored and a blank field is zero, as in Fortran
+// returns 0 on success, <0 on failure (see hb_strerror())
+static int _parse_field( char const* s, const size_t len, struct hb_format_t const* f, const unsigned long long max,
+                         unsigned int* ii, double* d ) {
+  // the usual case: one number with blanks around it, in a form the
+  // MatrixMarket parsers take as it is
+  char const* p = s;
+  char const* e = s + len;
+  while (( p < e ) && ( *p == ' ' ) )
+    p++;
+  while (( e > p ) && ( e[-1] == ' ' ) )
+    e--;
+  if ( p < e ) {
+    unsigned long long x;
+    double v;
+    if ( ii != NULL ) {
+      if (( mm_parse_uint( p, e, max, &x ) == e ) && ( x > 0 ) ) {
+        *ii = x;
+        return 0;
+      }
+    }
+    else if ((( f->decimals == 0 ) || ( memchr( p, '.', e - p ) != NULL ) ) &&
+             (( f->scale == 0 ) || ( memchr( p, 'E', e - p ) != NULL ) || ( memchr( p, 'e', e - p ) != NULL ) ) &&
+             ( mm_parse_double( p, e, &v ) == e ) ) {
+      if ( d != NULL )
+        *d = v;
+      return 0;
+    }
+  }
+
+  // otherwise, as Fortran reads it
+  char b[72];
+  size_t n = 0;
+  int dot = 0, exponent = 0;
+  for ( size_t i = 0; i < len; i++ ) {
+    char c = s[i];
+    if ( _is_blank( c ) )
+      continue;
+    if ( n >= sizeof( b ) - 8 )  // room for a '.' and an exponent
+      return -22;
+    if (( c == 'D' ) || ( c == 'd' ) || ( c == 'E' ) || ( c == 'e' ) || ( c == 'Q' ) || ( c == 'q' ) ) {
+      c = 'E';
+      exponent = 1;
+    }
+    else if ((( c == '+' ) || ( c == '-' ) ) && ( n > 0 ) && ( b[n - 1] != 'E' ) ) {
+      b[n++] = 'E';  // "1.0-100": an exponent too large for its letter
+      exponent = 1;
+    }
+    dot |= ( c == '.' );
+    b[n++] = c;
+  }
+  b[n] = '\0';
+
+  if ( ii != NULL ) {
+    unsigned long long x = 0;
+    if (( n == 0 ) || ( mm_parse_uint( b, b + n, max, &x ) != b + n ) || ( x == 0 ) )
+      return (( n > 0 ) && ( b[0] >= '0' ) && ( b[0] <= '9' ) ) ? -22 : -21;
+    *ii = x;
+    return 0;
+  }
+
+  if ( n == 0 ) {
+    if ( d != NULL )
+      *d = 0.0;
+    return 0;
+  }
+  if ( !dot && ( f->decimals > 0 ) ) {
+    // Fw.d, Ew.d: the last d digits of the mantissa are the fraction
+    char* const e = strchr( b, 'E' );
+    const size_t m = ( e == NULL ) ? n : ( size_t )( e - b );
+    const size_t sign = ( b[0] == '+' ) || ( b[0] == '-' );
+    const size_t pad = ( m - sign < ( size_t ) f->decimals ) ? f->decimals - ( m - sign ) : 0;
+    if ( n + pad + 1 >= sizeof( b ) - 8 )
+      return -22;
+    memmove( b + sign + pad, b + sign, n - sign + 1 );
+    memset( b + sign, '0', pad );
+    n += pad;
+    const size_t at = sign + ( m - sign + pad ) - f->decimals;
+    memmove( b + at + 1, b + at, n - at + 1 );
+    b[at] = '.';
+    n++;
+  }
+  if ( !exponent && ( f->scale != 0 ) )  // kP: the field is the value times 10^k
+    n += snprintf( b + n, sizeof( b ) - n, "E%d", -f->scale );
+
+  double x;
+  if ( mm_parse_double( b, b + n, &x ) != b + n )
+    return (( b[0] >= '0' ) && ( b[0] <= '9' ) ) || ( b[0] == '-' ) || ( b[0] == '+' ) || ( b[0] == '.' ) ? -22 : -21;
+  if ( d != NULL )
+    *d = x;
+  return 0;
+}
+
+// read 'n' numbers from the lines at p..end, into ii (integers, 1..max) or
+// d (values; both NULL: skip them): 'per_line' fields of 'width'
+// characters per line (a short line is padded with blanks), or with no
+// format, separated by blanks
+// returns 0 on success, <0 on failure, and '*next' is the start of the line
+// after the last one read
+static int _read_numbers( char const* p, char const* end, struct hb_format_t const* f, const size_t n,
+                          const unsigned long long max, unsigned int* ii, double* d, char const** next ) {
+  size_t k = 0;
+  int ret = 0;
+  char const* q;
+  if ( f->width > 0 ) {
+    for ( ; ( ret == 0 ) && ( k < n ); p = q ) {
+      if ( p >= end )
+        return -6;
+      const size_t len = _line( p, end, &q );
+      for ( size_t c = 0; ( ret == 0 ) && ( c < ( size_t ) f->per_line ) && ( k < n ); c++, k++ ) {
+        const size_t s = c * f->width;
+        const size_t w = ( s >= len ) ? 0 : ( len - s < ( size_t ) f->width ) ? len - s : ( size_t ) f->width;
+        ret = _parse_field( p + s, w, f, max, ( ii != NULL ) ? ii + k : NULL, ( d != NULL ) ? d + k : NULL );
+      }
+    }
+  }
+  else {
+    for ( ; ( ret == 0 ) && ( k < n ); k++ ) {
+      while (( p < end ) && ( _is_blank( *p ) || ( *p == '\n' ) ) )
+        p++;
+      if ( p == end )
+        return -6;
+      char const* const s = p;
+      while (( p < end ) && !_is_blank( *p ) && ( *p != '\n' ) )
+        p++;
+      ret = _parse_field( s, p - s, f, max, ( ii != NULL ) ? ii + k : NULL, ( d != NULL ) ? d + k : NULL );
+    }
+    if ( ret == 0 )
+      _line( p, end, &p );
+  }
+  *next = p;
+  return ret;
+}
+
+// CSC column pointers (base one): from 1 to nz+1, never decreasing
+static int _check_pointers( unsigned int const* p, const size_t n, const size_t nz ) {
+  if (( p[0] != 1 ) || ( p[n - 1] != nz + 1 ) )
+    return -23;
+  for ( size_t i = 1; i < n; i++ ) {
+    if ( p[i] < p[i - 1] )
+      return -23;
+  }
+  return 0;
+}
+
+// _read_numbers(), and if the fields don't make sense in the format given,
+// again taking them to be separated by blanks
+// pointers: also check ii holds column pointers to nz entries
+static int _read_section( char const* p, char const* end, struct hb_format_t const* f, const size_t n,
+                          const unsigned long long max, unsigned int* ii, double* d, const int pointers,
+                          const size_t nz ) {
+  char const* next;
+  int ret = _read_numbers( p, end, f, n, max, ii, d, &next );
+  if (( ret == 0 ) && pointers )
+    ret = _check_pointers( ii, n, nz );
+  if (( ret != 0 ) && ( f->width > 0 ) ) {
+    const struct hb_format_t blanks = { 0, 0, 0, f->scale };
+    int r = _read_numbers( p, end, &blanks, n, max, ii, d, &next );
+    if (( r == 0 ) && pointers )
+      r = _check_pointers( ii, n, nz );
+    if ( r == 0 )
+      ret = 0;
+  }
+  return ret;
+}
+
+// the right-hand sides, starting guesses and solutions: each 'n' values
+// starting on a new line (B, X may be NULL to skip them)
+static int _read_rhs( char const* p, char const* end, struct hb_format_t const* f, const size_t n, const int guess,
+                      const int solution, double* B, double* X ) {
+  int ret = _read_numbers( p, end, f, n, 0, NULL, B, &p );
+  if (( ret == 0 ) && guess )
+    ret = _read_numbers( p, end, f, n, 0, NULL, NULL, &p );
+  if (( ret == 0 ) && solution )
+    ret = _read_numbers( p, end, f, n, 0, NULL, X, &p );
+  return ret;
+}
+
+// a dense m x n matrix (DCOL) for right-hand sides or solutions
+static int _dense( matrix_t* M, const size_t m, const size_t n, const enum matrix_data_type_t t ) {
+  clear_matrix( M );
+  M->m = m;
+  M->n = n;
+  M->nz = m * n;
+  M->format = DCOL;
+  M->data_type = t;
+  M->dd = malloc( m * n * _data_width( t ) );
+  return (( m * n > 0 ) && ( M->dd == NULL ) ) ? -1 : 0;
+}
+
+static int _readhb( char const* p, char const* end, matrix_t* A, matrix_t* B, matrix_t* X ) {
+  // the header: four lines, and a fifth if there are right-hand sides
+  char const* line[5];
+  size_t len[5];
+  for ( int i = 0; i < 4; i++ ) {
+    if ( p >= end )
+      return -11;
+    line[i] = p;
+    len[i] = _line( p, end, &p );
+  }
+
+  unsigned long long crd[5] = { 0 };
+  const int ncrd = _header_ints( line[1], len[1], crd, 5 );
+  if ( ncrd < 4 )
+    return -12;
+  const size_t ptrcrd = crd[1], indcrd = crd[2], valcrd = crd[3], rhscrd = ( ncrd == 5 ) ? crd[4] : 0;
+
+  if ( len[2] < 3 )
+    return -12;
+  char type[4];
+  for ( int i = 0; i < 3; i++ )
+    type[i] = toupper(( unsigned char ) line[2][i] );
+  type[3] = '\0';
+  unsigned long long dim[4] = { 0 };
+  if ( _header_ints( line[2] + 3, len[2] - 3, dim, 4 ) < 3 )
+    return -12;
+  if (( strchr( "RCPIQ", type[0] ) == NULL ) || ( strchr( "SUHZR", type[1] ) == NULL ) ||
+      ( strchr( "AE", type[2] ) == NULL ) || ( type[0] == '\0' ) || ( type[1] == '\0' ) || ( type[2] == '\0' ) )
+    return -12;
+  if ( type[2] == 'E' )
+    return -13;
+  const size_t nrow = dim[0], ncol = dim[1], nz = dim[2];
+  if (( dim[0] > INT_MAX ) || ( dim[1] > INT_MAX ) || ( dim[2] >= UINT_MAX ) || ( dim[2] > dim[0] * dim[1] ) )
+    return -12;
+
+  // formats: pointers, indices, values (not for patterns), right-hand sides
+  const int pattern = ( type[0] == 'P' ) || ( type[0] == 'Q' );
+  const int values = ( type[0] == 'C' ) ? 2 : pattern ? 0 : 1;
+  struct hb_format_t fmt[4];
+  _parse_formats( line[3], len[3], fmt, pattern ? 3 : 4 );
+  struct hb_format_t const* const ptrfmt = fmt;
+  struct hb_format_t const* const indfmt = fmt + 1;
+  struct hb_format_t const* const valfmt = fmt + 2;
+  struct hb_format_t const* const rhsfmt = fmt + ( pattern ? 2 : 3 );
+
+  char rhstyp[4] = "   ";
+  unsigned long long nrhs = 0;
+  if ( rhscrd > 0 ) {
+    if ( p >= end )
+      return -11;
+    line[4] = p;
+    len[4] = _line( p, end, &p );
+    if (( len[4] < 3 ) || ( _header_ints( line[4] + 3, len[4] - 3, &nrhs, 1 ) != 1 ) || ( nrhs > INT_MAX ) )
+      return -12;
+    for ( int i = 0; i < 3; i++ )
+      rhstyp[i] = toupper(( unsigned char ) line[4][i] );
+  }
+
+  clear_matrix( A );
+  A->m = nrow;
+  A->n = ncol;
+  A->nz = nz;
+  A->base = FIRST_INDEX_ONE;
+  A->format = SM_CSC;
+  switch ( type[1] ) {
+    case 'S':
+      A->sym = SM_SYMMETRIC;
+      break;
+    case 'Z':
+      A->sym = SM_SKEW_SYMMETRIC;
+      break;
+    case 'H':
+      A->sym = SM_HERMITIAN;
+      break;
+    default:  // unsymmetric, rectangular
+      A->sym = SM_UNSYMMETRIC;
+  }
+  A->location = ( A->sym == SM_UNSYMMETRIC ) ? MC_STORE_BOTH : LOWER_TRIANGULAR;
+  A->data_type = pattern ? SM_PATTERN : ( values == 2 ) ? COMPLEX_DOUBLE : REAL_DOUBLE;
+  A->jj = malloc(( ncol + 1 ) * sizeof( unsigned int ) );
+  A->ii = malloc( nz * sizeof( unsigned int ) );
+  if ( !pattern )
+    A->dd = malloc( nz * values * sizeof( double ) );
+  if (( A->jj == NULL ) || (( nz > 0 ) && (( A->ii == NULL ) || ( !pattern && ( A->dd == NULL ) ) ) ) )
+    return -1;
+
+  // each section starts where the line counts say
+  char const* const ptr = p;
+  char const* const ind = _skip_lines( ptr, end, ptrcrd );
+  char const* const val = _skip_lines( ind, end, indcrd );
+  char const* const rhs = _skip_lines( val, end, valcrd );
+
+  int ret = _read_section( ptr, end, ptrfmt, ncol + 1, nz + 1, A->jj, NULL, 1, nz );
+  if ( ret == 0 )
+    ret = _read_section( ind, end, indfmt, nz, nrow, A->ii, NULL, 0, nz );
+  if (( ret == 0 ) && !pattern )
+    ret = _read_section( val, end, valfmt, nz * values, 0, NULL, A->dd, 0, nz );
+  if ( ret != 0 )
+    return ret;
+
+  // right-hand sides, if wanted
+  if ( B != NULL )
+    clear_matrix( B );
+  if ( X != NULL )
+    clear_matrix( X );
+  if (( rhscrd == 0 ) || ( nrhs == 0 ) || (( B == NULL ) && ( X == NULL ) ) )
+    return 0;
+  if ( rhstyp[0] != 'F' )
+    return -14;
+  const int guess = ( rhstyp[1] == 'G' ), solution = ( rhstyp[2] == 'X' );
+  const enum matrix_data_type_t t = ( values == 2 ) ? COMPLEX_DOUBLE : REAL_DOUBLE;
+  if (( B != NULL ) && (( ret = _dense( B, nrow, nrhs, t ) ) != 0 ) )
+    return ret;
+  if (( X != NULL ) && solution && (( ret = _dense( X, nrow, nrhs, t ) ) != 0 ) )
+    return ret;
+  const size_t n = nrow * nrhs * (( values == 2 ) ? 2 : 1 );
+  double* const b = ( B != NULL ) ? B->dd : NULL;
+  double* const x = (( X != NULL ) && solution ) ? X->dd : NULL;
+  ret = _read_rhs( rhs, end, rhsfmt, n, guess, solution, b, x );
+  if (( ret != 0 ) && ( rhsfmt->width > 0 ) ) {
+    const struct hb_format_t blanks = { 0, 0, 0, rhsfmt->scale };
+    if ( _read_rhs( rhs, end, &blanks, n, guess, solution, b, x ) == 0 )
+      ret = 0;
+  }
+  return ret;
+}
+
+int readhb( char const* filename, matrix_t* A, matrix_t* B, matrix_t* X ) {
+  struct mm_buffer_t b;
+  int ret = mm_buffer_open( filename, &b );
+  if ( ret != 0 )
+    return ret;
+  ret = _readhb( b.p, b.p + b.len, A, B, X );
+  mm_buffer_close( &b );
+  return ret;
+}
+
+// a format for integers up to 'max': as many fields as fit on a line, each
+// wide enough for a blank before the number
+static void _int_format( unsigned long long max, struct hb_format_t* f, char* s, const size_t len ) {
+  int w = 2;
+  for ( ; max >= 10; max /= 10 )
+    w++;
+  f->width = w;
+  f->per_line = HB_LINE / w;
+  snprintf( s, len, "(%dI%d)", f->per_line, w );
+}
+
+// lines needed for n numbers
+static size_t _lines( const size_t n, struct hb_format_t const* f ) {
+  return ( n + f->per_line - 1 ) / f->per_line;
+}
+
+// the numbers in ii (integers) or d (values), in the fields of 'f'
+static int _write_numbers( FILE* file, struct hb_format_t const* f, const size_t n, unsigned int const* ii,
+                           double const* d ) {
+  for ( size_t k = 0; k < n; k++ ) {
+    if ( ii != NULL )
+      fprintf( file, "%*u", f->width, ii[k] );
+    else
+      fprintf( file, "%*.16E", f->width, d[k] );
+    if ((( k + 1 ) % f->per_line == 0 ) || ( k + 1 == n ) )
+      fputc( '\n', file );
+  }
+  return ferror( file ) ? -2 : 0;
+}
+
+// double precision, complex values in (re, im) pairs
+static int _write_precision( matrix_t* M ) {
+  if ( M->data_type == SM_PATTERN )
+    return 0;
+  const int is_complex = ( M->data_type == COMPLEX_DOUBLE ) || ( M->data_type == COMPLEX_SINGLE );
+  int ret = convert_matrix_data_type( M, is_complex ? COMPLEX_DOUBLE : REAL_DOUBLE );
+  if ( ret == 0 )
+    ret = convert_matrix_complex_storage( M, MC_COMPLEX_PAIRED );
+  return ret;
+}
+
+int writehb( char const* filename, matrix_t* A, matrix_t* B, matrix_t* X, char const* title, char const* key,
+             int rutherford ) {
+  if (( rutherford && (( B != NULL ) || ( X != NULL ) ) ) || (( X != NULL ) && ( B == NULL ) ) )
+    return -3;
+  if (( B != NULL ) && (( B->m != A->m ) || (( X != NULL ) && (( X->m != B->m ) || ( X->n != B->n ) ) ) ) )
+    return -3;
+
+  // CSC, base one: symmetric matrices as their lower triangle, unless both
+  // triangles are stored (then it's written as unsymmetric)
+  int ret = convert_matrix( A, SM_CSC, FIRST_INDEX_ONE );
+  const int sym = ( A->sym != SM_UNSYMMETRIC ) && ( A->location != MC_STORE_BOTH );
+  if (( ret == 0 ) && sym && ( A->location != LOWER_TRIANGULAR ) )
+    ret = convert_matrix_symmetry( A, LOWER_TRIANGULAR );
+  if (( ret == 0 ) && ( A->index_width != MC_INDEX_32 ) )
+    ret = convert_matrix_index_width( A, MC_INDEX_32 );
+  if ( ret == 0 )
+    ret = _write_precision( A );
+  const int cplx = ( A->data_type == COMPLEX_DOUBLE );
+  for ( int i = 0; ( ret == 0 ) && ( i < 2 ); i++ ) {
+    matrix_t* const M = ( i == 0 ) ? B : X;
+    if ( M == NULL )
+      continue;
+    ret = convert_matrix( M, DCOL, FIRST_INDEX_ZERO );
+    if ( ret == 0 )
+      ret = _write_precision( M );
+    if (( ret == 0 ) && (( M->data_type == COMPLEX_DOUBLE ) != cplx ) )
+      ret = -3;  // the right-hand sides have the matrix's type
+  }
+  if ( ret != 0 )
+    return ( ret == -3 ) ? -3 : -1;
+
+  // formats and line counts
+  const int pattern = ( A->data_type == SM_PATTERN );
+  const size_t values = cplx ? 2 : 1;
+  struct hb_format_t ptrfmt, indfmt;
+  const struct hb_format_t valfmt = { 3, 25, 16, 1 };
+  char ptrs[17], inds[17], vals[21] = "(1P,3E25.16)";
+  _int_format( A->nz + 1, &ptrfmt, ptrs, sizeof( ptrs ) );
+  _int_format( A->m, &indfmt, inds, sizeof( inds ) );
+  if ( pattern )
+    vals[0] = '\0';
+  const size_t nrhs = ( B != NULL ) ? B->n : 0;
+  const size_t rhsn = A->m * nrhs * values;
+  const size_t ptrcrd = _lines( A->n + 1, &ptrfmt );
+  const size_t indcrd = _lines( A->nz, &indfmt );
+  const size_t valcrd = pattern ? 0 : _lines( A->nz * values, &valfmt );
+  const size_t rhscrd = _lines( rhsn, &valfmt ) * (( X != NULL ) ? 2 : 1 );
+
+  char type[4] = { pattern ? 'P' : cplx ? 'C' : 'R', 'U', 'A', '\0' };
+  if ( sym )
+    type[1] = ( A->sym == SM_SYMMETRIC ) ? 'S' : ( A->sym == SM_SKEW_SYMMETRIC ) ? 'Z' : 'H';
+  else if ( A->m != A->n )
+    type[1] = 'R';
+  if ( rutherford ) {  // lower case, by convention
+    for ( int i = 0; i < 3; i++ )
+      type[i] = tolower(( unsigned char ) type[i] );
+  }
+
+  FILE* const f = fopen( filename, "w" );
+  if ( f == NULL )
+    return -2;
+  fprintf( f, "%-72.72s%-8.8s\n", ( title != NULL ) ? title : "", ( key != NULL ) ? key : "" );
+  if ( rutherford )
+    fprintf( f, "%14zu%14zu%14zu%14zu\n", ptrcrd + indcrd + valcrd, ptrcrd, indcrd, valcrd );
+  else
+    fprintf( f, "%14zu%14zu%14zu%14zu%14zu\n", ptrcrd + indcrd + valcrd + rhscrd, ptrcrd, indcrd, valcrd, rhscrd );
+  fprintf( f, "%-3s%11s%14zu%14zu%14zu%14d\n", type, "", A->m, A->n, A->nz, 0 );
+  if ( rhscrd > 0 )
+    fprintf( f, "%-16s%-16s%-20s%s\n", ptrs, inds, vals, vals[0] ? vals : "(1P,3E25.16)" );
+  else if ( pattern )
+    fprintf( f, "%-16s%s\n", ptrs, inds );
+  else
+    fprintf( f, "%-16s%-16s%s\n", ptrs, inds, vals );
+  if ( rhscrd > 0 )
+    fprintf( f, "%-3s%11s%14zu%14d\n", ( X != NULL ) ? "F X" : "F", "", nrhs, 0 );
+
+  ret = _write_numbers( f, &ptrfmt, A->n + 1, A->jj, NULL );
+  if ( ret == 0 )
+    ret = _write_numbers( f, &indfmt, A->nz, A->ii, NULL );
+  if (( ret == 0 ) && !pattern )
+    ret = _write_numbers( f, &valfmt, A->nz * values, NULL, A->dd );
+  if (( ret == 0 ) && ( B != NULL ) )
+    ret = _write_numbers( f, &valfmt, rhsn, NULL, B->dd );
+  if (( ret == 0 ) && ( X != NULL ) )
+    ret = _write_numbers( f, &valfmt, rhsn, NULL, X->dd );
+  if (( fclose( f ) != 0 ) && ( ret == 0 ) )
+    ret = -2;
+  return ret;
+}
@@ -0,0 +1,61 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _HB_H_
+#define _HB_H_
+
+#include "config.h"
+#include "matrix.h"
+
+// Harwell-Boeing (.hb) and Rutherford-Boeing (.rb) reader and writer
+//
+// both store a matrix by columns, so it is read straight into SM_CSC (base
+// one) with no conversion or sort. The numbers are in fixed-width fields, as
+// the Fortran formats in the header say: "(16I5)", "(1P,4E20.12)", ...
+// (D exponents, exponents without a letter, implied decimal places and
+// scale factors included). Files whose fields don't match their formats
+// but are separated by blanks are read too.
+// Symmetric, skew-symmetric and Hermitian matrices hold their lower
+// triangle. Elemental matrices and sparse right-hand sides aren't supported.
+
+// read a Harwell-Boeing or Rutherford-Boeing file
+// input  'filename' to read
+// output '*A' the matrix: SM_CSC, base one, REAL_DOUBLE (real and integer
+//             types), COMPLEX_DOUBLE or SM_PATTERN
+//        '*B', '*X' if not NULL, the right-hand sides and the exact
+//             solutions that follow the matrix in a Harwell-Boeing file:
+//             DCOL, one column per right-hand side, cleared (m=n=0) if there are none.
+//             Starting guesses are skipped.
+// returns  0 on success, <0 on failure
+//          hb_strerror(ret) gives a string explaining the error
+int readhb( char const* filename, matrix_t* A, matrix_t* B, matrix_t* X );
+
+// write a Harwell-Boeing (rutherford = 0) or Rutherford-Boeing file
+// 'A' is converted in place to SM_CSC, base one, double precision
+// (symmetric matrices keep their lower triangle); 'B' and 'X' (Harwell-Boeing
+// only, may be NULL) are converted to DCOL and must have A's rows
+// 'title' (72 characters) and 'key' (8) may be NULL
+// values are written with 17 significant digits, enough to read them back
+// bit for bit
+// returns  0 on success, <0 on failure (see hb_strerror())
+int writehb( char const* filename, matrix_t* A, matrix_t* B, matrix_t* X, char const* title, char const* key,
+             int rutherford );
+
+char const* hb_strerror( int err );
+
+#endif
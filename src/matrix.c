@@ -18,111 +18,86 @@
  */
 #include "config.h"
 #include "matrix.h"
+#include "mempool.h"
 
 #include <stdlib.h>
+#include <stdio.h>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
 #include <assert.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
-// TODO rm these
-#include <bebop/util/init.h>
-#include <bebop/util/enumerations.h>
-#include <bebop/smc/sparse_matrix.h>
-#include <bebop/smc/sparse_matrix_ops.h>
-#include <bebop/smc/coo_matrix.h>
-#include <bebop/smc/csr_matrix.h>
-#include <bebop/smc/csc_matrix.h>
+// below this much work (entries touched), threading isn't worth the start-up cost
+#define MC_OMP_MIN_WORK (1 << 16)
 
-static inline int _realloc_arrays(matrix_t* m, size_t nz);
+// either sort order (see matrix_flags_t)
+#define MC_SORTED (MC_SORTED_BY_ROW | MC_SORTED_BY_COL)
 
-// sort by i=0: row, i=1: column
-struct _qsort_coo_data_double
+static inline int _realloc_arrays(matrix_t* m, size_t nz);
+static inline int _omp_threads(const size_t work);
+static inline int _kernel_storage(matrix_t* m);
+static inline void _entry_get(void const* dd, const size_t k, const enum matrix_data_type_t t, double* re, double* im);
+static inline void _entry_set(void* dd, const size_t k, const enum matrix_data_type_t t, const double re, const double im);
+static inline int _close(const double x, const double y, const double tol);
+static inline int _own_arrays(matrix_t* m);
+
+// allocate and release a matrix's arrays (and the temporaries of its
+// conversions) according to its owner: the buffer pool or malloc
+// borrowed arrays are never released (see _own_arrays())
+static inline void* _m_malloc(matrix_t const* m, const size_t size)
 {
-  unsigned int ii;
-  unsigned int jj;
-  double dd;
-} _qsort_coo_data_double;
-
-static void _qsort_coo(matrix_t* m, int i);
-static int _qsort_coo_cmp_rows_cols(const void* a, const void* b);
-static int _qsort_coo_cmp_cols_rows(const void* a, const void* b);
+  return (m->owner == MC_OWN_POOL) ? mempool_malloc(size) : malloc(size);
+}
 
-// TODO this is quick, dirty and cheap.. can be much improved and maybe avoid the two extra copies for SPEED
-static void _qsort_coo(matrix_t* m, int x)
+static inline void* _m_calloc(matrix_t const* m, const size_t n, const size_t size)
 {
-  assert(m->format == SM_COO);
-  assert(m->data_type == REAL_DOUBLE);
-
-  struct _qsort_coo_data_double* data = malloc((m->nz) * sizeof(_qsort_coo_data_double));
-  assert(data != NULL);
-
-  for (unsigned int i = 0; i < m->nz; i++) {
-    (data[i]).ii = m->ii[i];
-    (data[i]).jj = m->jj[i];
-    (data[i]).dd = ((double*) m->dd)[i];
-  }
-
-  if (x == 0)
-    qsort(data, m->nz, sizeof(struct _qsort_coo_data_double), &_qsort_coo_cmp_rows_cols);
-  else
-    qsort(data, m->nz, sizeof(struct _qsort_coo_data_double), &_qsort_coo_cmp_cols_rows);
-
-  for (unsigned int i = 0; i < m->nz; i++) {
-    m->ii[i] = data[i].ii;
-    m->jj[i] = data[i].jj;
-    ((double*) m->dd)[i] = data[i].dd;
-  }
+  return (m->owner == MC_OWN_POOL) ? mempool_calloc(n, size) : calloc(n, size);
+}
 
-  free(data);
+static inline void* _m_realloc(matrix_t const* m, void* p, const size_t size)
+{
+  assert(m->owner != MC_OWN_BORROWED);
+  return (m->owner == MC_OWN_POOL) ? mempool_realloc(p, size) : realloc(p, size);
 }
 
-static int _qsort_coo_cmp_rows_cols(const void* a, const void* b)
+static inline void _m_free(matrix_t const* m, void* p)
 {
-  const struct _qsort_coo_data_double* aa = a;
-  const struct _qsort_coo_data_double* bb = b;
-  if ((*aa).ii < (*bb).ii) {
-    return -1;
-  }
-  else if ((*aa).ii > (*bb).ii) {
-    return +1;
-  }
-  else {
-    if ((*aa).jj < (*bb).jj)
-      return -1;
-    else if ((*aa).jj > (*bb).jj)
-      return +1;
-    else
-      return 0;
-  }
+  if (m->owner == MC_OWN_POOL)
+    mempool_free(p);
+  else if (m->owner == MC_OWN_MALLOC)
+    free(p);
 }
 
-static int _qsort_coo_cmp_cols_rows(const void* a, const void* b)
+// number of OpenMP threads to use for a kernel touching 'work' entries
+// (1 if built without OpenMP or the problem is too small)
+static inline int _omp_threads(const size_t work)
 {
-  const struct _qsort_coo_data_double* aa = a;
-  const struct _qsort_coo_data_double* bb = b;
-  if ((*aa).jj < (*bb).jj) {
-    return -1;
-  }
-  else if ((*aa).jj > (*bb).jj) {
-    return +1;
-  }
-  else {
-    if ((*aa).ii < (*bb).ii)
-      return -1;
-    else if ((*aa).ii > (*bb).ii)
-      return +1;
-    else
-      return 0;
-  }
+#ifdef _OPENMP
+  if (work >= MC_OMP_MIN_WORK)
+    return omp_get_max_threads();
+#endif
+  return 1;
 }
 
+// COO sort, by row then column (by_col = 0) or column then row (by_col = 1)
+// stable, nthreads > 1 uses OpenMP when available
+// returns non-zero on malloc failure (matrix is left unchanged)
+int _sort_coo(matrix_t* m, const int by_col, int nthreads);
+
 inline matrix_t* malloc_matrix()
 {
   matrix_t* m = malloc(sizeof(matrix_t));
   // make this safe to free_matrix() whatever comes out of this
   if (m != NULL) {
     m->format = INVALID;
+    m->owner = MC_OWN_MALLOC;
     m->ii = NULL;
     m->jj = NULL;
+    m->ii64 = NULL;
+    m->jj64 = NULL;
     m->dd = NULL;
   }
   return m;
@@ -131,9 +106,11 @@ inline matrix_t* malloc_matrix()
 inline void free_matrix(matrix_t* m)
 {
   if (m != NULL) {
-    free(m->dd);
-    free(m->ii);
-    free(m->jj);
+    _m_free(m, m->dd);
+    _m_free(m, m->ii);
+    _m_free(m, m->jj);
+    _m_free(m, m->ii64);
+    _m_free(m, m->jj64);
     free(m);
   }
 }
@@ -141,9 +118,11 @@ inline void free_matrix(matrix_t* m)
 inline void clear_matrix(matrix_t* m)
 {
   assert(m != NULL);
-  free(m->dd);
-  free(m->ii);
-  free(m->jj);
+  _m_free(m, m->dd);
+  _m_free(m, m->ii);
+  _m_free(m, m->jj);
+  _m_free(m, m->ii64);
+  _m_free(m, m->jj64);
   *m = ( matrix_t ) { 0 };  // assign all zeros
 }
 
@@ -167,7 +146,34 @@ inline size_t _data_width(const enum matrix_data_type_t t)
   return 0;
 }
 
-// deep copy
+// number of entries in the ii and jj arrays for this format
+inline void _index_lengths(matrix_t const* m, size_t* ni, size_t* nj)
+{
+  switch (m->format) {
+    case SM_COO:
+      *ni = *nj = m->nz;
+      break;
+    case SM_CSR:
+      *ni = m->m + 1;
+      *nj = m->nz;
+      break;
+    case SM_CSC:
+      *ni = m->nz;
+      *nj = m->n + 1;
+      break;
+    case SM_BCSR:  // block rows, blocks
+      *ni = (m->m + m->block_size - 1) / m->block_size + 1;
+      *nj = m->nz / ((size_t) m->block_size * m->block_size);
+      break;
+    default:  // dense, invalid: no indices
+      *ni = *nj = 0;
+      break;
+  }
+  if (m->nz == 0)  // empty matrices don't hold ptr arrays either
+    *ni = *nj = 0;
+}
+
+// deep copy, with the same owner (a copy of borrowed arrays is malloc-ed)
 // TODO const correctness
 matrix_t* copy_matrix(matrix_t* m)
 {
@@ -178,8 +184,12 @@ matrix_t* copy_matrix(matrix_t* m)
     return NULL;
 
   *ret = *m;  // shallow copy
+  if (ret->owner == MC_OWN_BORROWED)
+    ret->owner = MC_OWN_MALLOC;
 
   // if its an invalid matrix, this is a quick job
+  ret->ii64 = NULL;
+  ret->jj64 = NULL;
   if (ret->format == INVALID) {
     ret->nz = 0;
     ret->dd = NULL;
@@ -204,7 +214,7 @@ matrix_t* copy_matrix(matrix_t* m)
     else
       n = m->nz;
 
-    ret->dd = malloc(n * dwidth);  // nz entries
+    ret->dd = _m_malloc(ret, n * dwidth);  // nz entries
 
     // malloc failed
     if (ret->dd == NULL) {
@@ -215,21 +225,43 @@ matrix_t* copy_matrix(matrix_t* m)
     memcpy(ret->dd, m->dd, n * dwidth);  // memcpy(*dest,*src,n)
   }
 
+  // handle indices: ii64, jj64
+  if (m->index_width == MC_INDEX_64) {
+    size_t ni, nj;
+    _index_lengths(m, &ni, &nj);
+    if (ni != 0)
+      ret->ii64 = _m_malloc(ret, ni * sizeof(uint64_t));
+    if (nj != 0)
+      ret->jj64 = _m_malloc(ret, nj * sizeof(uint64_t));
+    if (((ni != 0) && (ret->ii64 == NULL)) || ((nj != 0) && (ret->jj64 == NULL))) {  // malloc failed
+      _m_free(ret, ret->ii64);
+      _m_free(ret, ret->jj64);
+      _m_free(ret, ret->dd);
+      free(ret);
+      return NULL;
+    }
+    if (ni != 0)
+      memcpy(ret->ii64, m->ii64, ni * sizeof(uint64_t));
+    if (nj != 0)
+      memcpy(ret->jj64, m->jj64, nj * sizeof(uint64_t));
+    return ret;
+  }
+
   // handle indices: ii, jj
   switch (m->format) {
     case SM_COO:
-      ret->ii = malloc((m->nz) * sizeof(unsigned int));
+      ret->ii = _m_malloc(ret, (m->nz) * sizeof(unsigned int));
       if (ret->ii == NULL) {  // malloc failed
-        free(ret->dd);
+        _m_free(ret, ret->dd);
         free(ret);
         return NULL;
       }
       memcpy(ret->ii, m->ii, (m->nz) * sizeof(unsigned int));  // memcpy(*dest,*src,n)
 
-      ret->jj = malloc((m->nz) * sizeof(unsigned int));
+      ret->jj = _m_malloc(ret, (m->nz) * sizeof(unsigned int));
       if (ret->jj == NULL) {  // malloc failed
-        free(ret->ii);
-        free(ret->dd);
+        _m_free(ret, ret->ii);
+        _m_free(ret, ret->dd);
         free(ret);
         return NULL;
       }
@@ -237,18 +269,18 @@ matrix_t* copy_matrix(matrix_t* m)
       break;
 
     case SM_CSR:
-      ret->ii = malloc((m->m + 1) * sizeof(unsigned int));
+      ret->ii = _m_malloc(ret, (m->m + 1) * sizeof(unsigned int));
       if (ret->ii == NULL) {  // malloc failed
-        free(ret->dd);
+        _m_free(ret, ret->dd);
         free(ret);
         return NULL;
       }
       memcpy(ret->ii, m->ii, (m->m + 1) * sizeof(unsigned int));  // memcpy(*dest,*src,n)
 
-      ret->jj = malloc((m->nz) * sizeof(unsigned int));
+      ret->jj = _m_malloc(ret, (m->nz) * sizeof(unsigned int));
       if (ret->jj == NULL) {  // malloc failed
-        free(ret->ii);
-        free(ret->dd);
+        _m_free(ret, ret->ii);
+        _m_free(ret, ret->dd);
         free(ret);
         return NULL;
       }
@@ -256,24 +288,42 @@ matrix_t* copy_matrix(matrix_t* m)
       break;
 
     case SM_CSC:
-      ret->jj = malloc((m->n + 1) * sizeof(unsigned int));
+      ret->jj = _m_malloc(ret, (m->n + 1) * sizeof(unsigned int));
       if (ret->jj == NULL) {  // malloc failed
-        free(ret->dd);
+        _m_free(ret, ret->dd);
         free(ret);
         return NULL;
       }
       memcpy(ret->jj, m->jj, (m->n + 1) * sizeof(unsigned int));  // memcpy(*dest,*src,n)
 
-      ret->ii = malloc((m->nz) * sizeof(unsigned int));
+      ret->ii = _m_malloc(ret, (m->nz) * sizeof(unsigned int));
       if (ret->ii == NULL) {  // malloc failed
-        free(ret->jj);
-        free(ret->dd);
+        _m_free(ret, ret->jj);
+        _m_free(ret, ret->dd);
         free(ret);
         return NULL;
       }
       memcpy(ret->ii, m->ii, (m->nz) * sizeof(unsigned int));  // memcpy(*dest,*src,n)
       break;
 
+    case SM_BCSR:
+    {
+      size_t ni, nj;
+      _index_lengths(m, &ni, &nj);
+      ret->ii = _m_malloc(ret, ni * sizeof(unsigned int));
+      ret->jj = _m_malloc(ret, nj * sizeof(unsigned int));
+      if ((ret->ii == NULL) || (ret->jj == NULL)) {  // malloc failed
+        _m_free(ret, ret->ii);
+        _m_free(ret, ret->jj);
+        _m_free(ret, ret->dd);
+        free(ret);
+        return NULL;
+      }
+      memcpy(ret->ii, m->ii, ni * sizeof(unsigned int));
+      memcpy(ret->jj, m->jj, nj * sizeof(unsigned int));
+      break;
+    }
+
     case DROW:
     case DCOL:  // dense matrix
     case INVALID:  // invalid matrix
@@ -285,6 +335,218 @@ matrix_t* copy_matrix(matrix_t* m)
   return ret;
 }
 
+// the largest value held in ii/jj is an index (< rows or columns) or,
+// for CSR/CSC/BCSR, a pointer (<= nz), plus the base
+enum matrix_index_width_t matrix_index_width_required(matrix_t const* m)
+{
+  assert(m != NULL);
+  size_t max = (m->m > m->n) ? m->m : m->n;
+  if ((m->format == SM_COO) || (m->format == SM_CSR) || (m->format == SM_CSC) || (m->format == SM_BCSR))
+    max = (m->nz > max) ? m->nz : max;
+  if (max + m->base <= UINT_MAX)
+    return MC_INDEX_32;
+  return MC_INDEX_64;
+}
+
+int convert_matrix_index_width(matrix_t* m, const enum matrix_index_width_t w)
+{
+  assert(m != NULL);
+  if (m->index_width == w)
+    return 0;  // nothing to do
+  if ((w == MC_INDEX_32) && (matrix_index_width_required(m) != MC_INDEX_32))
+    return -1;  // won't fit
+  if (_own_arrays(m) != 0)
+    return -2;
+
+  size_t ni, nj;
+  _index_lengths(m, &ni, &nj);
+  if (w == MC_INDEX_64) {
+    uint64_t* const ii = (ni != 0) ? _m_malloc(m, ni * sizeof(uint64_t)) : NULL;
+    uint64_t* const jj = (nj != 0) ? _m_malloc(m, nj * sizeof(uint64_t)) : NULL;
+    if (((ni != 0) && (ii == NULL)) || ((nj != 0) && (jj == NULL))) {
+      _m_free(m, ii);
+      _m_free(m, jj);
+      return -2;
+    }
+    for (size_t k = 0; k < ni; k++)
+      ii[k] = m->ii[k];
+    for (size_t k = 0; k < nj; k++)
+      jj[k] = m->jj[k];
+    _m_free(m, m->ii);
+    _m_free(m, m->jj);
+    m->ii = m->jj = NULL;
+    m->ii64 = ii;
+    m->jj64 = jj;
+  }
+  else {
+    unsigned int* const ii = (ni != 0) ? _m_malloc(m, ni * sizeof(unsigned int)) : NULL;
+    unsigned int* const jj = (nj != 0) ? _m_malloc(m, nj * sizeof(unsigned int)) : NULL;
+    if (((ni != 0) && (ii == NULL)) || ((nj != 0) && (jj == NULL))) {
+      _m_free(m, ii);
+      _m_free(m, jj);
+      return -2;
+    }
+    for (size_t k = 0; k < ni; k++)
+      ii[k] = m->ii64[k];
+    for (size_t k = 0; k < nj; k++)
+      jj[k] = m->jj64[k];
+    _m_free(m, m->ii64);
+    _m_free(m, m->jj64);
+    m->ii64 = m->jj64 = NULL;
+    m->ii = ii;
+    m->jj = jj;
+  }
+  m->index_width = w;
+  return 0;
+}
+
+int convert_matrix_data_type(matrix_t* m, const enum matrix_data_type_t t)
+{
+  assert(m != NULL);
+  const enum matrix_data_type_t from = m->data_type;
+  if (from == t)
+    return 0;  // nothing to do
+  const int from_real = (from == REAL_DOUBLE) || (from == REAL_SINGLE);
+  const int to_real = (t == REAL_DOUBLE) || (t == REAL_SINGLE);
+  const int from_complex = (from == COMPLEX_DOUBLE) || (from == COMPLEX_SINGLE);
+  const int to_complex = (t == COMPLEX_DOUBLE) || (t == COMPLEX_SINGLE);
+  const int is_real = from_real && to_real;
+  const int is_complex = from_complex && to_complex;
+  if (!is_real && !is_complex && !(from_real && to_complex))
+    return -1;  // would lose data
+
+  // values held: a (real, imaginary) pair is two
+  size_t n = ((m->format == DROW) || (m->format == DCOL)) ? m->m * m->n : m->nz;
+  if ((m->format == INVALID) || (n == 0) || (m->dd == NULL)) {
+    m->data_type = t;
+    return 0;
+  }
+  if (_own_arrays(m) != 0)
+    return -2;
+
+  if (from_real && to_complex) {  // widen: (re, 0) pairs
+    void* const dd = _m_malloc(m, n * _data_width(t));
+    if (dd == NULL)
+      return -2;
+    for (size_t k = 0; k < n; k++) {
+      double re, im;
+      _entry_get(m->dd, k, from, &re, &im);
+      _entry_set(dd, k, t, re, im);
+    }
+    _m_free(m, m->dd);
+    m->dd = dd;
+    m->data_type = t;
+    m->complex_storage = MC_COMPLEX_PAIRED;
+    return 0;
+  }
+
+  // precision only: element by element, so paired and split layouts are both kept
+  if (is_complex)
+    n *= 2;
+  const int to_single = (t == REAL_SINGLE) || (t == COMPLEX_SINGLE);
+  void* const dd = _m_malloc(m, n * (to_single ? sizeof(float) : sizeof(double)));
+  if (dd == NULL)
+    return -2;
+  if (to_single) {
+    double const* const src = m->dd;
+    float* const dst = dd;
+    for (size_t k = 0; k < n; k++)
+      dst[k] = src[k];
+  }
+  else {
+    float const* const src = m->dd;
+    double* const dst = dd;
+    for (size_t k = 0; k < n; k++)
+      dst[k] = src[k];
+  }
+  _m_free(m, m->dd);
+  m->dd = dd;
+  m->data_type = t;
+  return 0;
+}
+
+int convert_matrix_complex_storage(matrix_t* m, const enum matrix_complex_storage_t s)
+{
+  assert(m != NULL);
+  if ((m->data_type != COMPLEX_DOUBLE) && (m->data_type != COMPLEX_SINGLE))
+    return (s == MC_COMPLEX_PAIRED) ? 0 : -1;  // real values are never split
+  if (m->complex_storage == s)
+    return 0;  // nothing to do
+
+  const size_t n = ((m->format == DROW) || (m->format == DCOL)) ? m->m * m->n : m->nz;
+  if ((m->format != INVALID) && (n != 0) && (m->dd != NULL)) {
+    if (_own_arrays(m) != 0)
+      return -2;
+    const size_t w = _data_width(m->data_type) / 2;  // one real
+    char* const dd = _m_malloc(m, 2 * n * w);
+    if (dd == NULL)
+      return -2;
+    char const* const src = m->dd;
+    if (s == MC_COMPLEX_SPLIT) {  // (re, im) pairs -> re..., im...
+      for (size_t k = 0; k < n; k++) {
+        memcpy(dd + k * w, src + 2 * k * w, w);
+        memcpy(dd + (n + k) * w, src + (2 * k + 1) * w, w);
+      }
+    }
+    else {  // re..., im... -> (re, im) pairs
+      for (size_t k = 0; k < n; k++) {
+        memcpy(dd + 2 * k * w, src + k * w, w);
+        memcpy(dd + (2 * k + 1) * w, src + (n + k) * w, w);
+      }
+    }
+    _m_free(m, m->dd);
+    m->dd = dd;
+  }
+  m->complex_storage = s;
+  return 0;
+}
+
+int convert_matrix_ownership(matrix_t* m, const enum matrix_ownership_t o)
+{
+  assert(m != NULL);
+  if (m->owner == o)
+    return 0;  // nothing to do
+  if (o == MC_OWN_BORROWED) {
+    m->owner = o;  // someone else releases them now
+    return 0;
+  }
+
+  // copy_matrix() allocates for the copy's owner
+  const enum matrix_ownership_t old = m->owner;
+  m->owner = o;
+  matrix_t* const c = copy_matrix(m);
+  m->owner = old;
+  if (c == NULL)
+    return -2;
+  clear_matrix(m);  // releases the arrays as the old owner would (borrowed: not at all)
+  *m = *c;
+  free(c);
+  return 0;
+}
+
+// borrowed arrays are copied before anything changes them
+// returns non-zero on malloc failure
+static inline int _own_arrays(matrix_t* m)
+{
+  if (m->owner != MC_OWN_BORROWED)
+    return 0;
+  return convert_matrix_ownership(m, MC_OWN_MALLOC);
+}
+
+// the format conversions and other kernels here work on 32-bit indices and
+// paired complex values: convert on the way in
+// (and on their own copy of borrowed arrays)
+// returns non-zero if the matrix is too large to narrow (or malloc failure)
+static inline int _kernel_storage(matrix_t* m)
+{
+  int ret;
+  if ((ret = _own_arrays(m)) != 0)
+    return ret;
+  if ((m->index_width != MC_INDEX_32) && ((ret = convert_matrix_index_width(m, MC_INDEX_32)) != 0))
+    return ret;
+  return convert_matrix_complex_storage(m, MC_COMPLEX_PAIRED);
+}
+
 // compare matrices
 // returns: zero on match
 // TODO compare with-in a given precision (floating pt. data a->dd)
@@ -304,6 +566,10 @@ int cmp_matrix(matrix_t* a, matrix_t* b)
   if ((a->m != b->m) || (a->n != b->n) || (a->data_type != b->data_type))
     return -2;
 
+  // compared as 32-bit indices, paired complex values
+  if ((_kernel_storage(a) != 0) || (_kernel_storage(b) != 0))
+    return -8;
+
   // TODO deal with symmetry issues (sym, location)
   // can't match if symmetry type doesn't match...
   // unless its an undetected symmetric matrix (unsymmetric only)
@@ -314,11 +580,17 @@ int cmp_matrix(matrix_t* a, matrix_t* b)
   matrix_t* bb;
   int copied;
   if ((a->format != b->format) || (a->base != b->base) || ((a->sym != b->sym) && (b->sym == SM_UNSYMMETRIC)) ||  // maybe b is symmetric?
-      ((a->sym == b->sym) && (b->sym != SM_UNSYMMETRIC) && (a->location != b->location))) {
+      ((a->sym == b->sym) && (b->sym != SM_UNSYMMETRIC) && (a->location != b->location)) ||
+      ((a->format == SM_BCSR) && (a->block_size != b->block_size))) {
     copied = 1;
     bb = copy_matrix(b);
     assert(bb != NULL);
-    int ret = convert_matrix(bb, a->format, a->base);
+    int ret = 0;
+    if ((a->format == SM_BCSR) && (bb->format == SM_BCSR) && (a->block_size != bb->block_size))
+      ret = convert_matrix(bb, SM_CSR, a->base);  // re-blocked below
+    if (a->format == SM_BCSR)
+      bb->block_size = a->block_size;
+    ret = ret || convert_matrix(bb, a->format, a->base);
     if (ret != 0) {
       free_matrix(bb);
       return -5;
@@ -360,8 +632,11 @@ int cmp_matrix(matrix_t* a, matrix_t* b)
       iilen = jjlen = a->nz;
       ddlen = dwidth * a->nz;
       // TODO this is a hack... really need to sort both matrices for all data types except DROW/DCOL! (need to copy both a and b...)
-      _qsort_coo(a, 0);  // TODO rm
-      _qsort_coo(bb, 0);  // TODO rm
+      if ((_sort_coo(a, 0, _omp_threads(a->nz)) != 0) || (_sort_coo(bb, 0, _omp_threads(bb->nz)) != 0)) {  // TODO rm
+        if (copied)
+          free_matrix(bb);
+        return -6;
+      }
       break;
     case SM_CSC:
       iilen = a->nz;
@@ -373,6 +648,10 @@ int cmp_matrix(matrix_t* a, matrix_t* b)
       jjlen = a->nz;
       ddlen = dwidth * a->nz;
       break;
+    case SM_BCSR:
+      _index_lengths(a, &iilen, &jjlen);
+      ddlen = dwidth * a->nz;
+      break;
   }
 
   // now compare data
@@ -402,31 +681,16 @@ int cmp_matrix(matrix_t* a, matrix_t* b)
     assert(a->dd != NULL);
     assert(bb->dd != NULL);
 
-    int ret;
+    int ret = 0;
 //    ret = memcmp(a->dd, bb->dd, ddlen); // TODO compare with some tolerance
-    switch (a->data_type) {
-      case REAL_DOUBLE:
-      {
-        const double tol = 1e-15;  // tolerance: what to approximate as zero when converting // TODO use machine epsilon*2?
-        double* d_old = a->dd;
-        double* d_new = bb->dd;
-        for (unsigned int i = 0; i < a->nz; i++) {
-          if ((*d_old < *d_new - tol) || (*d_old > *d_new + tol)) {  // if !zero store, otherwise skip
-            ret = -1;
-            break;
-          }
-          d_old++;
-          d_new++;
-        }
-        ret = 0;
-        break;
-      }
-      case REAL_SINGLE:
-      case COMPLEX_DOUBLE:
-      case COMPLEX_SINGLE:
-      case SM_PATTERN:
-        assert(0);  // TODO
-        break;
+    const enum matrix_data_type_t dt = a->data_type;
+    const double tol = ((dt == REAL_SINGLE) || (dt == COMPLEX_SINGLE)) ? 5e-6 : 5e-15;  // TODO use limits.h machine precision
+    for (size_t i = 0; (i < a->nz) && (ret == 0); i++) {
+      double re_a, im_a, re_b, im_b;
+      _entry_get(a->dd, i, dt, &re_a, &im_a);
+      _entry_get(bb->dd, i, dt, &re_b, &im_b);
+      if (!_close(re_a, re_b, tol) || !_close(im_a, im_b, tol))
+        ret = -1;
     }
 
     if (ret != 0) {
@@ -444,398 +708,789 @@ int cmp_matrix(matrix_t* a, matrix_t* b)
 
 // local conversion functions
 // NOTE: these have no checking built in!
-// TODO these currently use BeBOP sparse matrix stuff inside, to be replaced eventually!
-
-// --------------------------
-// NOTE: there is memory loss here -- I think its within BeBOP but its hard to see w/o removing it
+// The sparse conversions (COO <-> CSR/CSC) are counting sorts: one pass to
+// count entries per row/column, a prefix sum to get the row/column pointers,
+// then a pass to scatter the entries into place. They work in whichever base
+// the matrix is already in and leave the base unchanged.
 
-struct sparse_matrix_t* _bebop_input(matrix_t* m, enum sparse_matrix_storage_format_t f);
-struct sparse_matrix_t* _bebop_input(matrix_t* m, enum sparse_matrix_storage_format_t f)
+// copy a single entry of 'dwidth' bytes: dst[i] = src[j]
+static inline void _entry_copy(void* dst, const size_t i, void const* src, const size_t j, const size_t dwidth)
 {
-  struct sparse_matrix_t* A = malloc(sizeof(struct sparse_matrix_t));
-
-  enum value_type_t v = REAL;
-  switch (m->data_type) {
-    case COMPLEX_SINGLE:
-    case REAL_SINGLE:
-      assert(0);  // TODO bebop can't handle this!
-      break;
-    case REAL_DOUBLE:
-      v = REAL;
-      break;
-    case COMPLEX_DOUBLE:
-      v = COMPLEX;
-      break;
-    case SM_PATTERN:
-      v = PATTERN;
+  switch (dwidth) {
+    case 0:  // pattern: no data
       break;
-  }
-
-  switch (f) {
-    case CSC:
-    {
-      A->format = CSC;
-      struct csc_matrix_t* p = calloc(1, sizeof(struct csc_matrix_t));
-      A->repr = p;
-      p->m = m->m;
-      p->n = m->n;
-      p->nnz = m->nz;
-      p->values = m->dd;
-      p->rowidx = (int*) m->ii;
-      p->colptr = (int*) m->jj;
-      p->symmetry_type = UNSYMMETRIC;  // TODO
-      p->value_type = v;
-      p->ownership = USER_DEALLOCATES;
+    case sizeof(float):
+      ((float*) dst)[i] = ((float const*) src)[j];
       break;
-    }
-    case CSR:
-    {
-      A->format = CSR;
-      struct csr_matrix_t* p = calloc(1, sizeof(struct csr_matrix_t));
-      A->repr = p;
-      p->m = m->m;
-      p->n = m->n;
-      p->nnz = m->nz;
-      p->values = m->dd;
-      p->rowptr = (int*) m->ii;
-      p->colidx = (int*) m->jj;
-      p->symmetry_type = UNSYMMETRIC;  // TODO
-      p->value_type = v;
-      p->ownership = USER_DEALLOCATES;
+    case sizeof(double):  // a double, or a complex single (real, imag) pair: not read through double*
+      memcpy((char*) dst + i * sizeof(double), (char const*) src + j * sizeof(double), sizeof(double));
       break;
-    }
-    case COO:
-    {
-      A->format = COO;
-      struct coo_matrix_t* p = calloc(1, sizeof(struct coo_matrix_t));
-      A->repr = p;
-      p->m = m->m;
-      p->n = m->n;
-      p->nnz = m->nz;
-      p->val = m->dd;
-      p->II = (int*) m->ii;
-      p->JJ = (int*) m->jj;
-      if (m->base == FIRST_INDEX_ZERO)
-        p->index_base = ZERO;
-      else
-        p->index_base = ONE;
-      p->symmetry_type = UNSYMMETRIC;  // TODO
-      p->value_type = v;
-      p->ownership = USER_DEALLOCATES;
+    case 2 * sizeof(double):  // complex: (real, imag) pairs
+      ((double*) dst)[2 * i] = ((double const*) src)[2 * j];
+      ((double*) dst)[2 * i + 1] = ((double const*) src)[2 * j + 1];
       break;
-    }
     default:
-      assert(0);  // we don't handle the rest
+      memcpy((char*) dst + i * dwidth, (char const*) src + j * dwidth, dwidth);
+      break;
   }
-  return A;
 }
 
-// NOTE: the DATA isn't destroyed, just the containers
-void _bebop_destroy(struct sparse_matrix_t* A);
-void _bebop_destroy(struct sparse_matrix_t* A)
+// count the entries in each row (or column) of 'idx' (nz entries, base 'b')
+// and build the (zero-based) pointers: ptr[k] is the first entry of row k,
+// ptr[n] = nz, 'ptr' must have space for n+1 entries
+static inline void _count_ptr(unsigned int* ptr, const size_t n, unsigned int const* idx, const size_t nz,
+                              const unsigned int b)
 {
-  free(A->repr);
-  free(A);
+  memset(ptr, 0, (n + 1) * sizeof(unsigned int));
+  for (size_t k = 0; k < nz; k++)
+    ptr[idx[k] - b + 1]++;
+  for (size_t k = 0; k < n; k++)
+    ptr[k + 1] += ptr[k];
 }
-// --------------------------
 
-//
-// CSC -> COO
-int _csc2coo(matrix_t* m);
-int _csc2coo(matrix_t* m)
+// base change: add 'delta' to the 'n' indices in 'v', a single (vectorized) pass
+static inline void _shift_index(unsigned int* v, const size_t n, const int delta)
 {
-  assert(m->format == SM_CSC);
+  if (delta == 0)
+    return;
+  const unsigned int d = (unsigned int) delta;  // -1 wraps, as the indices do
+#ifdef _OPENMP
+  #pragma omp parallel for simd schedule(static) num_threads(_omp_threads(n))
+#endif
+  for (size_t k = 0; k < n; k++)
+    v[k] += d;
+}
 
-  // BeBOP only handles zero-based CSC matrices
-  const enum matrix_base_t old_base = m->base;
-  int ret;
-  ret = convert_matrix(m, m->format, FIRST_INDEX_ZERO);
-  assert(ret == 0);  // should never fail
+// is the COO matrix already ordered by 'major' then 'minor' index?
+static inline int _coo_is_ordered(unsigned int const* major, unsigned int const* minor, const size_t nz)
+{
+  for (size_t k = 1; k < nz; k++) {
+    if ((major[k - 1] > major[k]) || ((major[k - 1] == major[k]) && (minor[k - 1] > minor[k])))
+      return 0;
+  }
+  return 1;
+}
 
-  // store, ready for BeBOP
-  // Note that BeBOP loses these pointers if we don't save them
-  void* dd_old = m->dd;
-  void* ii_old = m->ii;
-  void* jj_old = m->jj;
-  struct sparse_matrix_t* A = _bebop_input(m, CSC);
+// least-significant-digit radix sort, digits of this many bits
+#define MC_RADIX_BITS 11
+#define MC_RADIX (1 << MC_RADIX_BITS)
 
-  int ierr = sparse_matrix_convert(A, COO);
-  assert(ierr == 0);  // might fail on malloc?
+// number of bits needed to hold the values 0..n-1
+static inline unsigned int _bits(size_t n)
+{
+  unsigned int r = 0;
+  for (n = (n > 0) ? n - 1 : 0; n != 0; n >>= 1)
+    r++;
+  return r;
+}
 
-  // store new matrix
-  struct coo_matrix_t* p = A->repr;
-  m->format = SM_COO;
-  m->ii = (unsigned int*) p->II;
-  m->jj = (unsigned int*) p->JJ;
-  m->dd = p->val;
+// serial LSD radix sort of 'key' (with the permutation 'perm') over 'passes'
+// digits, 'key_tmp' and 'perm_tmp' are scratch space, on return '*key' and
+// '*perm' point at the sorted arrays (may have been swapped with the scratch)
+// digits that are the same for every entry are skipped
+// returns non-zero on malloc failure
+static int _radix_sort_serial(uint64_t** key, uint64_t** key_tmp, unsigned int** perm, unsigned int** perm_tmp,
+                              const size_t nz, const unsigned int passes)
+{
+  size_t* const hist = calloc((size_t) passes * MC_RADIX, sizeof(size_t));
+  if (hist == NULL)
+    return -1;
 
-  // clean up after BeBOP
-  _bebop_destroy(A);
-  free(dd_old);
-  free(ii_old);
-  free(jj_old);
+  // count the digits for every pass in one sweep
+  for (size_t k = 0; k < nz; k++) {
+    for (unsigned int p = 0; p < passes; p++)
+      hist[(size_t) p * MC_RADIX + (((*key)[k] >> (p * MC_RADIX_BITS)) & (MC_RADIX - 1))]++;
+  }
 
-  // now convert back to appropriate base
-  ret = convert_matrix(m, m->format, old_base);
-  assert(ret == 0);  // should never fail
+  for (unsigned int p = 0; p < passes; p++) {
+    size_t* const h = hist + (size_t) p * MC_RADIX;
+    const unsigned int shift = p * MC_RADIX_BITS;
+    int skip = 0;
+    size_t sum = 0;
+    for (size_t d = 0; d < MC_RADIX; d++) {
+      const size_t v = h[d];
+      skip |= (v == nz);
+      h[d] = sum;
+      sum += v;
+    }
+    if (skip)
+      continue;
+
+    uint64_t const* const kin = *key;
+    unsigned int const* const pin = *perm;
+    uint64_t* const kout = *key_tmp;
+    unsigned int* const pout = *perm_tmp;
+    for (size_t k = 0; k < nz; k++) {
+      const size_t q = h[(kin[k] >> shift) & (MC_RADIX - 1)]++;
+      kout[q] = kin[k];
+      pout[q] = pin[k];
+    }
+    *key_tmp = *key;
+    *key = kout;
+    *perm_tmp = *perm;
+    *perm = pout;
+  }
 
+  free(hist);
   return 0;
 }
 
-// COO -> CSC
-int _coo2csc(matrix_t* m);
-int _coo2csc(matrix_t* m)
+#ifdef _OPENMP
+// OpenMP LSD radix sort, same interface and result as _radix_sort_serial()
+// each pass splits the keys into one contiguous chunk per thread: the
+// per-thread digit histograms are prefix summed in (digit, thread) order so
+// the threaded scatter stays stable
+// returns non-zero on malloc failure
+static int _radix_sort_omp(uint64_t** key, uint64_t** key_tmp, unsigned int** perm, unsigned int** perm_tmp,
+                           const size_t nz, const unsigned int passes, const int nthreads)
 {
-  assert(m->format == SM_COO);
+  size_t* const hist = malloc((size_t) nthreads * MC_RADIX * sizeof(size_t));
+  if (hist == NULL)
+    return -1;
 
-  // BeBOP only handles zero-based CSC matrices
-  const enum matrix_base_t old_base = m->base;
-  int ret;
-  ret = convert_matrix(m, m->format, FIRST_INDEX_ZERO);
-  assert(ret == 0);  // should never fail
-
-  // store, ready for BeBOP
-  // Note that BeBOP loses these pointers if we don't save them
-  void* dd_old = m->dd;
-  void* ii_old = m->ii;
-  void* jj_old = m->jj;
-  struct sparse_matrix_t* A = _bebop_input(m, COO);
-
-  int ierr = sparse_matrix_convert(A, CSC);
-  assert(ierr == 0);  // could fail on malloc?
-
-  // store new matrix
-  struct csc_matrix_t* p = A->repr;
-  m->format = SM_CSC;
-  m->ii = (unsigned int*) p->rowidx;
-  m->jj = (unsigned int*) p->colptr;
-  m->dd = p->values;
-
-  //output matrix (first 10 elements)
-//    int i;
-//    for (i = 0; i < 10; i++) {
-//        printf("%f %u %u \n", ((float*) m->dd)[i], m->ii[i], m->jj[i]);
-//    }
+  for (unsigned int p = 0; p < passes; p++) {
+    const unsigned int shift = p * MC_RADIX_BITS;
+    uint64_t const* const kin = *key;
+    unsigned int const* const pin = *perm;
+    uint64_t* const kout = *key_tmp;
+    unsigned int* const pout = *perm_tmp;
+    int skip = 0;
 
-  // stupid BeBOP doesn't allocate the last value for CSC
-  assert(m->jj[m->n] == m->nz);
-  assert(m->jj[0] == 0);
+    #pragma omp parallel num_threads(nthreads)
+    {
+      // the team may be smaller than asked for (OMP_DYNAMIC, OMP_THREAD_LIMIT,
+      // nesting): split by the threads we got
+      const int nt = omp_get_num_threads();
+      const int t = omp_get_thread_num();
+      const size_t lo = (nz * t) / nt;
+      const size_t hi = (nz * (t + 1)) / nt;
+      size_t* const mine = hist + (size_t) t * MC_RADIX;
+
+      memset(mine, 0, MC_RADIX * sizeof(size_t));
+      for (size_t k = lo; k < hi; k++)
+        mine[(kin[k] >> shift) & (MC_RADIX - 1)]++;
+      #pragma omp barrier
+
+      #pragma omp single
+      {
+        size_t sum = 0;
+        for (size_t d = 0; d < MC_RADIX; d++) {
+          const size_t before = sum;
+          for (int u = 0; u < nt; u++) {
+            const size_t v = hist[(size_t) u * MC_RADIX + d];
+            hist[(size_t) u * MC_RADIX + d] = sum;
+            sum += v;
+          }
+          skip |= (sum - before == nz);
+        }
+      }
 
-  // clean up after BeBOP
-  _bebop_destroy(A);
-  free(dd_old);
-  free(ii_old);
-  free(jj_old);
+      if (!skip) {
+        for (size_t k = lo; k < hi; k++) {
+          const size_t q = mine[(kin[k] >> shift) & (MC_RADIX - 1)]++;
+          kout[q] = kin[k];
+          pout[q] = pin[k];
+        }
+      }
+    }
 
-  // now convert back to appropriate base
-  ret = convert_matrix(m, m->format, old_base);
-  assert(ret == 0);  // should never fail
+    if (!skip) {
+      *key_tmp = *key;
+      *key = kout;
+      *perm_tmp = *perm;
+      *perm = pout;
+    }
+  }
 
+  free(hist);
   return 0;
 }
+#endif
 
-// CSR -> COO
-int _csr2coo(matrix_t* m);
-int _csr2coo(matrix_t* m)
+// The (major, minor) index pairs are packed into one 64-bit key, using only
+// as many bits as the matrix dimensions need, and the keys are radix sorted
+// together with a permutation (LSD, so each pass is stable). The indices are
+// then unpacked from the sorted keys and the data is permuted in one pass.
+int _sort_coo(matrix_t* m, const int by_col, int nthreads)
 {
-  assert(m->format == SM_CSR);
-
-  // BeBOP only handles zero-based CSC matrices
-  const enum matrix_base_t old_base = m->base;
-  int ret;
-  ret = convert_matrix(m, m->format, FIRST_INDEX_ZERO);
-  assert(ret == 0);  // should never fail
-
-  // store, ready for BeBOP
-  // Note that BeBOP loses these pointers if we don't save them
-  void* dd_old = m->dd;
-  void* ii_old = m->ii;
-  void* jj_old = m->jj;
-  struct sparse_matrix_t* A = _bebop_input(m, CSR);
-
-  int ierr = sparse_matrix_convert(A, COO);
-  assert(ierr == 0);  // could fail on malloc?
-
-  // store new matrix
-  struct coo_matrix_t* p = A->repr;
-  m->format = SM_COO;
-  m->ii = (unsigned int*) p->II;
-  m->jj = (unsigned int*) p->JJ;
-  m->dd = p->val;
+  assert(m->format == SM_COO);
+  const size_t nz = m->nz;
+  const unsigned int b = m->base;
+  unsigned int* const major = by_col ? m->jj : m->ii;
+  unsigned int* const minor = by_col ? m->ii : m->jj;
+  const unsigned int sorted = by_col ? MC_SORTED_BY_COL : MC_SORTED_BY_ROW;
+  if ((nz < 2) || (m->flags & sorted) || _coo_is_ordered(major, minor, nz)) {
+    m->flags |= sorted;
+    return 0;  // nothing to do
+  }
 
-  // clean up after BeBOP
-  _bebop_destroy(A);
-  free(dd_old);
-  free(ii_old);
-  free(jj_old);
+  const size_t dwidth = _data_width(m->data_type);
+  const unsigned int bminor = _bits(by_col ? m->m : m->n);
+  const unsigned int bmajor = _bits(by_col ? m->n : m->m);
+  assert(bminor + bmajor <= 64);
+  const unsigned int passes = (bminor + bmajor + MC_RADIX_BITS - 1) / MC_RADIX_BITS;
+
+  uint64_t* key = _m_malloc(m, nz * sizeof(uint64_t));
+  uint64_t* key_tmp = _m_malloc(m, nz * sizeof(uint64_t));
+  unsigned int* perm = _m_malloc(m, nz * sizeof(unsigned int));
+  unsigned int* perm_tmp = _m_malloc(m, nz * sizeof(unsigned int));
+  void* const dd_new = (dwidth == 0) ? NULL : _m_malloc(m, nz * dwidth);
+  int ret = -1;
+  if ((key != NULL) && (key_tmp != NULL) && (perm != NULL) && (perm_tmp != NULL) &&
+      ((dwidth == 0) || (dd_new != NULL))) {
+    for (size_t k = 0; k < nz; k++) {
+      key[k] = ((uint64_t)(major[k] - b) << bminor) | (minor[k] - b);
+      perm[k] = k;
+    }
+#ifdef _OPENMP
+    if (nthreads > 1)
+      ret = _radix_sort_omp(&key, &key_tmp, &perm, &perm_tmp, nz, passes, nthreads);
+#endif
+    if (ret != 0)
+      ret = _radix_sort_serial(&key, &key_tmp, &perm, &perm_tmp, nz, passes);
+  }
+  if (ret != 0) {
+    _m_free(m, key);
+    _m_free(m, key_tmp);
+    _m_free(m, perm);
+    _m_free(m, perm_tmp);
+    _m_free(m, dd_new);
+    return -1;
+  }
 
-  // now convert back to appropriate base
-  ret = convert_matrix(m, m->format, old_base);
-  assert(ret == 0);  // should never fail
+  // unpack the indices, permute the data
+  const uint64_t mask = ((uint64_t) 1 << bminor) - 1;
+  for (size_t k = 0; k < nz; k++) {
+    major[k] = (key[k] >> bminor) + b;
+    minor[k] = (key[k] & mask) + b;
+    _entry_copy(dd_new, k, m->dd, perm[k], dwidth);
+  }
 
+  _m_free(m, key);
+  _m_free(m, key_tmp);
+  _m_free(m, perm);
+  _m_free(m, perm_tmp);
+  _m_free(m, m->dd);
+  m->dd = dd_new;
+  m->flags = (m->flags & ~MC_SORTED) | sorted;
   return 0;
 }
 
-// COO -> CSR
-int _coo2csr(matrix_t* m);
-int _coo2csr(matrix_t* m)
+// COO -> CSR (by_col = 0) or CSC (by_col = 1)
+// Two stable counting sorts: first by the minor index (columns for CSR), then
+// by the major index, so entries come out sorted within each row (column).
+// If the COO entries are already in order (flagged, or found by a scan), the
+// indices and data are reused as-is and only the major index is compressed.
+// the output is written in base 'b_new' (the base shift is folded in)
+// returns non-zero on malloc failure (matrix is left unchanged)
+static int _coo2compressed(matrix_t* m, const int by_col, const enum matrix_base_t b_new)
 {
   assert(m->format == SM_COO);
+  const size_t nz = m->nz;
+  const size_t dwidth = _data_width(m->data_type);
+  const unsigned int b = m->base;
+  const int delta = (int) b_new - (int) b;
+  unsigned int* const major = by_col ? m->jj : m->ii;
+  unsigned int* const minor = by_col ? m->ii : m->jj;
+  const size_t nmajor = by_col ? m->n : m->m;
+  const size_t nminor = by_col ? m->m : m->n;
+
+  unsigned int* ptr = _m_malloc(m, (nmajor + 1) * sizeof(unsigned int));
+  if (ptr == NULL)
+    return -1;
 
-  // BeBOP only handles zero-based CSC matrices
-  const enum matrix_base_t old_base = m->base;
-  int ret;
-  ret = convert_matrix(m, m->format, FIRST_INDEX_ZERO);
-  assert(ret == 0);  // should never fail
-
-  // store, ready for BeBOP
-  // Note that BeBOP loses these pointers if we don't save them
-  void* dd_old = m->dd;
-  void* ii_old = m->ii;
-  void* jj_old = m->jj;
-  struct sparse_matrix_t* A = _bebop_input(m, COO);
-
-  int ierr = sparse_matrix_convert(A, CSR);
-  assert(ierr == 0);  // could fail on malloc?
+  unsigned int* minor_new = minor;
+  void* dd_new = m->dd;
+  const unsigned int sorted = by_col ? MC_SORTED_BY_COL : MC_SORTED_BY_ROW;
+  if (!(m->flags & sorted) && !_coo_is_ordered(major, minor, nz)) {
+    const size_t nwork = (nmajor > nminor) ? nmajor : nminor;
+    unsigned int* const perm = _m_malloc(m, nz * sizeof(unsigned int));
+    unsigned int* const work = _m_malloc(m, (nwork + 1) * sizeof(unsigned int));
+    minor_new = _m_malloc(m, nz * sizeof(unsigned int));
+    dd_new = (dwidth == 0) ? NULL : _m_malloc(m, nz * dwidth);
+    if ((perm == NULL) || (work == NULL) || (minor_new == NULL) || ((dwidth != 0) && (dd_new == NULL))) {
+      _m_free(m, perm);
+      _m_free(m, work);
+      _m_free(m, minor_new);
+      _m_free(m, dd_new);
+      _m_free(m, ptr);
+      return -1;
+    }
 
-  struct csr_matrix_t* p = A->repr;
-  m->format = SM_CSR;
-  m->ii = (unsigned int*) p->rowptr;
-  m->jj = (unsigned int*) p->colidx;
-  m->dd = p->values;
+    // pass 1: order by minor index (only the permutation is stored)
+    _count_ptr(work, nminor, minor, nz, b);
+    for (size_t k = 0; k < nz; k++)
+      perm[work[minor[k] - b]++] = k;
+
+    // pass 2: stable scatter by major index, in minor index order
+    _count_ptr(ptr, nmajor, major, nz, b);
+    memcpy(work, ptr, nmajor * sizeof(unsigned int));
+    for (size_t t = 0; t < nz; t++) {
+      const unsigned int k = perm[t];
+      const unsigned int p = work[major[k] - b]++;
+      minor_new[p] = minor[k] + delta;
+      _entry_copy(dd_new, p, m->dd, k, dwidth);
+    }
 
-  // clean up after BeBOP
-  _bebop_destroy(A);
-  free(dd_old);
-  free(ii_old);
-  free(jj_old);
+    _m_free(m, perm);
+    _m_free(m, work);
+    _m_free(m, minor);
+    _m_free(m, m->dd);
+  }
+  else {
+    _count_ptr(ptr, nmajor, major, nz, b);
+    _shift_index(minor, nz, delta);
+  }
+  _m_free(m, major);
 
-  // now convert back to appropriate base
-  ret = convert_matrix(m, m->format, old_base);
-  assert(ret == 0);  // should never fail
+  // pointers are stored in the same base as the indices
+  if (b_new != 0) {
+    for (size_t k = 0; k <= nmajor; k++)
+      ptr[k] += b_new;
+  }
 
+  if (by_col) {
+    m->jj = ptr;
+    m->ii = minor_new;
+    m->format = SM_CSC;
+  }
+  else {
+    m->ii = ptr;
+    m->jj = minor_new;
+    m->format = SM_CSR;
+  }
+  m->dd = dd_new;
+  m->base = b_new;
+  m->flags = (m->flags & ~MC_SORTED) | sorted;
   return 0;
 }
 
-// COO -> DROW
-int _coo2drow(matrix_t* m);
-int _coo2drow(matrix_t* m)
+// CSR (by_col = 0) or CSC (by_col = 1) -> COO
+// expand the row (column) pointers into row (column) indices,
+// the other index and the data are kept in place
+// the output is in base 'b_new', the other index is shifted in the same pass
+// sorted CSR (CSC) gives COO in row (column) order, so the flags carry over
+// returns non-zero on malloc failure (matrix is left unchanged)
+static int _compressed2coo(matrix_t* m, const int by_col, const enum matrix_base_t b_new)
 {
-  assert(m->format == SM_COO);
-  assert(m->base == FIRST_INDEX_ZERO);
-  const size_t dwidth = _data_width(m->data_type);
-  void* d_new = calloc((m->m) * (m->n), dwidth);
-  if (d_new == NULL)
-    return -1;  // malloc failure
+  assert(m->format == (by_col ? SM_CSC : SM_CSR));
+  const unsigned int b = m->base;
+  const unsigned int d = (unsigned int)((int) b_new - (int) b);  // -1 wraps, as the indices do
+  unsigned int* const ptr = by_col ? m->jj : m->ii;
+  unsigned int* const minor = by_col ? m->ii : m->jj;
+  const size_t nmajor = by_col ? m->n : m->m;
+
+  unsigned int* const idx = _m_malloc(m, m->nz * sizeof(unsigned int));
+  if ((idx == NULL) && (m->nz != 0))
+    return -1;
 
-  // convert from COO to DROW
-  const unsigned int cols = m->n;
-  for (unsigned int i = 0; i < m->nz; i++) {
-    // find index in row-major order, given dwidth size entries
-    // copy to the appropriate location in the dense array
-    const void* src = (char*) m->dd + i * dwidth;
-    void* dest = (char*) d_new + ((m->ii[i] * cols) + m->jj[i]) * dwidth;
-    memcpy(dest, src, dwidth);
+  for (size_t r = 0; r < nmajor; r++) {
+    const unsigned int end = ptr[r + 1] - b;
+    for (unsigned int k = ptr[r] - b; k < end; k++) {
+      idx[k] = r + b_new;
+      minor[k] += d;
+    }
   }
-  // rest of the entries in the array are zero from calloc()
-
-  // now clean up
-  free(m->dd);
-  free(m->ii);
-  free(m->jj);
-  m->dd = d_new;
-  m->ii = NULL;
-  m->jj = NULL;
-  m->format = DROW;
-  m->nz = m->m * m->n;  // not really valid, but might as well set it to a sane value
+  _m_free(m, ptr);
 
+  if (by_col)
+    m->jj = idx;
+  else
+    m->ii = idx;
+  m->format = SM_COO;
+  m->base = b_new;
   return 0;
 }
 
-// DROW -> COO
-int _drow2coo(matrix_t* m, const enum matrix_base_t b);
-int _drow2coo(matrix_t* m, const enum matrix_base_t b)
+// CSR <-> CSC: serial transpose
+// count the entries in each column (row), prefix sum, then scatter walking
+// the rows (columns) in order, so the output comes out sorted
+// 'ptr_new' is used as the scatter cursor and shifted back afterwards
+static void _transpose_serial(unsigned int* ptr_new, unsigned int* idx_new, void* dd_new,
+                              unsigned int const* ptr, unsigned int const* idx, void const* dd,
+                              const size_t nmajor, const size_t nminor, const size_t nz,
+                              const unsigned int b, const unsigned int b_new, const size_t dwidth)
+{
+  _count_ptr(ptr_new, nminor, idx, nz, b);
+  for (size_t r = 0; r < nmajor; r++) {
+    const unsigned int end = ptr[r + 1] - b;
+    for (unsigned int k = ptr[r] - b; k < end; k++) {
+      const unsigned int p = ptr_new[idx[k] - b]++;
+      idx_new[p] = r + b_new;
+      _entry_copy(dd_new, p, dd, k, dwidth);
+    }
+  }
+  for (size_t c = nminor; c > 0; c--)
+    ptr_new[c] = ptr_new[c - 1];
+  ptr_new[0] = 0;
+}
+
+#ifdef _OPENMP
+// CSR <-> CSC: OpenMP transpose
+// the rows (columns) are split into one contiguous block per thread, balanced
+// by number of entries; each thread counts its block's entries per column (row)
+// into a private histogram, the histograms are prefix summed in (column, thread)
+// order and each thread then scatters its own block, so the output is identical
+// to the serial version
+// needs nthreads*nminor counters (nthreads: the most threads the team can have)
+// returns non-zero on malloc failure
+static int _transpose_omp(unsigned int* ptr_new, unsigned int* idx_new, void* dd_new,
+                          unsigned int const* ptr, unsigned int const* idx, void const* dd,
+                          const size_t nmajor, const size_t nminor, const size_t nz,
+                          const unsigned int b, const unsigned int b_new, const size_t dwidth,
+                          const int nthreads)
+{
+  unsigned int* const cnt = calloc((size_t) nthreads * nminor, sizeof(unsigned int));
+  size_t* const blk = malloc((nthreads + 1) * sizeof(size_t));
+  if ((cnt == NULL) || (blk == NULL)) {
+    free(cnt);
+    free(blk);
+    return -1;
+  }
+
+  #pragma omp parallel num_threads(nthreads)
+  {
+    // the team may be smaller than asked for (OMP_DYNAMIC, OMP_THREAD_LIMIT,
+    // nesting): one block per thread we got
+    const int nt = omp_get_num_threads();
+    const int t = omp_get_thread_num();
+
+    // block boundaries: blk[u] is the first row with at least u*nz/nt entries before it
+    #pragma omp single
+    {
+      blk[0] = 0;
+      size_t r = 0;
+      for (int u = 1; u < nt; u++) {
+        const size_t target = (nz * u) / nt;
+        while ((r < nmajor) && ((size_t)(ptr[r] - b) < target))
+          r++;
+        blk[u] = r;
+      }
+      blk[nt] = nmajor;
+    }
+
+    unsigned int* const mycnt = cnt + (size_t) t * nminor;
+    const unsigned int first = ptr[blk[t]] - b;
+    const unsigned int last = ptr[blk[t + 1]] - b;
+    for (unsigned int k = first; k < last; k++)
+      mycnt[idx[k] - b]++;
+    #pragma omp barrier
+
+    // per-thread offsets within each column, column totals into ptr_new[c+1]
+    #pragma omp for schedule(static)
+    for (size_t c = 0; c < nminor; c++) {
+      unsigned int sum = 0;
+      for (int u = 0; u < nt; u++) {
+        const unsigned int v = cnt[(size_t) u * nminor + c];
+        cnt[(size_t) u * nminor + c] = sum;
+        sum += v;
+      }
+      ptr_new[c + 1] = sum;
+    }
+
+    #pragma omp single
+    {
+      ptr_new[0] = 0;
+      for (size_t c = 0; c < nminor; c++)
+        ptr_new[c + 1] += ptr_new[c];
+    }
+
+    for (size_t rr = blk[t]; rr < blk[t + 1]; rr++) {
+      const unsigned int end = ptr[rr + 1] - b;
+      for (unsigned int k = ptr[rr] - b; k < end; k++) {
+        const unsigned int c = idx[k] - b;
+        const unsigned int p = ptr_new[c] + mycnt[c]++;
+        idx_new[p] = rr + b_new;
+        _entry_copy(dd_new, p, dd, k, dwidth);
+      }
+    }
+  }
+
+  free(cnt);
+  free(blk);
+  return 0;
+}
+#endif
+
+// CSR <-> CSC: direct transpose of the compressed arrays, no intermediate COO
+// the output is written in base 'b_new' (the base shift is folded in)
+// nthreads > 1 uses the OpenMP row-block variant, when available
+// returns non-zero on malloc failure (matrix is left unchanged)
+int _compressed_transpose(matrix_t* m, const enum matrix_base_t b_new, int nthreads);
+int _compressed_transpose(matrix_t* m, const enum matrix_base_t b_new, int nthreads)
+{
+  assert((m->format == SM_CSR) || (m->format == SM_CSC));
+  const int by_col = (m->format == SM_CSC);
+  const size_t nz = m->nz;
+  const size_t dwidth = _data_width(m->data_type);
+  const unsigned int b = m->base;
+  unsigned int* const ptr = by_col ? m->jj : m->ii;
+  unsigned int* const idx = by_col ? m->ii : m->jj;
+  const size_t nmajor = by_col ? m->n : m->m;
+  const size_t nminor = by_col ? m->m : m->n;
+
+  unsigned int* const ptr_new = _m_malloc(m, (nminor + 1) * sizeof(unsigned int));
+  unsigned int* const idx_new = _m_malloc(m, nz * sizeof(unsigned int));
+  void* const dd_new = (dwidth == 0) ? NULL : _m_malloc(m, nz * dwidth);
+  if ((ptr_new == NULL) || ((idx_new == NULL) && (nz != 0)) || ((dwidth != 0) && (dd_new == NULL) && (nz != 0))) {
+    _m_free(m, ptr_new);
+    _m_free(m, idx_new);
+    _m_free(m, dd_new);
+    return -1;
+  }
+
+  // the per-thread histograms cost nthreads*nminor, keep that below ~nz
+  if ((nminor > 0) && ((size_t) nthreads > nz / nminor))
+    nthreads = (nz / nminor > 1) ? nz / nminor : 1;
+  int done = 0;
+#ifdef _OPENMP
+  if (nthreads > 1)  // falls back to the serial version if the histograms can't be allocated
+    done = (_transpose_omp(ptr_new, idx_new, dd_new, ptr, idx, m->dd, nmajor, nminor, nz,
+                           b, b_new, dwidth, nthreads) == 0);
+#endif
+  if (!done)
+    _transpose_serial(ptr_new, idx_new, dd_new, ptr, idx, m->dd, nmajor, nminor, nz, b, b_new, dwidth);
+
+  if (b_new != 0) {
+    for (size_t k = 0; k <= nminor; k++)
+      ptr_new[k] += b_new;
+  }
+
+  _m_free(m, ptr);
+  _m_free(m, idx);
+  _m_free(m, m->dd);
+  if (by_col) {  // CSC -> CSR
+    m->ii = ptr_new;
+    m->jj = idx_new;
+    m->format = SM_CSR;
+  }
+  else {  // CSR -> CSC
+    m->jj = ptr_new;
+    m->ii = idx_new;
+    m->format = SM_CSC;
+  }
+  m->dd = dd_new;
+  m->base = b_new;
+  m->flags = (m->flags & ~MC_SORTED) | (by_col ? MC_SORTED_BY_ROW : MC_SORTED_BY_COL);  // always sorted
+  return 0;
+}
+
+// CSC -> COO
+int _csc2coo(matrix_t* m, const enum matrix_base_t b);
+int _csc2coo(matrix_t* m, const enum matrix_base_t b)
+{
+  return _compressed2coo(m, 1, b);
+}
+
+// COO -> CSC
+int _coo2csc(matrix_t* m, const enum matrix_base_t b);
+int _coo2csc(matrix_t* m, const enum matrix_base_t b)
+{
+  return _coo2compressed(m, 1, b);
+}
+
+// CSR -> COO
+int _csr2coo(matrix_t* m, const enum matrix_base_t b);
+int _csr2coo(matrix_t* m, const enum matrix_base_t b)
+{
+  return _compressed2coo(m, 0, b);
+}
+
+// COO -> CSR
+int _coo2csr(matrix_t* m, const enum matrix_base_t b);
+int _coo2csr(matrix_t* m, const enum matrix_base_t b)
+{
+  return _coo2compressed(m, 0, b);
+}
+
+// COO -> DROW
+// any base, the indices are shifted as they are read
+// entries are scattered in parallel once they're known to be merged (no two
+// threads can write the same location), otherwise serially: the last of a
+// set of duplicates wins
+int _coo2drow(matrix_t* m);
+int _coo2drow(matrix_t* m)
+{
+  assert(m->format == SM_COO);
+  const unsigned int b = m->base;
+  const size_t dwidth = _data_width(m->data_type);
+  void* d_new = _m_calloc(m, (m->m) * (m->n), dwidth);
+  if (d_new == NULL)
+    return -1;  // malloc failure
+
+  // convert from COO to DROW
+  const size_t cols = m->n;
+  const size_t nz = m->nz;
+  unsigned int const* const ii = m->ii;
+  unsigned int const* const jj = m->jj;
+  char const* const dd = m->dd;
+#ifdef _OPENMP
+  const int nthreads = (m->flags & MC_MERGED) ? _omp_threads(nz) : 1;
+  #pragma omp parallel for schedule(static) num_threads(nthreads) if(nthreads > 1)
+#endif
+  for (size_t k = 0; k < nz; k++) {
+    // find index in row-major order, given dwidth size entries
+    // copy to the appropriate location in the dense array
+    void* dest = (char*) d_new + (((size_t)(ii[k] - b) * cols) + (jj[k] - b)) * dwidth;
+    memcpy(dest, dd + k * dwidth, dwidth);
+  }
+  // rest of the entries in the array are zero from calloc()
+
+  // now clean up
+  _m_free(m, m->dd);
+  _m_free(m, m->ii);
+  _m_free(m, m->jj);
+  m->dd = d_new;
+  m->ii = NULL;
+  m->jj = NULL;
+  m->format = DROW;
+  m->base = FIRST_INDEX_ZERO;
+  m->nz = m->m * m->n;  // not really valid, but might as well set it to a sane value
+  m->flags = 0;  // no entries to describe
+
+  return 0;
+}
+
+// is dense entry k non-zero (outside the tolerance)?
+static inline int _dense_nonzero(void const* dd, const size_t k, const enum matrix_data_type_t t, const double tol)
+{
+  double re, im;
+  _entry_get(dd, k, t, &re, &im);
+  return (re < 0.0 - tol) || (re > 0.0 + tol) || (im < 0.0 - tol) || (im > 0.0 + tol);
+}
+
+// DROW -> COO
+// Two passes over the rows, shared out between threads: count the non-zeros
+// in each row, prefix sum into the row's offset in the output, then fill in
+// the entries. The arrays are allocated at their final size.
+int _drow2coo(matrix_t* m, const enum matrix_base_t b);
+int _drow2coo(matrix_t* m, const enum matrix_base_t b)
 {
   assert(m->format == DROW);
+  assert(m->data_type != SM_PATTERN);  // dense matrices always hold values
   const double tol = 1e-15;  // tolerance: what to approximate as zero when converting // TODO use machine epsilon*2?
   const size_t dwidth = _data_width(m->data_type);
-
-  // allocate maximum size, then realloc later to reduce to the appropriate size ptr
-  // data (dd) is already maximum size
-  m->ii = malloc((m->m) * (m->n) * sizeof(unsigned int));
-  if (m->ii == NULL)
+  const enum matrix_data_type_t t = m->data_type;
+  const size_t rows = m->m;
+  const size_t cols = m->n;
+#ifdef _OPENMP
+  const int nthreads = _omp_threads(rows * cols);
+#endif
+  void const* const dd = m->dd;
+
+  size_t* const ptr = _m_malloc(m, (rows + 1) * sizeof(size_t));
+  if (ptr == NULL)
     return -1;
-  m->jj = malloc((m->m) * (m->n) * sizeof(unsigned int));
-  if (m->jj == NULL) {
-    free(m->ii);
-    m->ii = NULL;
+
+  // pass 1: count
+  ptr[0] = 0;
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static) num_threads(nthreads) if(nthreads > 1)
+#endif
+  for (size_t i = 0; i < rows; i++) {
+    size_t c = 0;
+    for (size_t j = 0; j < cols; j++)
+      c += _dense_nonzero(dd, i * cols + j, t, tol);
+    ptr[i + 1] = c;
+  }
+  for (size_t i = 0; i < rows; i++)
+    ptr[i + 1] += ptr[i];
+  const size_t nz = ptr[rows];
+  if (nz + b > UINT_MAX) {  // too large for 32-bit indices
+    _m_free(m, ptr);
     return -1;
   }
 
-  // in-place compression of data, row-by-row
-  const unsigned int rows = m->m;
-  const unsigned int cols = m->n;
-  unsigned int* i_new = m->ii;
-  unsigned int* j_new = m->jj;
+  unsigned int* const ii = _m_malloc(m, nz * sizeof(unsigned int));
+  unsigned int* const jj = _m_malloc(m, nz * sizeof(unsigned int));
+  void* const d_new = _m_malloc(m, nz * dwidth);
+  if ((nz != 0) && ((ii == NULL) || (jj == NULL) || (d_new == NULL))) {
+    _m_free(m, ptr);
+    _m_free(m, ii);
+    _m_free(m, jj);
+    _m_free(m, d_new);
+    return -1;
+  }
 
-  int nz = 0;
-  switch (m->data_type) {
-    case REAL_DOUBLE:
-    {
-      double* d_old = m->dd;
-      double* d_new = m->dd;
-      for (unsigned int i = 0; i < rows; i++) {  // (i initialized already)
-        for (unsigned int j = 0; j < cols; j++) {  // (j initialized already)
-          // index = (i*cols + j); // row-major indexing
-          if ((*d_old < 0.0 - tol) || (*d_old > 0.0 + tol)) {  // if !zero store, otherwise skip
-            // store, if not the same address
-            if (d_old != d_new)  // addresses can't overlap for memcpy
-              memcpy(d_new, d_old, dwidth);  // memcpy(dest,src,size)
-
-            if (b == FIRST_INDEX_ONE) {  // then loop variables have to be +1
-              *i_new = i + 1;
-              *j_new = j + 1;
-            }
-            else {  // FIRST_INDEX_ZERO
-              *i_new = i;
-              *j_new = j;
-            }
-
-            d_new++;
-            i_new++;
-            j_new++;
-            nz++;  // update the entry count
-          }
-          d_old++;
-        }
+  // pass 2: fill, row by row
+#ifdef _OPENMP
+  #pragma omp parallel for schedule(static) num_threads(nthreads) if(nthreads > 1)
+#endif
+  for (size_t i = 0; i < rows; i++) {
+    size_t p = ptr[i];
+    for (size_t j = 0; j < cols; j++) {
+      const size_t k = i * cols + j;  // row-major indexing
+      if (_dense_nonzero(dd, k, t, tol)) {  // if !zero store, otherwise skip
+        _entry_copy(d_new, p, dd, k, dwidth);
+        ii[p] = i + b;
+        jj[p] = j + b;
+        p++;
       }
     }
-      break;
-    case REAL_SINGLE:
-    case COMPLEX_DOUBLE:
-    case COMPLEX_SINGLE:
-    case SM_PATTERN:
-      assert(0);
-      break;
   }
-  // optimization!
-  // resize ptr arrays to the correct size, now that
-  // we know exactly how many non-zero entries there are
-  // -- if these fail we still have the original ptr
-  _realloc_arrays(m, nz);
+  _m_free(m, ptr);
+
+  _m_free(m, m->dd);
+  m->dd = d_new;
+  m->ii = ii;
+  m->jj = jj;
+  m->nz = nz;
   m->format = SM_COO;
   m->base = b;
+  m->flags = MC_SORTED_BY_ROW | MC_MERGED;  // zeros on the diagonal are dropped
 
   return 0;
 }
 
+// dense transpose: 'src' is rows x cols, 'dst' gets cols x rows (both row-major)
+// done in square tiles so the reads and the writes both stay in cache, the
+// tiles are shared out between threads; entries are copied at a fixed width
+// where possible so the copy is a single load and store
+#define MC_TRANSPOSE_TILE 32
+#define MC_TRANSPOSE_LOOP(W) \
+  for (size_t i = i0; i < i1; i++) \
+    for (size_t j = j0; j < j1; j++) \
+      memcpy(d + (j * rows + i) * (W), s + (i * cols + j) * (W), (W))
+static void _dense_transpose(void* dst, void const* src, const size_t rows, const size_t cols, const size_t dwidth)
+{
+  char* const d = dst;
+  char const* const s = src;
+  const size_t tr = (rows + MC_TRANSPOSE_TILE - 1) / MC_TRANSPOSE_TILE;
+  const size_t tc = (cols + MC_TRANSPOSE_TILE - 1) / MC_TRANSPOSE_TILE;
+#ifdef _OPENMP
+  const int nthreads = _omp_threads(rows * cols);
+  #pragma omp parallel for schedule(static) num_threads(nthreads) if(nthreads > 1)
+#endif
+  for (size_t t = 0; t < tr * tc; t++) {
+    const size_t i0 = (t / tc) * MC_TRANSPOSE_TILE;
+    const size_t j0 = (t % tc) * MC_TRANSPOSE_TILE;
+    const size_t i1 = (i0 + MC_TRANSPOSE_TILE < rows) ? i0 + MC_TRANSPOSE_TILE : rows;
+    const size_t j1 = (j0 + MC_TRANSPOSE_TILE < cols) ? j0 + MC_TRANSPOSE_TILE : cols;
+    switch (dwidth) {
+      case sizeof(float):
+        MC_TRANSPOSE_LOOP(sizeof(float));
+        break;
+      case sizeof(double):
+        MC_TRANSPOSE_LOOP(sizeof(double));
+        break;
+      case 2 * sizeof(double):
+        MC_TRANSPOSE_LOOP(2 * sizeof(double));
+        break;
+      default:
+        MC_TRANSPOSE_LOOP(dwidth);
+        break;
+    }
+  }
+}
+#undef MC_TRANSPOSE_LOOP
+
 // DROW -> DCOL
 int _drow2dcol(matrix_t* m);
 int _drow2dcol(matrix_t* m)
 {
   assert(m->format == DROW);
-  const unsigned int rows = m->m;
-  const unsigned int cols = m->n;
+  const size_t rows = m->m;
+  const size_t cols = m->n;
 
   // short-circuit
   // if its already a vector, converting from column-to-row major is a no-op
@@ -844,24 +1499,16 @@ int _drow2dcol(matrix_t* m)
     return 0;
   }
 
-  void* d_new = malloc((m->m) * (m->n) * _data_width(m->data_type));
+  const size_t dwidth = _data_width(m->data_type);
+  void* d_new = _m_malloc(m, rows * cols * dwidth);
   if (d_new == NULL)
     return -1;  // malloc failure
 
-  // swaps rows and columns
-  unsigned int i, j;
-  void* d_old = m->dd;
-  const size_t dwidth = _data_width(m->data_type);
-  for (i = 0; i < rows; i++) {
-    for (j = 0; j < cols; j++) {
-      const void* src = (char*) d_old + (i * cols + j) * dwidth;
-      void* dest = (char*) d_new + (j * rows + i) * dwidth;
-      memcpy(dest, src, dwidth);
-    }
-  }
+  // swaps rows and columns: DCOL is the row-major transpose
+  _dense_transpose(d_new, m->dd, rows, cols, dwidth);
 
   // swap ptrs
-  free(m->dd);
+  _m_free(m, m->dd);
   m->dd = d_new;
   m->format = DCOL;
 
@@ -873,8 +1520,8 @@ int _dcol2drow(matrix_t* m);
 int _dcol2drow(matrix_t* m)
 {
   assert(m->format == DCOL);
-  const unsigned int rows = m->m;
-  const unsigned int cols = m->n;
+  const size_t rows = m->m;
+  const size_t cols = m->n;
   // short-circuit
   // if its already a vector, converting from column-to-row major is a no-op
   if ((rows == 1) || (cols == 1)) {
@@ -883,41 +1530,248 @@ int _dcol2drow(matrix_t* m)
   }
 
   // get a new chunk of memory
-  void* d_new = malloc((m->m) * (m->n) * _data_width(m->data_type));
+  const size_t dwidth = _data_width(m->data_type);
+  void* d_new = _m_malloc(m, rows * cols * dwidth);
   if (d_new == NULL)
     return -1;  // malloc failure
 
-  // swaps rows and columns
-  unsigned int i, j;
-  void* d_old = m->dd;
-  const size_t dwidth = _data_width(m->data_type);
-  // TODO common code: only swapping roll of i,j and indexing between _dcol2drow and _drow2dcol
-  for (i = 0; i < cols; i++) {
-    for (j = 0; j < rows; j++) {
-      const void* src = (char*) d_old + (i * rows + j) * dwidth;
-      void* dest = (char*) d_new + (j * cols + i) * dwidth;
-      memcpy(dest, src, dwidth);
-    }
-  }
+  // swaps rows and columns: the DCOL array is the (cols x rows) row-major transpose
+  _dense_transpose(d_new, m->dd, cols, rows, dwidth);
 
   // swap ptrs
-  free(m->dd);
+  _m_free(m, m->dd);
   m->dd = d_new;
   m->format = DROW;
 
   return 0;
 }
 
+// a(i,j) += b(k): dst[i] += src[k]
+static inline void _entry_accumulate(void* dst, const size_t i, void const* src, const size_t k, const enum matrix_data_type_t t)
+{
+  double re, im, re_k, im_k;
+  _entry_get(dst, i, t, &re, &im);
+  _entry_get(src, k, t, &re_k, &im_k);
+  _entry_set(dst, i, t, re + re_k, im + im_k);
+}
+
+static int _cmp_uint(void const* a, void const* b)
+{
+  const unsigned int x = *(unsigned int const*) a;
+  const unsigned int y = *(unsigned int const*) b;
+  return (x > y) - (x < y);
+}
+
+// CSR -> BCSR (block_size from m, or detected if zero)
+// Two passes over each block row: the first counts the distinct block columns
+// its rows touch, the second lists and sorts them then adds each entry into
+// its block. 'stamp' marks a block column as seen by this block row (+1, so
+// there is no clearing between block rows). Duplicate entries are summed.
+int _csr2bcsr(matrix_t* m, const enum matrix_base_t b_new);
+int _csr2bcsr(matrix_t* m, const enum matrix_base_t b_new)
+{
+  assert(m->format == SM_CSR);
+  if (m->data_type == SM_PATTERN)
+    return -1;  // the blocks have to hold their zeros
+  if (m->block_size == 0)
+    m->block_size = detect_matrix_block_size(m);
+  const size_t bs = m->block_size;
+  const size_t bb = bs * bs;
+  const size_t mb = (m->m + bs - 1) / bs;
+  const size_t nb = (m->n + bs - 1) / bs;
+  const unsigned int b = m->base;
+  const enum matrix_data_type_t t = m->data_type;
+  unsigned int const* const rowptr = m->ii;
+  unsigned int const* const colidx = m->jj;
+
+  unsigned int* const ptr = _m_malloc(m, (mb + 1) * sizeof(unsigned int));
+  size_t* const stamp = _m_calloc(m, nb + 1, sizeof(size_t));
+  unsigned int* const pos = _m_malloc(m, (nb + 1) * sizeof(unsigned int));  // where block column J is stored in this block row
+  if ((ptr == NULL) || (stamp == NULL) || (pos == NULL)) {  // malloc failure
+    _m_free(m, ptr);
+    _m_free(m, stamp);
+    _m_free(m, pos);
+    return -1;
+  }
+
+  // pass 1: count the blocks in each block row
+  ptr[0] = 0;
+  for (size_t I = 0; I < mb; I++) {
+    const size_t r_end = ((I + 1) * bs < m->m) ? (I + 1) * bs : m->m;
+    size_t c = 0;
+    for (size_t r = I * bs; r < r_end; r++) {
+      for (size_t k = rowptr[r] - b; k < rowptr[r + 1] - b; k++) {
+        const size_t J = (colidx[k] - b) / bs;
+        if (stamp[J] != I + 1) {
+          stamp[J] = I + 1;
+          c++;
+        }
+      }
+    }
+    ptr[I + 1] = ptr[I] + c;
+  }
+  const size_t nzb = ptr[mb];
+  if (nzb > UINT_MAX / bb) {  // the zero filled entries wouldn't fit 32-bit indices
+    _m_free(m, ptr);
+    _m_free(m, stamp);
+    _m_free(m, pos);
+    return -1;
+  }
+
+  unsigned int* const idx = _m_malloc(m, nzb * sizeof(unsigned int));
+  void* const dd = _m_calloc(m, nzb * bb, _data_width(t));  // zero filled blocks
+  if (((nzb != 0) && ((idx == NULL) || (dd == NULL)))) {  // malloc failure
+    _m_free(m, ptr);
+    _m_free(m, stamp);
+    _m_free(m, pos);
+    _m_free(m, idx);
+    _m_free(m, dd);
+    return -1;
+  }
+
+  // pass 2: list each block row's block columns in order, then fill the blocks
+  memset(stamp, 0, (nb + 1) * sizeof(size_t));
+  for (size_t I = 0; I < mb; I++) {
+    const size_t r_end = ((I + 1) * bs < m->m) ? (I + 1) * bs : m->m;
+    size_t p = ptr[I];
+    for (size_t r = I * bs; r < r_end; r++) {
+      for (size_t k = rowptr[r] - b; k < rowptr[r + 1] - b; k++) {
+        const size_t J = (colidx[k] - b) / bs;
+        if (stamp[J] != I + 1) {
+          stamp[J] = I + 1;
+          idx[p++] = J;
+        }
+      }
+    }
+    assert(p == ptr[I + 1]);
+    qsort(idx + ptr[I], p - ptr[I], sizeof(unsigned int), _cmp_uint);
+    for (size_t q = ptr[I]; q < p; q++)
+      pos[idx[q]] = q;
+
+    for (size_t r = I * bs; r < r_end; r++) {
+      for (size_t k = rowptr[r] - b; k < rowptr[r + 1] - b; k++) {
+        const size_t j = colidx[k] - b;
+        _entry_accumulate(dd, pos[j / bs] * bb + (r % bs) * bs + (j % bs), m->dd, k, t);
+      }
+    }
+  }
+  _shift_index(idx, nzb, b_new);
+  _shift_index(ptr, mb + 1, b_new);
+
+  _m_free(m, stamp);
+  _m_free(m, pos);
+  _m_free(m, m->ii);
+  _m_free(m, m->jj);
+  _m_free(m, m->dd);
+  m->ii = ptr;
+  m->jj = idx;
+  m->dd = dd;
+  m->nz = nzb * bb;
+  m->base = b_new;
+  m->format = SM_BCSR;
+  m->flags = MC_SORTED_BY_ROW | MC_MERGED;
+  return 0;
+}
+
+// BCSR -> CSR
+// Two passes over the rows: count the non-zeros each row holds across its
+// blocks, then copy them out. The zero fill and the overhang past the edge of
+// the matrix are dropped: the blocks can't tell the fill from a zero that was
+// stored, so a CSR -> BCSR -> CSR round trip loses the explicit zeros too.
+// Each row comes out sorted if the block columns were.
+int _bcsr2csr(matrix_t* m, const enum matrix_base_t b_new);
+int _bcsr2csr(matrix_t* m, const enum matrix_base_t b_new)
+{
+  assert(m->format == SM_BCSR);
+  assert(m->block_size != 0);
+  const size_t bs = m->block_size;
+  const size_t bb = bs * bs;
+  const unsigned int b = m->base;
+  const enum matrix_data_type_t t = m->data_type;
+  const size_t dwidth = _data_width(t);
+  unsigned int const* const ptr = m->ii;
+  unsigned int const* const idx = m->jj;
+
+  unsigned int* const rowptr = _m_malloc(m, (m->m + 1) * sizeof(unsigned int));
+  if (rowptr == NULL)
+    return -1;  // malloc failure
+
+  // pass 1: count
+  rowptr[0] = b_new;
+  for (size_t r = 0; r < m->m; r++) {
+    const size_t I = r / bs;
+    const size_t rr = r % bs;
+    size_t c = 0;
+    for (size_t q = ptr[I] - b; q < ptr[I + 1] - b; q++) {
+      const size_t j0 = (idx[q] - b) * bs;
+      for (size_t cc = 0; (cc < bs) && (j0 + cc < m->n); cc++)
+        c += _dense_nonzero(m->dd, q * bb + rr * bs + cc, t, 0.0);
+    }
+    rowptr[r + 1] = rowptr[r] + c;
+  }
+  const size_t nz = rowptr[m->m] - b_new;
+
+  unsigned int* const colidx = _m_malloc(m, nz * sizeof(unsigned int));
+  void* const dd = _m_malloc(m, nz * dwidth);
+  if ((nz != 0) && ((colidx == NULL) || (dd == NULL))) {  // malloc failure
+    _m_free(m, rowptr);
+    _m_free(m, colidx);
+    _m_free(m, dd);
+    return -1;
+  }
+
+  // pass 2: fill
+  for (size_t r = 0; r < m->m; r++) {
+    const size_t I = r / bs;
+    const size_t rr = r % bs;
+    size_t k = rowptr[r] - b_new;
+    for (size_t q = ptr[I] - b; q < ptr[I + 1] - b; q++) {
+      const size_t j0 = (idx[q] - b) * bs;
+      for (size_t cc = 0; (cc < bs) && (j0 + cc < m->n); cc++) {
+        const size_t src = q * bb + rr * bs + cc;
+        if (_dense_nonzero(m->dd, src, t, 0.0)) {
+          colidx[k] = j0 + cc + b_new;
+          _entry_copy(dd, k, m->dd, src, dwidth);
+          k++;
+        }
+      }
+    }
+    assert(k == rowptr[r + 1] - b_new);
+  }
+
+  _m_free(m, m->ii);
+  _m_free(m, m->jj);
+  _m_free(m, m->dd);
+  m->ii = rowptr;
+  m->jj = colidx;
+  m->dd = dd;
+  m->nz = nz;
+  m->base = b_new;
+  m->format = SM_CSR;
+  m->flags &= MC_SORTED_BY_ROW | MC_MERGED;  // distinct blocks -> distinct entries
+  return 0;
+}
+
 // convert between formats: some conversions might take more than one step
-// non-zero means failure: -1 to/from INVALID, +1 malloc/realloc failed
+// non-zero means failure: -1 to/from INVALID or too large for 32-bit indices, +1 malloc/realloc failed
 int convert_matrix(matrix_t* m, enum matrix_format_t f, enum matrix_base_t b)
 {
   // convert to base 0 if going to dense format
   if ((f == DROW) || (f == DCOL))
     b = FIRST_INDEX_ZERO;
 
-  // do base conversion
-  if (m->base != b) {
+  // a 64-bit matrix is left alone unless there is work to do
+  if (((m->format != f) || (m->base != b)) && (_kernel_storage(m) != 0))
+    return -1;
+
+  // CSR <-> CSC: direct transpose, does the base conversion on the way
+  if (((m->format == SM_CSR) && (f == SM_CSC)) || ((m->format == SM_CSC) && (f == SM_CSR)))
+    return _compressed_transpose(m, b, _omp_threads(m->nz));
+
+  // base conversion only: one pass over each index array
+  // (the format conversions below write their output in base 'b' directly)
+  if ((m->base != b) && (m->format == f)) {
+    const int delta = (int) b - (int) m->base;
     switch (m->format) {
       case INVALID:
         return -1;
@@ -925,50 +1779,31 @@ int convert_matrix(matrix_t* m, enum matrix_format_t f, enum matrix_base_t b)
       case DCOL:
         break;  // nothing needs to be done
       case SM_COO:  // adjust row and col
-        if (b == FIRST_INDEX_ZERO) {
-          for (unsigned int i = 0; i < (m->nz); i++) {
-            m->ii[i]--;
-            m->jj[i]--;
-          }
-        }
-        else {  // FIRST_INDEX_ONE
-          for (unsigned int i = 0; i < (m->nz); i++) {
-            m->ii[i]++;
-            m->jj[i]++;
-          }
-        }
+        _shift_index(m->ii, m->nz, delta);
+        _shift_index(m->jj, m->nz, delta);
         break;
       case SM_CSC:
-        if (b == FIRST_INDEX_ZERO) {
-          for (unsigned int i = 0; i < (m->nz); i++)
-            m->ii[i]--;
-          for (unsigned int i = 0; i < ((m->n) + 1); i++)
-            m->jj[i]--;  // col ptrs
-        }
-        else {  // FIRST_INDEX_ONE
-          for (unsigned int i = 0; i < m->nz; i++)
-            m->ii[i]++;
-          for (unsigned int i = 0; i < ((m->n) + 1); i++)
-            m->jj[i]++;  // col ptrs
-        }
+        _shift_index(m->ii, m->nz, delta);
+        _shift_index(m->jj, m->n + 1, delta);  // col ptrs
         break;
       case SM_CSR:
-        if (b == FIRST_INDEX_ZERO) {
-          for (unsigned int i = 0; i < (m->nz); i++)
-            m->jj[i]--;
-          for (unsigned i = 0; i < ((m->m) + 1); i++)
-            m->ii[i]--;  // row ptrs
-        }
-        else {  // FIRST_INDEX_ONE
-          for (unsigned i = 0; i < m->nz; i++)
-            m->jj[i]++;
-          for (unsigned i = 0; i < ((m->m) + 1); i++)
-            m->ii[i]++;  // row ptrs
-        }
+        _shift_index(m->jj, m->nz, delta);
+        _shift_index(m->ii, m->m + 1, delta);  // row ptrs
         break;
+      case SM_BCSR:
+      {
+        size_t ni, nj;
+        _index_lengths(m, &ni, &nj);
+        _shift_index(m->jj, nj, delta);
+        _shift_index(m->ii, ni, delta);  // block row ptrs
+        break;
+      }
     }
     m->base = b;
+    return 0;
   }
+  if ((m->format == DROW) || (m->format == DCOL))
+    m->base = FIRST_INDEX_ZERO;  // dense matrices don't have indices, so are always "zero-based"
 
 //    //output matrix --> MS: This loop+print segfaults!
 //    int i;
@@ -976,7 +1811,7 @@ int convert_matrix(matrix_t* m, enum matrix_format_t f, enum matrix_base_t b)
 //        printf("%f %u %u \n", ((float*) m->dd)[i], m->ii[i], m->jj[i]);
 //    }
 
-  int ret1, ret2, ret3;
+  int ret1, ret2, ret3, ret4;
   switch (m->format) {
     case INVALID:
       return -2;
@@ -994,13 +1829,19 @@ int convert_matrix(matrix_t* m, enum matrix_format_t f, enum matrix_base_t b)
           return ret1;
         case SM_CSC:
           ret1 = _drow2coo(m, b);
-          ret2 = _coo2csc(m);
+          ret2 = _coo2csc(m, b);
           return (ret1 || ret2);
         case SM_CSR:
           ret1 = _drow2coo(m, b);
-          ret2 = _coo2csr(m);
+          ret2 = _coo2csr(m, b);
           return (ret1 || ret2);
+        case SM_BCSR:
+          ret1 = _drow2coo(m, b);
+          ret2 = _coo2csr(m, b);
+          ret3 = _csr2bcsr(m, b);
+          return (ret1 || ret2 || ret3);
       }
+      break;
     case DCOL:
       switch (f) {
         case INVALID:
@@ -1017,14 +1858,21 @@ int convert_matrix(matrix_t* m, enum matrix_format_t f, enum matrix_base_t b)
         case SM_CSC:
           ret1 = _dcol2drow(m);
           ret2 = _drow2coo(m, b);
-          ret3 = _coo2csc(m);
+          ret3 = _coo2csc(m, b);
           return (ret1 || ret2 || ret3);
         case SM_CSR:
           ret1 = _dcol2drow(m);
           ret2 = _drow2coo(m, b);
-          ret3 = _coo2csr(m);
+          ret3 = _coo2csr(m, b);
           return (ret1 || ret2 || ret3);
+        case SM_BCSR:
+          ret1 = _dcol2drow(m);
+          ret2 = _drow2coo(m, b);
+          ret3 = _coo2csr(m, b);
+          ret4 = _csr2bcsr(m, b);
+          return (ret1 || ret2 || ret3 || ret4);
       }
+      break;
     case SM_COO:
       switch (f) {
         case INVALID:
@@ -1039,61 +1887,146 @@ int convert_matrix(matrix_t* m, enum matrix_format_t f, enum matrix_base_t b)
         case SM_COO:
           return 0;  // nothing to do
         case SM_CSC:
-          ret1 = _coo2csc(m);
+          ret1 = _coo2csc(m, b);
           return ret1;
         case SM_CSR:
-          ret1 = _coo2csr(m);
+          ret1 = _coo2csr(m, b);
           return ret1;
+        case SM_BCSR:
+          ret1 = _coo2csr(m, b);
+          ret2 = _csr2bcsr(m, b);
+          return (ret1 || ret2);
       }
+      break;
     case SM_CSC:
       switch (f) {
         case INVALID:
           return -6;
         case DROW:
-          ret1 = _csc2coo(m);
+          ret1 = _csc2coo(m, b);
           ret2 = _coo2drow(m);
           return (ret1 || ret2);
         case DCOL:
-          ret1 = _csc2coo(m);
+          ret1 = _csc2coo(m, b);
           ret2 = _coo2drow(m);
           ret3 = _drow2dcol(m);
           return (ret1 || ret2 || ret3);
         case SM_COO:
-          ret1 = _csc2coo(m);
+          ret1 = _csc2coo(m, b);
           return ret1;
         case SM_CSC:
           return 0;  // nothing to do
-        case SM_CSR:
-          ret1 = _csc2coo(m);
-          ret2 = _coo2csr(m);
+        case SM_CSR:  // handled above, by direct transpose
+          ret1 = _compressed_transpose(m, b, 1);
+          return ret1;
+        case SM_BCSR:
+          ret1 = _compressed_transpose(m, b, _omp_threads(m->nz));
+          ret2 = _csr2bcsr(m, b);
           return (ret1 || ret2);
       }
+      break;
     case SM_CSR:
       switch (f) {
         case INVALID:
           return -7;
         case DROW:
-          ret1 = _csr2coo(m);
+          ret1 = _csr2coo(m, b);
           ret2 = _coo2drow(m);
           return (ret1 || ret2);
         case DCOL:
-          ret1 = _csr2coo(m);
+          ret1 = _csr2coo(m, b);
           ret2 = _coo2drow(m);
           ret3 = _drow2dcol(m);
           return (ret1 || ret2 || ret3);
         case SM_COO:
-          ret1 = _csr2coo(m);
+          ret1 = _csr2coo(m, b);
+          return ret1;
+        case SM_CSC:  // handled above, by direct transpose
+          ret1 = _compressed_transpose(m, b, 1);
+          return ret1;
+        case SM_CSR:
+          return 0;  // nothing to do
+        case SM_BCSR:
+          ret1 = _csr2bcsr(m, b);
           return ret1;
+      }
+      break;
+    case SM_BCSR:
+      switch (f) {
+        case INVALID:
+          return -8;
+        case DROW:
+          ret1 = _bcsr2csr(m, b);
+          ret2 = _csr2coo(m, b);
+          ret3 = _coo2drow(m);
+          return (ret1 || ret2 || ret3);
+        case DCOL:
+          ret1 = _bcsr2csr(m, b);
+          ret2 = _csr2coo(m, b);
+          ret3 = _coo2drow(m);
+          ret4 = _drow2dcol(m);
+          return (ret1 || ret2 || ret3 || ret4);
+        case SM_COO:
+          ret1 = _bcsr2csr(m, b);
+          ret2 = _csr2coo(m, b);
+          return (ret1 || ret2);
         case SM_CSC:
-          ret1 = _csr2coo(m);
-          ret2 = _coo2csc(m);
+          ret1 = _bcsr2csr(m, b);
+          ret2 = _compressed_transpose(m, b, _omp_threads(m->nz));
           return (ret1 || ret2);
         case SM_CSR:
+          ret1 = _bcsr2csr(m, b);
+          return ret1;
+        case SM_BCSR:
           return 0;  // nothing to do
       }
+      break;
   }
   assert(0);  // shouldn't be able to get here due to returns
-  return -8;
+  return -9;
+}
+
+// turn the value of a(i,j) (entry k) into the value of a(j,i):
+// unchanged if symmetric, negated if skew-symmetric, conjugated if hermitian
+static inline void _entry_mirror(void* dd, const size_t k, const enum matrix_data_type_t t, const enum matrix_symmetry_t sym);
+static inline void _entry_mirror(void* dd, const size_t k, const enum matrix_data_type_t t, const enum matrix_symmetry_t sym)
+{
+  if (sym == SM_SKEW_SYMMETRIC) {
+    switch (t) {
+      case REAL_DOUBLE:
+        ((double*) dd)[k] = -((double*) dd)[k];
+        break;
+      case REAL_SINGLE:
+        ((float*) dd)[k] = -((float*) dd)[k];
+        break;
+      case COMPLEX_DOUBLE:
+        ((double*) dd)[2 * k] = -((double*) dd)[2 * k];
+        ((double*) dd)[2 * k + 1] = -((double*) dd)[2 * k + 1];
+        break;
+      case COMPLEX_SINGLE:
+        ((float*) dd)[2 * k] = -((float*) dd)[2 * k];
+        ((float*) dd)[2 * k + 1] = -((float*) dd)[2 * k + 1];
+        break;
+      case SM_PATTERN:
+        break;  // no data
+    }
+  }
+  else if (sym == SM_HERMITIAN) {  // real hermitian is just symmetric
+    if (t == COMPLEX_DOUBLE)
+      ((double*) dd)[2 * k + 1] = -((double*) dd)[2 * k + 1];
+    else if (t == COMPLEX_SINGLE)
+      ((float*) dd)[2 * k + 1] = -((float*) dd)[2 * k + 1];
+  }
+}
+
+// mirror every value, after the stored triangle has been transposed
+static inline void _mirror_values(matrix_t* m);
+static inline void _mirror_values(matrix_t* m)
+{
+  if ((m->sym == SM_SYMMETRIC) || (m->data_type == SM_PATTERN))
+    return;  // nothing to do
+  for (size_t k = 0; k < m->nz; k++)
+    _entry_mirror(m->dd, k, m->data_type, m->sym);
 }
 
 // swap upper-to-lower triangular and vice-versa
@@ -1101,7 +2034,7 @@ int convert_matrix(matrix_t* m, enum matrix_format_t f, enum matrix_base_t b)
 static inline void _symmetry_swap(matrix_t* m)
 {
   assert(m->format == SM_COO);
-  assert(m->sym == SM_SYMMETRIC);
+  assert(m->sym != SM_UNSYMMETRIC);
   assert(m->location != MC_STORE_BOTH);
 
   // swap ii and jj (rows and column indices)
@@ -1109,8 +2042,15 @@ static inline void _symmetry_swap(matrix_t* m)
   void * const t = m->ii;
   m->ii = m->jj;
   m->jj = t;
+  _mirror_values(m);
 
   // update matrix info
+  const unsigned int sorted = m->flags & MC_SORTED;
+  m->flags &= ~MC_SORTED;
+  if (sorted & MC_SORTED_BY_ROW)
+    m->flags |= MC_SORTED_BY_COL;
+  if (sorted & MC_SORTED_BY_COL)
+    m->flags |= MC_SORTED_BY_ROW;
   if (m->location == UPPER_TRIANGULAR)
     m->location = LOWER_TRIANGULAR;
   else
@@ -1119,49 +2059,145 @@ static inline void _symmetry_swap(matrix_t* m)
 }
 
 // duplicate data
+// the mirrored off-diagonal entries are appended in a single pass,
+// after growing the arrays once to their final size
 // returns non-zero on malloc failure
 static inline int _symmetry_both(matrix_t* m);
 static inline int _symmetry_both(matrix_t* m)
 {
   assert(m->format == SM_COO);
-  assert(m->sym == SM_SYMMETRIC);
+  assert(m->sym != SM_UNSYMMETRIC);
   assert(m->location != MC_STORE_BOTH);
 
   const size_t dwidth = _data_width(m->data_type);
   const size_t nz_old = m->nz;
-  if (_realloc_arrays(m, nz_old * 2) != 0)
+  size_t off = 0;  // off-diagonal entries
+  for (size_t k = 0; k < nz_old; k++)
+    off += (m->ii[k] != m->jj[k]);
+  if (nz_old + off + m->base > UINT_MAX)
+    return -1;  // too large for 32-bit indices
+  if (_realloc_arrays(m, nz_old + off) != 0)
     return -1;
 
-  assert(m->nz == nz_old * 2);
-
-  // duplicate data
   // append the converse indices, duplicate the data
-  // reverse ii and jj in the copied portions, appended to the old data
-  memcpy(m->ii + nz_old, m->jj, nz_old * sizeof(unsigned int));
-  memcpy(m->jj + nz_old, m->ii, nz_old * sizeof(unsigned int));
-  memcpy(m->dd + nz_old * dwidth, m->dd, nz_old * dwidth);
+  size_t p = nz_old;
+  for (size_t k = 0; k < nz_old; k++) {
+    if (m->ii[k] != m->jj[k]) {
+      m->ii[p] = m->jj[k];
+      m->jj[p] = m->ii[k];
+      _entry_copy(m->dd, p, m->dd, k, dwidth);
+      _entry_mirror(m->dd, p, m->data_type, m->sym);
+      p++;
+    }
+  }
+  assert(p == m->nz);
 
-  // update ptrs
   m->location = MC_STORE_BOTH;
-  // TODO clean this up!
-  // TODO -- better to strip out entries on the diagonal as we go! (doing it the current way means copying the data multiple times
-  // but now we might have duplicate entries if there were any on the diagonal
-  // so remove anything on the diagonal that occurs in the second set of arrays
-  int del = 0;
-  for (unsigned i = nz_old; i < m->nz - del; i++) {
-    if ((m->ii)[i] == (m->jj)[i]) {  // on the diagonal
-      if (i + 1 < m->nz) {  // unless its the last entry
-        // Note: have to use memmove here since potentially the arrays dst and src overlap when we shuffle them downwards
-        memmove(m->ii + i, m->ii + (i + 1), (m->nz - i - 1 - del) * sizeof(unsigned int));
-        memmove(m->jj + i, m->jj + (i + 1), (m->nz - i - 1 - del) * sizeof(unsigned int));
-        memmove(m->dd + i * dwidth, m->dd + (i + 1) * dwidth, (m->nz - i - 1 - del) * dwidth);
-        i--;
+  m->flags &= ~MC_SORTED;  // the mirrored entries are appended at the end
+  return 0;
+}
+
+// duplicate data, producing sorted CSR or CSC (f)
+// Walking the stored triangle column by column (CSC, rows sorted), each entry
+// (i,j) is placed in row i and its mirror (j,i) in row j: every row then
+// receives its columns in increasing order, so one counting pass and one
+// scatter pass give sorted CSR. Since the result is symmetric its CSC arrays
+// are the same as its CSR arrays (once skew-symmetric or hermitian values are
+// mirrored: the CSC arrays are the CSR arrays of the transpose).
+// If the rows weren't sorted within each column, neither is the output.
+// returns non-zero on malloc failure
+static int _symmetry_both_compressed(matrix_t* m, const enum matrix_format_t f);
+static int _symmetry_both_compressed(matrix_t* m, const enum matrix_format_t f)
+{
+  assert(m->sym != SM_UNSYMMETRIC);
+  assert(m->location != MC_STORE_BOTH);
+  assert((f == SM_CSR) || (f == SM_CSC));
+  assert(m->m == m->n);
+
+  int ret;
+  if ((ret = convert_matrix(m, SM_CSC, m->base)) != 0)
+    return ret;
+
+  const size_t n = m->n;
+  const size_t dwidth = _data_width(m->data_type);
+  const unsigned int b = m->base;
+  const int sorted = (m->flags & MC_SORTED_BY_COL) != 0;
+  unsigned int const* const colptr = m->jj;
+  unsigned int const* const rowidx = m->ii;
+
+  unsigned int* const ptr = _m_calloc(m, n + 1, sizeof(unsigned int));
+  if (ptr == NULL)
+    return -1;
+  size_t off = 0;  // off-diagonal entries
+  for (size_t j = 0; j < n; j++) {
+    for (unsigned int k = colptr[j] - b; k < colptr[j + 1] - b; k++) {
+      const unsigned int i = rowidx[k] - b;
+      ptr[i + 1]++;
+      if (i != j) {
+        ptr[j + 1]++;
+        off++;
+      }
+    }
+  }
+  if (m->nz + off + b > UINT_MAX) {  // too large for 32-bit indices
+    _m_free(m, ptr);
+    return -1;
+  }
+  for (size_t r = 0; r < n; r++)
+    ptr[r + 1] += ptr[r];
+
+  const size_t nz = ptr[n];
+  unsigned int* const idx = _m_malloc(m, nz * sizeof(unsigned int));
+  void* const dd = (dwidth == 0) ? NULL : _m_malloc(m, nz * dwidth);
+  if (((idx == NULL) && (nz != 0)) || ((dwidth != 0) && (dd == NULL) && (nz != 0))) {
+    _m_free(m, ptr);
+    _m_free(m, idx);
+    _m_free(m, dd);
+    return -1;
+  }
+
+  const int mirror = (m->sym != SM_SYMMETRIC) && (m->data_type != SM_PATTERN);
+  const int transposed = (f == SM_CSC);  // building the rows of the transpose
+  for (size_t j = 0; j < n; j++) {
+    for (unsigned int k = colptr[j] - b; k < colptr[j + 1] - b; k++) {
+      const unsigned int i = rowidx[k] - b;
+      unsigned int p = ptr[i]++;
+      idx[p] = j + b;
+      _entry_copy(dd, p, m->dd, k, dwidth);
+      if (mirror && transposed)
+        _entry_mirror(dd, p, m->data_type, m->sym);
+      if (i != j) {
+        p = ptr[j]++;
+        idx[p] = i + b;
+        _entry_copy(dd, p, m->dd, k, dwidth);
+        if (mirror && !transposed)
+          _entry_mirror(dd, p, m->data_type, m->sym);
       }
-      del++;  // deleting the i-th entry
     }
   }
-  _realloc_arrays(m, m->nz - del);
-  // ignore return value .. we're shrinking the arrays and if the realloc fails we can continue on
+  // ptr[r] now points at the end of row r: shift back, into base b
+  for (size_t r = n; r > 0; r--)
+    ptr[r] = ptr[r - 1] + b;
+  ptr[0] = b;
+
+  _m_free(m, m->ii);
+  _m_free(m, m->jj);
+  _m_free(m, m->dd);
+  if (f == SM_CSR) {
+    m->ii = ptr;
+    m->jj = idx;
+  }
+  else {
+    m->jj = ptr;
+    m->ii = idx;
+  }
+  m->dd = dd;
+  m->nz = nz;
+  m->format = f;
+  m->location = MC_STORE_BOTH;
+  m->flags &= ~MC_SORTED;
+  if (sorted)
+    m->flags |= (f == SM_CSR) ? MC_SORTED_BY_ROW : MC_SORTED_BY_COL;
   return 0;
 }
 
@@ -1172,20 +2208,21 @@ static inline int _realloc_arrays(matrix_t* m, size_t nz)
 
   // TODO could probably clean this code up: realloc free's the ptrs and returns NULL if nz = 0... but need to detect the malloc failure cases too!
   if (nz == 0) {
-    free(m->ii);
-    free(m->jj);
-    free(m->dd);
+    _m_free(m, m->ii);
+    _m_free(m, m->jj);
+    _m_free(m, m->dd);
     m->ii = NULL;
     m->jj = NULL;
     m->dd = NULL;
     m->nz = 0;
+    return 0;
   }
 
   const size_t dwidth = _data_width(m->data_type);
   // resize arrays
-  unsigned int* ii_new = realloc(m->ii, nz * sizeof(unsigned int));
-  unsigned int* jj_new = realloc(m->jj, nz * sizeof(unsigned int));
-  void* dd_new = realloc(m->dd, nz * dwidth);
+  unsigned int* ii_new = _m_realloc(m, m->ii, nz * sizeof(unsigned int));
+  unsigned int* jj_new = _m_realloc(m, m->jj, nz * sizeof(unsigned int));
+  void* dd_new = (dwidth == 0) ? NULL : _m_realloc(m, m->dd, nz * dwidth);  // pattern: no data
 
   // udpate ptrs
   if (ii_new != NULL) {
@@ -1198,7 +2235,7 @@ static inline int _realloc_arrays(matrix_t* m, size_t nz)
     m->dd = dd_new;
   }
 
-  if ((ii_new == NULL) || (jj_new == NULL) || (dd_new == NULL)) {
+  if ((ii_new == NULL) || (jj_new == NULL) || ((dd_new == NULL) && (dwidth != 0))) {
     m->nz = 0;  // something has gone horribly wrong, don't look at these arrays!
     assert(0);
     return -1;
@@ -1211,31 +2248,93 @@ static inline int _realloc_arrays(matrix_t* m, size_t nz)
 
 // search for duplicate matrix entries
 // combine the duplicates by adding
-// static inline void _coo_merge_duplicate_entries(matrix_t* m);
-static inline void _coo_merge_duplicate_entries(matrix_t* m)
+// CSR/CSC: MC_STORE_BOTH -> LOWER_TRIANGULAR or UPPER_TRIANGULAR
+// a filtered copy, compacting the arrays in place
+// note that realloc might fail but we can carry on: no failure cases
+static void _symmetry_filter_compressed(matrix_t* m, const enum matrix_symmetric_storage_t loc);
+static void _symmetry_filter_compressed(matrix_t* m, const enum matrix_symmetric_storage_t loc)
 {
-  assert(m->format == SM_COO);
+  assert((m->format == SM_CSR) || (m->format == SM_CSC));
+  assert(m->sym != SM_UNSYMMETRIC);
+  assert(m->location == MC_STORE_BOTH);
+  assert(loc != MC_STORE_BOTH);
+
+  const int by_col = (m->format == SM_CSC);
+  unsigned int* const ptr = by_col ? m->jj : m->ii;
+  unsigned int* const idx = by_col ? m->ii : m->jj;
+  const size_t nmajor = by_col ? m->n : m->m;
   const size_t dwidth = _data_width(m->data_type);
-  int del = 0;
-  // expensive: this is O(log(n))?
-  assert(m->data_type == REAL_DOUBLE);  // TODO other data types
-  double* d = (double*) m->dd;
-  for (unsigned i = 0; i < m->nz; i++) {
-    for (unsigned j = i + 1; i < m->nz; j++) {
-      if ((m->ii[i] == m->ii[j]) && (m->jj[i] == m->jj[j])) {
-        // combine the duplicate entries (addition)
-        d[i] = d[i] + d[j];
-
-        del++;  // deleting the j-th entry
-        if (j + 1 != m->nz) {  // unless its the last entry
-          memcpy(m->ii + j, m->ii + (j + 1), (m->nz - j - 1) * sizeof(unsigned int));
-          memcpy(m->jj + j, m->jj + (j + 1), (m->nz - j - 1) * sizeof(unsigned int));
-          memcpy(m->dd + j * dwidth, m->dd + (j + 1) * dwidth, (m->nz - j - 1) * dwidth);
-        }
+  const unsigned int b = m->base;
+  // lower triangle: row >= column
+  const int keep_major_ge = (loc == LOWER_TRIANGULAR) ? !by_col : by_col;
+
+  size_t p = 0;
+  unsigned int start = ptr[0] - b;
+  for (size_t r = 0; r < nmajor; r++) {
+    const unsigned int end = ptr[r + 1] - b;
+    ptr[r] = p + b;
+    for (unsigned int k = start; k < end; k++) {
+      const unsigned int c = idx[k] - b;
+      if (keep_major_ge ? (r >= c) : (r <= c)) {
+        idx[p] = idx[k];
+        _entry_copy(m->dd, p, m->dd, k, dwidth);
+        p++;
       }
     }
+    start = end;
+  }
+  ptr[nmajor] = p + b;
+
+  if ((p != m->nz) && (p != 0)) {  // shrink, keep the old arrays if realloc fails
+    unsigned int* const idx_new = _m_realloc(m, idx, p * sizeof(unsigned int));
+    if (idx_new != NULL) {
+      if (by_col)
+        m->ii = idx_new;
+      else
+        m->jj = idx_new;
+    }
+    if (dwidth != 0) {
+      void* const dd_new = _m_realloc(m, m->dd, p * dwidth);
+      if (dd_new != NULL)
+        m->dd = dd_new;
+    }
+  }
+  m->nz = p;
+  m->location = loc;
+}
+
+// CSR/CSC: UPPER_TRIANGULAR <-> LOWER_TRIANGULAR
+// for a symmetric matrix the upper triangle is the transpose of the lower:
+// the CSR arrays of one are the CSC arrays of the other, so relabel the
+// arrays (free) then transpose back into the original format
+// (skew-symmetric and hermitian values are then mirrored)
+// returns non-zero on malloc failure
+static int _symmetry_swap_compressed(matrix_t* m);
+static int _symmetry_swap_compressed(matrix_t* m)
+{
+  assert((m->format == SM_CSR) || (m->format == SM_CSC));
+  assert(m->sym != SM_UNSYMMETRIC);
+  assert(m->location != MC_STORE_BOTH);
+  assert(m->m == m->n);
+
+  unsigned int* const t = m->ii;
+  m->ii = m->jj;
+  m->jj = t;
+  m->format = (m->format == SM_CSR) ? SM_CSC : SM_CSR;
+  m->location = (m->location == UPPER_TRIANGULAR) ? LOWER_TRIANGULAR : UPPER_TRIANGULAR;
+
+  const int ret = _compressed_transpose(m, m->base, _omp_threads(m->nz));
+  if (ret != 0) {  // undo
+    unsigned int* const u = m->ii;
+    m->ii = m->jj;
+    m->jj = u;
+    m->format = (m->format == SM_CSR) ? SM_CSC : SM_CSR;
+    m->location = (m->location == UPPER_TRIANGULAR) ? LOWER_TRIANGULAR : UPPER_TRIANGULAR;
+  }
+  else {
+    _mirror_values(m);
   }
-  _realloc_arrays(m, m->nz - del);
+  return ret;
 }
 
 // convert from symmetry MC_STORE_BOTH -> LOWER_TRIANGULAR
@@ -1244,7 +2343,7 @@ static inline void _symmetry_lower(matrix_t* m);
 static inline void _symmetry_lower(matrix_t* m)
 {
   assert(m->format == SM_COO);
-  assert(m->sym == SM_SYMMETRIC);
+  assert(m->sym != SM_UNSYMMETRIC);
   assert(m->location == MC_STORE_BOTH);
 
   // remove redundant entries in the upper triangle
@@ -1264,17 +2363,33 @@ static inline void _symmetry_lower(matrix_t* m)
   m->location = LOWER_TRIANGULAR;
 }
 
+// symmetric, skew-symmetric and hermitian (the mirrored values are negated or conjugated)
 int convert_matrix_symmetry(matrix_t* m, enum matrix_symmetric_storage_t loc)
 {
-  assert(m->sym == SM_SYMMETRIC);
+  assert(m->sym != SM_UNSYMMETRIC);
 
   // short circuit if no work to do
   //if(m->location == loc)
   //  return 0;
 
   int ret;
+  if ((ret = _kernel_storage(m)) != 0)
+    return ret;
   const enum matrix_format_t old_format = m->format;
 
+  // CSR/CSC are converted directly, without going through COO
+  if ((old_format == SM_CSR) || (old_format == SM_CSC)) {
+    if (m->location == loc)
+      return 0;  // nothing to do
+    else if (loc == MC_STORE_BOTH)
+      return _symmetry_both_compressed(m, old_format);
+    else if (m->location == MC_STORE_BOTH)
+      _symmetry_filter_compressed(m, loc);
+    else
+      return _symmetry_swap_compressed(m);
+    return 0;
+  }
+
   // convert to COO format
   // TODO handle other formats directly (changing formats is expensive)?
   if ((ret = convert_matrix(m, SM_COO, m->base)) != 0)
@@ -1327,6 +2442,318 @@ int convert_matrix_symmetry(matrix_t* m, enum matrix_symmetric_storage_t loc)
 }
 
 // non-zero indicates failure (malloc)
+// read entry k as a (real, imaginary) pair, pattern entries read as 1.0
+static inline void _entry_get(void const* dd, const size_t k, const enum matrix_data_type_t t, double* re, double* im)
+{
+  switch (t) {
+    case REAL_DOUBLE:
+      *re = ((double const*) dd)[k];
+      *im = 0.0;
+      break;
+    case REAL_SINGLE:
+      *re = ((float const*) dd)[k];
+      *im = 0.0;
+      break;
+    case COMPLEX_DOUBLE:
+      *re = ((double const*) dd)[2 * k];
+      *im = ((double const*) dd)[2 * k + 1];
+      break;
+    case COMPLEX_SINGLE:
+      *re = ((float const*) dd)[2 * k];
+      *im = ((float const*) dd)[2 * k + 1];
+      break;
+    case SM_PATTERN:
+    default:
+      *re = 1.0;
+      *im = 0.0;
+      break;
+  }
+}
+
+// write entry k from a (real, imaginary) pair, the imaginary part is dropped for real types
+static inline void _entry_set(void* dd, const size_t k, const enum matrix_data_type_t t, const double re, const double im)
+{
+  switch (t) {
+    case REAL_DOUBLE:
+      ((double*) dd)[k] = re;
+      break;
+    case REAL_SINGLE:
+      ((float*) dd)[k] = re;
+      break;
+    case COMPLEX_DOUBLE:
+      ((double*) dd)[2 * k] = re;
+      ((double*) dd)[2 * k + 1] = im;
+      break;
+    case COMPLEX_SINGLE:
+      ((float*) dd)[2 * k] = re;
+      ((float*) dd)[2 * k + 1] = im;
+      break;
+    case SM_PATTERN:
+      break;  // no data
+  }
+}
+
+// add entry j to entry i
+static inline void _entry_add(void* dd, const size_t i, const size_t j, const enum matrix_data_type_t t)
+{
+  switch (t) {
+    case REAL_DOUBLE:
+      ((double*) dd)[i] += ((double const*) dd)[j];
+      break;
+    case REAL_SINGLE:
+      ((float*) dd)[i] += ((float const*) dd)[j];
+      break;
+    case COMPLEX_DOUBLE:
+      ((double*) dd)[2 * i] += ((double const*) dd)[2 * j];
+      ((double*) dd)[2 * i + 1] += ((double const*) dd)[2 * j + 1];
+      break;
+    case COMPLEX_SINGLE:
+      ((float*) dd)[2 * i] += ((float const*) dd)[2 * j];
+      ((float*) dd)[2 * i + 1] += ((float const*) dd)[2 * j + 1];
+      break;
+    case SM_PATTERN:
+      break;  // no data
+  }
+}
+
+// sort the COO entries (radix sort), then sum runs of duplicates while
+// compacting the arrays in a single pass
+// CSR/CSC are merged via COO (counting sorts: O(nz + n))
+// nothing is done if the matrix is already flagged as merged (COO is still sorted)
+int merge_duplicate_entries(matrix_t* m)
+{
+  assert(m != NULL);
+  if ((m->format == INVALID) || (m->format == DROW) || (m->format == DCOL))
+    return 0;  // can't have duplicates
+  if ((m->flags & MC_MERGED) && (m->format != SM_COO))
+    return 0;  // already done
+
+  int ret;
+  const enum matrix_format_t old_format = m->format;
+  if ((ret = _kernel_storage(m)) != 0)
+    return ret;
+  if ((ret = convert_matrix(m, SM_COO, m->base)) != 0)
+    return ret;
+  if ((ret = _sort_coo(m, 0, _omp_threads(m->nz))) != 0)
+    return ret;
+  if (m->flags & MC_MERGED)
+    return 0;  // was COO: only needed sorting
+
+  const size_t dwidth = _data_width(m->data_type);
+  size_t nz = 0;
+  for (size_t k = 0; k < m->nz; k++) {
+    if ((nz > 0) && (m->ii[k] == m->ii[nz - 1]) && (m->jj[k] == m->jj[nz - 1])) {
+      _entry_add(m->dd, nz - 1, k, m->data_type);
+    }
+    else {
+      if (k != nz) {
+        m->ii[nz] = m->ii[k];
+        m->jj[nz] = m->jj[k];
+        _entry_copy(m->dd, nz, m->dd, k, dwidth);
+      }
+      nz++;
+    }
+  }
+  if ((ret = _realloc_arrays(m, nz)) != 0)
+    return ret;
+  m->flags |= MC_MERGED;  // still sorted by row
+
+  return convert_matrix(m, old_format, m->base);
+}
+
+// x and y match to a relative tolerance (so zero only matches zero)
+static inline int _close(const double x, const double y, const double tol)
+{
+  const double ax = (x < 0) ? -x : x;
+  const double ay = (y < 0) ? -y : y;
+  const double d = (x - y < 0) ? y - x : x - y;
+  return d <= tol * ((ax > ay) ? ax : ay);
+}
+
+// stable counting sort of the permutation 'in' (identity if NULL) by 'key'
+// (nz entries, values b..n-1+b) into 'out', 'cnt' needs n+1 entries
+static void _counting_sort_perm(unsigned int* out, unsigned int const* in, unsigned int const* key,
+                                const size_t nz, const size_t n, const unsigned int b, unsigned int* cnt)
+{
+  _count_ptr(cnt, n, key, nz, b);
+  for (size_t t = 0; t < nz; t++) {
+    const unsigned int k = (in == NULL) ? t : in[t];
+    out[cnt[key[k] - b]++] = k;
+  }
+}
+
+// The entries are ordered twice with counting sorts: by (row, column) which
+// walks A row by row, and by (column, row) which walks the transpose A' row
+// by row. The two sorted streams are then merged: for each location (i,j)
+// a(i,j) is compared with a'(i,j) = a(j,i). Duplicate entries are summed, a
+// missing partner counts as zero. O(nz + n) time and memory.
+int analyse_matrix_symmetry(matrix_t* m, struct matrix_symmetry_info_t* info)
+{
+  assert(m != NULL);
+  assert(info != NULL);
+  *info = (struct matrix_symmetry_info_t) {
+    0
+  };
+  if ((m->sym != SM_UNSYMMETRIC) && (m->location != MC_STORE_BOTH))
+    return -1;  // only one triangle is stored, can't check it
+  if ((m->format == INVALID) || (m->m != m->n))
+    return 0;  // can't be symmetric
+  if (_kernel_storage(m) != 0)
+    return -3;
+  if (m->format == SM_BCSR) {  // on the unblocked entries: the zero fill isn't part of the pattern
+    matrix_t* c = copy_matrix(m);
+    if (c == NULL)
+      return -2;
+    int ret = convert_matrix(c, SM_CSR, c->base);
+    if (ret == 0)
+      ret = analyse_matrix_symmetry(c, info);
+    free_matrix(c);
+    return (ret > 0) ? -2 : ret;
+  }
+
+  const enum matrix_data_type_t dt = m->data_type;
+  const int is_complex = (dt == COMPLEX_DOUBLE) || (dt == COMPLEX_SINGLE);
+  const double tol = ((dt == REAL_SINGLE) || (dt == COMPLEX_SINGLE)) ? 5e-6 : 5e-15;  // TODO use limits.h machine precision
+  const size_t n = m->n;
+  int sym = 1, skew = 1, herm = is_complex;
+  info->pattern = 1;
+
+  if ((m->format == DROW) || (m->format == DCOL)) {
+    // a(i,j) is at i*n+j in DROW, a(j,i) in DCOL: a square matrix is
+    // symmetric in one iff it is in the other
+    for (size_t i = 0; i < n; i++) {
+      for (size_t j = i; j < n; j++) {
+        double are, aim, tre, tim;
+        _entry_get(m->dd, i * n + j, dt, &are, &aim);
+        _entry_get(m->dd, j * n + i, dt, &tre, &tim);
+        if (i != j) {
+          const int has_a = (are != 0.0) || (aim != 0.0);
+          const int has_t = (tre != 0.0) || (tim != 0.0);
+          info->nz_offdiag += has_a + has_t;
+          info->nz_matched += (has_a && has_t) ? 2 : 0;
+          if (has_a != has_t)
+            info->pattern = 0;
+        }
+        sym &= _close(are, tre, tol) && _close(aim, tim, tol);
+        skew &= _close(are, -tre, tol) && _close(aim, -tim, tol);
+        herm &= _close(are, tre, tol) && _close(aim, -tim, tol);
+      }
+    }
+  }
+  else {
+    const size_t nz = m->nz;
+    const unsigned int b = m->base;
+    unsigned int const* rows = m->ii;
+    unsigned int const* cols = m->jj;
+    unsigned int* expanded = NULL;
+    if ((m->format == SM_CSR) || (m->format == SM_CSC)) {
+      // expand the pointers back into indices
+      unsigned int const* const ptr = (m->format == SM_CSR) ? m->ii : m->jj;
+      expanded = _m_malloc(m, nz * sizeof(unsigned int));
+      if ((expanded == NULL) && (nz != 0))
+        return -2;
+      for (size_t r = 0; r < n; r++) {
+        for (unsigned int k = ptr[r] - b; k < ptr[r + 1] - b; k++)
+          expanded[k] = r + b;
+      }
+      if (m->format == SM_CSR)
+        rows = expanded;
+      else
+        cols = expanded;
+    }
+
+    unsigned int* perm_t = _m_malloc(m, nz * sizeof(unsigned int));  // by (column, row)
+    unsigned int* perm_a = _m_malloc(m, nz * sizeof(unsigned int));  // by (row, column)
+    unsigned int* const cnt = _m_malloc(m, (n + 1) * sizeof(unsigned int));
+    if ((((perm_t == NULL) || (perm_a == NULL)) && (nz != 0)) || (cnt == NULL)) {
+      _m_free(m, expanded);
+      _m_free(m, perm_t);
+      _m_free(m, perm_a);
+      _m_free(m, cnt);
+      return -2;
+    }
+    if ((m->flags & MC_SORTED_BY_ROW) || _coo_is_ordered(rows, cols, nz)) {  // already in (row, column) order
+      _counting_sort_perm(perm_t, NULL, cols, nz, n, b, cnt);
+      _m_free(m, perm_a);
+      perm_a = NULL;
+    }
+    else if (m->flags & MC_SORTED_BY_COL) {  // sorted CSC, or COO: already in (column, row) order
+      _counting_sort_perm(perm_a, NULL, rows, nz, n, b, cnt);
+      _m_free(m, perm_t);
+      perm_t = NULL;
+    }
+    else {
+      _counting_sort_perm(perm_a, NULL, rows, nz, n, b, cnt);
+      _counting_sort_perm(perm_t, perm_a, cols, nz, n, b, cnt);
+      _counting_sort_perm(perm_a, perm_t, rows, nz, n, b, cnt);
+    }
+    _m_free(m, cnt);
+
+    // merge the two sorted streams location by location
+    size_t p = 0, q = 0;
+    while ((p < nz) || (q < nz)) {
+      unsigned int pk = 0, qk = 0;
+      uint64_t ka = UINT64_MAX, kt = UINT64_MAX;
+      if (p < nz) {
+        pk = (perm_a == NULL) ? p : perm_a[p];
+        ka = ((uint64_t)(rows[pk] - b) << 32) | (cols[pk] - b);
+      }
+      if (q < nz) {
+        qk = (perm_t == NULL) ? q : perm_t[q];
+        kt = ((uint64_t)(cols[qk] - b) << 32) | (rows[qk] - b);
+      }
+      const uint64_t k = (ka < kt) ? ka : kt;
+
+      double are = 0.0, aim = 0.0, tre = 0.0, tim = 0.0, re, im;
+      const int has_a = (ka == k);
+      const int has_t = (kt == k);
+      while (ka == k) {
+        _entry_get(m->dd, pk, dt, &re, &im);
+        are += re;
+        aim += im;
+        if (++p >= nz)
+          break;
+        pk = (perm_a == NULL) ? p : perm_a[p];
+        ka = ((uint64_t)(rows[pk] - b) << 32) | (cols[pk] - b);
+      }
+      while (kt == k) {
+        _entry_get(m->dd, qk, dt, &re, &im);
+        tre += re;
+        tim += im;
+        if (++q >= nz)
+          break;
+        qk = (perm_t == NULL) ? q : perm_t[q];
+        kt = ((uint64_t)(cols[qk] - b) << 32) | (rows[qk] - b);
+      }
+
+      if ((k >> 32) != (k & 0xffffffff)) {  // off-diagonal
+        if (has_a)
+          info->nz_offdiag++;
+        if (has_a && has_t)
+          info->nz_matched++;
+        else
+          info->pattern = 0;
+      }
+      sym &= _close(are, tre, tol) && _close(aim, tim, tol);
+      skew &= _close(are, -tre, tol) && _close(aim, -tim, tol);
+      herm &= _close(are, tre, tol) && _close(aim, -tim, tol);
+    }
+
+    _m_free(m, expanded);
+    _m_free(m, perm_t);
+    _m_free(m, perm_a);
+  }
+
+  if (dt == SM_PATTERN) {  // no values: only the pattern can be symmetric
+    sym = info->pattern;
+    skew = 0;
+  }
+  info->symmetric = sym;
+  info->skew_symmetric = skew;
+  info->hermitian = herm;
+  return 0;
+}
+
 int detect_matrix_symmetry(matrix_t* m)
 {
   // if the matrix isn't currently unsymmetric, then
@@ -1334,59 +2761,141 @@ int detect_matrix_symmetry(matrix_t* m)
   if (m->sym != SM_UNSYMMETRIC)
     return 0;
 
-  const enum matrix_format_t old_format = m->format;
-  int ret;
-
-  // convert to COO format
-  // TODO handle other formats directly (changing formats is expensive)
-  if ((ret = convert_matrix(m, SM_COO, m->base)) != 0)
+  struct matrix_symmetry_info_t info;
+  const int ret = analyse_matrix_symmetry(m, &info);
+  if (ret != 0)
     return ret;
 
-  const double tol = 5e-15;  // TODO use limits.h machine precision -- different tolerances for patterns
-  int pattern_is_symmetric = 1;
-  // TODO handle other data formats
-  assert(m->data_type == REAL_DOUBLE);
-  double * const dd = m->dd;
-  // TODO if entries were sorted this could be made more efficient
-  // TODO need to ensure there are no entries for the same location? or does this matter? (probably, since these should be added together first)
-  // TODO need to check for hermitian, skew symetric too
-  // TODO only need to check half the entries?
-  // loop over all entries, stop if we find a single unsymmetric entry
-  // yuck: O(n^2) currently
-  // TODO _coo_merge_duplicate_entries(m);
-  for (unsigned i = 0; i < m->nz && pattern_is_symmetric; i++) {
-    // ignore entries on the diagonal
-    if (m->ii[i] != m->jj[i]) {
-      int match = 0;
-      // then look for a corresponding entry on the other side of the matrix
-      for (unsigned j = 0; j < m->nz && !match; j++) {  // stop when we find a match
-        if ((i != j) &&  // not the same entry
-            (m->ii[i] == m->jj[j]) &&  // indices are flipped (diagonal symmetry
-            (m->jj[i] == m->ii[j])) {
-          // found a matching entry: potential match
-          if ((dd[i] < dd[j] + tol) &&  // and data matches within machine precision
-              (dd[i] > dd[j] - tol)) {
-            match = 1;
-          }
-          else {  // data doesn't match.. we can quit now!
-            pattern_is_symmetric = 0;  // done searching!
-            match = 1;  // just so we can break out of here
-          }
+  // prefer symmetric, it is the most widely supported by solvers
+  if (info.symmetric)
+    m->sym = SM_SYMMETRIC;
+  else if (info.hermitian)
+    m->sym = SM_HERMITIAN;
+  else if (info.skew_symmetric)
+    m->sym = SM_SKEW_SYMMETRIC;
+  if (m->sym != SM_UNSYMMETRIC)
+    m->location = MC_STORE_BOTH;
+  return 0;
+}
+
+// One pass over the entries: are neighbouring entries in order, are any
+// repeated, and how many are on the diagonal. Duplicates are only neighbours
+// once the entries are sorted, so an unsorted matrix is never flagged as
+// merged (and then the diagonal count can't be trusted either).
+// The flags are replaced by what is found.
+int detect_matrix_flags(matrix_t* m)
+{
+  assert(m != NULL);
+  if ((m->format != SM_COO) && (m->format != SM_CSR) && (m->format != SM_CSC) && (m->format != SM_BCSR))
+    return 0;  // no entries to describe
+  if (m->index_width != MC_INDEX_32)
+    return 0;  // TODO scan 64-bit indices, for now the flags are left as they are
+
+  const size_t nz = m->nz;
+  const unsigned int b = m->base;
+  int by_row = 1, by_col = 1, repeats = 0;
+  size_t ndiag = 0;
+  if (m->format == SM_COO) {
+    unsigned int const* const ii = m->ii;
+    unsigned int const* const jj = m->jj;
+    for (size_t k = 0; k < nz; k++) {
+      ndiag += (ii[k] == jj[k]);
+      if (k > 0) {
+        by_row &= (ii[k - 1] < ii[k]) || ((ii[k - 1] == ii[k]) && (jj[k - 1] <= jj[k]));
+        by_col &= (jj[k - 1] < jj[k]) || ((jj[k - 1] == jj[k]) && (ii[k - 1] <= ii[k]));
+        repeats |= (ii[k - 1] == ii[k]) && (jj[k - 1] == jj[k]);
+      }
+    }
+  }
+  else {
+    const int by_ptr_col = (m->format == SM_CSC);
+    unsigned int const* const ptr = by_ptr_col ? m->jj : m->ii;
+    unsigned int const* const idx = by_ptr_col ? m->ii : m->jj;
+    // BCSR: the block rows and columns, a diagonal block holds its diagonal entries
+    const size_t bs = (m->format == SM_BCSR) ? m->block_size : 1;
+    const size_t nmajor = by_ptr_col ? m->n : (m->m + bs - 1) / bs;
+    int sorted = 1;
+    for (size_t r = 0; r < nmajor; r++) {
+      const unsigned int start = ptr[r] - b;
+      const unsigned int end = ptr[r + 1] - b;
+      for (unsigned int k = start; k < end; k++) {
+        ndiag += (idx[k] - b == r);
+        if (k > start) {
+          sorted &= (idx[k - 1] <= idx[k]);
+          repeats |= (idx[k - 1] == idx[k]);
         }
       }
-      if (!match)
-        pattern_is_symmetric = 0;
     }
+    by_row = sorted && !by_ptr_col;
+    by_col = sorted && by_ptr_col;
   }
 
-  if (pattern_is_symmetric) {
-    m->sym = SM_SYMMETRIC;
-    m->location = MC_STORE_BOTH;
+  unsigned int flags = 0;
+  if (by_row)
+    flags |= MC_SORTED_BY_ROW;
+  if (by_col)
+    flags |= MC_SORTED_BY_COL;
+  if ((by_row || by_col) && !repeats) {
+    const size_t bs = (m->format == SM_BCSR) ? m->block_size : 1;
+    const size_t ndiag_max = (((m->m < m->n) ? m->m : m->n) + bs - 1) / bs;
+    flags |= MC_MERGED;
+    if (ndiag == ndiag_max)
+      flags |= MC_DIAGONAL;
   }
+  m->flags = flags;
+  return 0;
+}
 
-  // return to original format
-  ret = convert_matrix(m, old_format, m->base);
-  return ret;
+// Count the distinct blocks of each candidate size (a pass over the CSR
+// entries per size, 'stamp' as in _csr2bcsr()) and compare the bytes stored:
+// BCSR holds nzb*b^2 values + nzb column indices + the block row pointers.
+unsigned int detect_matrix_block_size(matrix_t* m)
+{
+  assert(m != NULL);
+  if ((m->format == INVALID) || (m->data_type == SM_PATTERN) || (m->nz == 0))
+    return 1;
+  matrix_t* c = NULL;
+  if ((m->format != SM_CSR) || (m->index_width != MC_INDEX_32)) {
+    c = copy_matrix(m);
+    if ((c == NULL) || (convert_matrix(c, SM_CSR, c->base) != 0)) {
+      if (c != NULL)
+        free_matrix(c);
+      return 1;  // just don't block it
+    }
+  }
+  matrix_t const* const a = (c != NULL) ? c : m;
+  const unsigned int b = a->base;
+  const size_t dwidth = _data_width(a->data_type);
+  size_t* const stamp = malloc(((a->n + 1) / 2 + 1) * sizeof(size_t));
+
+  unsigned int best = 1;
+  size_t best_bytes = a->nz * (dwidth + sizeof(unsigned int)) + (a->m + 1) * sizeof(unsigned int);
+  for (size_t bs = 2; (bs <= MC_BLOCK_SIZE_MAX) && (stamp != NULL); bs++) {
+    const size_t mb = (a->m + bs - 1) / bs;
+    const size_t nb = (a->n + bs - 1) / bs;
+    memset(stamp, 0, nb * sizeof(size_t));
+    size_t nzb = 0;
+    for (size_t I = 0; I < mb; I++) {
+      const size_t r_end = ((I + 1) * bs < a->m) ? (I + 1) * bs : a->m;
+      for (size_t k = a->ii[I * bs] - b; k < a->ii[r_end] - b; k++) {
+        const size_t J = (a->jj[k] - b) / bs;
+        if (stamp[J] != I + 1) {
+          stamp[J] = I + 1;
+          nzb++;
+        }
+      }
+    }
+    const size_t bytes = nzb * (bs * bs * dwidth + sizeof(unsigned int)) + (mb + 1) * sizeof(unsigned int);
+    if (bytes < best_bytes) {
+      best = bs;
+      best_bytes = bytes;
+    }
+  }
+
+  free(stamp);
+  if (c != NULL)
+    free_matrix(c);
+  return best;
 }
 
 // test matrix
@@ -1394,7 +2903,9 @@ int detect_matrix_symmetry(matrix_t* m)
 //   -1: bad size
 //   -2: bad ptrs
 //   -3: CSR/CSC wrong size in ptr array
-//   -4: CSR/CSC bad first ptr entry (expect 0)
+//   -4: CSR/CSC bad first ptr entry (expect 0, or 1 for FIRST_INDEX_ONE)
+//   -5: the flags promise something that isn't so
+//   -6: BCSR bad block size (none, or nz not a whole number of blocks, or pattern data)
 int validate_matrix(matrix_t* m)
 {
   assert(m != NULL);
@@ -1411,33 +2922,75 @@ int validate_matrix(matrix_t* m)
   if (m->format == INVALID) {  // empty matrix
     if ((m->m != 0) || (m->n != 0) || (m->nz != 0))
       return -1;
-    else if ((m->ii != NULL) || (m->jj != NULL) || (m->dd != NULL))
+    else if ((m->ii != NULL) || (m->jj != NULL) || (m->ii64 != NULL) || (m->jj64 != NULL) || (m->dd != NULL))
       return -2;
     else
       return 0;
   }
 
   // if there is no data, ptrs should be null
-  if ((m->nz == 0) && ((m->ii != NULL) || (m->jj != NULL) || (m->dd != NULL)))
+  if ((m->nz == 0) && ((m->ii != NULL) || (m->jj != NULL) || (m->ii64 != NULL) || (m->jj64 != NULL) || (m->dd != NULL)))
+    return -2;
+
+  // only the index arrays for this width are used
+  if ((m->index_width == MC_INDEX_32) && ((m->ii64 != NULL) || (m->jj64 != NULL)))
+    return -2;
+  if ((m->index_width == MC_INDEX_64) && ((m->ii != NULL) || (m->jj != NULL)))
     return -2;
 
   // pattern type matrices can't hold data, only indices
   if ((m->data_type == SM_PATTERN) && (m->dd != NULL))
     return -2;
 
+  // only complex values can be split
+  if ((m->complex_storage != MC_COMPLEX_PAIRED) && (m->data_type != COMPLEX_DOUBLE) && (m->data_type != COMPLEX_SINGLE))
+    return -2;
+
   // if dense, ii, jj = NULL
   if (((m->format == DROW) || (m->format == DCOL)) && ((m->ii != NULL) || (m->jj != NULL)))
     return -2;
 
+  if ((m->format == SM_BCSR) &&
+      ((m->block_size == 0) || (m->nz % ((size_t) m->block_size * m->block_size) != 0) || (m->data_type == SM_PATTERN)))
+    return -6;
+
   // if CSC/CSR, then nz must match expected value in first & last element of m->ii/jj
-  if ((m->format == SM_CSR) && ((m->ii)[m->m] != m->nz))
-    return -3;
-  if ((m->format == SM_CSC) && ((m->jj)[m->n] != m->nz))
-    return -3;
-  if ((m->format == SM_CSR) && ((m->ii)[0] != 0))
-    return -4;
-  if ((m->format == SM_CSC) && ((m->jj)[0] != 0))
-    return -4;
+  // (pointers are stored in the same base as the indices)
+  // BCSR: the block count, the last of ceil(m/block_size)+1 block row pointers
+  if ((m->nz != 0) && ((m->format == SM_CSR) || (m->format == SM_CSC) || (m->format == SM_BCSR))) {
+    size_t ni, nj;
+    _index_lengths(m, &ni, &nj);
+    const size_t np = ((m->format == SM_CSC) ? nj : ni) - 1;  // pointers, less one
+    const size_t nend = (m->format == SM_CSC) ? ni : nj;  // where the last one points: entries (blocks for BCSR)
+    uint64_t first, last;
+    if (m->index_width == MC_INDEX_64) {
+      uint64_t const* const ptr = (m->format != SM_CSC) ? m->ii64 : m->jj64;
+      first = ptr[0];
+      last = ptr[np];
+    }
+    else {
+      unsigned int const* const ptr = (m->format != SM_CSC) ? m->ii : m->jj;
+      first = ptr[0];
+      last = ptr[np];
+    }
+    if (last != nend + m->base)
+      return -3;
+    if (first != m->base)
+      return -4;
+  }
+
+  // only what the flags promise is checked: nothing to do if they promise nothing
+  // (merged can only be confirmed for sorted entries, diagonal for merged ones)
+  if ((m->flags != 0) && (m->index_width == MC_INDEX_32) && (m->format != DROW) && (m->format != DCOL)) {
+    matrix_t t = *m;  // shallow copy: the scan only writes the flags
+    detect_matrix_flags(&t);
+    if ((m->flags & MC_SORTED) & ~t.flags)
+      return -5;
+    if ((t.flags & MC_SORTED) && (m->flags & MC_MERGED) && !(t.flags & MC_MERGED))
+      return -5;
+    if ((t.flags & MC_MERGED) && (m->flags & MC_DIAGONAL) && !(t.flags & MC_DIAGONAL))
+      return -5;
+  }
 
   // TODO for CSC/CSR/COO check for duplicate entrys (should be summed)
   // TODO if symmetric check there aren't any extra values in the other triangle
@@ -1455,22 +3008,27 @@ void printf_matrix(char const * const pre, matrix_t* m)
   matrix_t * const c = copy_matrix(m);
   assert(c != NULL);
   convert_matrix(c, SM_COO, FIRST_INDEX_ZERO);  // TODO return value?
+  convert_matrix_complex_storage(c, MC_COMPLEX_PAIRED);
 
-  assert(c->data_type == REAL_DOUBLE);
-  double* v = c->dd;
+  const int is_complex = (c->data_type == COMPLEX_DOUBLE) || (c->data_type == COMPLEX_SINGLE);
   if ((c->m == 0) || (c->n == 0)) {
     printf("%s is empty\n", pre);
   }
   else if (c->nz == 0) {
     printf("%s is all-zero\n", pre);
   }
-  else if (c->n == 1) {  // if its a vector
-    for (unsigned i = 0; i < c->nz; i++)
-      printf("%s(%i)=%.2f\n", pre, c->ii[i], v[i]);
-  }
-  else {  // its a matrix
-    for (unsigned i = 0; i < c->nz; i++)
-      printf("%s(%i,%i)=%.2f\n", pre, c->ii[i], c->jj[i], v[i]);
+  else {
+    for (unsigned i = 0; i < c->nz; i++) {
+      double re, im;
+      _entry_get(c->dd, i, c->data_type, &re, &im);
+      if (c->n == 1)  // if its a vector
+        printf("%s(%i)=%.2f", pre, c->ii[i], re);
+      else  // its a matrix
+        printf("%s(%i,%i)=%.2f", pre, c->ii[i], c->jj[i], re);
+      if (is_complex)
+        printf("%+.2fi", im);
+      printf("\n");
+    }
   }
 
   free_matrix(c);
@@ -1482,8 +3040,9 @@ int results_match(matrix_t* expected_matrix, matrix_t* result_matrix, const doub
   assert(result_matrix != NULL);
   assert(expected_matrix->format != INVALID);
   assert(result_matrix->format != INVALID);
-  assert(expected_matrix->data_type == REAL_DOUBLE);
-  assert(result_matrix->data_type == REAL_DOUBLE);
+  // any precision: single precision results are compared against double precision answers
+  assert(expected_matrix->data_type != SM_PATTERN);
+  assert(result_matrix->data_type != SM_PATTERN);
   assert(result_matrix->m == expected_matrix->m);
   assert(result_matrix->n == expected_matrix->n);
 
@@ -1494,15 +3053,21 @@ int results_match(matrix_t* expected_matrix, matrix_t* result_matrix, const doub
   assert(ret == 0);
   ret = convert_matrix(result_matrix, DCOL, FIRST_INDEX_ZERO);
   assert(ret == 0);
+  ret = convert_matrix_complex_storage(expected_matrix, MC_COMPLEX_PAIRED);
+  assert(ret == 0);
+  ret = convert_matrix_complex_storage(result_matrix, MC_COMPLEX_PAIRED);
+  assert(ret == 0);
 
-  const double* expected = expected_matrix->dd;
-  const double* result = result_matrix->dd;
   for (unsigned int i = 0; i < result_matrix->m; i++) {
     for (unsigned int j = 0; j < result_matrix->n; j++) {
 
       const unsigned int n = j * result_matrix->m + i;
-      if ((result[n] < (expected[n] - precision)) || (result[n] > (expected[n] + precision))) {
-        printf("unexpected answer: expected(%d,%d)=%lg vs result=%lg\n", i, j, expected[n], result[n]);
+      double expected, expected_im, result, result_im;
+      _entry_get(expected_matrix->dd, n, expected_matrix->data_type, &expected, &expected_im);
+      _entry_get(result_matrix->dd, n, result_matrix->data_type, &result, &result_im);
+      if ((result < (expected - precision)) || (result > (expected + precision)) ||
+          (result_im < (expected_im - precision)) || (result_im > (expected_im + precision))) {
+        printf("unexpected answer: expected(%d,%d)=%lg vs result=%lg\n", i, j, expected, result);
         return 0;
       }
     }
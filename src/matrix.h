@@ -22,6 +22,7 @@
 #include "config.h"
 
 #include <stdlib.h>
+#include <stdint.h>
 //#include <bebop/smc/sparse_matrix.h>
 
 // whether the first index is zero or one for sparse storage
@@ -39,8 +40,11 @@ enum matrix_base_t { FIRST_INDEX_ZERO = 0, FIRST_INDEX_ONE = 1 };
 //   but will never be stored: will always set 'order' field
 //   as appropriate and use 'COMPRESSED' in the 'format' field
 //   (CSC is COMPRESSED & COLUMN, CSR is COMPRESSED & ROW)
-// TODO: block storage formats BCOO, BCSR, JAD
-enum matrix_format_t { INVALID = 0, DROW, DCOL, SM_COO, SM_CSC, SM_CSR }; // TODO remove SM prefixes (bebop conflict)
+// BCSR: block compressed row storage, CSR over dense block_size x block_size blocks
+//   (FEM matrices with several unknowns per node): one column index per block
+//   rather than per entry, converted to/from the other formats through CSR
+// TODO: block storage formats BCOO, JAD
+enum matrix_format_t { INVALID = 0, DROW, DCOL, SM_COO, SM_CSC, SM_CSR, SM_BCSR }; // TODO remove SM prefixes (bebop conflict)
 
 // matrix symmetry
 enum matrix_symmetry_t { SM_UNSYMMETRIC = 0, SM_SYMMETRIC, SM_SKEW_SYMMETRIC, SM_HERMITIAN }; //  TODO remove SM prefixes (bebop conflict)
@@ -51,17 +55,46 @@ enum matrix_symmetric_storage_t { MC_STORE_BOTH = 0, UPPER_TRIANGULAR, LOWER_TRI
 // data type
 // REAL_SINGLE: C float, single-precision floating point number
 // REAL_DOUBLE: C double, double-precision floating point number
-// COMPLEX_SINGLE: two C floats make a complex single-precision floating point number
+// COMPLEX_DOUBLE: two C doubles make a complex double-precision floating point number
 // COMPLEX_SINGLE: two C floats make a complex single-precision floating point number
 // PATTERN: no data (dd), pattern of non-zero entries is indicated by ii, jj
 // TODO I like the way TAUCS used a union to split out the different data types the pointer could hold (null, d, s, c, z)... look at taucs doc/
 enum matrix_data_type_t { SM_REAL = 0, REAL_DOUBLE = 0, REAL_SINGLE = 1, SM_COMPLEX = 2, COMPLEX_DOUBLE = 2, COMPLEX_SINGLE = 3, SM_PATTERN = 4 };  //  TODO remove SM prefixes (bebop conflict)
-// TODO support MATLAB complex format where real and imag are split ("ZOMPLEX") (CHOLMOD)
 // TODO maybe split REAL/COMPLEX/PATTERN from storage type (float, double, int, long, uint, ulong)
 
-// TODO support various index formats for ii, jj (int, unsigned int, long) (CHOLMOD)
+// index width: storage for the row/column indices and pointers (ii, jj)
+// MC_INDEX_32: unsigned int (ii, jj), MC_INDEX_64: uint64_t (ii64, jj64)
+//   the narrow width is preferred whenever the matrix fits (less memory traffic),
+//   see matrix_index_width_required()
+enum matrix_index_width_t { MC_INDEX_32 = 0, MC_INDEX_64 };
+
+// complex value storage (dd), ignored for real and pattern data
+// MC_COMPLEX_PAIRED: { x1, y1, x2, y2, ... } (re, im) pairs, C99 complex, Fortran COMPLEX
+// MC_COMPLEX_SPLIT: { x1, x2, ..., y1, y2, ... } all real parts then all imaginary parts,
+//   in the one allocation: MATLAB's "zomplex" (CHOLMOD_ZOMPLEX, UMFPACK Ax/Az)
+//   the format conversions work on paired values, split values are paired first
+enum matrix_complex_storage_t { MC_COMPLEX_PAIRED = 0, MC_COMPLEX_SPLIT };
+
+// who owns the arrays (dd, ii, jj, ii64, jj64) and how they are released
+// MC_OWN_MALLOC: malloc-ed, free-ed by clear_matrix()/free_matrix() and the conversions
+// MC_OWN_POOL: from the buffer pool (mempool.h), released back to it for reuse
+// MC_OWN_BORROWED: they belong to someone else (another matrix_t, a solver) and
+//   are never released here; a conversion that would change them takes a
+//   (malloc-ed) copy first
+enum matrix_ownership_t { MC_OWN_MALLOC = 0, MC_OWN_POOL, MC_OWN_BORROWED };
+
+// what is known about the stored entries (flags, a bitmask): a set bit is a
+// promise, a clear bit means "don't know" (so flags=0 is always safe)
+// MC_SORTED_BY_ROW: entries are in row-major order (by row, then column)
+//   COO: the whole array, CSR: column indices ascend within each row
+// MC_SORTED_BY_COL: entries are in column-major order (by column, then row)
+//   COO: the whole array, CSC: row indices ascend within each column
+// MC_MERGED: no duplicate entries, each (i,j) is stored at most once
+// MC_DIAGONAL: every diagonal entry a(i,i) is stored (possibly as a zero)
+// the conversions keep these up to date and use them to skip sorts and scans,
+// anything else that modifies ii, jj must clear them (see detect_matrix_flags())
+enum matrix_flags_t { MC_SORTED_BY_ROW = 1, MC_SORTED_BY_COL = 2, MC_MERGED = 4, MC_DIAGONAL = 8 };
 
-// TODO support sorted OR unsorted flag (if sorted, doesn't need sorting later, mark as unsorted when modifying)
 // TODO support "packed" -- nzmax is malloc size, nz is ptr to end-of-row/col (CHOLMOD)
 // unpacked: A->i [A->p [j] ... A->p [j]+A->nz[j]-1] vs packed: A->i [A->p [j] ... A->p [j+1]-1]
 
@@ -76,6 +109,11 @@ typedef struct matrix_t {
   enum matrix_symmetry_t sym;  // UNSYMMETRIC, SYMMETRIC, SKEW_SYMMETRIC, HERMITIAN
   enum matrix_symmetric_storage_t location; // MC_STORE_BOTH, UPPER_TRIANGULAR, LOWER_TRIANGULAR
   enum matrix_data_type_t data_type; // REAL, COMPLEX, etc
+  enum matrix_index_width_t index_width; // MC_INDEX_32, MC_INDEX_64: selects ii/jj or ii64/jj64
+  enum matrix_complex_storage_t complex_storage; // MC_COMPLEX_PAIRED, MC_COMPLEX_SPLIT (complex data only)
+  enum matrix_ownership_t owner; // MC_OWN_MALLOC, MC_OWN_POOL, MC_OWN_BORROWED
+  unsigned int flags; // MC_SORTED_BY_ROW, MC_SORTED_BY_COL, MC_MERGED, MC_DIAGONAL (known properties)
+  unsigned int block_size; // BCSR only: rows and columns per block, 0 picks one when converting (detect_matrix_block_size())
   // data storage (meaning varies by format)
   // DENSE: ii and jj are ignored
   // COO: ii=row indices, jj=column indices
@@ -85,17 +123,25 @@ typedef struct matrix_t {
   //     and there are ii[2]-ii[1] entries in the second row
   // CSC: ii=row indices, jj=per-column ptrs into ii
   //   Note: swaps the row and column vs. CSR
+  // BCSR: ii=per-block-row ptrs into jj, jj=block column indices (as CSR, with
+  //   ceil(m/block_size) block rows), dd=the blocks, block_size^2 entries each,
+  //   row-major within the block and zero filled
+  //   Note: nz counts the stored entries, zero fill included, so there are
+  //     nz/block_size^2 blocks; blocks on the last block row/column may hang
+  //     over the edge of the matrix (the overhang holds zeros)
+  //   converting back drops every zero, explicitly stored ones included
+  //   the sorted flags describe the block column indices
   void* dd; // data (size of entries defined by 'data_type', is float or double)
-  // TODO support single precision (float) and double precision (double) in real and complex (paired) and complex (split)
-  //      for complex (split) use the same pointer (2*nz) but have { x1, x2, i y1, i y2 } -- this is "zomplex" ala MATLAB?
-  //        (this can be treated as seperate pointers by those who need to, though it can't be safely free'd as two pointers...)
-  //      for complex (paired) use { x1, i y1, x2, i y2 }
+  //   complex data is laid out as given by 'complex_storage', split data can be
+  //   treated as two pointers (dd, dd + nz reals) but is free'd as one
   unsigned int* ii;
-  // TODO support int/uint 8, 16, 32, 64 and conversion between (limited by max rows/columns values - fail if it could be exceeded)
+  // TODO support 8, 16-bit indices (see index_width)
   //      allow this to be upsized if the matrix grows
-  //      allow these to be converted to match a specific solver
-  //      minimize memory footprint for small matrices == faster solutions! (unless copying it around takes longer...)
   unsigned int* jj; // max is UINT_MAX (limits.h), at least 4,294,967,295
+  // 64-bit indices (index_width == MC_INDEX_64), same layout as ii, jj
+  // only one pair is allocated at a time, the other is NULL
+  uint64_t* ii64;
+  uint64_t* jj64;
 } matrix_t;
 // Note: initializing via 'matrix_t A = {0};' should get the most common defaults and a valid but empty matrix
 
@@ -113,10 +159,56 @@ int cmp_matrix( matrix_t* a, matrix_t* b );
 // returns: non-zero on failure
 int convert_matrix( matrix_t* m, enum matrix_format_t f, enum matrix_base_t b );
 int convert_matrix_symmetry( matrix_t* m, enum matrix_symmetric_storage_t loc );
+// smallest index width that can hold this matrix's indices and pointers
+enum matrix_index_width_t matrix_index_width_required( matrix_t const* m );
+// convert ii, jj <-> ii64, jj64
+// the conversion routines below work on 32-bit indices: a 64-bit matrix is
+// narrowed first, and they fail if it doesn't fit
+// returns: non-zero on failure (-1 too large for 32-bit indices, -2 malloc failure)
+int convert_matrix_index_width( matrix_t* m, enum matrix_index_width_t w );
+// change the precision of the values (dd): REAL_DOUBLE <-> REAL_SINGLE, COMPLEX_DOUBLE <-> COMPLEX_SINGLE
+// or widen real values to complex (zero imaginary part)
+// returns: non-zero on failure (-1 would lose data (complex -> real, pattern), -2 malloc failure)
+int convert_matrix_data_type( matrix_t* m, enum matrix_data_type_t t );
+// change the layout of complex values: MC_COMPLEX_PAIRED <-> MC_COMPLEX_SPLIT
+// returns: non-zero on failure (-1 not complex data, -2 malloc failure)
+int convert_matrix_complex_storage( matrix_t* m, enum matrix_complex_storage_t s );
+// move the arrays to another owner: MC_OWN_MALLOC <-> MC_OWN_POOL copies them,
+// MC_OWN_BORROWED only marks them (the caller is responsible for releasing them)
+// returns: non-zero on failure (-2 malloc failure)
+int convert_matrix_ownership( matrix_t* m, enum matrix_ownership_t o );
+// sum entries with the same row and column (COO comes out sorted by row, then column)
+// returns: non-zero on failure
+int merge_duplicate_entries( matrix_t* m );
 int detect_matrix_symmetry( matrix_t* m );
-
-
-// check the matrix isn't malformed
+// scan the entries and set the flags that hold (sparse formats, 32-bit indices),
+// cheaper than the sorts and merges it lets later conversions skip
+// returns: non-zero on failure
+int detect_matrix_flags( matrix_t* m );
+// BCSR block size that stores this matrix in the fewest bytes (values and
+// indices), from the sizes natural to FEM problems (2..MC_BLOCK_SIZE_MAX),
+// 1 if blocking doesn't pay; works on a CSR copy if m isn't already CSR
+#define MC_BLOCK_SIZE_MAX 6
+unsigned int detect_matrix_block_size( matrix_t* m );
+
+// symmetry of a square matrix, the pattern (structure) and values are reported
+// separately: duplicate entries are summed and a missing partner entry counts
+// as zero when comparing values
+// (detect_matrix_symmetry() uses this to set sym to the best match)
+struct matrix_symmetry_info_t {
+  int pattern;        // every off-diagonal (i,j) has a stored (j,i)
+  int symmetric;      // a(i,j) = a(j,i)
+  int skew_symmetric; // a(i,j) = -a(j,i), zero diagonal
+  int hermitian;      // a(i,j) = conj(a(j,i)), complex matrices only
+  size_t nz_offdiag;  // off-diagonal locations stored
+  size_t nz_matched;  // ... of those, how many have a stored partner
+};
+// returns: non-zero on failure (-1 only one triangle stored, -2 malloc failure,
+//   -3 too large for 32-bit indices)
+int analyse_matrix_symmetry( matrix_t* m, struct matrix_symmetry_info_t* info );
+
+
+// check the matrix isn't malformed (including the promises made by the flags)
 // returns: 0: okay, <0=problem found
 // TODO const correctness
 int validate_matrix( matrix_t* m );
@@ -128,6 +220,8 @@ void printf_matrix( char const *const pre, matrix_t* m );
 
 // from enum, returns width of ea. value in the matrix in bytes
 size_t _data_width( const enum matrix_data_type_t t );
+// from the format, the number of entries in ii and jj (or ii64, jj64)
+void _index_lengths( matrix_t const* m, size_t* ni, size_t* nj );
 
 
 // test result of matrix computations
@@ -20,8 +20,23 @@
 #include "config.h"
 #include "matrix_share.h"
 
+#include <limits.h>
 #include <assert.h>
 
+// MPI counts are ints: send large arrays in pieces
+static int _bcast_array(void* buf, size_t count, MPI_Datatype type, size_t width, int root, MPI_Comm comm);
+static int _bcast_array(void* buf, size_t count, MPI_Datatype type, size_t width, int root, MPI_Comm comm) {
+  char* p = buf;
+  int ret = MPI_SUCCESS;
+  while((count > 0) && (ret == MPI_SUCCESS)) {
+    const int c = (count > INT_MAX) ? INT_MAX : (int) count;
+    ret = MPI_Bcast(p, c, type, root, comm);
+    p += c * width;
+    count -= c;
+  }
+  return ret;
+}
+
 // broadcast a matrix A to all nodes in the MPI communicator 'comm'
 // MPI node 'root' intially holds the original matrix
 // afterwards, all nodes hold the whole matrix 'A'
@@ -43,7 +58,7 @@ int matrix_bcast(matrix_t* A, int root, MPI_Comm comm) {
   assert(root < size); // root to big for communicator
   if(myrank == root) {
     assert(A->format == SM_CSC); // can only handle CSC format for now
-    assert(A->data_type == REAL_DOUBLE); // con only handle double
+    assert(A->data_type != SM_PATTERN); // need values to share
   }
 
   // make sure we aren't going to lose any memory
@@ -51,45 +66,75 @@ int matrix_bcast(matrix_t* A, int root, MPI_Comm comm) {
     clear_matrix(A);
 
   // send round one: sizes for malloc
-  // TODO this could be more efficient if sending all three, then waiting for completion
+  // (m, n, nz are size_t: sent as 64-bit values)
   // TODO return an error rather than aborting
-  ret = MPI_Bcast(&(A->m),         1, MPI_INT, root, comm);
-  assert(ret == MPI_SUCCESS);
-  ret = MPI_Bcast(&(A->n),         1, MPI_INT, root, comm);
-  assert(ret == MPI_SUCCESS);
-  ret = MPI_Bcast(&(A->nz),        1, MPI_INT, root, comm);
-  assert(ret == MPI_SUCCESS);
-  ret = MPI_Bcast(&(A->base),      1, MPI_INT, root, comm);
-  assert(ret == MPI_SUCCESS);
-  ret = MPI_Bcast(&(A->format),    1, MPI_INT, root, comm);
-  assert(ret == MPI_SUCCESS);
-  ret = MPI_Bcast(&(A->sym),       1, MPI_INT, root, comm);
-  assert(ret == MPI_SUCCESS);
-  ret = MPI_Bcast(&(A->location),  1, MPI_INT, root, comm);
-  assert(ret == MPI_SUCCESS);
-  ret = MPI_Bcast(&(A->data_type), 1, MPI_INT, root, comm);
+  unsigned long long hdr[12];
+  if(myrank == root) {
+    hdr[0] = A->m;
+    hdr[1] = A->n;
+    hdr[2] = A->nz;
+    hdr[3] = A->base;
+    hdr[4] = A->format;
+    hdr[5] = A->sym;
+    hdr[6] = A->location;
+    hdr[7] = A->data_type;
+    hdr[8] = A->index_width;
+    hdr[9] = A->complex_storage;
+    hdr[10] = A->flags;
+    hdr[11] = A->block_size;
+  }
+  ret = MPI_Bcast(hdr, 12, MPI_UNSIGNED_LONG_LONG, root, comm);
   assert(ret == MPI_SUCCESS);
+  if(myrank != root) {
+    A->m           = hdr[0];
+    A->n           = hdr[1];
+    A->nz          = hdr[2];
+    A->base        = hdr[3];
+    A->format      = hdr[4];
+    A->sym         = hdr[5];
+    A->location    = hdr[6];
+    A->data_type   = hdr[7];
+    A->index_width = hdr[8];
+    A->complex_storage = hdr[9];
+    A->flags       = hdr[10];
+    A->block_size  = hdr[11];
+  }
 
   // allocate memory where required
+  const int wide = (A->index_width == MC_INDEX_64);
+  const size_t iwidth = wide ? sizeof(uint64_t) : sizeof(unsigned int);
+  const MPI_Datatype itype = wide ? MPI_UNSIGNED_LONG_LONG : MPI_UNSIGNED;
+  // complex values are sent as twice as many reals, paired or split alike
+  const int single = (A->data_type == REAL_SINGLE) || (A->data_type == COMPLEX_SINGLE);
+  const int cplx = (A->data_type == COMPLEX_DOUBLE) || (A->data_type == COMPLEX_SINGLE);
+  const MPI_Datatype dtype = single ? MPI_FLOAT : MPI_DOUBLE;
+  const size_t dwidth = single ? sizeof(float) : sizeof(double);
   if(myrank != root) {
     // TODO refactor: this could be a generic matrix_realloc(A, m_new, n_new, nz_new)
     // assuming CSC format
-    A->ii = malloc(A->nz * sizeof(unsigned int)); // row indices
-    assert(A->ii != NULL); // TODO malloc error
-    A->jj = malloc(((A->n)+1) * sizeof(unsigned int)); // col ptrs
-    assert(A->jj != NULL); // TODO malloc error
-    A->dd = malloc(A->nz * sizeof(double)); // data
+    void* ii = malloc(A->nz * iwidth); // row indices
+    assert(ii != NULL); // TODO malloc error
+    void* jj = malloc(((A->n)+1) * iwidth); // col ptrs
+    assert(jj != NULL); // TODO malloc error
+    if(wide) {
+      A->ii64 = ii;
+      A->jj64 = jj;
+    }
+    else {
+      A->ii = ii;
+      A->jj = jj;
+    }
+    A->dd = malloc(A->nz * _data_width(A->data_type)); // data
     assert(A->dd != NULL); // TODO malloc error
   }
 
   // send round two: data
-  ret = MPI_Bcast(A->ii, A->nz, MPI_INT, root, comm);
+  ret = _bcast_array(wide ? (void*) A->ii64 : (void*) A->ii, A->nz, itype, iwidth, root, comm);
   assert(ret == MPI_SUCCESS);
-  ret = MPI_Bcast(A->jj, (A->n) +1, MPI_INT, root, comm);
+  ret = _bcast_array(wide ? (void*) A->jj64 : (void*) A->jj, (A->n) +1, itype, iwidth, root, comm);
   assert(ret == MPI_SUCCESS);
-  ret = MPI_Bcast(A->dd, A->nz, MPI_DOUBLE, root, comm);
+  ret = _bcast_array(A->dd, A->nz * (cplx ? 2 : 1), dtype, dwidth, root, comm);
   assert(ret == MPI_SUCCESS);
 
   return ret;
 }
-
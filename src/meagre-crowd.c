@@ -46,7 +46,10 @@
 #include "perftimer.h"
 #include "file.h"
 #include "matrix.h"
+#include "mempool.h"
 #include "solvers.h"
+#include "spmv.h"
+#include "stats.h"
 #include "util.h"
 
 
@@ -58,7 +61,10 @@ int main(int argc, char ** argv)
   // handle command-line arguments
   struct parse_args* args = calloc(1, sizeof(struct parse_args));
   // TODO should default to appropriate epsilon for solver, may need to be *2 or some larger value given numerical instability? should print out epsilon of solution in verbose mode
-  args->expected_precision = 5e-14;  // TODO was DBL_EPSILON=1.11e-16 but not stored with enough digits? // default to machine epsilon for 'double'
+  const double default_precision = 5e-14;  // TODO was DBL_EPSILON=1.11e-16 but not stored with enough digits? // default to machine epsilon for 'double'
+  args->expected_precision = default_precision;
+  const double default_residual = 1e-10;  // a backward stable solve gives ~1e-16, whatever the conditioning
+  args->residual_tolerance = default_residual;
   // args->expected_precision = FLT_EPSILON*2;
 
   assert(args != NULL);  // calloc failure
@@ -66,6 +72,10 @@ int main(int argc, char ** argv)
     free(args);
     return retval;
   }
+  if ((args->load_flags & MC_LOAD_SINGLE) && (args->expected_precision == default_precision))
+    args->expected_precision = 1e-4;  // single precision solve: FLT_EPSILON=1.19e-7, less a few digits to conditioning
+  if ((args->load_flags & MC_LOAD_SINGLE) && (args->residual_tolerance == default_residual))
+    args->residual_tolerance = 1e-5;  // backward error is not affected by conditioning, but values are stored to FLT_EPSILON
 
   // initialize MPI
   perftimer_t* timer = perftimer_malloc();
@@ -76,10 +86,12 @@ int main(int argc, char ** argv)
   }
 
   // if this solver is not thread/mpi safe, report an error if its been launched that way
-  const int uses_mpi = solver_uses_mpi(args->solver);
-  const int requires_mpi = solver_requires_mpi(args->solver);
-  const int uses_omp = solver_uses_omp(args->solver);
-  const int requires_omp = solver_requires_omp(args->solver);
+  // (-s auto: the solver is chosen once A is loaded, so MPI is started in case it's wanted)
+  const int is_auto = (args->solver == SOLVER_AUTO);
+  const int uses_mpi = is_auto || solver_uses_mpi(args->solver);
+  const int requires_mpi = !is_auto && solver_requires_mpi(args->solver);
+  const int uses_omp = is_auto || solver_uses_omp(args->solver);
+  const int requires_omp = !is_auto && solver_requires_omp(args->solver);
   int c_mpi = get_mpi_num_procs();
   //  {
   //    const char* mpi_world_size = getenv("OMPI_COMM_WORLD_SIZE");
@@ -128,6 +140,7 @@ int main(int argc, char ** argv)
   matrix_t* expected = NULL;
   matrix_t* A = NULL;
   matrix_t* rhs = NULL;
+  struct matrix_stats_t stats = { 0 };
   if (args->mpi_rank == 0) {
     // we only load matrices for the zero-rank master process
     b = malloc_matrix();
@@ -144,8 +157,13 @@ int main(int argc, char ** argv)
     if (extra_timing && args->rep == 0)
       perftimer_inc(timer, "load", -1);
 
-    // Load A
-    if ((retval = load_matrix(args->input, A)) != 0) {
+    // Load A, and its structure: one O(nz) pass, reported with -v and in the
+    // timing CSV (or kept with the cache)
+    if (args->cache_enabled)
+      retval = load_matrix_cached(args->input, A, args->load_flags, args->cache_dir, &stats);
+    else if ((retval = load_matrix(args->input, A, args->load_flags)) == 0)
+      retval = matrix_stats(A, &stats);
+    if (retval != 0) {
       return 1;
     }
     assert(validate_matrix(A) == 0);
@@ -156,7 +174,7 @@ int main(int argc, char ** argv)
     // allocate an sequentially numbered right-hand side of A.m rows
     // TODO warn if there is already a rhs loaded
     if (args->rhs != NULL) {
-      if ((retval = load_matrix(args->rhs, b)) != 0) {
+      if ((retval = load_matrix(args->rhs, b, args->load_flags)) != 0) {
         return 1;
       }
       assert(b->m == m);  // rows must match // TODO nice error (user could load some random matrix file, also testcases)
@@ -179,19 +197,34 @@ int main(int argc, char ** argv)
           d++;
         }
       }
+      if ((args->load_flags & MC_LOAD_SINGLE) && (convert_matrix_data_type(b, REAL_SINGLE) != 0))
+        return 1;
+      if ((args->load_flags & MC_LOAD_POOL) && (convert_matrix_ownership(b, MC_OWN_POOL) != 0))
+        return 1;
     }
     assert(validate_matrix(b) == 0);
 
     // Load x (if provided)
     if (args->expected != NULL) {
       // TODO refactor: this is a cut and paste of the loader for 'b'
-      if ((retval = load_matrix(args->expected, expected)) != 0) {
+      if ((retval = load_matrix(args->expected, expected, args->load_flags & ~MC_LOAD_SINGLE)) != 0) {
         return 1;
       }
       assert(validate_matrix(expected) == 0);
       assert(expected->m == m);  // rows must match // TODO nice error (user could load some random matrix file, also testcases)
     }
 
+    // choose a solver, or check the one we were given can do this (rather than fail inside it)
+    if (is_auto) {
+      args->solver = select_solver(A, b, &stats, args->history);
+      if (args->solver < 0)
+        fprintf( stderr, "error: none of the solvers can solve this problem\n");
+    }
+    else if (!solver_can_do(args->solver, A, b, &stats)) {
+      fprintf( stderr, "error: selected solver (%s) can't solve this problem\n", solver2str(args->solver));
+      args->solver = -1;
+    }
+
     if (extra_timing && args->rep == 0) {
       perftimer_inc(timer, "solver", -1);
       perftimer_inc(timer, "rhs", -1);
@@ -199,7 +232,7 @@ int main(int argc, char ** argv)
 
     // verbose output
     if (args->verbosity >= 1)
-      print_verbose_output(args, A, b, expected, c_mpi, c_omp);
+      print_verbose_output(args, A, &stats, b, expected, c_mpi, c_omp);
 
     if (extra_timing && args->rep == 0)
       perftimer_adjust_depth(timer, -1);
@@ -207,6 +240,25 @@ int main(int argc, char ** argv)
 
   } // MPI master
 
+  // every process runs the solver rank 0 settled on
+  if (is_mpi) {
+    int ierr = MPI_Bcast(&(args->solver), 1, MPI_INT, 0, MPI_COMM_WORLD);
+    assert(ierr == MPI_SUCCESS);
+  }
+  if (args->solver < 0) {
+    if (is_mpi) {
+      int ierr = MPI_Finalize();
+      assert(ierr == 0);
+    }
+    free_matrix(b);
+    free_matrix(expected);
+    free_matrix(A);
+    free_matrix(rhs);
+    perftimer_free(timer);
+    free(args);
+    return 11;
+  }
+
   solver_state_t* state = solver_init(args->solver, args->verbosity, args->mpi_rank, timer);  //okay
 
   // MS: Since I don't understand how this timer works, and I am currently only interested in "time to solution" for
@@ -229,6 +281,24 @@ int main(int argc, char ** argv)
 //    }
 //    while (r < args->rep);
 
+  // convert A and b for the solver once, up front: timed on its own rather
+  // than being charged to the first repetition (A's view is then reused)
+  const long long solve_start = current_timestamp();  // for the history: conversion and solves
+  {
+#if TIMEON
+    long long start = current_timestamp();
+#endif
+    if (solver_prepare(state, A, b) != 0) {  // reported
+      if (is_mpi)
+        MPI_Abort(MPI_COMM_WORLD, 12);  // the other processes are waiting on rank 0
+      return 12;
+    }
+#if TIMEON
+    long long finish = current_timestamp();
+    printf("Conversion\t time %lld\n", (finish-start));
+#endif
+  }
+
   printf("\nStart solving Ax=b %d time(s) ...\n", args->rep);
   for (int i = 1; i <= args->rep; ++i) {
 #if TIMEON
@@ -241,6 +311,7 @@ int main(int argc, char ** argv)
 #endif
   }
   printf("Done.\n");
+  const double solve_time = (current_timestamp() - solve_start) * 1e-6 / args->rep;
 
   if (extra_timing && args->rep == 0) {
     perftimer_inc(timer, "clean up", -1);
@@ -275,6 +346,33 @@ int main(int argc, char ** argv)
     }
   }
 
+  // check the residual? needs no reference solution and costs a product with A
+  double* residual = NULL;
+  if ((args->mpi_rank == 0) && args->residual_enabled) {
+    printf("\nCheck residual ||b-Ax||/(||A|| ||x||+||b||)...\n");
+    residual = malloc(rhs->n * sizeof(double));
+    int pass = (residual != NULL) && (spmv_residual(A, rhs, b, residual) == 0);
+    for (size_t c = 0; pass && (c < rhs->n); c++) {
+      printf("  column %zu: %lg\n", c, residual[c]);
+      pass = pass && (residual[c] <= args->residual_tolerance);  // NaN fails
+    }
+    if (pass) {
+      if (retval != 100)
+        retval = 0;
+      printf("  PASS.\n");
+    }
+    else {
+      retval = 100;
+      printf("  FAIL.\n");
+    }
+  }
+
+  // a good solve goes in the history (for -s auto)
+  if ((args->mpi_rank == 0) && (args->history != NULL) && (retval == 0)) {
+    if (solver_history_append(args->history, args->solver, &stats, solve_time) != 0)
+      fprintf( stderr, "warning: failed to record the solve in %s\n", args->history);
+  }
+
   solver_finalize(state);
 
   // we can report on memory usage per-process
@@ -305,6 +403,12 @@ int main(int argc, char ** argv)
       printf("memory usage: maximum resident=%lgMB, page reclaims=%ld, page faults w/ IO=%ld\n", usage.ru_maxrss / 1e3, /* maximum resident set size */
              usage.ru_minflt, /* page reclaims */
              usage.ru_majflt); /* page faults */
+    if (args->load_flags & MC_LOAD_POOL) {
+      struct mempool_stats_t pool;
+      mempool_stats(&pool);
+      printf("buffer pool: reused=%zu, allocated=%zu (huge page aligned=%zu), in use=%lgMB, cached=%lgMB\n",
+             pool.hits, pool.misses, pool.huge, pool.in_use / 1e6, pool.cached / 1e6);
+    }
   }
 
   // show timing info, if requested, to depth N
@@ -330,10 +434,20 @@ int main(int argc, char ** argv)
 
   if (args->mpi_rank == 0) {
     if (args->timing_enabled == 1) {
-      printf("status, solver, threads, rows, max. memory (MB), total memory (MB), ");
+      printf("status, solver, threads, rows, max. memory (MB), total memory (MB), residual, ");
+      matrix_stats_printf_csv_header();
       perftimer_printf_csv_header(timer, 2);
       printf("%s, %s, %d, %zu, %lg, %lg, ", retval == 100 ? "FAIL" : "PASS", solver2str(args->solver), c_mpi, A->m,
              usage.ru_maxrss / 1e3, mem_sum);
+      if (residual == NULL)
+        printf("-, ");
+      else {  // worst column
+        double r = 0.0;
+        for (size_t c = 0; c < rhs->n; c++)
+          r = (residual[c] > r) || (residual[c] != residual[c]) ? residual[c] : r;
+        printf("%lg, ", r);
+      }
+      matrix_stats_printf_csv_body(&stats);
       perftimer_printf_csv_body(timer, 2);
     }
     else if (args->timing_enabled != 0) {
@@ -355,6 +469,7 @@ int main(int argc, char ** argv)
   }
 
   // clean up matrices
+  free(residual);
   free_matrix(b);
   free_matrix(expected);
   free_matrix(A);
@@ -0,0 +1,203 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "config.h"
+#include <stdlib.h> // posix_memalign, free
+#include <string.h> // memset, memcpy
+#include <assert.h>
+#include <sys/mman.h> // madvise
+#include "mempool.h"
+
+// every buffer is preceded by a header recording its size class,
+// the free lists are threaded through the headers of released buffers
+typedef union mempool_header_t {
+  struct {
+    size_t cls;
+    union mempool_header_t* next;
+  } h;
+  char pad[MEMPOOL_ALIGN];  // keeps the buffer itself aligned
+} mempool_header_t;
+
+// four classes per power of two: class c holds (4 + c%4) << (c/4) bytes
+#define MEMPOOL_CLASSES 256
+#define MEMPOOL_MIN_BYTES 128  // smallest buffer (including the header)
+
+// the free lists and statistics are shared by all threads
+#ifdef _OPENMP
+#define MEMPOOL_LOCKED _Pragma("omp critical (mempool)")
+#else
+#define MEMPOOL_LOCKED
+#endif
+
+static mempool_header_t* _free_list[MEMPOOL_CLASSES];
+static struct mempool_stats_t _stats;
+static size_t _limit = MEMPOOL_DEFAULT_LIMIT;
+
+static inline size_t _class_bytes( const size_t cls );
+static inline size_t _size_class( size_t bytes );
+static mempool_header_t* _system_alloc( const size_t cls );
+static void _evict( const size_t limit );
+
+static inline size_t _class_bytes( const size_t cls ) {
+  return ( size_t )( 4 + ( cls & 3 ) ) << ( cls >> 2 );
+}
+
+// the smallest class holding 'bytes'
+static inline size_t _size_class( size_t bytes ) {
+  if ( bytes < MEMPOOL_MIN_BYTES )
+    bytes = MEMPOOL_MIN_BYTES;
+  unsigned int e = 0; // 2^e <= bytes - 1 < 2^(e+1)
+  for ( size_t v = bytes - 1; v > 1; v >>= 1 )
+    e++;
+  const unsigned int s = e - 2; // class granularity: 2^s bytes
+  const size_t k = (( bytes - 1 ) >> s ) + 1; // 5 .. 8 granules
+  return 4 * ( size_t ) s + ( k - 4 );
+}
+
+// a new buffer straight from the system: huge page aligned if it's large enough
+static mempool_header_t* _system_alloc( const size_t cls ) {
+  const size_t bytes = _class_bytes( cls );
+  const int huge = ( bytes >= MEMPOOL_HUGE_PAGE );
+  void* p = NULL;
+  if ( posix_memalign( &p, huge ? MEMPOOL_HUGE_PAGE : MEMPOOL_ALIGN, bytes ) != 0 )
+    return NULL;
+#ifdef MADV_HUGEPAGE
+  if ( huge )
+    madvise( p, bytes, MADV_HUGEPAGE ); // only a hint: failure is harmless
+#endif
+  mempool_header_t* const hdr = p;
+  hdr->h.cls = cls;
+  hdr->h.next = NULL;
+  MEMPOOL_LOCKED
+  {
+    _stats.misses++;
+    _stats.huge += huge;
+  }
+  return hdr;
+}
+
+void* mempool_malloc( size_t size ) {
+  if ( size > (( size_t ) 1 << 62 ) ) // no class is large enough
+    return NULL;
+  const size_t cls = _size_class( size + sizeof( mempool_header_t ) );
+  assert( cls < MEMPOOL_CLASSES );
+
+  mempool_header_t* hdr;
+  MEMPOOL_LOCKED
+  {
+    hdr = _free_list[cls];
+    if ( hdr != NULL ) {
+      _free_list[cls] = hdr->h.next;
+      _stats.cached -= _class_bytes( cls );
+      _stats.hits++;
+    }
+  }
+  if ( hdr == NULL )
+    hdr = _system_alloc( cls );
+  if ( hdr == NULL )
+    return NULL;
+
+  MEMPOOL_LOCKED
+  _stats.in_use += _class_bytes( cls );
+  return hdr + 1;
+}
+
+void* mempool_calloc( size_t n, size_t size ) {
+  if (( size != 0 ) && ( n > (( size_t ) - 1 ) / size ) )
+    return NULL; // overflow
+  void* const p = mempool_malloc( n * size );
+  if ( p != NULL )
+    memset( p, 0, n * size );
+  return p;
+}
+
+void* mempool_realloc( void* p, size_t size ) {
+  if ( p == NULL )
+    return mempool_malloc( size );
+  if ( size == 0 ) {
+    mempool_free( p );
+    return NULL;
+  }
+  mempool_header_t const* const hdr = ( mempool_header_t* ) p - 1;
+  const size_t have = _class_bytes( hdr->h.cls ) - sizeof( mempool_header_t );
+  // it still fits and would use at least half the buffer: keep it
+  if (( size <= have ) && ( size >= have / 2 ) )
+    return p;
+
+  void* const q = mempool_malloc( size );
+  if ( q == NULL )
+    return NULL; // 'p' is untouched, like realloc()
+  memcpy( q, p, ( size < have ) ? size : have );
+  mempool_free( p );
+  return q;
+}
+
+void mempool_free( void* p ) {
+  if ( p == NULL )
+    return;
+  mempool_header_t* const hdr = ( mempool_header_t* ) p - 1;
+  const size_t cls = hdr->h.cls;
+  assert( cls < MEMPOOL_CLASSES );
+  const size_t bytes = _class_bytes( cls );
+
+  int keep;
+  MEMPOOL_LOCKED
+  {
+    _stats.in_use -= bytes;
+    keep = ( _stats.cached + bytes <= _limit );
+    if ( keep ) {
+      hdr->h.next = _free_list[cls];
+      _free_list[cls] = hdr;
+      _stats.cached += bytes;
+    }
+  }
+  if ( !keep )
+    free( hdr );
+}
+
+// free cached buffers, the largest first, until no more than 'limit' bytes
+// are cached (the caller holds the lock)
+static void _evict( const size_t limit ) {
+  for ( size_t c = MEMPOOL_CLASSES; ( c > 0 ) && ( _stats.cached > limit ); c-- ) {
+    while (( _free_list[c - 1] != NULL ) && ( _stats.cached > limit ) ) {
+      mempool_header_t* const hdr = _free_list[c - 1];
+      _free_list[c - 1] = hdr->h.next;
+      _stats.cached -= _class_bytes( c - 1 );
+      free( hdr );
+    }
+  }
+}
+
+void mempool_trim() {
+  MEMPOOL_LOCKED
+  _evict( 0 );
+}
+
+void mempool_set_limit( size_t bytes ) {
+  MEMPOOL_LOCKED
+  {
+    _limit = bytes;
+    _evict( bytes );
+  }
+}
+
+void mempool_stats( struct mempool_stats_t* s ) {
+  assert( s != NULL );
+  MEMPOOL_LOCKED
+  *s = _stats;
+}
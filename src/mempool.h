@@ -0,0 +1,64 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _MEMPOOL_H_
+#define _MEMPOOL_H_
+
+#include "config.h"
+#include <stddef.h>
+
+// buffer pool for the large arrays of a matrix_t (owner = MC_OWN_POOL, see matrix.h)
+//
+// released buffers are kept, by size class, and handed out again to later
+// requests of a similar size, so repeated conversions (--rep) reuse memory
+// instead of going back to malloc every time
+// size classes are four per power of two, so at most 25% of a buffer is unused
+// buffers of MEMPOOL_HUGE_PAGE or more are huge page aligned (and, where the
+// system supports it, marked for transparent huge pages)
+//
+// buffers are MEMPOOL_ALIGN aligned and must only be released with
+// mempool_free() or mempool_realloc()
+// safe to call from OpenMP threads, but intended for the (serial) set up
+// around the kernels, not inside them
+
+#define MEMPOOL_ALIGN 64                 // bytes: a cache line
+#define MEMPOOL_HUGE_PAGE (2 << 20)      // bytes: x86-64 huge page
+#define MEMPOOL_DEFAULT_LIMIT (1 << 30)  // bytes: cached (released) buffers kept at most
+
+void* mempool_malloc( size_t size );
+void* mempool_calloc( size_t n, size_t size );
+// grows or shrinks in place when the buffer's size class allows it
+void* mempool_realloc( void* p, size_t size );
+void mempool_free( void* p );
+
+// hand all cached buffers back to the system
+void mempool_trim();
+// limit on the bytes held in released buffers (beyond this they are freed),
+// a lower limit frees cached buffers, the largest first, until the rest fit
+void mempool_set_limit( size_t bytes );
+
+struct mempool_stats_t {
+  size_t hits;    // requests served from a cached buffer
+  size_t misses;  // requests that went to the system
+  size_t huge;    // ... of which were huge page aligned
+  size_t cached;  // bytes currently held in released buffers
+  size_t in_use;  // bytes currently handed out
+};
+void mempool_stats( struct mempool_stats_t* s );
+
+#endif
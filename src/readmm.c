@@ -0,0 +1,870 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <strings.h> // strncasecmp
+#include <limits.h>
+#include <float.h> // FLT_EVAL_METHOD
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <assert.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "readmm.h"
+#include "stream.h"
+
+// references:
+// [1] http://math.nist.gov/MatrixMarket/formats.html
+// [2] The Matrix Market Exchange Formats: Initial Design,
+//     R. F. Boisvert, R. Pozo, K. Remington,
+//     Applied and Computational Mathematics Division, NIST
+//     http://math.nist.gov/MatrixMarket/reports/MMformat.ps
+
+// MatrixMarket format notes:
+// sparse coordinate format: COO
+// dense format: column-oriented (DCOL)
+//   TODO to express a preference for DROW format, set that in the input matrix, 'A'
+// type: real, complex, integer, pattern
+// symmetry: general, symmetric, skew-symmetric, Hermitian
+//   for symmetric types only the *lower triangular* portion is stored
+//   for skew-symmetric matrices, diagonal is zero, so left out too
+
+// require "%%MatrixMarket " as first 15 characters
+// "%%MatrixMarket <object> <format> [qualifier ...]"
+// object could be vector, matrix, directed graph
+// format type is the storage format (coordinate, array)
+// qualifiers are fields, symmetry, etc
+// data is one entry per line
+// additional restrictions:
+//  * lines are limited 1024 characters (not enforced here: longer lines are read)
+//  * blanks lines can appear in any line after the first
+//  * data is separated by one or more "blanks" (spaces?)
+//  * real data is floating-point decimal, optionally use E-format exponential
+//  * all indices are 1-based
+//  * text is case-insensitive
+
+// expect sparse:
+// "%%MatrixMarket matrix coordinate <datatype> <sym>"
+// "%<comments>" -- zero or more lines
+// "  <rows> <columns> <non-zeros>"
+// "  <row> <col> <real>" -- indices are base-1, not base-0 REAL
+// "  <row> <col> <real> <imag>" -- indices are base-1, not base-0 COMPLEX
+
+// expect dense:
+// "%%MatrixMarket matrix array <type> <sym>"
+// "%<comments>" -- zero or more lines
+// "<rows> <columns>"
+// "<real>" -- REAL, column major order
+// "<real> <imag>" -- COMPLEX
+
+// additional restrictions: (kind of common-sense)
+//  * for coordinate AND array, "Hermitian" matrix types can only be "complex"
+//  * pattern matrices can only be coordinate format, and general or symmetric
+
+// <format> = coordinate, array
+// <datatype> = real, integer, complex, pattern
+// <sym> = general, symmetric, skew-symmetric, hermitian
+
+// Symmetry
+// general: no symmetry
+// symmetric A(i,j) = A(j,i)       (on or below diagonal) (square matrices)
+// skew-symmetric A(i,j) = -A(j,i)       (below diagonal) (square matrices)
+// hermitian      A(i,j) = A(j,i)* (on or below diagonal) (square matrices)
+
+// extensions:
+// * structured comments
+// * format specializations (pretty printing?)
+// * new object and format types
+//    <object> = graphs, grids, vectors?
+//    <format> = elemental (FEM), band, Toeplitz? (50% less storage or keen interest)
+
+// example structured comments
+//  "%%Harwell-Boeing collection"
+//  "%"
+//  "%HB FILE_NAME   abcd.mtx"
+//  "%HB KEY         MMEXMPL1"
+//  "%HB OBJECT      matrix"
+//  "%HB FORMAT      coordinate"
+//  "%HB QUALIFIRES  real general"
+//  "%HB DESCRIPTION Unsymmetric matrix from example"
+//  "%HB CONTRIBUTOR R. Boisvert (email@email.com)"
+//  "%HB DATE        June 24, 1996"
+//  "%HB PRECISION   4"
+//  "%HB DATA_LINES  9"
+//  "%"
+//  "% some more comments"
+
+#define MM_OMP_MIN_BYTES ( 1 << 20 ) // data section: below this, one thread
+
+// the largest number of entries we'll allocate for (complex values: 16 bytes each)
+#define MM_MAX_NZ ( SIZE_MAX / ( 2 * sizeof( double ) ) )
+
+char const* readmm_strerror( int err ) {
+  switch ( err ) {
+    case 0:
+      return "success";
+    case -1:
+      return "memory allocation failure";
+    case -2:
+      return "can't open file";
+    case -3:
+      return "unexpected MatrixMarket header object (matrix)";
+    case -4:
+      return "unrecognized MatrixMarket header format (coordinate or array)";
+    case -5:
+      return "unsupported MatrixMarket header data type";
+    case -6:
+      return "unexpected end of file, fewer entries than the header promised";
+    case -7:
+      return "wrong number of values in an entry (real or complex?)";
+    case -8:
+      return "unsupported symmetric array (dense) matrix";
+    case -9:
+      return "more entries than the header promised";
+    case -11:
+      return "EOF before header";
+    case -12:
+      return "not MatrixMarket format, bad header";
+    case -13:
+      return "corrupt or truncated compressed file";
+    case -14:
+      return "no *.mtx file in the archive";
+    case -15:
+      return "unsupported compression (not built with that library)";
+    case -21:
+      return "not a number";
+    case -22:
+      return "malformed number or index out of range";
+    default:
+      return "unknown";
+  }
+}
+
+int mm_buffer_open( char const* filename, struct mm_buffer_t* b ) {
+  b->p = NULL;
+  b->len = 0;
+  b->mapped = 0;
+  const int fd = open( filename, O_RDONLY );
+  if ( fd < 0 )
+    return -2;
+
+  struct stat st;
+  if (( fstat( fd, &st ) == 0 ) && S_ISREG( st.st_mode ) && ( st.st_size > 0 ) ) {
+    void* const p = mmap( NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+    if ( p != MAP_FAILED ) {
+      posix_madvise( p, st.st_size, POSIX_MADV_SEQUENTIAL );  // just a hint
+      close( fd );
+      b->p = p;
+      b->len = st.st_size;
+      b->mapped = 1;
+      return 0;
+    }
+  }
+
+  // not a regular file (a pipe), or it couldn't be mapped: read it all in
+  size_t cap = 1 << 16;
+  char* buf = malloc( cap );
+  size_t len = 0;
+  ssize_t r = 0;
+  while ( buf != NULL ) {
+    if ( len == cap ) {
+      char* const t = realloc( buf, cap *= 2 );
+      if ( t == NULL ) {
+        free( buf );
+        buf = NULL;
+        break;
+      }
+      buf = t;
+    }
+    if (( r = read( fd, buf + len, cap - len ) ) <= 0 )
+      break;
+    len += r;
+  }
+  close( fd );
+  if ( buf == NULL )
+    return -1;
+  if ( r < 0 ) {
+    free( buf );
+    return -2;
+  }
+  b->p = buf;
+  b->len = len;
+  return 0;
+}
+
+void mm_buffer_close( struct mm_buffer_t* b ) {
+  if ( b->mapped )
+    munmap(( void* ) b->p, b->len );
+  else
+    free(( void* ) b->p );
+  b->p = NULL;
+  b->len = 0;
+  b->mapped = 0;
+}
+
+// white space within a line (the MatrixMarket "blanks", and the '\r' of DOS line endings)
+static inline int _is_blank( const char c ) {
+  return ( c == ' ' ) || ( c == '\t' ) || ( c == '\r' ) || ( c == '\v' ) || ( c == '\f' );
+}
+
+static inline int _is_space( const char c ) {
+  return _is_blank( c ) || ( c == '\n' );
+}
+
+static inline int _is_digit( const char c ) {
+  return ( c >= '0' ) && ( c <= '9' );
+}
+
+static inline char const* _skip_blanks( char const* p, char const* end ) {
+  while (( p < end ) && _is_blank( *p ) )
+    p++;
+  return p;
+}
+
+// the start of the next line, or 'end'
+static inline char const* _next_line( char const* p, char const* end ) {
+  char const* const e = memchr( p, '\n', end - p );
+  return ( e == NULL ) ? end : e + 1;
+}
+
+char const* mm_parse_uint( char const* p, char const* end, unsigned long long max, unsigned long long* v ) {
+  char const* const s = p;
+  unsigned long long x = 0;
+  for ( ; ( p < end ) && _is_digit( *p ); p++ ) {
+    const unsigned int d = *p - '0';
+    if (( d > max ) || ( x > ( max - d ) / 10 ) )
+      return NULL;  // x * 10 + d > max
+    x = x * 10 + d;
+  }
+  if (( p == s ) || (( p < end ) && !_is_space( *p ) ) )
+    return NULL;
+  *v = x;
+  return p;
+}
+
+// powers of ten that are exact doubles (5^22 < 2^53)
+static const double _pow10[] = {
+  1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+  1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+char const* mm_parse_double( char const* p, char const* end, double* v ) {
+  char const* const s = p;
+  int neg = 0;
+  if (( p < end ) && (( *p == '-' ) || ( *p == '+' ) ) ) {
+    neg = ( *p == '-' );
+    p++;
+  }
+
+  // the value is m * 10^e10, keeping up to 19 significant digits in m
+  uint64_t m = 0;
+  int digits = 0;
+  int exact = 1;  // no non-zero digits were left out of m
+  int any = 0;
+  long e10 = 0;
+  for ( ; ( p < end ) && _is_digit( *p ); p++ ) {
+    any = 1;
+    if ( digits < 19 ) {
+      m = m * 10 + ( *p - '0' );
+      digits += ( m != 0 );
+    }
+    else {
+      e10++;
+      exact &= ( *p == '0' );
+    }
+  }
+  if (( p < end ) && ( *p == '.' ) ) {
+    for ( p++; ( p < end ) && _is_digit( *p ); p++ ) {
+      any = 1;
+      if ( digits < 19 ) {
+        m = m * 10 + ( *p - '0' );
+        digits += ( m != 0 );
+        e10--;
+      }
+      else {
+        exact &= ( *p == '0' );
+      }
+    }
+  }
+  if ( !any )
+    return NULL;
+  if (( p < end ) && (( *p == 'e' ) || ( *p == 'E' ) ) ) {
+    p++;
+    int eneg = 0;
+    if (( p < end ) && (( *p == '-' ) || ( *p == '+' ) ) ) {
+      eneg = ( *p == '-' );
+      p++;
+    }
+    char const* const es = p;
+    long x = 0;
+    for ( ; ( p < end ) && _is_digit( *p ); p++ ) {
+      if ( x < 100000 )  // far past overflow or underflow, either way
+        x = x * 10 + ( *p - '0' );
+    }
+    if ( p == es )
+      return NULL;
+    e10 += eneg ? -x : x;
+  }
+  if (( p < end ) && !_is_space( *p ) )
+    return NULL;
+
+  if ( m == 0 ) {
+    *v = neg ? -0.0 : 0.0;
+    return p;
+  }
+#if FLT_EVAL_METHOD == 0
+  // m and 10^|e10| are both exact doubles, so a single multiply or divide is
+  // correctly rounded: the same answer strtod() gives (Clinger's fast path)
+  // this covers the values most files hold: up to 15-16 significant digits
+  if ( exact && ( m <= ( UINT64_C( 1 ) << 53 ) ) && ( e10 >= -22 ) && ( e10 <= 22 ) ) {
+    const double x = ( e10 < 0 ) ? ( double ) m / _pow10[-e10] : ( double ) m * _pow10[e10];
+    *v = neg ? -x : x;
+    return p;
+  }
+#endif
+
+  // anything else is left to strtod(), which needs a null terminated copy
+  char buf[64];
+  const size_t len = p - s;
+  char* const t = ( len < sizeof( buf ) ) ? buf : malloc( len + 1 );
+  if ( t == NULL )
+    return NULL;
+  memcpy( t, s, len );
+  t[len] = '\0';
+  *v = strtod( t, NULL );
+  if ( t != buf )
+    free( t );
+  return p;
+}
+
+// error code for a token that failed to parse at 'p'
+static inline int _bad_token( char const* p, char const* end ) {
+  if (( p < end ) && ( _is_digit( *p ) || ( *p == '-' ) || ( *p == '+' ) || ( *p == '.' ) ) )
+    return -22;  // malformed or out of range
+  return -21;  // not a number
+}
+
+// appends a line to the malloc-ed string '*s' (of length '*len')
+static int _append_line( char** s, size_t* len, char const* p, const size_t n ) {
+  char* const t = realloc( *s, *len + n + 1 );
+  if ( t == NULL )
+    return -1;
+  memcpy( t + *len, p, n );
+  *len += n;
+  t[*len] = '\0';
+  *s = t;
+  return 0;
+}
+
+// input buffer p..end
+// output object    is -1 unrecognized, 0 matrix
+//        format    is -1 unrecognized, 0 array, 1 coordinate
+//        datatype  is -1 unrecognized, 0 real, 1 integer, 2 complex, 3 pattern
+//        symmetry  is -1 unrecognized, 0 general, 1 symmetric, 2 skew-symmetric, 3 hermitian
+//        rows, cols, nz are dimensions of the matrix
+//        comments (if not NULL) are a malloc-ed copy of the comments
+//        data is the start of the line after the dimensions
+// returns 0 on success, -1 malloc failure, -11 if EOF before parsing the
+//         header, -12 if not Matrix Market format
+static int _read_header( char const* p, char const* end, int* object, int* format, int* datatype, int* symmetry,
+                         size_t* rows, size_t* cols, size_t* nz, char** comments, char const** data ) {
+  // valid field types
+  static const char* header[]     = { "%%matrixmarket", NULL };
+  static const char* objects[]    = { "matrix", NULL };
+  static const char* formats[]    = { "array", "coordinate", NULL };
+  static const char* datatypes[]  = { "real", "integer", "complex", "pattern", NULL };
+  static const char* symmetries[] = { "general", "symmetric", "skew-symmetric", "hermitian", NULL };
+  char const* const* const fields[] = { header, objects, formats, datatypes, symmetries };
+  int dummy;
+  int* const outputs[] = { &dummy, object, format, datatype, symmetry };
+
+  if ( p == end )
+    return -11;
+
+  // the first line: "%%MatrixMarket <object> <format> <datatype> <symmetry>"
+  char const* const eol = _next_line( p, end );
+  for ( int f = 0; f < 5; f++ ) {
+    *outputs[f] = -1;
+    for ( int s = 0; fields[f][s] != NULL; s++ ) {
+      const size_t len = strlen( fields[f][s] );
+      if (( eol - p >= ( ptrdiff_t ) len ) && ( strncasecmp( p, fields[f][s], len ) == 0 ) &&
+          (( p + len == end ) || _is_space( p[len] ) ) ) {
+        *outputs[f] = s;
+        p += len;
+        break;
+      }
+    }
+    if ( *outputs[f] == -1 )
+      return -12;  // unrecognized, no need to go further if we're lost
+    p = _skip_blanks( p, eol );
+  }
+
+  // skip (or collect) the comments and blank lines
+  size_t clen = 0;
+  for ( p = eol; p < end; ) {
+    char const* const q = _skip_blanks( p, end );
+    if (( q < end ) && ( *q != '%' ) && ( *q != '\n' ) )
+      break;  // the dimensions
+    char const* const next = _next_line( p, end );
+    if (( comments != NULL ) && ( q < end ) && ( *q == '%' ) ) {
+      if ( _append_line( comments, &clen, p, next - p ) != 0 )
+        return -1;
+    }
+    p = next;
+  }
+
+  // find matrix dimensions
+  // dense array, expecting "  <rows> <columns>"
+  // COO format, expecting "  <rows> <columns> <non-zeros>"
+  unsigned long long r, c, k = 0;
+  p = _skip_blanks( p, end );
+  if (( p = mm_parse_uint( p, end, INT_MAX, &r ) ) == NULL )
+    return -12;
+  if (( p = mm_parse_uint( _skip_blanks( p, end ), end, INT_MAX, &c ) ) == NULL )
+    return -12;
+  if ( *format == 1 ) {
+    if (( p = mm_parse_uint( _skip_blanks( p, end ), end, MM_MAX_NZ, &k ) ) == NULL )
+      return -12;
+  }
+  else {
+    // as many values as a coordinate header may promise: r * c can't overflow
+    // (both are <= INT_MAX), but the array for it could
+    if (( r != 0 ) && ( c > MM_MAX_NZ / r ) )
+      return -12;
+    k = r * c;
+  }
+  p = _skip_blanks( p, end );
+  if (( p < end ) && ( *p != '\n' ) )
+    return -12;  // something else on the line
+
+  *rows = r;
+  *cols = c;
+  *nz = k;
+  *data = ( p < end ) ? p + 1 : end;
+  return 0;
+}
+
+// parse one entry at p (the start of a non-blank line): "<row> <col> <values>"
+// (sparse: ii, jj not NULL) or "<values>" (dense), with 'values' numbers
+// (1: real, 2: complex) stored at d
+// indices are checked against 'rows', 'cols' (base one)
+// returns 0 on success, <0 on failure (see readmm_strerror()), and '*next'
+// is the end of the line
+static inline int _read_entry( char const* p, char const* end, const int values, const size_t rows, const size_t cols,
+                               unsigned int* ii, unsigned int* jj, double* d, char const** next ) {
+  char const* q;
+  if ( ii != NULL ) {
+    unsigned long long i, j;
+    if ((( q = mm_parse_uint( p, end, rows, &i ) ) == NULL ) || ( i == 0 ) )
+      return _bad_token( p, end );
+    p = _skip_blanks( q, end );
+    if ((( q = mm_parse_uint( p, end, cols, &j ) ) == NULL ) || ( j == 0 ) )
+      return _bad_token( p, end );
+    p = _skip_blanks( q, end );
+    *ii = i;
+    *jj = j;
+  }
+
+  int n = 0;
+  while (( p < end ) && ( *p != '\n' ) ) {
+    if ( n == values )
+      return -7;  // too many values (complex data in a real matrix?)
+    if (( q = mm_parse_double( p, end, d + n ) ) == NULL )
+      return _bad_token( p, end );
+    n++;
+    p = _skip_blanks( q, end );
+  }
+  if ( n != values )
+    return -7;
+  *next = p;
+  return 0;
+}
+
+// skip leading blanks and blank lines
+static inline char const* _skip_space( char const* p, char const* end ) {
+  while (( p < end ) && _is_space( *p ) )
+    p++;
+  return p;
+}
+
+// parse the entries from p..end, one per line, into ii, jj (NULL for dense)
+// and d, from entry '*k' on; blank lines are skipped
+// p..end holds whole lines: more may follow in the next call
+// returns 0 on success, <0 on failure (see readmm_strerror()), and '*k' is
+// the number of entries so far
+static int _read_lines( char const* p, char const* end, size_t* k, const size_t count, const int values,
+                        const size_t rows, const size_t cols, unsigned int* ii, unsigned int* jj, double* d ) {
+  size_t i = *k;
+  int ret = 0;
+  while (( ret == 0 ) && (( p = _skip_space( p, end ) ) < end ) ) {
+    if ( i == count ) {
+      ret = -9;
+      break;
+    }
+    ret = _read_entry( p, end, values, rows, cols, ( ii != NULL ) ? ii + i : NULL, ( jj != NULL ) ? jj + i : NULL,
+                       d + i * values, &p );
+    i += ( ret == 0 );
+  }
+  *k = i;
+  return ret;
+}
+
+#ifdef _OPENMP
+// the entries one thread found in its share of the file
+struct mm_chunk_t {
+  unsigned int* ii;
+  unsigned int* jj;
+  double* d;
+  size_t count;
+  size_t cap;
+  int ret;
+};
+
+// the start of the t-th of T shares of p..end, moved on to the start of a line
+static inline char const* _chunk_start( char const* p, char const* end, const int t, const int T ) {
+  if ( t == 0 )
+    return p;
+  if ( t == T )
+    return end;
+  char const* const q = p + ( size_t )( end - p ) * t / T;
+  return _next_line( q - 1, end );
+}
+
+static int _grow_chunk( struct mm_chunk_t* c, const int values, const int sparse ) {
+  const size_t cap = ( c->cap == 0 ) ? 1024 : 2 * c->cap;
+  double* const d = realloc( c->d, cap * values * sizeof( double ) );
+  if ( d == NULL )
+    return -1;
+  c->d = d;
+  if ( sparse ) {
+    unsigned int* const ii = realloc( c->ii, cap * sizeof( unsigned int ) );
+    if ( ii == NULL )
+      return -1;
+    c->ii = ii;
+    unsigned int* const jj = realloc( c->jj, cap * sizeof( unsigned int ) );
+    if ( jj == NULL )
+      return -1;
+    c->jj = jj;
+  }
+  c->cap = cap;
+  return 0;
+}
+
+// parse every entry in p..end into the chunk's own arrays
+static void _read_chunk( char const* p, char const* end, const int values, const size_t rows, const size_t cols,
+                         const int sparse, struct mm_chunk_t* c ) {
+  // a guess at the number of entries: one per 16 characters, once doubled
+  c->cap = ( end - p ) / 32;
+  c->ret = _grow_chunk( c, values, sparse );
+  while (( c->ret == 0 ) && (( p = _skip_space( p, end ) ) < end ) ) {
+    if (( c->count == c->cap ) && (( c->ret = _grow_chunk( c, values, sparse ) ) != 0 ) )
+      break;
+    const size_t k = c->count;
+    c->ret = _read_entry( p, end, values, rows, cols, sparse ? c->ii + k : NULL, sparse ? c->jj + k : NULL,
+                          c->d + k * values, &p );
+    c->count++;
+  }
+}
+
+// _read_lines(), with the lines shared out between threads: each parses a
+// share of p..end (split at line ends) into its own arrays, then the arrays
+// are copied into place, each at the sum of the counts before it
+static int _read_lines_omp( char const* p, char const* end, size_t* k, const size_t count, const int values,
+                              const size_t rows, const size_t cols, unsigned int* ii, unsigned int* jj, double* d ) {
+  const int nt = omp_get_max_threads();
+  struct mm_chunk_t* const c = calloc( nt, sizeof( struct mm_chunk_t ) );
+  size_t* const offset = malloc(( nt + 1 ) * sizeof( size_t ) );
+  if (( c == NULL ) || ( offset == NULL ) ) {
+    free( c );
+    free( offset );
+    return -1;
+  }
+
+  int ret = 0;
+  #pragma omp parallel num_threads( nt )
+  {
+    const int t = omp_get_thread_num();
+    const int T = omp_get_num_threads();
+    _read_chunk( _chunk_start( p, end, t, T ), _chunk_start( p, end, t + 1, T ), values, rows, cols, ii != NULL, c + t );
+    #pragma omp barrier
+    #pragma omp single
+    {
+      // report the first error in the file, as a single thread would
+      offset[0] = *k;
+      for ( int i = 0; i < T; i++ ) {
+        if (( ret == 0 ) && ( c[i].ret != 0 ) )
+          ret = c[i].ret;
+        offset[i + 1] = offset[i] + c[i].count;
+      }
+      if (( ret == 0 ) && ( offset[T] > count ) )
+        ret = -9;
+      if ( ret == 0 )
+        *k = offset[T];
+    }
+    if ( ret == 0 ) {
+      memcpy( d + offset[t] * values, c[t].d, c[t].count * values * sizeof( double ) );
+      if ( ii != NULL ) {
+        memcpy( ii + offset[t], c[t].ii, c[t].count * sizeof( unsigned int ) );
+        memcpy( jj + offset[t], c[t].jj, c[t].count * sizeof( unsigned int ) );
+      }
+    }
+  }
+
+  for ( int i = 0; i < nt; i++ ) {
+    free( c[i].ii );
+    free( c[i].jj );
+    free( c[i].d );
+  }
+  free( c );
+  free( offset );
+  return ret;
+}
+#endif
+
+// parse the entries in p..end (whole lines), with threads if it's worth it
+static int _read_block( char const* p, char const* end, size_t* k, const size_t count, const int values,
+                        const size_t rows, const size_t cols, unsigned int* ii, unsigned int* jj, double* d ) {
+#ifdef _OPENMP
+  if (( end - p >= MM_OMP_MIN_BYTES ) && ( omp_get_max_threads() > 1 ) )
+    return _read_lines_omp( p, end, k, count, values, rows, cols, ii, jj, d );
+#endif
+  return _read_lines( p, end, k, count, values, rows, cols, ii, jj, d );
+}
+
+// set up 'A' for the entries the header describes (see _read_header())
+// returns 0 on success, <0 on failure, and '*values' is the number of values
+// per entry
+static int _prepare_matrix( matrix_t* A, const int object, const int format, const int datatype, const int symmetry,
+                            const size_t rows, const size_t cols, const size_t nz, int* values ) {
+  if ( object != 0 )
+    return -3;  // check we got the expected object type == matrix
+
+  clear_matrix( A );
+  A->m = rows;
+  A->n = cols;
+  A->nz = nz;
+  A->base = FIRST_INDEX_ONE;
+  A->location = LOWER_TRIANGULAR;  // TODO test for this at the end and report error
+
+  switch ( symmetry ) {  // 0 general, 1 symmetric, 2 skew-symmetric, 3 hermitian
+    case 0:
+      A->sym = SM_UNSYMMETRIC;
+      break;
+    case 1:
+      A->sym = SM_SYMMETRIC;
+      break;
+    case 2:
+      A->sym = SM_SKEW_SYMMETRIC;
+      break;
+    case 3:
+      A->sym = SM_HERMITIAN;
+      break;
+    default:
+      assert( 0 );  // shouldn't be able to get here (checked in _read_header)
+  }
+
+  switch ( datatype ) {  // real, integer, complex, pattern
+    case 0:
+    case 1:  // integers are exact doubles (up to 2^53)
+      A->data_type = REAL_DOUBLE;
+      *values = 1;
+      break;
+    case 2:
+      A->data_type = COMPLEX_DOUBLE;
+      *values = 2;
+      break;
+    default:
+      return -5;  // TODO pattern matrices
+  }
+
+  switch ( format ) {
+    case 0:  // array, column major order
+      A->format = DCOL;
+      if ( symmetry != 0 )
+        return -8;  // TODO handle other symmetries, adjust nz
+      break;
+    case 1:  // coordinate
+      A->format = SM_COO;
+      A->ii = malloc( nz * sizeof( unsigned int ) );
+      A->jj = malloc( nz * sizeof( unsigned int ) );
+      if (( nz > 0 ) && (( A->ii == NULL ) || ( A->jj == NULL ) ) )
+        return -1;
+      break;
+    default:
+      return -4;
+  }
+  A->dd = malloc( nz * *values * sizeof( double ) );
+  if (( nz > 0 ) && ( A->dd == NULL ) )
+    return -1;
+  return 0;
+}
+
+// the end of the header at p..end (just after the line with the dimensions),
+// or NULL if it isn't all there yet
+static char const* _header_end( char const* p, char const* end ) {
+  for ( p = _next_line( p, end ); p < end; ) {
+    char const* const q = _skip_blanks( p, end );
+    char const* const eol = memchr( p, '\n', end - p );
+    if ( eol == NULL )
+      return NULL;
+    if (( *q != '%' ) && ( *q != '\n' ) )
+      return eol + 1;
+    p = eol + 1;
+  }
+  return NULL;
+}
+
+// readmm() for compressed files and tar archives: the stream's blocks are
+// parsed as they arrive, while the reader thread decompresses the next ones
+// a line split between two blocks is put back together in 'line'
+static int _readmm_stream( char const* filename, const unsigned int flags, matrix_t* A, char** comments ) {
+  struct mc_stream_t* s;
+  int ret = mc_stream_open( filename, flags, &s );
+  if ( ret != 0 )
+    return ret;
+
+  char* line = NULL; // the header, then the start of a split line
+  size_t len = 0;
+  char const* p = NULL;
+  size_t n = 0;
+  int eof = 0;
+
+  // collect the header
+  char const* data = NULL;
+  while (( ret == 0 ) && ( data == NULL ) && !eof ) {
+    if (( ret = mc_stream_next( s, &p, &n ) ) < 0 )
+      break;
+    eof = ( ret == 1 );
+    ret = eof ? 0 : _append_line( &line, &len, p, n );
+    if (( ret == 0 ) && ( line != NULL ) ) {
+      static const char magic[] = "%%MatrixMarket";
+      if (( memchr( line, '\n', len ) != NULL ) && (( len < sizeof( magic ) - 1 ) ||
+          ( strncasecmp( line, magic, sizeof( magic ) - 1 ) != 0 ) ) )
+        ret = -12;  // no need to read the whole file to find out
+      if ( !eof )
+        data = _header_end( line, line + len );
+    }
+  }
+
+  int object, format, datatype, symmetry, values = 0;
+  size_t rows, cols, nz, k = 0;
+  if ( ret == 0 ) {
+    if ( comments != NULL )
+      *comments = NULL;
+    ret = _read_header(( line != NULL ) ? line : "", ( line != NULL ) ? line + len : "", &object, &format, &datatype,
+                       &symmetry, &rows, &cols, &nz, comments, &data );
+  }
+  if ( ret == 0 )
+    ret = _prepare_matrix( A, object, format, datatype, symmetry, rows, cols, nz, &values );
+
+  // the rest of the header's blocks, then block by block
+  if ( ret == 0 ) {
+    len -= data - line;
+    memmove( line, data, len );
+    p = NULL;
+    n = 0;
+  }
+  while (( ret == 0 ) && !eof ) {
+    char const* const eol = memrchr( line, '\n', len );
+    if ( eol != NULL ) {
+      // the lines that were split, and what came with them
+      ret = _read_block( line, eol + 1, &k, nz, values, rows, cols, A->ii, A->jj, A->dd );
+      len -= eol + 1 - line;
+      memmove( line, eol + 1, len );
+    }
+    if ( ret != 0 )
+      break;
+    if (( ret = mc_stream_next( s, &p, &n ) ) < 0 )
+      break;
+    eof = ( ret == 1 );
+    ret = 0;
+    if ( eof )
+      break;
+
+    // finish the split line, then parse the block's whole lines in place
+    char const* const first = memchr( p, '\n', n );
+    char const* const last = ( first == NULL ) ? NULL : memrchr( p, '\n', n );
+    if ( first == NULL ) {
+      ret = _append_line( &line, &len, p, n );
+      continue;
+    }
+    char const* start = p;
+    if ( len > 0 ) {
+      ret = _append_line( &line, &len, p, first + 1 - p );
+      if ( ret == 0 )
+        ret = _read_block( line, line + len, &k, nz, values, rows, cols, A->ii, A->jj, A->dd );
+      len = 0;
+      start = first + 1;
+    }
+    if ( ret == 0 )
+      ret = _read_block( start, last + 1, &k, nz, values, rows, cols, A->ii, A->jj, A->dd );
+    if ( ret == 0 )
+      ret = _append_line( &line, &len, last + 1, p + n - ( last + 1 ) );
+  }
+  // the last line, if it had no newline
+  if (( ret == 0 ) && ( len > 0 ) )
+    ret = _read_block( line, line + len, &k, nz, values, rows, cols, A->ii, A->jj, A->dd );
+  if (( ret == 0 ) && ( k < nz ) )
+    ret = -6;
+
+  free( line );
+  mc_stream_close( s );
+  return ret;
+}
+
+int readmm( char const* filename, matrix_t* A, char** comments ) {
+  int tar;
+  const int compression = mc_stream_detect( filename, &tar );
+  if ( compression < 0 )
+    return compression;
+  if (( compression != MC_UNCOMPRESSED ) || tar ) {
+    // a SuiteSparse archive's matrix, or failing that any *.mtx in it
+    int ret = _readmm_stream( filename, 0, A, comments );
+    if ( ret == -14 )
+      ret = _readmm_stream( filename, MC_STREAM_ANY_MTX, A, comments );
+    return ret;
+  }
+
+  struct mm_buffer_t b;
+  int ret = mm_buffer_open( filename, &b );
+  if ( ret != 0 )
+    return ret;
+  char const* const end = b.p + b.len;
+
+  if ( comments != NULL )
+    *comments = NULL;
+  int object, format, datatype, symmetry, values = 0;
+  size_t rows, cols, nz, k = 0;
+  char const* data;
+  ret = _read_header( b.p, end, &object, &format, &datatype, &symmetry, &rows, &cols, &nz, comments, &data );
+  if ( ret == 0 )
+    ret = _prepare_matrix( A, object, format, datatype, symmetry, rows, cols, nz, &values );
+  if ( ret == 0 )
+    ret = _read_block( data, end, &k, nz, values, rows, cols, A->ii, A->jj, A->dd );
+  if (( ret == 0 ) && ( k < nz ) )
+    ret = -6;
+
+  mm_buffer_close( &b );
+  return ret;
+}
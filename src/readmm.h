@@ -0,0 +1,73 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _READMM_H_
+#define _READMM_H_
+
+#include "config.h"
+#include <stddef.h>
+#include "matrix.h"
+
+// MatrixMarket (.mtx) reader
+//
+// the file is mapped into memory (or read in whole, if it can't be mapped:
+// pipes, /dev/stdin) and parsed in place: no line length limit, no copies of
+// the lines, and no sscanf() per token. Values are converted exactly as
+// strtod() would, bit for bit.
+// With OpenMP, large files are split at line ends and the shares are parsed
+// by separate threads.
+// Compressed files (gzip, zstd, xz) and tar archives, such as SuiteSparse's
+// Name.tar.gz, are decompressed as they're parsed (see stream.h).
+
+// a read-only view of a whole file
+struct mm_buffer_t {
+  char const* p;
+  size_t len;
+  int mapped; // 1: mmap-ed, 0: malloc-ed copy
+};
+
+// returns 0 on success, -1 malloc failure, -2 can't open or read the file
+int mm_buffer_open( char const* filename, struct mm_buffer_t* b );
+void mm_buffer_close( struct mm_buffer_t* b );
+
+// number parsers: 'p' is the first character of the token, 'end' is the end
+// of the buffer (the buffer need not be null terminated)
+// a token must be followed by white space or the end of the buffer
+// returns a pointer to the character after the token, or NULL if it isn't a
+// number of the expected form
+
+// unsigned decimal integer, no sign, at most 'max'
+char const* mm_parse_uint( char const* p, char const* end, unsigned long long max, unsigned long long* v );
+// decimal floating point number, [+-]digits[.digits][(e|E)[+-]digits],
+// converted as strtod() would (no hex, inf or nan)
+char const* mm_parse_double( char const* p, char const* end, double* v );
+
+// read a MatrixMarket formatted file
+// input  'filename' to read, possibly compressed, or a tar archive holding
+//             the matrix as "Name/Name.mtx" (or else any "*.mtx")
+// output '*A' the matrix: COO (sparse) or DCOL (dense), base one, REAL_DOUBLE
+//             ("real" and "integer" files) or COMPLEX_DOUBLE
+//        '**comments' if not NULL, a malloc-ed copy of the comment lines
+//             from the header (for use with structured comments, parsed by
+//             some other function), NULL if there were none
+// returns  0 on success, <0 on failure
+//          readmm_strerror(ret) gives a string explaining the error
+int readmm( char const* filename, matrix_t* A, char** comments );
+char const* readmm_strerror( int err );
+
+#endif
@@ -25,9 +25,15 @@
 #include <string.h> // memcpy
 #include <assert.h>
 
+#ifndef SuiteSparse_long
+#define SuiteSparse_long UF_long  // CHOLMOD < 2.0
+#endif
+
 typedef struct {
   cholmod_common common;
   cholmod_factor* factor;
+  int started; // common has been initialized...
+  int wide;    // ...for 64-bit indices: cholmod_l_* (otherwise cholmod_*)
 } solve_system_cholmod_t;
 
 void solver_init_cholmod( solver_state_t* s ) {
@@ -36,8 +42,34 @@ void solver_init_cholmod( solver_state_t* s ) {
   solve_system_cholmod_t* const p = calloc( 1, sizeof( solve_system_cholmod_t ) );
   s->specific = p;
   assert( s->specific != NULL );
+  // Note: cholmod_start() or cholmod_l_start() is called in the analysis
+  // stage, once we know the matrix' index width
+}
 
-  assert( cholmod_start( &p->common ) == 1 );
+// start CHOLMOD for this index width
+static void _cholmod_start( solve_system_cholmod_t* p, matrix_t* A );
+static void _cholmod_start( solve_system_cholmod_t* p, matrix_t* A ) {
+  const int wide = ( A->index_width == MC_INDEX_64 );
+  if ( p->started && ( p->wide == wide ) )
+    return;
+  if ( p->started ) {
+    if ( p->factor != NULL ) {
+      if ( p->wide )
+        cholmod_l_free_factor( &p->factor, &p->common );
+      else
+        cholmod_free_factor( &p->factor, &p->common );
+    }
+    if ( p->wide )
+      cholmod_l_finish( &p->common );
+    else
+      cholmod_finish( &p->common );
+  }
+  p->wide = wide;
+  if ( wide )
+    assert( cholmod_l_start( &p->common ) == 1 );
+  else
+    assert( cholmod_start( &p->common ) == 1 );
+  p->started = 1;
   // TODO handle errors nicely (avoid asserting on malloc failures...)
 }
 
@@ -58,8 +90,16 @@ static inline void _matrix2cholmodsparse( matrix_t* A, cholmod_sparse* B )  {
   B->nrow = A->m;
   B->ncol = A->n;
   B->nzmax = A->nz;
-  B->p = A->jj; // column pointers
-  B->i = A->ii; // row indices
+  if ( A->index_width == MC_INDEX_64 ) {
+    B->p = A->jj64; // column pointers
+    B->i = A->ii64; // row indices
+    B->itype = CHOLMOD_LONG;
+  }
+  else {
+    B->p = A->jj; // column pointers
+    B->i = A->ii; // row indices
+    B->itype = CHOLMOD_INT;
+  }
   B->nz = NULL; // we use packed matrices
   B->x = A->dd; // data
   // z is NULL unless complex and in MATLAB format
@@ -73,8 +113,6 @@ static inline void _matrix2cholmodsparse( matrix_t* A, cholmod_sparse* B )  {
   else // LOWER_TRIANGULAR
     B->stype = -1;
 
-  B->itype = CHOLMOD_INT; // TODO or CHOLMOD_INTLONG or CHOLMOD_LONG
-
   // TODO refactor
   switch ( A->data_type ) {
       // TODO handle CHOLMOD_ZOMPLEX (matlab split real/imag vectors)
@@ -100,7 +138,7 @@ static inline void _matrix2cholmodsparse( matrix_t* A, cholmod_sparse* B )  {
       break;
   }
 
-  B->sorted = 0; // TODO TRUE if columns are sorted, FALSE otherwise
+  B->sorted = (( A->flags & MC_SORTED_BY_COL ) != 0 ); // rows sorted within each column
   B->packed = 1; // TODO nz is ignored
 }
 static inline void _cholmodsparse2matrix( cholmod_sparse* B, matrix_t* A );
@@ -114,12 +152,21 @@ static inline void _cholmodsparse2matrix( cholmod_sparse* B, matrix_t* A )  {
 
   A->m = B->nrow;
   A->n = B->ncol;
-  A->nz = (( int* ) B->p )[B->ncol];
   // TODO B->nzmax;
-
-  A->jj = B->p; // column pointers
-  A->ii = B->i; // row indices
+  assert(( B->itype == CHOLMOD_INT ) || ( B->itype == CHOLMOD_LONG ) ); // TODO or CHOLMOD_INTLONG
+  if ( B->itype == CHOLMOD_LONG ) {
+    A->index_width = MC_INDEX_64;
+    A->nz = (( SuiteSparse_long* ) B->p )[B->ncol];
+    A->jj64 = B->p; // column pointers
+    A->ii64 = B->i; // row indices
+  }
+  else {
+    A->nz = (( int* ) B->p )[B->ncol];
+    A->jj = B->p; // column pointers
+    A->ii = B->i; // row indices
+  }
   assert( B->nz == NULL ); // we use packed matrices
+  A->flags = B->sorted ? MC_SORTED_BY_COL : 0;
   A->dd = B->x; // data
   // z is NULL unless complex and in MATLAB format
   // (complex is split into real and imag components)
@@ -134,9 +181,6 @@ static inline void _cholmodsparse2matrix( cholmod_sparse* B, matrix_t* A )  {
   else  // B->stype < 0
     A->location = LOWER_TRIANGULAR;
 
-
-  assert( B->itype == CHOLMOD_INT ); // TODO or CHOLMOD_INTLONG or CHOLMOD_LONG
-
   // TODO refactor
   if ( B->xtype == CHOLMOD_REAL ) {
     if ( B->dtype == CHOLMOD_DOUBLE )
@@ -251,10 +295,14 @@ void solver_analyze_cholmod( solver_state_t* s, matrix_t* A ) {
   solve_system_cholmod_t* const p = s->specific;
   assert( p != NULL );
 
+  _cholmod_start( p, A );
   cholmod_sparse B;
   _matrix2cholmodsparse( A, &B );
 
-  p->factor = cholmod_analyze( &B, &p->common );
+  if ( p->wide )
+    p->factor = cholmod_l_analyze( &B, &p->common );
+  else
+    p->factor = cholmod_analyze( &B, &p->common );
   assert( p->factor != NULL );
   // TODO handle errors nicely
 }
@@ -266,10 +314,14 @@ void solver_factorize_cholmod( solver_state_t* s, matrix_t* A ) {
   solve_system_cholmod_t* const p = s->specific;
   assert( p != NULL );
 
+  assert( p->wide == ( A->index_width == MC_INDEX_64 ) ); // must match the analysis
   cholmod_sparse B;
   _matrix2cholmodsparse( A, &B );
 
-  assert( cholmod_factorize( &B, p->factor, &p->common ) == 1 );
+  if ( p->wide )
+    assert( cholmod_l_factorize( &B, p->factor, &p->common ) == 1 );
+  else
+    assert( cholmod_factorize( &B, p->factor, &p->common ) == 1 );
   // TODO handle errors nicely
 }
 
@@ -300,7 +352,11 @@ static void _solver_evaluate_cholmod_dense( solver_state_t* s, matrix_t* b, matr
   // solve
   cholmod_dense B;
   _matrix2cholmoddense( b, &B );
-  cholmod_dense* xc = cholmod_solve( CHOLMOD_A, p->factor, &B, &p->common );
+  cholmod_dense* xc;
+  if ( p->wide )
+    xc = cholmod_l_solve( CHOLMOD_A, p->factor, &B, &p->common );
+  else
+    xc = cholmod_solve( CHOLMOD_A, p->factor, &B, &p->common );
   assert( xc != NULL );
 
   // xc -> x
@@ -316,7 +372,11 @@ static void _solver_evaluate_cholmod_sparse( solver_state_t* s, matrix_t* b, mat
   // solve
   cholmod_sparse B;
   _matrix2cholmodsparse( b, &B );
-  cholmod_sparse* xc = cholmod_spsolve( CHOLMOD_A, p->factor, &B, &p->common );
+  cholmod_sparse* xc;
+  if ( p->wide )
+    xc = cholmod_l_spsolve( CHOLMOD_A, p->factor, &B, &p->common );
+  else
+    xc = cholmod_spsolve( CHOLMOD_A, p->factor, &B, &p->common );
   assert( xc != NULL );
 
   // TODO xc -> x
@@ -332,7 +392,12 @@ void solver_finalize_cholmod( solver_state_t* s ) {
   solve_system_cholmod_t* const p = s->specific;
 
   // release memory
-  if ( p != NULL ) {
+  if (( p != NULL ) && p->started && p->wide ) {
+    if ( p->factor != NULL )
+      cholmod_l_free_factor( &p->factor, &p->common );
+    cholmod_l_finish( &p->common );
+  }
+  else if (( p != NULL ) && p->started ) {
     if ( p->factor != NULL )
       cholmod_free_factor( &p->factor, &p->common );
     cholmod_finish( &p->common );
@@ -21,6 +21,16 @@
 
 #ifdef HAVE_MUMPS
   #include "solver_mumps.h"
+  #ifdef HAVE_SMUMPS
+    #define SOLVES_MUMPS_SINGLE SOLVES_DATA_TYPE_REAL_SINGLE
+  #else
+    #define SOLVES_MUMPS_SINGLE 0
+  #endif
+  #ifdef HAVE_ZMUMPS
+    #define SOLVES_MUMPS_COMPLEX SOLVES_DATA_TYPE_COMPLEX_DOUBLE
+  #else
+    #define SOLVES_MUMPS_COMPLEX 0
+  #endif
 #endif
 #ifdef HAVE_UMFPACK
   #include "solver_umfpack.h"
@@ -106,6 +116,12 @@ struct  solver_properties_t {
 
 #define SOLVES_RHS_VECTOR_ONLY (1<<29)
 
+// takes 64-bit indices (MC_INDEX_64) as well as 32-bit
+#define SOLVES_INDEX_64 (1<<30)
+
+// takes complex values split into real and imaginary arrays (MC_COMPLEX_SPLIT) as well as paired
+#define SOLVES_COMPLEX_SPLIT (1u<<31)
+
 
 // how multicore is each solver?
 #define SOLVER_SINGLE_THREADED_ONLY 0
@@ -132,7 +148,9 @@ static const struct solver_properties_t solver_lookup[] = {
     &solver_finalize_umfpack,
     SOLVES_FORMAT_CSC | SOLVES_BASE_ZERO | SOLVES_UNSYMMETRIC |
     SOLVES_DATA_TYPE_REAL_DOUBLE |
+    SOLVES_DATA_TYPE_COMPLEX_DOUBLE | SOLVES_COMPLEX_SPLIT | // umfpack_zi_*, Ax/Az
     SOLVES_SQUARE_ONLY |
+    SOLVES_INDEX_64 | // umfpack_dl_*, umfpack_zl_*
     SOLVES_RHS_DCOL | SOLVES_RHS_VECTOR_ONLY,
     SOLVER_SINGLE_THREADED_ONLY,
     // Note: Adjacent constant strings will be concatentated
@@ -159,7 +177,7 @@ static const struct solver_properties_t solver_lookup[] = {
     &solver_evaluate_mumps,
     &solver_finalize_mumps,
     SOLVES_FORMAT_COO | SOLVES_BASE_ONE | SOLVES_UNSYMMETRIC |
-    SOLVES_DATA_TYPE_REAL_DOUBLE |
+    SOLVES_DATA_TYPE_REAL_DOUBLE | SOLVES_MUMPS_SINGLE | SOLVES_MUMPS_COMPLEX |
     SOLVES_SQUARE_ONLY |
     // TODO is mumps really restricted to square matrices?
     // TODO mumps can handle sparse rhs and can solve multiple right hand sides
@@ -191,6 +209,7 @@ static const struct solver_properties_t solver_lookup[] = {
     // upper or lower triangular symmetric or BOTH or unsymmetric but must still be SPD
     // TODO keep track of when a matrices' entries have been sorted!
     SOLVES_DATA_TYPE_REAL_DOUBLE |
+    SOLVES_INDEX_64 | // cholmod_l_*
     // TODO is cholmod really restricted to square matrices?
     SOLVES_RHS_DCOL | SOLVES_RHS_VECTOR_ONLY, // TODO | SOLVES_RHS_CSC,
     SOLVER_SINGLE_THREADED_ONLY,
@@ -20,9 +20,17 @@
 #include "solvers.h"
 #include "matrix.h"
 #include <dmumps_c.h>
+#ifdef HAVE_SMUMPS
+#include <smumps_c.h>
+#endif
+#ifdef HAVE_ZMUMPS
+#include <zmumps_c.h>
+#endif
+#include <mpi.h>
 
 #include <stdlib.h> // malloc, free
 #include <string.h> // memcpy
+#include <limits.h> // INT_MAX
 #include <assert.h>
 
 
@@ -32,54 +40,132 @@
 
 #define MUMPS_USE_COMM_WORLD -987654
 
+// one MUMPS instance: double (dmumps), single (smumps) or complex double (zmumps)
+// the arithmetic follows A, chosen when the matrix is analyzed
+typedef struct {
+  char arith; // 'd': dmumps, 's': smumps, 'z': zmumps
+  void* rhs_sparse; // converted sparse right-hand side values (when b's precision != A's)
+  union {
+    DMUMPS_STRUC_C d;
+#ifdef HAVE_SMUMPS
+    SMUMPS_STRUC_C s;
+#endif
+#ifdef HAVE_ZMUMPS
+    ZMUMPS_STRUC_C z;
+#endif
+  } id;
+} mumps_state_t;
 
-// the functions called from the "solver" wrapper and defined in "solver_lookup.h"
-// TODO probably need to see an example matrix so we can choose appropriate options, etc for solver
-void solver_init_mumps( solver_state_t* s ) {
-  // initialize MUMPS instance
-  DMUMPS_STRUC_C* id = calloc( 1, sizeof( DMUMPS_STRUC_C ) ); // initialize to zero
-  assert( id != NULL ); // calloc failure
-  s->specific = id; // stored for future use
-
-  id->job = JOB_INIT;
-  id->par = 1; // host involved in factorization/solve
-  id->sym = 0; // 0: general, 1: sym pos def, 2: sym (note: no hermitian support) // TODO support other matrix types
+// pick the instance's field if that arithmetic was built, otherwise drop the choice
+#ifdef HAVE_SMUMPS
+#define ID_S(X) ( st->arith == 's' ) ? ( X ) :
+#define ID_S_SET(F, V) if ( st->arith == 's' ) st->id.s.F = ( V ); else
+#else
+#define ID_S(X)
+#define ID_S_SET(F, V)
+#endif
+#ifdef HAVE_ZMUMPS
+#define ID_Z(X) ( st->arith == 'z' ) ? ( X ) :
+#define ID_Z_SET(F, V) if ( st->arith == 'z' ) st->id.z.F = ( V ); else
+#else
+#define ID_Z(X)
+#define ID_Z_SET(F, V)
+#endif
+
+// fields that have the same type in all instances (integers, arrays of integers)
+#define ID(F) (*( ID_S( &( st->id.s.F ) ) ID_Z( &( st->id.z.F ) ) &( st->id.d.F ) ))
+
+// fields holding values: float* for smumps, double* for dmumps, ZMUMPS_COMPLEX* for zmumps
+#define ID_REAL(F) ( ID_S(( void* ) st->id.s.F ) ID_Z(( void* ) st->id.z.F ) ( void* ) st->id.d.F )
+#define ID_REAL_SET(F, V) do { ID_S_SET(F, V) ID_Z_SET(F, V) st->id.d.F = ( V ); } while ( 0 )
+
+#define INFOG(I) infog[(I)-1] // macro s.t. indices match documentation
+#define ICNTL(I) icntl[(I)-1] // macro s.t. indices match documentation
+
+static void _mumps_c( mumps_state_t* st );
+static void _mumps_start( mumps_state_t* st, const char arith, const int verbosity );
+static enum matrix_data_type_t _mumps_data_type( mumps_state_t const* st );
+
+static void _mumps_c( mumps_state_t* st ) {
+#ifdef HAVE_SMUMPS
+  if ( st->arith == 's' ) {
+    smumps_c( &( st->id.s ) );
+    return;
+  }
+#endif
+#ifdef HAVE_ZMUMPS
+  if ( st->arith == 'z' ) {
+    zmumps_c( &( st->id.z ) );
+    return;
+  }
+#endif
+  dmumps_c( &( st->id.d ) );
+}
+
+// initialize a MUMPS instance of the requested arithmetic
+static void _mumps_start( mumps_state_t* st, const char arith, const int verbosity ) {
+  memset( &( st->id ), 0, sizeof( st->id ) );
+  st->arith = arith;
+
+  ID( job ) = JOB_INIT;
+  ID( par ) = 1; // host involved in factorization/solve
+  ID( sym ) = 0; // 0: general, 1: sym pos def, 2: sym (note: no hermitian support, complex symmetric only) // TODO support other matrix types
   // Note: if set to symmetric and matrix ISN'T, the redundant entries will be *summed*
   // TODO could convert the C communicator instead of using the fortran one (see MUMPS doc)
-  id->comm_fortran = MUMPS_USE_COMM_WORLD;
-#define INFOG(I) infog[(I)-1] // macro s.t. indices match documentation
-  dmumps_c( id );
-  assert( id->INFOG( 1 ) == 0 ); // check it worked
+  ID( comm_fortran ) = MUMPS_USE_COMM_WORLD;
+  _mumps_c( st );
+  assert( ID( INFOG( 1 ) ) == 0 ); // check it worked
   // clears the rest of the unused values
 
   // set debug verbosity
-#define ICNTL(I) icntl[(I)-1] // macro s.t. indices match documentation
   // No outputs
-  if ( s->verbosity < 3 ) { // no debug
-    id->ICNTL( 1 ) = -1;
-    id->ICNTL( 2 ) = -1;
-    id->ICNTL( 3 ) = -1;
-    id->ICNTL( 4 ) = 0;
+  if ( verbosity < 3 ) { // no debug
+    ID( ICNTL( 1 ) ) = -1;
+    ID( ICNTL( 2 ) ) = -1;
+    ID( ICNTL( 3 ) ) = -1;
+    ID( ICNTL( 4 ) ) = 0;
   }
   else { // debug
-    id->ICNTL( 1 ) = 6; // err output stream
-    id->ICNTL( 2 ) = 6; // warn/info output stream
-    id->ICNTL( 3 ) = 6; // global output stream
-    id->ICNTL( 4 ) = 4; // debug level 0:none, 1: err, 2: warn/stats 3:diagnostics, 4:parameters
+    ID( ICNTL( 1 ) ) = 6; // err output stream
+    ID( ICNTL( 2 ) ) = 6; // warn/info output stream
+    ID( ICNTL( 3 ) ) = 6; // global output stream
+    ID( ICNTL( 4 ) ) = 4; // debug level 0:none, 1: err, 2: warn/stats 3:diagnostics, 4:parameters
   }
 }
 
+// the values the instance works in
+static enum matrix_data_type_t _mumps_data_type( mumps_state_t const* st ) {
+  switch ( st->arith ) {
+    case 's': return REAL_SINGLE;
+    case 'z': return COMPLEX_DOUBLE;
+    default:  return REAL_DOUBLE;
+  }
+}
+
+
+// the functions called from the "solver" wrapper and defined in "solver_lookup.h"
+// TODO probably need to see an example matrix so we can choose appropriate options, etc for solver
+void solver_init_mumps( solver_state_t* s ) {
+  // initialize MUMPS instance, real double precision until we see A
+  mumps_state_t* st = calloc( 1, sizeof( mumps_state_t ) ); // initialize to zero
+  assert( st != NULL ); // calloc failure
+  s->specific = st; // stored for future use
+
+  _mumps_start( st, 'd', s->verbosity );
+}
+
 void solver_finalize_mumps( solver_state_t* s ) {
   assert( s != NULL );
-  DMUMPS_STRUC_C* const id = s->specific;
-  assert( id != NULL );
+  mumps_state_t* const st = s->specific;
+  assert( st != NULL );
 
-  id->job = JOB_END;
-  dmumps_c( id ); // Terminate instance
-  assert( id->INFOG( 1 ) == 0 ); // check it worked
+  ID( job ) = JOB_END;
+  _mumps_c( st ); // Terminate instance
+  assert( ID( INFOG( 1 ) ) == 0 ); // check it worked
 
-  free( id->rhs );
-  free( id );
+  free( ID_REAL( rhs ) );
+  free( st->rhs_sparse );
+  free( st );
 
   s->specific = NULL;
 }
@@ -91,7 +177,27 @@ void solver_analyze_mumps( solver_state_t* s, matrix_t* A ) {
   else
     assert( A == NULL );
 
-  DMUMPS_STRUC_C* const id = s->specific;
+  mumps_state_t* const st = s->specific;
+
+  // every rank must call the same (single, double or complex) MUMPS,
+  // so share A's value type and restart the instance if it changed
+  char arith = 'd';
+  if ( s->mpi_rank == 0 )
+    arith = ( A->data_type == REAL_SINGLE ) ? 's' : ( A->data_type == COMPLEX_DOUBLE ) ? 'z' : 'd';
+  int is_mpi;
+  int ierr = MPI_Initialized( &is_mpi );
+  assert( ierr == 0 );
+  if ( is_mpi ) {
+    ierr = MPI_Bcast( &arith, 1, MPI_CHAR, 0, MPI_COMM_WORLD );
+    assert( ierr == MPI_SUCCESS );
+  }
+  if ( arith != st->arith ) {
+    ID( job ) = JOB_END;
+    _mumps_c( st );
+    assert( ID( INFOG( 1 ) ) == 0 ); // check it worked
+    free( ID_REAL( rhs ) );
+    _mumps_start( st, arith, s->verbosity );
+  }
 
   // load A's pattern for analysis (COO format)
   if ( s->mpi_rank == 0 ) { // only rank=0 needs the initial data
@@ -102,17 +208,24 @@ void solver_analyze_mumps( solver_state_t* s, matrix_t* A ) {
     assert( A->format == SM_COO );
     assert( A->base == FIRST_INDEX_ONE );
 
-    assert( A->data_type == REAL_DOUBLE ); // don't handle complex... yet TODO
+    assert( A->data_type == _mumps_data_type( st ) ); // TODO complex single (cmumps)
+    assert(( A->data_type != COMPLEX_DOUBLE ) || ( A->complex_storage == MC_COMPLEX_PAIRED ) );
     assert( A->m == A->n ); // square matrices only?
+    assert( A->index_width == MC_INDEX_32 ); // indices are MUMPS_INT, only the non-zero count can be 64-bit
 
 
     // TODO really we should just copy this to be CORRECT/TYPESAFE (not worth being clever...)
 
     // mumps: irn=row indices, jcn=column idices, a=values, rhs=right-hand side, n = matrix order (on-a-side?) nz=non-zeros?
-    id->n   = A->m; // A.m: rows, A.n: columns
-    id->nz  = A->nz; // non-zeros
-    id->irn = ( int* ) A->ii; // row    indices
-    id->jcn = ( int* ) A->jj; // column indices
+    ID( n )   = A->m; // A.m: rows, A.n: columns
+#ifdef MUMPS_INT8
+    ID( nnz ) = A->nz; // non-zeros (64-bit, MUMPS >= 5.1)
+#else
+    assert( A->nz <= INT_MAX ); // TODO too many non-zeros for this MUMPS
+    ID( nz )  = A->nz; // non-zeros
+#endif
+    ID( irn ) = ( int* ) A->ii; // row    indices
+    ID( jcn ) = ( int* ) A->jj; // column indices
   }
 
   // Call the MUMPS package.
@@ -173,10 +286,10 @@ void solver_analyze_mumps( solver_state_t* s, matrix_t* A ) {
   //       ... sets SCHUR_MLOC, SCHUR_NLOC
   // id->WRITE_PROBLEM: store distributed in matrix market format
 #define JOB_ANALYSE 1
-  id->job = JOB_ANALYSE;
-  dmumps_c( id );
-  if ( id->INFOG( 1 ) != 0 ) fprintf( stderr, "warning: analysis failed\n" );
-  assert( id->INFOG( 1 ) == 0 ); // check it worked
+  ID( job ) = JOB_ANALYSE;
+  _mumps_c( st );
+  if ( ID( INFOG( 1 ) ) != 0 ) fprintf( stderr, "warning: analysis failed\n" );
+  assert( ID( INFOG( 1 ) ) == 0 ); // check it worked
 
   // available info:
   // INFO(15)/INFOG(16/17): min/max/sum-over-all-cpus mem requried [in megabytes]
@@ -191,12 +304,14 @@ void solver_factorize_mumps( solver_state_t* s, matrix_t* A ) {
     assert( A != NULL );
   else
     assert( A == NULL );
-  DMUMPS_STRUC_C* const id = s->specific;
+  mumps_state_t* const st = s->specific;
 
   // load A's *data* for factorization
   // Note: pattern must have remained the same
-  if ( s->mpi_rank == 0 )
-    id->a   = A->dd;
+  if ( s->mpi_rank == 0 ) {
+    assert( A->data_type == _mumps_data_type( st ) ); // same as analyzed
+    ID_REAL_SET( a, A->dd );
+  }
 
   // requires id->A if ICNTL(5)=0 (assembled matrix)
   // requires id->A_ELT if ICNTL(5)=1 (elemental matrix)
@@ -208,39 +323,81 @@ void solver_factorize_mumps( solver_state_t* s, matrix_t* A ) {
   //   requires id->COLSCA, ROWSCA
   // ICNTL(19)=2,3 requires SCHUR_LLD, SCHUR
 #define JOB_FACTORIZE 2
-  id->job = JOB_FACTORIZE;
-  dmumps_c( id );
-  assert( id->INFOG( 1 ) == 0 ); // check it worked
+  ID( job ) = JOB_FACTORIZE;
+  _mumps_c( st );
+  assert( ID( INFOG( 1 ) ) == 0 ); // check it worked
+}
+
+// copy 'n' values from 'src' (type 't') to 'dst' in the instance's precision
+// complex values are paired, so they are copied as 2n reals
+static void _mumps_copy_values( mumps_state_t const* st, void* dst, void const* src, const enum matrix_data_type_t t, size_t n );
+static void _mumps_copy_values( mumps_state_t const* st, void* dst, void const* src, const enum matrix_data_type_t t, size_t n ) {
+  const enum matrix_data_type_t to = _mumps_data_type( st );
+  const int single = ( to == REAL_SINGLE ) || ( to == COMPLEX_SINGLE );
+  if (( t == COMPLEX_DOUBLE ) || ( t == COMPLEX_SINGLE ) ) {
+    assert(( to == COMPLEX_DOUBLE ) || ( to == COMPLEX_SINGLE ) ); // b is widened for a complex A (see solvers.c)
+    n *= 2;
+  }
+  else {
+    assert(( to == REAL_DOUBLE ) || ( to == REAL_SINGLE ) );
+  }
+  if ( t == to ) {
+    memcpy( dst, src, n * ( single ? sizeof( float ) : sizeof( double ) ) );
+  }
+  else if ( single ) { // double -> float
+    float* d = dst;
+    double const* v = src;
+    for ( size_t i = 0; i < n; i++ )
+      d[i] = v[i];
+  }
+  else { // float -> double
+    double* d = dst;
+    float const* v = src;
+    for ( size_t i = 0; i < n; i++ )
+      d[i] = v[i];
+  }
 }
 
 void solver_evaluate_mumps( solver_state_t* s, matrix_t* b, matrix_t* x ) {
   assert( s != NULL );
-  DMUMPS_STRUC_C* const id = s->specific;
+  mumps_state_t* const st = s->specific;
 
   if ( s->mpi_rank == 0 ) {
     assert( x != NULL );
     assert( b != NULL );
-    assert( b->data_type == REAL_DOUBLE );
-    assert( b->m == id->n ); // rows of b match rows of A
+    // b may differ in precision from A, it is converted as it is copied in
+    assert( b->data_type != SM_PATTERN );
+    assert(( b->data_type != COMPLEX_DOUBLE ) || ( b->complex_storage == MC_COMPLEX_PAIRED ) );
+    assert( b->m == ID( n ) ); // rows of b match rows of A
     assert( (b->format == DCOL) || (b->format == SM_CSC) );
 
-    id->lrhs = b->m; // rows of b
-    id->nrhs = b->n; // columns of b
-    id->rhs = malloc( id->n * id->nrhs * sizeof( double ) );
-    assert( id->rhs != NULL ); // malloc failure
+    const enum matrix_data_type_t t = _mumps_data_type( st );
+    ID( lrhs ) = b->m; // rows of b
+    ID( nrhs ) = b->n; // columns of b
+    void* rhs = malloc( ID( n ) * ID( nrhs ) * _data_width( t ) );
+    assert( rhs != NULL ); // malloc failure
+    ID_REAL_SET( rhs, rhs );
     if(b->format == SM_CSC) { // sparse RHS
       assert(b->base == FIRST_INDEX_ONE);
-      id->ICNTL(20) = 1;
-      id->nz_rhs = b->nz;             // non-zeros
-      id->rhs_sparse = b->dd;         // data
+      ID( ICNTL(20) ) = 1;
+      ID( nz_rhs ) = b->nz;             // non-zeros
+      if ( b->data_type == t ) {
+        ID_REAL_SET( rhs_sparse, b->dd ); // data
+      }
+      else {
+        st->rhs_sparse = realloc( st->rhs_sparse, b->nz * _data_width( t ) );
+        assert( st->rhs_sparse != NULL ); // realloc failure
+        _mumps_copy_values( st, st->rhs_sparse, b->dd, b->data_type, b->nz );
+        ID_REAL_SET( rhs_sparse, st->rhs_sparse ); // data
+      }
       // TODO check the cast is safe: rows < max_int, nz < max_int, so we don't muck it up when we drop the signed-ness
-      id->irhs_sparse = (int*) b->ii; // row indices
-      id->irhs_ptr = (int*) b->jj;    // column ptrs
+      ID( irhs_sparse ) = (int*) b->ii; // row indices
+      ID( irhs_ptr ) = (int*) b->jj;    // column ptrs
     }
     else { // dense RHS
       // need to copy 'b' in since it gets destroyed
       // TODO unless x == b && b != CSC
-      memcpy( id->rhs, b->dd, id->n * id->nrhs * sizeof( double ) );
+      _mumps_copy_values( st, rhs, b->dd, b->data_type, ID( n ) * ID( nrhs ) );
     }
   }
   else {
@@ -271,22 +428,22 @@ void solver_evaluate_mumps( solver_state_t* s, matrix_t* b, matrix_t* x ) {
   // id->LRHS >= NRHS, =leading dimension of RHS (optional)
   //
 #define JOB_SOLVE 3
-  id->job = JOB_SOLVE;
-  dmumps_c( id );
-  assert( id->INFOG( 1 ) == 0 ); // check it worked
+  ID( job ) = JOB_SOLVE;
+  _mumps_c( st );
+  assert( ID( INFOG( 1 ) ) == 0 ); // check it worked
 
   // put the answer in a nice formatted bundle
   if ( s->mpi_rank == 0 ) {
     clear_matrix( x );
-    x->m = id->n;
-    x->n = id->nrhs;
+    x->m = ID( n );
+    x->n = ID( nrhs );
     x->nz = x->m * x->n;
     x->format = DCOL;
-    x->data_type = REAL_DOUBLE;
+    x->data_type = _mumps_data_type( st ); // A's values
     // we can recycle this pointer:
     //  1. we allocated it just prior to the solve call, so it doesn't belong to 'b'
     //  2. the data was copied from 'b' then overwritten in the solve stage so no need to copy again
-    x->dd = id->rhs;
-    id->rhs = NULL; // transfer pointer ownership to x
+    x->dd = ID_REAL( rhs );
+    ID_REAL_SET( rhs, NULL ); // transfer pointer ownership to x
   }
 }
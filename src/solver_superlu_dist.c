@@ -94,6 +94,11 @@ void solver_analyze_superlu_dist( solver_state_t* s, matrix_t* A ) {
   matrix_t* AA;
   if(s->mpi_rank == 0) {
     AA = copy_matrix(A);
+    assert(AA != NULL); // TODO malloc error
+    // SuperLU_DIST takes the arrays and free()s them in
+    // Destroy_CompCol_Matrix_dist(): they can't be in the buffer pool
+    int ierr = convert_matrix_ownership(AA, MC_OWN_MALLOC);
+    assert(ierr == 0); // TODO malloc error
   }
   else {
     AA = malloc_matrix();
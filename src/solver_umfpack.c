@@ -26,18 +26,35 @@
 #include <stdio.h>  // getenv
 #include <assert.h>
 
+#ifndef SuiteSparse_long
+#define SuiteSparse_long UF_long  // UMFPACK < 5.6
+#endif
+
 typedef struct
 {
   int Arows;
   int Acols;
-  int* Aii;  // these are pointers to existing data (DON'T free)
-  int* Ajj;
+  int wide;  // 64-bit indices: umfpack_dl_* (otherwise umfpack_di_*)
+  int cplx;  // complex values: umfpack_zi_*/umfpack_zl_*
+  void* Aii;  // these are pointers to existing data (DON'T free)
+  void* Ajj;
   double* Add;
+  double* Adz;  // complex: imaginary parts if split (zomplex), NULL if paired in Add
   void* Symbolic;
   void* Numeric;
   double Control[UMFPACK_CONTROL];
 } solve_system_umfpack_t;
 
+// complex values split into real and imaginary parts are passed as Ax, Az,
+// paired values as Ax with Az = NULL
+static inline double* _imag_umfpack(matrix_t const* A);
+static inline double* _imag_umfpack(matrix_t const* A)
+{
+  if ((A->data_type != COMPLEX_DOUBLE) || (A->complex_storage != MC_COMPLEX_SPLIT))
+    return NULL;
+  return ((double*) A->dd) + A->nz;
+}
+
 void solver_init_umfpack(solver_state_t* s)
 {
   assert(s != NULL);
@@ -68,23 +85,52 @@ void solver_analyze_umfpack(solver_state_t* s, matrix_t* A)
   // prepare the matrix
   assert(A->format == SM_CSC);
   assert(A->base == FIRST_INDEX_ZERO);
-  assert(A->data_type == REAL_DOUBLE);  // don't handle complex... yet TODO
+  assert((A->data_type == REAL_DOUBLE) || (A->data_type == COMPLEX_DOUBLE));  // TODO single precision
   assert(A->m == A->n);  // TODO can only handle square matrices at present (UMFPACK?)
 
   // Compressed Column Format
-  assert(A->jj[0] == 0);
-  assert(A->jj[A->n] == A->nz);
+  assert(validate_matrix(A) == 0);
+  p->wide = (A->index_width == MC_INDEX_64);
+  p->cplx = (A->data_type == COMPLEX_DOUBLE);
+  double* const Az = _imag_umfpack(A);
 
   //X1 TODO Control[UMFPACK_STRATEGY] = UMFPACK_STRATEGY_SYMMETRIC;
 
-  if (s->verbosity >= 4) {
+  if (s->verbosity >= 4)
     p->Control[UMFPACK_PRL] = 6;      // printing level, 6 is highest value, also print license (c.f. UserGuide)
-    umfpack_di_report_matrix(A->m, A->n, (int*) A->jj, (int*) A->ii, A->dd, 0, p->Control);
+
+  int status;
+  if (p->wide) {
+    SuiteSparse_long const* const Ap = (SuiteSparse_long*) A->jj64;
+    SuiteSparse_long const* const Ai = (SuiteSparse_long*) A->ii64;
+    if (p->cplx) {
+      if (s->verbosity >= 4)
+        umfpack_zl_report_matrix(A->m, A->n, Ap, Ai, A->dd, Az, 0, p->Control);
+      status = umfpack_zl_symbolic(A->m, A->n, Ap, Ai, A->dd, Az, &(p->Symbolic), p->Control, NULL);
+    }
+    else {
+      if (s->verbosity >= 4)
+        umfpack_dl_report_matrix(A->m, A->n, Ap, Ai, A->dd, 0, p->Control);
+      status = umfpack_dl_symbolic(A->m, A->n, Ap, Ai, A->dd, &(p->Symbolic), p->Control, NULL);
+    }
+  }
+  else {
+    int const* const Ap = (int*) A->jj;
+    int const* const Ai = (int*) A->ii;
+    if (p->cplx) {
+      if (s->verbosity >= 4)
+        umfpack_zi_report_matrix(A->m, A->n, Ap, Ai, A->dd, Az, 0, p->Control);
+      status = umfpack_zi_symbolic(A->m, A->n, Ap, Ai, A->dd, Az, &(p->Symbolic), p->Control, NULL);
+    }
+    else {
+      if (s->verbosity >= 4)
+        umfpack_di_report_matrix(A->m, A->n, Ap, Ai, A->dd, 0, p->Control);
+      status = umfpack_di_symbolic(A->m, A->n, Ap, Ai, A->dd, &(p->Symbolic), p->Control, NULL);
+    }
   }
 
 //  printf("  UMFPACK Ordering: %f \n", (p->Control[UMFPACK_ORDERING]));
 
-  int status = umfpack_di_symbolic(A->m, A->n, (int*) A->jj, (int*) A->ii, A->dd, &(p->Symbolic), p->Control, NULL);
   if (status != UMFPACK_OK)
     umfpack_di_report_status(NULL, status);
   assert(status == UMFPACK_OK);
@@ -100,17 +146,27 @@ void solver_factorize_umfpack(solver_state_t* s, matrix_t* A)
   // prepare the matrix
   assert(A->format == SM_CSC);
   assert(A->base == FIRST_INDEX_ZERO);
-  assert(A->data_type == REAL_DOUBLE);  // don't handle complex... yet TODO
+  assert(A->data_type == (p->cplx ? COMPLEX_DOUBLE : REAL_DOUBLE));  // must match the analysis
   assert(A->m == A->n);  // TODO can only handle square matrices at present (UMFPACK?)
 
   // saved for evaluation phase
   p->Arows = A->m;
   p->Acols = A->n;
-  p->Ajj = (int*) A->jj;
-  p->Aii = (int*) A->ii;
+  assert(p->wide == (A->index_width == MC_INDEX_64));  // must match the analysis
+  p->Ajj = p->wide ? (void*) A->jj64 : (void*) A->jj;
+  p->Aii = p->wide ? (void*) A->ii64 : (void*) A->ii;
   p->Add = A->dd;
+  p->Adz = _imag_umfpack(A);
 
-  int status = umfpack_di_numeric(p->Ajj, p->Aii, p->Add, p->Symbolic, &(p->Numeric), p->Control, NULL);
+  int status;
+  if (p->wide && p->cplx)
+    status = umfpack_zl_numeric(p->Ajj, p->Aii, p->Add, p->Adz, p->Symbolic, &(p->Numeric), p->Control, NULL);
+  else if (p->wide)
+    status = umfpack_dl_numeric(p->Ajj, p->Aii, p->Add, p->Symbolic, &(p->Numeric), p->Control, NULL);
+  else if (p->cplx)
+    status = umfpack_zi_numeric(p->Ajj, p->Aii, p->Add, p->Adz, p->Symbolic, &(p->Numeric), p->Control, NULL);
+  else
+    status = umfpack_di_numeric(p->Ajj, p->Aii, p->Add, p->Symbolic, &(p->Numeric), p->Control, NULL);
   if (status != UMFPACK_OK)
     umfpack_di_report_status(NULL, status);
   assert(status == UMFPACK_OK);
@@ -129,24 +185,33 @@ void solver_evaluate_umfpack(solver_state_t* s, matrix_t* b, matrix_t* x)
   // and we have a valid 'x' and 'b'
   int ierr = convert_matrix(b, DCOL, FIRST_INDEX_ZERO);
   assert(ierr == 0);
-  assert(b->data_type == REAL_DOUBLE);  // don't handle complex... yet TODO
   assert(b->n == 1);
   assert(b->m == p->Acols);  // TODO move to wrapper level check?
-  assert(b->data_type == REAL_DOUBLE);
+  assert(b->data_type == (p->cplx ? COMPLEX_DOUBLE : REAL_DOUBLE));  // same as A (see solvers.c)
+  assert(b->complex_storage == MC_COMPLEX_PAIRED);
 
   // allocate x, if required
-  if ((x->format != DCOL) || (x->m != p->Acols) || (x->n != b->n)) {
+  if ((x->format != DCOL) || (x->m != p->Acols) || (x->n != b->n) || (x->data_type != b->data_type)) {
     clear_matrix(x);
     x->format = DCOL;
     x->data_type = b->data_type;
     x->m = p->Acols;
     x->n = b->n;
     x->nz = x->m * x->n;
-    x->dd = calloc((x->m) * (x->n), sizeof(double));  // TODO this shouldn't need to be a calloc!
+    x->dd = calloc((x->m) * (x->n), _data_width(x->data_type));  // TODO this shouldn't need to be a calloc!
     assert(x->dd != NULL);
   }
 
-  int status = umfpack_di_solve(UMFPACK_A, p->Ajj, p->Aii, p->Add, x->dd, b->dd, p->Numeric, p->Control/*X1 NULL*/, NULL);
+  // x and b are paired complex: Xz = Bz = NULL
+  int status;
+  if (p->wide && p->cplx)
+    status = umfpack_zl_solve(UMFPACK_A, p->Ajj, p->Aii, p->Add, p->Adz, x->dd, NULL, b->dd, NULL, p->Numeric, p->Control, NULL);
+  else if (p->wide)
+    status = umfpack_dl_solve(UMFPACK_A, p->Ajj, p->Aii, p->Add, x->dd, b->dd, p->Numeric, p->Control/*X1 NULL*/, NULL);
+  else if (p->cplx)
+    status = umfpack_zi_solve(UMFPACK_A, p->Ajj, p->Aii, p->Add, p->Adz, x->dd, NULL, b->dd, NULL, p->Numeric, p->Control, NULL);
+  else
+    status = umfpack_di_solve(UMFPACK_A, p->Ajj, p->Aii, p->Add, x->dd, b->dd, p->Numeric, p->Control/*X1 NULL*/, NULL);
   if (status != UMFPACK_OK)
     umfpack_di_report_status(NULL, status);
   assert(status == UMFPACK_OK);
@@ -160,7 +225,22 @@ void solver_finalize_umfpack(solver_state_t* s)
   solve_system_umfpack_t* const p = s->specific;
 
   // release memory
-  if (p != NULL) {
+  if (p == NULL) {
+    // nothing to do
+  }
+  else if (p->wide && p->cplx) {
+    umfpack_zl_free_numeric(&(p->Numeric));
+    umfpack_zl_free_symbolic(&(p->Symbolic));
+  }
+  else if (p->wide) {
+    umfpack_dl_free_numeric(&(p->Numeric));
+    umfpack_dl_free_symbolic(&(p->Symbolic));
+  }
+  else if (p->cplx) {
+    umfpack_zi_free_numeric(&(p->Numeric));
+    umfpack_zi_free_symbolic(&(p->Symbolic));
+  }
+  else {
     umfpack_di_free_numeric(&(p->Numeric));
     umfpack_di_free_symbolic(&(p->Symbolic));
   }
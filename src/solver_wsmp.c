@@ -294,6 +294,7 @@ void solver_evaluate_wsmp( solver_state_t* s, matrix_t* b, matrix_t* x ) {
 	x->dd = malloc(x->nz * sizeof( double ));
       }
       x->dd = b->dd;
+      x->owner = b->owner;
       b->dd = NULL;
       clear_matrix(b);
     }
@@ -301,6 +302,10 @@ void solver_evaluate_wsmp( solver_state_t* s, matrix_t* b, matrix_t* x ) {
       // need to copy b since it's destroyed in the process
       clear_matrix(x);
       matrix_t* t = copy_matrix(b);
+      assert(t != NULL); // malloc failure -- TODO proper error code
+      // x->dd may be realloc-ed below, so it has to be malloc-ed (not pooled)
+      int ierr = convert_matrix_ownership(t, MC_OWN_MALLOC);
+      assert(ierr == 0);
       // push copied t contents into x
       *x = *t;
       t->dd = NULL; // transfer dd pointer ownership to x
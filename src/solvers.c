@@ -23,13 +23,50 @@
 #include <stdlib.h>
 
 #include <mpi.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 
 #include "config.h"
 #include "solvers.h"
 #include "perftimer.h"
 #include "matrix.h"
+#include "stats.h"
 #include "solver_lookup.h"
 
+// entries: below this, a solver's threads aren't counted on to pay off
+#define MC_SOLVER_OMP_MIN_NZ (1 << 16)
+
+// pick the data type a solver will be handed: keep 't' if the solver can
+// take it, otherwise change precision (single <-> double) to one it can
+static inline enum matrix_data_type_t _solver_data_type(const unsigned int c, const enum matrix_data_type_t t)
+{
+  switch (t) {
+    case REAL_DOUBLE:
+      return (c & SOLVES_DATA_TYPE_REAL_DOUBLE) ? REAL_DOUBLE : REAL_SINGLE;
+    case REAL_SINGLE:
+      return (c & SOLVES_DATA_TYPE_REAL_SINGLE) ? REAL_SINGLE : REAL_DOUBLE;
+    case COMPLEX_DOUBLE:
+      return (c & SOLVES_DATA_TYPE_COMPLEX_DOUBLE) ? COMPLEX_DOUBLE : COMPLEX_SINGLE;
+    case COMPLEX_SINGLE:
+      return (c & SOLVES_DATA_TYPE_COMPLEX_SINGLE) ? COMPLEX_SINGLE : COMPLEX_DOUBLE;
+    default:
+      return t;
+  }
+}
+
+// is every diagonal entry of A stored? from the flags where they can say, else counted
+static int _diagonal_complete(matrix_t* A)
+{
+  if (!(A->flags & MC_MERGED))
+    detect_matrix_flags(A);
+  if (A->flags & MC_MERGED)
+    return (A->flags & MC_DIAGONAL) != 0;
+  struct matrix_stats_t s;  // unsorted, repeated entries or 64-bit indices
+  return (matrix_stats(A, &s) == 0) && (s.diagonal == A->m);
+}
+
+// returns: non-zero if A can't be converted for this solver
 static inline int _convert_matrix_A(const int solver, matrix_t* A)
 {
   const unsigned int c = solver_lookup[solver].capabilities;
@@ -39,7 +76,9 @@ static inline int _convert_matrix_A(const int solver, matrix_t* A)
       assert(c & SOLVES_UNSYMMETRIC);  // nothing we can do...
       break;
     case SM_SYMMETRIC:
-      if (c & SOLVES_SYMMETRIC) {
+      // a solver that needs the diagonal takes A as unsymmetric without it, if it can (see _can_do)
+      if ((c & SOLVES_SYMMETRIC) &&
+          (!(c & SOLVER_SYM_REQUIRES_DIAGONAL) || !(c & SOLVES_UNSYMMETRIC) || _diagonal_complete(A))) {
         switch (A->location) {
           case MC_STORE_BOTH:
             if (!(c & SOLVES_SYMMETRIC_BOTH)) {
@@ -101,10 +140,17 @@ static inline int _convert_matrix_A(const int solver, matrix_t* A)
       }
       break;
     case SM_SKEW_SYMMETRIC:
-      assert(0);  // TODO
-      break;
     case SM_HERMITIAN:
-      assert(0);  // TODO
+      // TODO no solver is told about these yet, but with both triangles
+      // stored it can be solved as unsymmetric
+      if (c & SOLVES_UNSYMMETRIC) {
+        int ierr = convert_matrix_symmetry(A, MC_STORE_BOTH);  // negated/conjugated mirror
+        assert(ierr == 0);
+        A->sym = SM_UNSYMMETRIC;  // forget we were symmetric
+      }
+      else {
+        assert(0);  // TODO
+      }
       break;
   }
 
@@ -131,8 +177,9 @@ static inline int _convert_matrix_A(const int solver, matrix_t* A)
       break;
     case DROW:
     case DCOL:
-      format = SM_COO;  // set default, then drop through to COO
+      format = SM_COO;  // set default, then on as COO
 //      assert(0); // TODO .. decide if we should be doing this in a sparse format?
+      // fall through
     case SM_COO:
       if (!(c & SOLVES_FORMAT_COO)) {  // can't handle COO format... figure out what to do next
         if (c & SOLVES_FORMAT_CSR) {
@@ -159,6 +206,9 @@ static inline int _convert_matrix_A(const int solver, matrix_t* A)
         }
       }
       break;
+    case SM_BCSR:
+      format = SM_CSR;  // no solver takes blocks: unblock, then on as CSR
+      // fall through
     case SM_CSR:
       if (!(c & SOLVES_FORMAT_CSR)) {  // can't handle COO format... figure out what to do next
         if (c & SOLVES_FORMAT_COO) {
@@ -174,11 +224,53 @@ static inline int _convert_matrix_A(const int solver, matrix_t* A)
       break;
   }
   int ierr = convert_matrix(A, format, base);
-  assert(ierr == 0);
-  return 0;  // TODO return error code
+  if (ierr != 0)
+    return ierr;
+
+  // compressed formats are handed over sorted (UMFPACK requires it): nothing
+  // to do if the flags already say so, else a scan, and a sort only if needed
+  const unsigned int sorted = (format == SM_CSR) ? MC_SORTED_BY_ROW : MC_SORTED_BY_COL;
+  if (((format == SM_CSR) || (format == SM_CSC)) && !(A->flags & sorted) && (A->index_width == MC_INDEX_32)) {
+    ierr = detect_matrix_flags(A);
+    if (ierr != 0)
+      return ierr;
+    if (!(A->flags & sorted)) {  // via COO: the conversion back sorts
+      if (((ierr = convert_matrix(A, SM_COO, base)) != 0) || ((ierr = convert_matrix(A, format, base)) != 0))
+        return ierr;
+    }
+  }
+
+  // index width: use the narrowest that fits (less memory traffic)
+  const enum matrix_index_width_t width = matrix_index_width_required(A);
+  if ((width != MC_INDEX_32) && !(c & SOLVES_INDEX_64))
+    return -1;  // too large for this solver
+  ierr = convert_matrix_index_width(A, width);
+  if (ierr != 0)
+    return ierr;
+
+  // precision: promote/demote if the solver can't take what we loaded
+  // (complex A for a real-only solver fails here)
+  ierr = convert_matrix_data_type(A, _solver_data_type(c, A->data_type));
+  if (ierr != 0)
+    return ierr;
+
+  // complex values stay split ("zomplex") only if the solver takes them that way
+  if (!(c & SOLVES_COMPLEX_SPLIT))
+    return convert_matrix_complex_storage(A, MC_COMPLEX_PAIRED);
+  return 0;
 }
 
-static inline int _convert_matrix_b(const int solver, matrix_t* b)
+// the right-hand side's value type: a real 'b' is widened for a complex 'A'
+static inline enum matrix_data_type_t _rhs_data_type(const unsigned int c, const enum matrix_data_type_t a,
+                                                     const enum matrix_data_type_t b)
+{
+  enum matrix_data_type_t t = b;
+  if (((a == COMPLEX_DOUBLE) || (a == COMPLEX_SINGLE)) && ((b == REAL_DOUBLE) || (b == REAL_SINGLE)))
+    t = (b == REAL_SINGLE) ? COMPLEX_SINGLE : COMPLEX_DOUBLE;
+  return _solver_data_type(c, t);
+}
+
+static inline int _convert_matrix_b(const int solver, matrix_t* b, const enum matrix_data_type_t a)
 {
   const unsigned int c = solver_lookup[solver].capabilities;
   // symmetry: don't convert unless we have to
@@ -291,6 +383,9 @@ static inline int _convert_matrix_b(const int solver, matrix_t* b)
         }
       }
       break;
+    case SM_BCSR:
+      format = SM_CSR;  // no solver takes blocks: unblock, then on as CSR
+      // fall through
     case SM_CSR:
       if (!(c & SOLVES_RHS_CSR)) {
         if (c & SOLVES_RHS_COO) {
@@ -313,12 +408,47 @@ static inline int _convert_matrix_b(const int solver, matrix_t* b)
   }
   ierr = convert_matrix(b, format, base);
   assert(ierr == 0);
+
+  // values: precision and real/complex to suit the solver and 'A' (a),
+  // always paired: the solvers step through b a column at a time
+  ierr = convert_matrix_data_type(b, _rhs_data_type(c, a, b->data_type));
+  assert(ierr == 0);
+  ierr = convert_matrix_complex_storage(b, MC_COMPLEX_PAIRED);
+  assert(ierr == 0);
   return 0;  // TODO return error code
 }
 
+// convert b to suit the solver (and A's values), in place
+// returns: how many times to call the solver, once per column if it only takes vectors
+static inline int _convert_rhs(solver_state_t* s, matrix_t* b)
+{
+  const unsigned int c = solver_lookup[s->solver].capabilities;
+  if ((b->n != 1) && (c & SOLVES_RHS_VECTOR_ONLY)) {
+    // TODO FIXME: also need to handle non-DCOL format (sparse, etc)
+    // Force to single column: We do one column at a time and
+    // monkey with the data pointer. Note that if the solver's
+    // wrapper does data conversion internally and reallocates
+    // memory this method will break! For those solvers, we need to
+    // support their desired format so they can't break this wrapper.
+    // This special consideration is only necessary for
+    // SOLVES_RHS_VECTOR_ONLY solvers.
+    // ensure the RHS is in column major format
+    assert(c & SOLVES_RHS_DCOL);
+    convert_matrix(b, DCOL, FIRST_INDEX_ZERO);
+    int ierr = convert_matrix_data_type(b, _rhs_data_type(c, s->data_type, b->data_type));
+    assert(ierr == 0);
+    ierr = convert_matrix_complex_storage(b, MC_COMPLEX_PAIRED);
+    assert(ierr == 0);
+    return b->n;
+  }
+  _convert_matrix_b(s->solver, b, s->data_type);  // don't need to do anything special
+  return 1;
+}
+
 static inline int _valid_solver(const int solver)
 {
-  return (solver_lookup[solver].shortname != NULL);
+  const int n = sizeof(solver_lookup) / sizeof(solver_lookup[0]) - 1;  // less the null entry
+  return (solver >= 0) && (solver < n) && (solver_lookup[solver].shortname != NULL);
 }
 
 // lookup functions
@@ -377,17 +507,93 @@ void printf_solvers(const unsigned int verbosity)
       // TODO capabilities
     }
   }
+  printf("  auto");
+  for (int j = 4; j < max_shortname_len; j++)
+    printf(" ");
+  printf("    the one of these best suited to the problem (see --history)\n");
 
   free(l);
 }
 
 // --------------------------------------------
+// the processes and threads we have to work with
+static void _resources(int* c_mpi, int* c_omp)
+{
+  int initialized = 0;
+  *c_mpi = 1;
+  if ((MPI_Initialized(&initialized) == MPI_SUCCESS) && initialized)
+    MPI_Comm_size(MPI_COMM_WORLD, c_mpi);
+#ifdef _OPENMP
+  *c_omp = omp_get_max_threads();
+#else
+  *c_omp = 1;
+#endif
+}
+
+// solver_can_do(), given A's statistics (s) and the resources
+static int _can_do(const int solver, matrix_t* A, matrix_t* b, struct matrix_stats_t const* s, const int c_mpi)
+{
+  if (!_valid_solver(solver))
+    return 0;
+  const unsigned int c = solver_lookup[solver].capabilities;
+  const unsigned int mc = solver_lookup[solver].multicore;
+
+  // values: either precision will do, they're converted (see _solver_data_type)
+  const int a_complex = (A->data_type == COMPLEX_DOUBLE) || (A->data_type == COMPLEX_SINGLE);
+  const int b_complex = (b != NULL) && ((b->data_type == COMPLEX_DOUBLE) || (b->data_type == COMPLEX_SINGLE));
+  if ((A->data_type == SM_PATTERN) || ((b != NULL) && (b->data_type == SM_PATTERN)))
+    return 0;
+  if ((a_complex || b_complex) && !(c & (SOLVES_DATA_TYPE_COMPLEX_DOUBLE | SOLVES_DATA_TYPE_COMPLEX_SINGLE)))
+    return 0;
+  if (!a_complex && !b_complex && !(c & (SOLVES_DATA_TYPE_REAL_DOUBLE | SOLVES_DATA_TYPE_REAL_SINGLE)))
+    return 0;
+
+  // shape and symmetry, as _convert_matrix_A handles them
+  if ((c & SOLVES_SQUARE_ONLY) && (A->m != A->n))
+    return 0;
+  switch (A->sym) {
+    case SM_UNSYMMETRIC:
+    case SM_SKEW_SYMMETRIC:
+    case SM_HERMITIAN:
+      if (!(c & SOLVES_UNSYMMETRIC))
+        return 0;
+      break;
+    case SM_SYMMETRIC:
+      if (!(c & (SOLVES_SYMMETRIC | SOLVES_UNSYMMETRIC)))
+        return 0;
+      // without its diagonal, stored as unsymmetric if the solver takes that
+      if ((c & SOLVER_SYM_REQUIRES_DIAGONAL) && !(c & SOLVES_UNSYMMETRIC) && (s->diagonal != A->m))
+        return 0;
+      break;
+  }
+  if ((c & SOLVES_SYMMETRIC_POSITIVE_DEFINITE_ONLY) &&
+      ((A->sym != SM_SYMMETRIC) || (matrix_stats_definite(s) < 0)))
+    return 0;
+  if ((matrix_index_width_required(A) != MC_INDEX_32) && !(c & SOLVES_INDEX_64))
+    return 0;
+
+  // right-hand side: several columns are solved one by one, from DCOL
+  if ((b != NULL) && (b->m != A->m))
+    return 0;
+  if ((b != NULL) && (b->n != 1) && (c & SOLVES_RHS_VECTOR_ONLY) && !(c & SOLVES_RHS_DCOL))
+    return 0;
+
+  // resources: launched with several processes, a solver has to take them
+  if ((c_mpi > 1) && !(mc & (SOLVER_CAN_USE_MPI | SOLVER_REQUIRES_MPI)))
+    return 0;
+  return 1;
+}
+
 // can the preferred solver solve this problem?
 //   e.g. can the solver only handle Symmetric Positive Definite (SPD) matrices
 // returns: 1 yes, 0 no
-int solver_can_do(const int solver, matrix_t* A, matrix_t* b)
+int solver_can_do(const int solver, matrix_t* A, matrix_t* b, struct matrix_stats_t const* s)
 {
-  return 1;  // TODO something more clever, like a real answer
+  assert(A != NULL);
+  assert(s != NULL);
+  int c_mpi, c_omp;
+  _resources(&c_mpi, &c_omp);
+  return _can_do(solver, A, b, s, c_mpi);
 }
 
 inline int solver_uses_mpi(const int solver)
@@ -410,20 +616,119 @@ inline int solver_requires_omp(const int solver)
   return ((solver_lookup[solver].multicore & SOLVER_REQUIRES_OMP) != 0);
 }
 
+// past timings: the fastest estimate for each solver from the records of
+// similar problems (same symmetry and resources, rows and entries within a
+// factor of two), scaled by the number of entries; negative where there are none
+// returns: non-zero if the history can't be read
+static int _history_estimates(const char* history, struct matrix_stats_t const* s, const int c_mpi, const int c_omp,
+                              double* estimate, const int n)
+{
+  for (int i = 0; i < n; i++)
+    estimate[i] = -1.0;
+  FILE* f = fopen(history, "r");
+  if (f == NULL)
+    return 1;
+  char line[256];
+  while (fgets(line, sizeof(line), f) != NULL) {
+    char name[SOLVER_SHORTNAME_MAX_LEN + 1];
+    size_t m, nz;
+    int sym, p, t;
+    double seconds;
+    if ((line[0] == '#') ||
+        (sscanf(line, "%15s %zu %zu %d %d %d %lf", name, &m, &nz, &sym, &p, &t, &seconds) != 7))
+      continue;  // comment, or not a record
+    const int i = lookup_solver_by_shortname(name);
+    if ((i < 0) || (i >= n) || (sym != s->sym) || (p != c_mpi) || (t != c_omp) || (nz == 0) || (seconds < 0.0))
+      continue;
+    if ((2 * m < s->m) || (m > 2 * s->m) || (2 * nz < s->nz) || (nz > 2 * s->nz))
+      continue;
+    const double e = seconds * s->nz / nz;
+    if ((estimate[i] < 0.0) || (e < estimate[i]))
+      estimate[i] = e;
+  }
+  fclose(f);
+  return 0;
+}
+
+// without a history: a higher rank for the solver more likely to be fast
+static int _rank(const int solver, struct matrix_stats_t const* s, const int c_mpi, const int c_omp)
+{
+  const unsigned int c = solver_lookup[solver].capabilities;
+  const unsigned int mc = solver_lookup[solver].multicore;
+  int r = 0;
+  if (c & SOLVES_SYMMETRIC_POSITIVE_DEFINITE_ONLY)
+    r += (matrix_stats_definite(s) > 0) ? 4 : -4;  // Cholesky: half the work of LU, if it doesn't break down
+  if ((s->sym != SM_UNSYMMETRIC) && (c & SOLVES_SYMMETRIC))
+    r += 2;  // one triangle is factored
+  if ((c_mpi > 1) && (mc & (SOLVER_CAN_USE_MPI | SOLVER_REQUIRES_MPI)))
+    r += 2;
+  else if ((c_mpi == 1) && (mc & SOLVER_REQUIRES_MPI))
+    r -= 1;  // the communication costs, with nothing to share the work with
+  if ((c_omp > 1) && (mc & (SOLVER_CAN_USE_OMP | SOLVER_REQUIRES_OMP)) && (s->nz >= MC_SOLVER_OMP_MIN_NZ))
+    r += 1;
+  return r;
+}
+
 // select the most appropriate solver for this problem
 //  - is it small and thus should be solved single-threaded (single processor)
 //  - is it moderate and should be solved SMP (shared memory)
 //  - is it huge and should be solved MPI (distributed memory)
-int select_solver(matrix_t* A, matrix_t* b)
+int select_solver(matrix_t* A, matrix_t* b, struct matrix_stats_t const* s, const char* history)
 {
-  return 0;  // TODO something clever
+  assert(A != NULL);
+  assert(s != NULL);
+  int c_mpi, c_omp;
+  _resources(&c_mpi, &c_omp);
+
+  int n = 0;
+  while (solver_lookup[n].shortname != NULL)
+    n++;
+  double* const estimate = malloc((n + 1) * sizeof(double));
+  assert(estimate != NULL);  // malloc failure
+  if (history != NULL)
+    _history_estimates(history, s, c_mpi, c_omp, estimate, n);  // an unreadable history is no history
+  else
+    for (int i = 0; i < n; i++)
+      estimate[i] = -1.0;
+
+  // measured beats ranked; ties go to the first in the lookup
+  int best = -1;
+  for (int i = 0; i < n; i++) {
+    if (!_can_do(i, A, b, s, c_mpi))
+      continue;
+    if (best < 0)
+      best = i;
+    else if (estimate[i] >= 0.0)
+      best = ((estimate[best] < 0.0) || (estimate[i] < estimate[best])) ? i : best;
+    else if ((estimate[best] < 0.0) && (_rank(i, s, c_mpi, c_omp) > _rank(best, s, c_mpi, c_omp)))
+      best = i;
+  }
+  free(estimate);
+  return best;
+}
+
+int solver_history_append(const char* history, const int solver, struct matrix_stats_t const* s, const double seconds)
+{
+  assert(history != NULL);
+  assert(s != NULL);
+  if (!_valid_solver(solver))
+    return -1;
+  int c_mpi, c_omp;
+  _resources(&c_mpi, &c_omp);
+  FILE* f = fopen(history, "a");
+  if (f == NULL)
+    return -1;
+  if (ftell(f) == 0)
+    fprintf(f, "# solver, rows, entries, symmetry, processes, threads, seconds per solve\n");
+  fprintf(f, "%s %zu %zu %d %d %d %lg\n", solver_lookup[solver].shortname, s->m, s->nz, s->sym, c_mpi, c_omp, seconds);
+  return (fclose(f) == 0) ? 0 : -1;
 }
 
 // --------------------------------------------
 // wrapper function: solve 'A x = b' for 'x'
 // calls initialize, analyze, factorize, evaluate, finalize
 // returns x, the solution
-void solver(const int solver, const int verbosity, const int mpi_rank, matrix_t* A, matrix_t* b, matrix_t* x)
+void solver(const int solver, const int verbosity, const int mpi_rank, matrix_t const* A, matrix_t* b, matrix_t* x)
 {
   solver_state_t* s = solver_init(solver, verbosity, mpi_rank, NULL);
   assert(s != NULL);  // malloc failure
@@ -437,7 +742,7 @@ void solver(const int solver, const int verbosity, const int mpi_rank, matrix_t*
 // calls analyze, factorize, evaluate
 // must call initialize before and finalize after when all done
 // returns x, the solution
-void solver_solve(solver_state_t* s, matrix_t* A, matrix_t* b, matrix_t* x)
+void solver_solve(solver_state_t* s, matrix_t const* A, matrix_t* b, matrix_t* x)
 {
   solver_analyze(s, A);
   solver_factorize(s, A);
@@ -457,6 +762,9 @@ solver_state_t* solver_init(const int solver, const int verbosity, const int mpi
   s->mpi_rank = mpi_rank;
   s->timer = timer;
   s->specific = NULL;
+  s->data_type = REAL_DOUBLE;
+  s->A = NULL;
+  s->A_src = ( matrix_t ) { 0 };
   if (_valid_solver(solver) && (solver_lookup[solver].init != NULL))
     solver_lookup[solver].init(s);
 
@@ -474,37 +782,98 @@ void solver_finalize(solver_state_t* s)
   // make sure it won't get deallocated twice by mistake
   s->specific = NULL;
 
+  // after the solver is done with it: releases only what the conversions copied
+  free_matrix(s->A);
+  s->A = NULL;
+
   free(s);
 }
 
+// is the view still of this A? (the same arrays, shape and layout)
+static inline int _view_is_of(solver_state_t const* s, matrix_t const* A)
+{
+  matrix_t const* const v = &(s->A_src);
+  return (s->A != NULL) &&
+         (v->dd == A->dd) && (v->ii == A->ii) && (v->jj == A->jj) && (v->ii64 == A->ii64) && (v->jj64 == A->jj64) &&
+         (v->m == A->m) && (v->n == A->n) && (v->nz == A->nz) && (v->base == A->base) && (v->format == A->format) &&
+         (v->sym == A->sym) && (v->location == A->location) && (v->data_type == A->data_type) &&
+         (v->index_width == A->index_width) && (v->complex_storage == A->complex_storage);
+}
+
+// the solver's view of A, made on first use and then reused
+// The view starts as a shallow copy that borrows A's arrays: the conversions
+// copy whatever they change (copy-on-write) so A is never modified, and
+// anything left as it was stays shared with A.
+// returns: NULL if A can't be converted for the solver
+static matrix_t* _view_matrix_A(solver_state_t* s, matrix_t const* A)
+{
+  if (_view_is_of(s, A))
+    return s->A;  // already converted
+
+  perftimer_inc(s->timer, "convert", -1);
+  free_matrix(s->A);
+  s->A = malloc_matrix();
+  assert(s->A != NULL);  // malloc failure
+  *(s->A) = *A;  // shallow copy
+  s->A->owner = MC_OWN_BORROWED;
+  s->A_src = *A;
+  if (_convert_matrix_A(s->solver, s->A) != 0) {
+    fprintf(stderr, "error: failed to convert A for the %s solver\n", solver2str(s->solver));
+    free_matrix(s->A);
+    s->A = NULL;
+    return NULL;
+  }
+  s->data_type = s->A->data_type;  // the right-hand side is matched to this
+  return s->A;
+}
+
+int solver_prepare(solver_state_t* s, matrix_t const* A, matrix_t* b)
+{
+  assert(s != NULL);
+  if (s->mpi_rank != 0)
+    return 0;  // only rank 0 holds the matrices
+  assert(A != NULL);
+  if (_view_matrix_A(s, A) == NULL)
+    return 1;
+  if (b != NULL)
+    _convert_rhs(s, b);
+  return 0;
+}
+
 // evaluate the patterns in A, doesn't care about the actual values in the matrix (A->dd)
-void solver_analyze(solver_state_t* s, matrix_t* A)
+void solver_analyze(solver_state_t* s, matrix_t const* A)
 {
   assert(s != NULL);
   const int solver = s->solver;
+  matrix_t* AA = NULL;
   if (s->mpi_rank == 0) {
     assert(A != NULL);
-    _convert_matrix_A(solver, A);
+    AA = _view_matrix_A(s, A);
+    if (AA == NULL)
+      return;  // reported
   }
   perftimer_inc(s->timer, "analyze", -1);
 
   if (_valid_solver(solver) && (solver_lookup[solver].analyze != NULL)) {
-    solver_lookup[solver].analyze(s, A);
+    solver_lookup[solver].analyze(s, AA);
   }
 }
 
 // factorize the matrix A, A must have the same pattern of non-zeros at that used in the solver_analyze stage
-void solver_factorize(solver_state_t* s, matrix_t* A)
+void solver_factorize(solver_state_t* s, matrix_t const* A)
 {
   assert(s != NULL);
   const int solver = s->solver;
+  matrix_t* AA = NULL;
   if (s->mpi_rank == 0) {
     assert(A != NULL);
-    _convert_matrix_A(solver, A);
+    AA = _view_matrix_A(s, A);
+    if (AA == NULL)
+      return;  // reported
   }
   perftimer_inc(s->timer, "factorize", -1);
   if (_valid_solver(solver) && (solver_lookup[solver].factorize != NULL)) {
-    solver_lookup[solver].factorize(s, A);
+    solver_lookup[solver].factorize(s, AA);
   }
 }
 
@@ -514,7 +883,6 @@ void solver_evaluate(solver_state_t* s, matrix_t* b, matrix_t* x)
 {
   assert(s != NULL);
   const int solver = s->solver;
-  const unsigned int c = solver_lookup[solver].capabilities;
 
   // decide if we need to use MPI
   int is_mpi;
@@ -527,27 +895,12 @@ void solver_evaluate(solver_state_t* s, matrix_t* b, matrix_t* x)
     assert(b != NULL);
     assert(x != NULL);
 
-    if ((b->n != 1) && (c & SOLVES_RHS_VECTOR_ONLY)) {
-      // TODO FIXME: also need to handle non-DCOL format (sparse, etc)
-      // Force to single column: We do one column at a time and
-      // monkey with the data pointer. Note that if the solver's
-      // wrapper does data conversion internally and reallocates
-      // memory this method will break! For those solvers, we need to
-      // support their desired format so they can't break this wrapper.
-      // This special consideration is only necessary for
-      // SOLVES_RHS_VECTOR_ONLY solvers.
-      // ensure the RHS is in column major format
-      assert(c & SOLVES_RHS_DCOL);
-      convert_matrix(b, DCOL, FIRST_INDEX_ZERO);
-      bb = *b;  // shallow copy
+    // (a no-op if solver_prepare has already done this)
+    loops = _convert_rhs(s, b);
+    bb = *b;  // shallow copy
+    bb.owner = MC_OWN_BORROWED;  // b's arrays: never released through bb, a solver converting bb gets its own copy
+    if (loops > 1)
       bb.n = 1;  // pretend this right-hand side is only one column
-      loops = b->n;
-    }
-    else {  // don't need to do anything special
-      _convert_matrix_b(s->solver, b);
-      bb = *b;  // shallow copy
-      loops = 1;
-    }
   }
 
   // share with all nodes, how many loops do we need to do when we can't handle more than a vector RHS
@@ -582,14 +935,15 @@ void solver_evaluate(solver_state_t* s, matrix_t* b, matrix_t* x)
           // for the next loop, advance by a column
           assert((bb.format == DCOL) || (bb.format == DROW));
           assert(bb.n == 1);
+          assert(bb.owner == MC_OWN_BORROWED);  // still pointing into b (see above)
           convert_matrix(&bb, DCOL, FIRST_INDEX_ZERO);
           // as a short-circuit conversion DROW->DCOL, this doesn't
           // actually replace the memory pointers, so we're safe to
           // continue with the monkey-ing with pointers (it converts
           // to the correct index-ing and changes from DROW -> DCOL)
 
-          double* dd = bb.dd;
-          dd += bb.m;  // advance by a column
+          char* dd = bb.dd;
+          dd += bb.m * _data_width(bb.data_type);  // advance by a column
           bb.dd = dd;
         }
 
@@ -605,15 +959,20 @@ void solver_evaluate(solver_state_t* s, matrix_t* b, matrix_t* x)
           convert_matrix(&xx, DCOL, FIRST_INDEX_ZERO);
 
           // resize to capture another column
-          x->dd = realloc(x->dd, (x->m * (x->n + xx.n)) * sizeof(double));
+          const size_t w = _data_width(x->data_type);
+          assert(xx.data_type == x->data_type);
+          assert(x->owner == MC_OWN_MALLOC);  // solvers malloc their results
+          x->dd = realloc(x->dd, (x->m * (x->n + xx.n)) * w);
           assert(x->dd != NULL);  // realloc failure
           // and copy the data into the newly resized buffer
-          memcpy(x->dd + (x->m * x->n) * sizeof(double), xx.dd, x->m * xx.n * sizeof(double));
+          memcpy((char*) x->dd + (x->m * x->n) * w, xx.dd, x->m * xx.n * w);
           x->n += xx.n;  // increment the column count
         }
         clear_matrix(&xx);  // free any memory we accumulated from the solver
       }
     }
+    if ((s->mpi_rank == 0) && (bb.owner != MC_OWN_BORROWED))
+      clear_matrix(&bb);  // the solver converted bb: release its copy
   }
   else {
     clear_matrix(x);
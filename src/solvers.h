@@ -22,6 +22,7 @@
 #include "config.h"
 #include "perftimer.h"
 #include "matrix.h"
+#include "stats.h"
 
 // TODO solve different types of systems (CHOLMOD)
 // #define CHOLMOD_A    0          /* solve Ax=b */
@@ -35,7 +36,8 @@
 // #define CHOLMOD_Pt   8          /* permute x=P'x */
 
 
-// TODO add option to preserve A or allow it to be destroyed? (need solver_lookup.h flag to indicate if copy is necessary?)
+// A is preserved: the solvers work on a view of it, converted to suit them
+// (see solver_prepare), that is made once and reused by later solves
 // TODO options for preserving x or allow them to be destroyed in the process?
 // if ptr x == b, then x can be destroyed (need flag in solver_lookup to tell whether copying is necessary?)
 // TODO for now, assume a copy is required and don't count this cost in the timing
@@ -48,6 +50,9 @@ typedef struct {
   int                verbosity;
   perftimer_t*       timer;
   void*              specific; // further solver-specific state
+  enum matrix_data_type_t data_type; // A's values (rank 0, set with the view of A)
+  matrix_t*          A;        // the view: A as this solver takes it (rank 0)
+  matrix_t           A_src;    // shallow snapshot of the A the view was made from
 } solver_state_t;
 
 
@@ -60,8 +65,9 @@ void printf_solvers( const unsigned int verbosity );
 // --------------------------------------------
 // can the preferred solver solve this problem?
 //   e.g. can the solver only handle Symmetric Postive Definite (SPD) matrices
+// s: A's statistics (see matrix_stats())
 // returns: 1 yes, 0 no
-int solver_can_do( const int solver, matrix_t* A, matrix_t* b );
+int solver_can_do( const int solver, matrix_t* A, matrix_t* b, struct matrix_stats_t const* s );
 /*inline*/ int solver_uses_mpi( const int solver );
 /*inline*/ int solver_requires_mpi( const int solver );
 /*inline*/ int solver_uses_omp( const int solver );
@@ -72,30 +78,54 @@ int solver_can_do( const int solver, matrix_t* A, matrix_t* b );
 //  - is it small and thus should be solved single-threaded (single processor)
 //  - is it moderate and should be solved SMP (shared memory)
 //  - is it huge and should be solved MPI (distributed memory)
-int select_solver( matrix_t* A, matrix_t* b );
+// from the solvers that can do it (solver_can_do) on the processes and
+// threads we have: the fastest for similar problems in the history file if
+// there are any records of them, else ranked on A's structure (see
+// matrix_stats()): Cholesky if A is surely positive definite, solvers that
+// take one triangle of a symmetric A, and parallel solvers when there's
+// something to share the work with
+// s: A's statistics (see matrix_stats())
+// history: past timings (see solver_history_append()), may be NULL or missing
+// returns: the solver, or -1 if none can solve it
+#define SOLVER_AUTO (-2) // args: select_solver() picks one once A is loaded
+int select_solver( matrix_t* A, matrix_t* b, struct matrix_stats_t const* s, const char* history );
+// add a timing to the history: one line per solve, plain text
+// ("shortname rows entries symmetry processes threads seconds")
+// s: the statistics of the A that was solved
+// returns: non-zero on failure
+int solver_history_append( const char* history, const int solver, struct matrix_stats_t const* s, const double seconds );
 
 // --------------------------------------------
 // wrapper function: solve 'A x = b' for 'x'
 // calls initialize, analyze, factorize, evaluate, finalize
 // returns x, the solution
 // TODO cleaner way of passing in MPI info, if required?
-void solver( const int solver, const int verbosity, const int mpi_rank, matrix_t* A, matrix_t* b, matrix_t* x );
+void solver( const int solver, const int verbosity, const int mpi_rank, matrix_t const* A, matrix_t* b, matrix_t* x );
 
 // wrapper function: solve 'A x = b' for 'x' w/o re-initializing solver
 // calls analyze, factorize, evaluate
 // must call initialize before and finalize after when all done
 // returns x, the solution
-void solver_solve( solver_state_t* state, matrix_t* A, matrix_t* b, matrix_t* x );
+void solver_solve( solver_state_t* state, matrix_t const* A, matrix_t* b, matrix_t* x );
 
 // --------------------------------------------
 // initialize and finalize the solver state
 solver_state_t* solver_init( const int solver, const int verbosity, const int mpi_rank, perftimer_t* timer );
 void solver_finalize( solver_state_t* p );
 
+// convert A and b to the forms the solver takes, ahead of the solves
+// A is left as it is: the converted view is cached in the solver state and
+// used by analyze/factorize for as long as they are given the same
+// (unchanged) A, so repeated solves don't pay for the conversion again;
+// b is converted in place (as solver_evaluate would), b may be NULL
+// the conversion is timed as "convert"
+// returns: non-zero if A can't be converted for the solver
+int solver_prepare( solver_state_t* p, matrix_t const* A, matrix_t* b );
+
 // evaluate the patterns in A, doesn't care about the actual values in the matrix (A->dd)
-void solver_analyze( solver_state_t* p, matrix_t* A );
+void solver_analyze( solver_state_t* p, matrix_t const* A );
 // factorize the matrix A, A must have the same pattern of non-zeros at that used in the solver_analyze stage
-void solver_factorize( solver_state_t* p, matrix_t* A );
+void solver_factorize( solver_state_t* p, matrix_t const* A );
 // solve the matrix 'A' for right-hand side 'b'
 // returns 'x', the solution
 void solver_evaluate( solver_state_t* p, matrix_t* b, matrix_t* x );
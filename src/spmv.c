@@ -0,0 +1,676 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <string.h>
+#include <complex.h>
+#include <assert.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "spmv.h"
+
+// x86-64 SIMD kernels are compiled for their instruction set by attribute,
+// so the rest of the build needs no special flags; which one runs is decided
+// from the CPU at run time
+#if ( defined( __GNUC__ ) || defined( __clang__ ) ) && defined( __x86_64__ )
+#define MC_SPMV_X86
+#include <immintrin.h>
+#endif
+
+// the BCSR loops over a block are unrolled for the common block sizes, so
+// the row sums stay in registers
+#if defined( __GNUC__ ) || defined( __clang__ )
+#define MC_SPMV_UNROLL _Pragma( "GCC unroll 8" )
+#else
+#define MC_SPMV_UNROLL
+#endif
+
+#define MC_SPMV_OMP_MIN_WORK ( 1 << 16 ) // entries x right-hand sides: below this, one thread
+
+// where entry (i, c) of a dense x or y is: i*rs + c*cs
+typedef struct {
+  size_t rs;
+  size_t cs;
+} spmv_layout_t;
+
+// sum of dd[i] * x[idx[i] - b], i < len (x is contiguous)
+typedef double ( *spmv_dot_t )( double const* dd, unsigned int const* idx, const size_t len, double const* x, const unsigned int b );
+
+// one product, as seen by the kernels
+typedef struct {
+  matrix_t const* A;
+  void const* x;
+  void* y;
+  spmv_layout_t xl;
+  spmv_layout_t yl;
+  size_t k; // right-hand sides
+  double alpha;
+  double beta;
+  int half; // one triangle stored: mirror the off-diagonal entries
+  spmv_dot_t dot; // the real dot product kernel for this product
+} spmv_args_t;
+
+static enum spmv_kernel_t _kernel = SPMV_AUTO;
+static spmv_dot_t _dot = NULL;
+
+static double _dot_scalar( double const* dd, unsigned int const* idx, const size_t len, double const* x, const unsigned int b ) {
+  double s = 0.0;
+  for ( size_t i = 0; i < len; i++ )
+    s += dd[i] * x[idx[i] - b];
+  return s;
+}
+
+#ifdef MC_SPMV_X86
+// four entries per gather, two independent sums to cover the FMA latency
+__attribute__(( target( "avx2,fma" ) ) )
+static double _dot_avx2( double const* dd, unsigned int const* idx, const size_t len, double const* x, const unsigned int b ) {
+  const __m128i vb = _mm_set1_epi32(( int ) b );
+  __m256d s0 = _mm256_setzero_pd();
+  __m256d s1 = _mm256_setzero_pd();
+  size_t i = 0;
+  for ( ; i + 8 <= len; i += 8 ) {
+    const __m128i i0 = _mm_sub_epi32( _mm_loadu_si128(( __m128i const* )( idx + i ) ), vb );
+    const __m128i i1 = _mm_sub_epi32( _mm_loadu_si128(( __m128i const* )( idx + i + 4 ) ), vb );
+    s0 = _mm256_fmadd_pd( _mm256_loadu_pd( dd + i ), _mm256_i32gather_pd( x, i0, 8 ), s0 );
+    s1 = _mm256_fmadd_pd( _mm256_loadu_pd( dd + i + 4 ), _mm256_i32gather_pd( x, i1, 8 ), s1 );
+  }
+  if ( i + 4 <= len ) {
+    const __m128i i0 = _mm_sub_epi32( _mm_loadu_si128(( __m128i const* )( idx + i ) ), vb );
+    s0 = _mm256_fmadd_pd( _mm256_loadu_pd( dd + i ), _mm256_i32gather_pd( x, i0, 8 ), s0 );
+    i += 4;
+  }
+  s0 = _mm256_add_pd( s0, s1 );
+  const __m128d h = _mm_add_pd( _mm256_castpd256_pd128( s0 ), _mm256_extractf128_pd( s0, 1 ) );
+  double s = _mm_cvtsd_f64( _mm_add_sd( h, _mm_unpackhi_pd( h, h ) ) );
+  for ( ; i < len; i++ )
+    s += dd[i] * x[idx[i] - b];
+  return s;
+}
+
+// eight entries per gather
+__attribute__(( target( "avx512f" ) ) )
+static double _dot_avx512( double const* dd, unsigned int const* idx, const size_t len, double const* x, const unsigned int b ) {
+  const __m256i vb = _mm256_set1_epi32(( int ) b );
+  __m512d s0 = _mm512_setzero_pd();
+  size_t i = 0;
+  for ( ; i + 8 <= len; i += 8 ) {
+    const __m256i i0 = _mm256_sub_epi32( _mm256_loadu_si256(( __m256i const* )( idx + i ) ), vb );
+    s0 = _mm512_fmadd_pd( _mm512_loadu_pd( dd + i ), _mm512_i32gather_pd( i0, x, 8 ), s0 );
+  }
+  double s = _mm512_reduce_add_pd( s0 );
+  for ( ; i < len; i++ )
+    s += dd[i] * x[idx[i] - b];
+  return s;
+}
+#endif
+
+static int _cpu_has( const enum spmv_kernel_t k ) {
+  switch ( k ) {
+    case SPMV_SCALAR:
+      return 1;
+#ifdef MC_SPMV_X86
+    case SPMV_AVX2:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" );
+    case SPMV_AVX512:
+      __builtin_cpu_init();
+      return __builtin_cpu_supports( "avx512f" );
+#endif
+    default:
+      return 0;
+  }
+}
+
+int spmv_set_kernel( enum spmv_kernel_t k ) {
+  if ( k == SPMV_AUTO )
+    k = _cpu_has( SPMV_AVX512 ) ? SPMV_AVX512 : ( _cpu_has( SPMV_AVX2 ) ? SPMV_AVX2 : SPMV_SCALAR );
+  if ( !_cpu_has( k ) )
+    return -1;
+  switch ( k ) {
+#ifdef MC_SPMV_X86
+    case SPMV_AVX2:
+      _dot = _dot_avx2;
+      break;
+    case SPMV_AVX512:
+      _dot = _dot_avx512;
+      break;
+#endif
+    default:
+      _dot = _dot_scalar;
+      break;
+  }
+  _kernel = k;
+  return 0;
+}
+
+enum spmv_kernel_t spmv_kernel() {
+  if ( _dot == NULL )
+    spmv_set_kernel( SPMV_AUTO );
+  return _kernel;
+}
+
+char const* spmv_kernel_name( const enum spmv_kernel_t k ) {
+  switch ( k ) {
+    case SPMV_AUTO:
+      return "auto";
+    case SPMV_SCALAR:
+      return "scalar";
+    case SPMV_AVX2:
+      return "avx2";
+    case SPMV_AVX512:
+      return "avx512";
+  }
+  return "unknown";
+}
+
+// a(j,i) from a(i,j), when only one triangle is stored
+static inline double _mirror_real( const double v, const enum matrix_symmetry_t s ) {
+  return ( s == SM_SKEW_SYMMETRIC ) ? -v : v;
+}
+static inline double complex _mirror_complex( const double complex v, const enum matrix_symmetry_t s ) {
+  return ( s == SM_SKEW_SYMMETRIC ) ? -v : (( s == SM_HERMITIAN ) ? conj( v ) : v );
+}
+
+// the kernels, for real (double) and complex (double complex) values:
+//
+// _csr_rows: y = alpha*A*x + beta*y for rows [r0, r1) of a CSR matrix,
+//   one dot product per row and right-hand side (DOT: p->dot for real
+//   values, a SIMD kernel when x is contiguous)
+// _bcsr_rows: the same for block rows [r0, r1) of a BCSR matrix: the block
+//   row's bs sums stay in registers and each block's column index is loaded
+//   once; the common block sizes get their own copy of the loop, with bs a
+//   constant so it unrolls
+// _scatter: y += alpha*A*x for the entries in [r0, r1) of A's major
+//   dimension (COO: entries, CSR: rows, CSC: columns, BCSR: block rows)
+#define MC_SPMV_KERNELS( T, S, DOT, MIRROR ) \
+static void _csr_rows_##S( spmv_args_t const* p, const size_t r0, const size_t r1 ) { \
+  matrix_t const* const A = p->A; \
+  unsigned int const* const ptr = A->ii; \
+  unsigned int const* const idx = A->jj; \
+  T const* const dd = A->dd; \
+  const unsigned int b = A->base; \
+  for ( size_t c = 0; c < p->k; c++ ) { \
+    T const* const x = ( T const* ) p->x + c * p->xl.cs; \
+    T* const y = ( T* ) p->y + c * p->yl.cs; \
+    for ( size_t r = r0; r < r1; r++ ) { \
+      const size_t k0 = ptr[r] - b; \
+      const size_t k1 = ptr[r + 1] - b; \
+      T s = 0; \
+      if ( p->xl.rs == 1 ) \
+        s = DOT( dd + k0, idx + k0, k1 - k0, x, b ); \
+      else \
+        for ( size_t i = k0; i < k1; i++ ) \
+          s += dd[i] * x[( idx[i] - b ) * p->xl.rs]; \
+      T* const yr = y + r * p->yl.rs; \
+      *yr = ( p->beta == 0.0 ) ? p->alpha * s : p->alpha * s + p->beta * *yr; \
+    } \
+  } \
+} \
+\
+static inline void _bcsr_block_row_##S( spmv_args_t const* p, const size_t ib, const size_t bs ) { \
+  matrix_t const* const A = p->A; \
+  const unsigned int b = A->base; \
+  const size_t q0 = A->ii[ib] - b; \
+  const size_t q1 = A->ii[ib + 1] - b; \
+  const size_t xs = p->xl.rs; \
+  for ( size_t c = 0; c < p->k; c++ ) { \
+    T const* const x = ( T const* ) p->x + c * p->xl.cs; \
+    T* const y = ( T* ) p->y + c * p->yl.cs; \
+    T s[MC_BLOCK_SIZE_MAX] = { 0 }; \
+    T xb[MC_BLOCK_SIZE_MAX] = { 0 }; \
+    T const* blk = ( T const* ) A->dd + q0 * bs * bs; \
+    for ( size_t q = q0; q < q1; q++, blk += bs * bs ) { \
+      const size_t j0 = ( A->jj[q] - b ) * bs; \
+      const size_t nc = ( j0 + bs <= A->n ) ? bs : A->n - j0; /* overhangs the last column? */ \
+      MC_SPMV_UNROLL \
+      for ( size_t cc = 0; cc < nc; cc++ ) \
+        xb[cc] = x[( j0 + cc ) * xs]; \
+      MC_SPMV_UNROLL \
+      for ( size_t rr = 0; rr < bs; rr++ ) { \
+        MC_SPMV_UNROLL \
+        for ( size_t cc = 0; cc < bs; cc++ ) \
+          s[rr] += blk[rr * bs + cc] * xb[cc]; \
+      } \
+    } \
+    for ( size_t rr = 0; ( rr < bs ) && ( ib * bs + rr < A->m ); rr++ ) { \
+      T* const yr = y + ( ib * bs + rr ) * p->yl.rs; \
+      *yr = ( p->beta == 0.0 ) ? p->alpha * s[rr] : p->alpha * s[rr] + p->beta * *yr; \
+    } \
+  } \
+} \
+\
+static void _bcsr_rows_##S( spmv_args_t const* p, const size_t r0, const size_t r1 ) { \
+  const size_t bs = p->A->block_size; \
+  assert( bs <= MC_BLOCK_SIZE_MAX ); \
+  for ( size_t ib = r0; ib < r1; ib++ ) { \
+    switch ( bs ) { \
+      case 2: \
+        _bcsr_block_row_##S( p, ib, 2 ); \
+        break; \
+      case 3: \
+        _bcsr_block_row_##S( p, ib, 3 ); \
+        break; \
+      case 4: \
+        _bcsr_block_row_##S( p, ib, 4 ); \
+        break; \
+      case 6: \
+        _bcsr_block_row_##S( p, ib, 6 ); \
+        break; \
+      default: \
+        _bcsr_block_row_##S( p, ib, bs ); \
+        break; \
+    } \
+  } \
+} \
+\
+static void _scatter_##S( spmv_args_t const* p, const size_t r0, const size_t r1 ) { \
+  matrix_t const* const A = p->A; \
+  T const* const dd = A->dd; \
+  const unsigned int b = A->base; \
+  const size_t bs = A->block_size; \
+  for ( size_t c = 0; c < p->k; c++ ) { \
+    T const* const x = ( T const* ) p->x + c * p->xl.cs; \
+    T* const y = ( T* ) p->y + c * p->yl.cs; \
+    size_t i, j; \
+    T v; \
+    switch ( A->format ) { \
+      case SM_COO: \
+        for ( size_t e = r0; e < r1; e++ ) { \
+          i = A->ii[e] - b; \
+          j = A->jj[e] - b; \
+          v = dd[e]; \
+          MC_SPMV_SCATTER( MIRROR ); \
+        } \
+        break; \
+      case SM_CSR: \
+        for ( i = r0; i < r1; i++ ) \
+          for ( size_t e = A->ii[i] - b; e < A->ii[i + 1] - b; e++ ) { \
+            j = A->jj[e] - b; \
+            v = dd[e]; \
+            MC_SPMV_SCATTER( MIRROR ); \
+          } \
+        break; \
+      case SM_CSC: \
+        for ( j = r0; j < r1; j++ ) \
+          for ( size_t e = A->jj[j] - b; e < A->jj[j + 1] - b; e++ ) { \
+            i = A->ii[e] - b; \
+            v = dd[e]; \
+            MC_SPMV_SCATTER( MIRROR ); \
+          } \
+        break; \
+      case SM_BCSR: \
+        for ( size_t ib = r0; ib < r1; ib++ ) \
+          for ( size_t q = A->ii[ib] - b; q < A->ii[ib + 1] - b; q++ ) \
+            for ( size_t e = 0; e < bs * bs; e++ ) { \
+              i = ib * bs + e / bs; \
+              j = ( A->jj[q] - b ) * bs + e % bs; \
+              v = dd[q * bs * bs + e]; \
+              if (( i < A->m ) && ( j < A->n ) && ( v != 0 ) ) \
+                MC_SPMV_SCATTER( MIRROR ); \
+            } \
+        break; \
+      default: \
+        assert( 0 ); \
+    } \
+  } \
+}
+// one entry a(i,j)=v: y(i) += alpha*v*x(j), then a(j,i) if one triangle is stored
+#define MC_SPMV_SCATTER( MIRROR ) do { \
+    y[i * p->yl.rs] += p->alpha * v * x[j * p->xl.rs]; \
+    if ( p->half && ( i != j ) ) \
+      y[j * p->yl.rs] += p->alpha * MIRROR( v, A->sym ) * x[i * p->xl.rs]; \
+  } while ( 0 )
+
+// complex dot products are always scalar
+static inline double complex _dot_complex( double complex const* dd, unsigned int const* idx, const size_t len,
+    double complex const* x, const unsigned int b ) {
+  double complex s = 0;
+  for ( size_t i = 0; i < len; i++ )
+    s += dd[i] * x[idx[i] - b];
+  return s;
+}
+
+MC_SPMV_KERNELS( double, real, p->dot, _mirror_real )
+MC_SPMV_KERNELS( double complex, complex, _dot_complex, _mirror_complex )
+#undef MC_SPMV_KERNELS
+#undef MC_SPMV_SCATTER
+
+static spmv_layout_t _layout( matrix_t const* v ) {
+  spmv_layout_t l;
+  if ( v->format == DCOL ) { // column-major: each right-hand side is contiguous
+    l.rs = 1;
+    l.cs = v->m;
+  }
+  else {
+    l.rs = v->n;
+    l.cs = 1;
+  }
+  return l;
+}
+
+#ifdef _OPENMP
+// first of the n rows (columns, block rows) in part t of nparts, balanced by entries
+static size_t _split( unsigned int const* ptr, const size_t n, const unsigned int b, const int t, const int nparts ) {
+  if ( t >= nparts )
+    return n;
+  const size_t target = ( size_t )(( double )( ptr[n] - b ) * t / nparts );
+  size_t lo = 0, hi = n;  // first r with ptr[r] >= target
+  while ( lo < hi ) {
+    const size_t mid = lo + ( hi - lo ) / 2;
+    if ( ptr[mid] - b < target )
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+#endif
+
+// y = beta*y (zeroed if beta = 0, whatever was in it)
+static void _scale( spmv_args_t const* p, const size_t m, const size_t width ) {
+  for ( size_t c = 0; c < p->k; c++ ) {
+    for ( size_t i = 0; i < m; i++ ) {
+      const size_t at = i * p->yl.rs + c * p->yl.cs;
+      if ( p->beta == 0.0 )
+        memset(( char* ) p->y + at * width, 0, width );
+      else if ( width == sizeof( double ) )
+        (( double* ) p->y )[at] *= p->beta;
+      else
+        (( double complex* ) p->y )[at] *= p->beta;
+    }
+  }
+}
+
+// the rows of y, shared out by the entries in each: each thread writes only its own rows
+static void _product_rows( spmv_args_t const* p, const size_t nrows, const int nthreads ) {
+  matrix_t const* const A = p->A;
+  const int is_complex = ( A->data_type == COMPLEX_DOUBLE );
+  void ( *rows )( spmv_args_t const*, size_t, size_t );
+  if ( A->format == SM_CSR )
+    rows = is_complex ? _csr_rows_complex : _csr_rows_real;
+  else
+    rows = is_complex ? _bcsr_rows_complex : _bcsr_rows_real;
+
+#ifdef _OPENMP
+  #pragma omp parallel num_threads( nthreads ) if( nthreads > 1 )
+  {
+    const int t = omp_get_thread_num();
+    const int nt = omp_get_num_threads();
+    rows( p, _split( A->ii, nrows, A->base, t, nt ), _split( A->ii, nrows, A->base, t + 1, nt ) );
+  }
+#else
+  rows( p, 0, nrows );
+#endif
+}
+
+// scattered entries: y = beta*y first, then each thread adds its share of
+// the entries into a private y (or y itself, with one thread), then the
+// private copies are summed into y, shared out by rows
+// returns: non-zero on malloc failure
+static int _product_scatter( spmv_args_t const* p, const size_t nmajor, const int nthreads ) {
+  matrix_t const* const A = p->A;
+  const int is_complex = ( A->data_type == COMPLEX_DOUBLE );
+  const size_t width = is_complex ? sizeof( double complex ) : sizeof( double );
+  void ( *scatter )( spmv_args_t const*, size_t, size_t ) = is_complex ? _scatter_complex : _scatter_real;
+  _scale( p, A->m, width );
+  if ( nthreads == 1 ) {
+    scatter( p, 0, nmajor );
+    return 0;
+  }
+
+#ifdef _OPENMP
+  // private copies: column-major m x k, one after another
+  const size_t len = A->m * p->k;
+  char* const buf = calloc( nthreads * len, width );
+  if ( buf == NULL )
+    return -2;
+  unsigned int const* const ptr = ( A->format == SM_CSC ) ? A->jj : A->ii;
+  #pragma omp parallel num_threads( nthreads )
+  {
+    const int t = omp_get_thread_num();
+    const int nt = omp_get_num_threads();
+    spmv_args_t q = *p;
+    q.y = buf + t * len * width;
+    q.yl.rs = 1;
+    q.yl.cs = A->m;
+    if ( A->format == SM_COO )
+      scatter( &q, nmajor * t / nt, nmajor * ( t + 1 ) / nt );
+    else
+      scatter( &q, _split( ptr, nmajor, A->base, t, nt ), _split( ptr, nmajor, A->base, t + 1, nt ) );
+    #pragma omp barrier
+    #pragma omp for schedule(static)
+    for ( size_t i = 0; i < A->m; i++ ) {
+      for ( size_t c = 0; c < p->k; c++ ) {
+        const size_t at = i * p->yl.rs + c * p->yl.cs;
+        for ( int u = 0; u < nt; u++ ) {
+          if ( is_complex )
+            (( double complex* ) p->y )[at] += (( double complex* )( buf + u * len * width ) )[i + c * A->m];
+          else
+            (( double* ) p->y )[at] += (( double* )( buf + u * len * width ) )[i + c * A->m];
+        }
+      }
+    }
+  }
+  free( buf );
+#endif
+  return 0;
+}
+
+int spmv( matrix_t* A, matrix_t const* x, matrix_t* y, const double alpha, const double beta ) {
+  assert( A != NULL );
+  assert( x != NULL );
+  assert( y != NULL );
+  if (( A->format != SM_COO ) && ( A->format != SM_CSR ) && ( A->format != SM_CSC ) && ( A->format != SM_BCSR ) )
+    return -1;
+  if (( A->data_type != REAL_DOUBLE ) && ( A->data_type != COMPLEX_DOUBLE ) )
+    return -1;
+  if ((( x->format != DROW ) && ( x->format != DCOL ) ) || (( y->format != DROW ) && ( y->format != DCOL ) ) )
+    return -1;
+  if (( x->data_type != A->data_type ) || ( y->data_type != A->data_type ) ||
+      ( x->complex_storage != MC_COMPLEX_PAIRED ) || ( y->complex_storage != MC_COMPLEX_PAIRED ) )
+    return -1;
+  if (( x->m != A->n ) || ( y->m != A->m ) || ( x->n != y->n ) )
+    return -1;
+  const int half = ( A->sym != SM_UNSYMMETRIC ) && ( A->location != MC_STORE_BOTH );
+  if ( half && ( A->m != A->n ) )
+    return -1;
+  if (( A->index_width != MC_INDEX_32 ) && ( convert_matrix_index_width( A, MC_INDEX_32 ) != 0 ) )
+    return -3;
+  if (( A->data_type == COMPLEX_DOUBLE ) && ( convert_matrix_complex_storage( A, MC_COMPLEX_PAIRED ) != 0 ) )
+    return -2;
+  if ( _dot == NULL )
+    spmv_set_kernel( SPMV_AUTO );
+  // the gathers take signed 32-bit offsets
+  const spmv_dot_t dot = ( A->n > INT32_MAX ) ? _dot_scalar : _dot;
+
+  const spmv_args_t p = { A, x->dd, y->dd, _layout( x ), _layout( y ), x->n, alpha, beta, half, dot };
+  int nthreads = 1;
+#ifdef _OPENMP
+  if ( A->nz * p.k >= MC_SPMV_OMP_MIN_WORK )
+    nthreads = omp_get_max_threads();
+#endif
+
+  int ret = 0;
+  const size_t bs = A->block_size;
+  if ( A->nz == 0 )  // no entries: nothing to add
+    _scale( &p, A->m, ( A->data_type == COMPLEX_DOUBLE ) ? sizeof( double complex ) : sizeof( double ) );
+  else if ( !half && ( A->format == SM_CSR ) )
+    _product_rows( &p, A->m, nthreads );
+  else if ( !half && ( A->format == SM_BCSR ) && ( bs <= MC_BLOCK_SIZE_MAX ) )
+    _product_rows( &p, ( A->m + bs - 1 ) / bs, nthreads );
+  else if ( A->format == SM_COO )
+    ret = _product_scatter( &p, A->nz, nthreads );
+  else if ( A->format == SM_CSC )
+    ret = _product_scatter( &p, A->n, nthreads );
+  else if ( A->format == SM_CSR )
+    ret = _product_scatter( &p, A->m, nthreads );
+  else
+    ret = _product_scatter( &p, ( A->m + bs - 1 ) / bs, nthreads );
+  return ret;
+}
+
+// |v|, as LAPACK's CABS1 for complex values
+static inline double _abs1( void const* dd, const size_t k, const int is_complex ) {
+  if ( is_complex ) {
+    const double complex v = (( double complex const* ) dd )[k];
+    return (( creal( v ) < 0 ) ? -creal( v ) : creal( v ) ) + (( cimag( v ) < 0 ) ? -cimag( v ) : cimag( v ) );
+  }
+  const double v = (( double const* ) dd )[k];
+  return ( v < 0 ) ? -v : v;
+}
+
+// largest row sum of |a(i,j)| (mirrored entries included)
+// returns: a negative value on malloc failure
+static double _norm_inf( matrix_t const* A, const int half ) {
+  const int is_complex = ( A->data_type == COMPLEX_DOUBLE );
+  const unsigned int b = A->base;
+  double* const row = calloc( A->m + 1, sizeof( double ) );
+  if ( row == NULL )
+    return -1.0;
+  switch ( A->format ) {
+    case SM_COO:
+      for ( size_t k = 0; k < A->nz; k++ ) {
+        row[A->ii[k] - b] += _abs1( A->dd, k, is_complex );
+        if ( half && ( A->ii[k] != A->jj[k] ) )
+          row[A->jj[k] - b] += _abs1( A->dd, k, is_complex );
+      }
+      break;
+    case SM_CSR:
+      for ( size_t i = 0; ( A->nz != 0 ) && ( i < A->m ); i++ ) {
+        for ( size_t k = A->ii[i] - b; k < A->ii[i + 1] - b; k++ ) {
+          row[i] += _abs1( A->dd, k, is_complex );
+          if ( half && ( A->jj[k] - b != i ) )
+            row[A->jj[k] - b] += _abs1( A->dd, k, is_complex );
+        }
+      }
+      break;
+    case SM_CSC:
+      for ( size_t j = 0; ( A->nz != 0 ) && ( j < A->n ); j++ ) {
+        for ( size_t k = A->jj[j] - b; k < A->jj[j + 1] - b; k++ ) {
+          row[A->ii[k] - b] += _abs1( A->dd, k, is_complex );
+          if ( half && ( A->ii[k] - b != j ) )
+            row[j] += _abs1( A->dd, k, is_complex );
+        }
+      }
+      break;
+    case SM_BCSR: {
+      const size_t bs = A->block_size;
+      const size_t mb = ( A->m + bs - 1 ) / bs;
+      for ( size_t ib = 0; ( A->nz != 0 ) && ( ib < mb ); ib++ ) {
+        for ( size_t q = A->ii[ib] - b; q < A->ii[ib + 1] - b; q++ ) {
+          for ( size_t e = 0; e < bs * bs; e++ ) {
+            const size_t i = ib * bs + e / bs;
+            const size_t j = ( A->jj[q] - b ) * bs + e % bs;
+            if (( i >= A->m ) || ( j >= A->n ) )
+              continue;  // overhang: zeros
+            row[i] += _abs1( A->dd, q * bs * bs + e, is_complex );
+            if ( half && ( i != j ) )
+              row[j] += _abs1( A->dd, q * bs * bs + e, is_complex );
+          }
+        }
+      }
+      break;
+    }
+    default:
+      assert( 0 );  // converted by the caller
+  }
+  double max = 0.0;
+  for ( size_t i = 0; i < A->m; i++ )
+    max = ( row[i] > max ) ? row[i] : max;
+  free( row );
+  return max;
+}
+
+// largest |v(i,c)| of column c of a DCOL matrix
+static double _column_norm_inf( matrix_t const* v, const size_t c ) {
+  const int is_complex = ( v->data_type == COMPLEX_DOUBLE );
+  double max = 0.0;
+  for ( size_t i = 0; i < v->m; i++ ) {
+    const double a = _abs1( v->dd, c * v->m + i, is_complex );
+    max = ( a > max ) ? a : max;
+  }
+  return max;
+}
+
+// a DCOL copy of a dense or sparse matrix, with paired values of type t
+static matrix_t* _dense_copy( matrix_t const* v, const enum matrix_data_type_t t ) {
+  matrix_t* c = copy_matrix(( matrix_t* ) v );
+  if ( c == NULL )
+    return NULL;
+  if (( convert_matrix( c, DCOL, FIRST_INDEX_ZERO ) != 0 ) || ( convert_matrix_complex_storage( c, MC_COMPLEX_PAIRED ) != 0 ) ||
+      ( convert_matrix_data_type( c, t ) != 0 ) ) {
+    free_matrix( c );
+    return NULL;
+  }
+  return c;
+}
+
+int spmv_residual( matrix_t* A, matrix_t const* x, matrix_t const* b, double* r ) {
+  assert( A != NULL );
+  assert( x != NULL );
+  assert( b != NULL );
+  assert( r != NULL );
+  if (( A->m != b->m ) || ( A->n != x->m ) || ( x->n != b->n ) )
+    return -1;
+  if (( A->data_type == SM_PATTERN ) || ( x->data_type == SM_PATTERN ) || ( b->data_type == SM_PATTERN ) )
+    return -1;
+  const int is_complex = ( A->data_type == COMPLEX_DOUBLE ) || ( A->data_type == COMPLEX_SINGLE ) ||
+                         ( x->data_type == COMPLEX_DOUBLE ) || ( x->data_type == COMPLEX_SINGLE ) ||
+                         ( b->data_type == COMPLEX_DOUBLE ) || ( b->data_type == COMPLEX_SINGLE );
+  const enum matrix_data_type_t t = is_complex ? COMPLEX_DOUBLE : REAL_DOUBLE;
+
+  // A as spmv() takes it: in a copy if it has to change
+  matrix_t* a = A;
+  if (( A->data_type != t ) || ( A->format == DROW ) || ( A->format == DCOL ) ) {
+    a = copy_matrix( A );
+    if ( a == NULL )
+      return -2;
+    if (( convert_matrix_data_type( a, t ) != 0 ) ||
+        ((( a->format == DROW ) || ( a->format == DCOL ) ) && ( convert_matrix( a, SM_CSR, FIRST_INDEX_ZERO ) != 0 ) ) ) {
+      free_matrix( a );
+      return -2;
+    }
+  }
+  matrix_t* xx = _dense_copy( x, t );
+  matrix_t* rr = _dense_copy( b, t );  // r = b - Ax, in place
+  int ret = (( xx == NULL ) || ( rr == NULL ) ) ? -2 : 0;
+
+  const int half = ( a->sym != SM_UNSYMMETRIC ) && ( a->location != MC_STORE_BOTH );
+  const double anorm = ( ret == 0 ) ? _norm_inf( a, half ) : 0.0;
+  if ( anorm < 0.0 )
+    ret = -2;
+  for ( size_t c = 0; ( ret == 0 ) && ( c < x->n ); c++ )
+    r[c] = anorm * _column_norm_inf( xx, c ) + _column_norm_inf( rr, c );  // the denominator, for now
+  if ( ret == 0 )
+    ret = spmv( a, xx, rr, -1.0, 1.0 );
+  for ( size_t c = 0; ( ret == 0 ) && ( c < x->n ); c++ ) {
+    const double rnorm = _column_norm_inf( rr, c );
+    if ( r[c] > 0.0 )
+      r[c] = rnorm / r[c];
+    else  // A = 0 or x = 0, and b = 0: exact if nothing is left over
+      r[c] = ( rnorm == 0.0 ) ? 0.0 : 1.0;
+  }
+
+  if ( a != A )
+    free_matrix( a );
+  free_matrix( xx );
+  free_matrix( rr );
+  return ret;
+}
@@ -0,0 +1,71 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _SPMV_H_
+#define _SPMV_H_
+
+#include "config.h"
+#include "matrix.h"
+
+// sparse matrix-vector and matrix-matrix products: y = alpha*A*x + beta*y
+//
+// A: COO, CSR, CSC or BCSR, REAL_DOUBLE or COMPLEX_DOUBLE values
+//   a symmetric matrix with one triangle stored (location != MC_STORE_BOTH)
+//   is multiplied as the whole matrix: each off-diagonal entry is applied
+//   again, mirrored (negated if skew-symmetric, conjugated if hermitian)
+// x, y: dense (DCOL or DROW), n x k and m x k, same data type as A
+//   k > 1 is a product with k right-hand sides at once (SpMM)
+//   beta = 0 overwrites y without reading it
+//
+// CSR and BCSR are the fast paths: the rows (block rows) are shared out
+// between OpenMP threads, balanced by non-zeros, and each row is a dot
+// product; the real CSR dot products use AVX2 or AVX-512 gathers when the CPU
+// has them (see spmv_set_kernel()), BCSR keeps the block's row sums in
+// registers. COO, CSC and one-triangle storage scatter into y instead: each
+// thread accumulates into its own copy of y and the copies are summed.
+//
+// A is given 32-bit indices and paired complex values if it doesn't already
+// have them (as the format conversions do)
+// returns: non-zero on failure (-1 unsupported format/type or mismatched
+//   sizes, -2 malloc failure, -3 too large for 32-bit indices)
+int spmv( matrix_t* A, matrix_t const* x, matrix_t* y, double alpha, double beta );
+
+// normwise backward error of each column of x as a solution of Ax = b:
+//   ||b - Ax|| / (||A|| ||x|| + ||b||), in the infinity norm
+//   (complex moduli are |re| + |im|, as LAPACK's CABS1)
+// around 1e-16 for a backward stable double precision solve, whatever the
+// conditioning of A, so no reference solution is needed; the cost is one
+// product with A and a pass over A for its norm
+// A, x, b can be in any format and precision: whatever spmv() can't take is
+// converted in a copy (single precision is widened to double)
+// r: one value per column of x
+// returns: non-zero on failure (-1 mismatched sizes or pattern data,
+//   -2 malloc failure)
+int spmv_residual( matrix_t* A, matrix_t const* x, matrix_t const* b, double* r );
+
+// the dot product kernels for the real CSR path
+// SPMV_AUTO picks the widest one this CPU supports (the default)
+enum spmv_kernel_t { SPMV_AUTO = 0, SPMV_SCALAR, SPMV_AVX2, SPMV_AVX512 };
+// select a kernel (benchmarks, tests), not thread-safe: call between products
+// returns: non-zero if this build or CPU can't run it (the kernel is unchanged)
+int spmv_set_kernel( enum spmv_kernel_t k );
+// the kernel in use
+enum spmv_kernel_t spmv_kernel();
+char const* spmv_kernel_name( enum spmv_kernel_t k );
+
+#endif
@@ -0,0 +1,308 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <complex.h>
+#include <assert.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "stats.h"
+
+#define MC_STATS_OMP_MIN_WORK ( 1 << 16 ) // entries: below this, one thread
+
+#ifdef _OPENMP
+static inline int _threads( const size_t work ) {
+  return ( work >= MC_STATS_OMP_MIN_WORK ) ? omp_get_max_threads() : 1;
+}
+#endif
+
+// a(k), re + i im (zero for pattern matrices)
+static inline void _entry( void const* dd, const size_t k, const enum matrix_data_type_t t, double* re, double* im ) {
+  *re = *im = 0.0;
+  switch ( t ) {
+    case REAL_DOUBLE:
+      *re = (( double const* ) dd )[k];
+      break;
+    case REAL_SINGLE:
+      *re = (( float const* ) dd )[k];
+      break;
+    case COMPLEX_DOUBLE:
+      *re = creal((( double complex const* ) dd )[k] );
+      *im = cimag((( double complex const* ) dd )[k] );
+      break;
+    case COMPLEX_SINGLE:
+      *re = crealf((( float complex const* ) dd )[k] );
+      *im = cimagf((( float complex const* ) dd )[k] );
+      break;
+    default:  // pattern
+      break;
+  }
+}
+
+// histogram bin of a row with d entries: 0, 1, 2-3, 4-7, ...
+static inline unsigned int _bin( size_t d ) {
+  unsigned int b = 0;
+  while (( d != 0 ) && ( b < MC_STATS_DEGREE_BINS - 1 ) ) {
+    d >>= 1;
+    b++;
+  }
+  return b;
+}
+
+// the CSR matrix the statistics are taken from: A itself or a copy
+// returns: NULL on failure
+static matrix_t* _csr( matrix_t* A ) {
+  const int split = (( A->data_type == COMPLEX_DOUBLE ) || ( A->data_type == COMPLEX_SINGLE ) ) &&
+                    ( A->complex_storage == MC_COMPLEX_SPLIT );
+  const int upper = ( A->sym != SM_UNSYMMETRIC ) && ( A->location == UPPER_TRIANGULAR );
+  if (( A->format == SM_CSR ) && ( A->index_width == MC_INDEX_32 ) && !split && !upper )
+    return A;
+  matrix_t* c = copy_matrix( A );
+  if ( c == NULL )
+    return NULL;
+  if (( upper && ( convert_matrix_symmetry( c, LOWER_TRIANGULAR ) != 0 ) ) ||
+      ( convert_matrix( c, SM_CSR, FIRST_INDEX_ZERO ) != 0 ) ||
+      ( convert_matrix_index_width( c, MC_INDEX_32 ) != 0 ) ||
+      ( split && ( convert_matrix_complex_storage( c, MC_COMPLEX_PAIRED ) != 0 ) ) ) {
+    free_matrix( c );
+    return NULL;
+  }
+  return c;
+}
+
+int matrix_stats( matrix_t* A, struct matrix_stats_t* s ) {
+  assert( A != NULL );
+  assert( s != NULL );
+  *s = ( struct matrix_stats_t ) {
+    0
+  };
+  if ( A->format == INVALID )
+    return -1;
+  s->m = A->m;
+  s->n = A->n;
+  s->sym = A->sym;
+  s->block_size = 1;
+  if (( A->m == 0 ) || ( A->n == 0 ) ) {
+    s->degree_histogram[0] = A->m;
+    s->empty_rows = A->m;
+    s->empty_cols = A->n;
+    return 0;
+  }
+
+  matrix_t* const a = _csr( A );
+  if ( a == NULL )
+    return -2;
+  const size_t m = a->m;
+  const size_t n = a->n;
+  const unsigned int b = a->base;
+  const enum matrix_data_type_t t = a->data_type;
+  const int half = ( a->sym != SM_UNSYMMETRIC ) && ( a->location != MC_STORE_BOTH );
+  size_t* const degree = calloc( m, sizeof( size_t ) );
+  double* const diag = calloc( m, sizeof( double ) );  // |a(i,i)|
+  double* const diag_re = calloc( m, sizeof( double ) );  // re a(i,i)
+  double* const off = calloc( m, sizeof( double ) );   // sum of the others' |a(i,j)|
+  unsigned char* const col = calloc( n, sizeof( unsigned char ) );  // column has an entry
+  if (( degree == NULL ) || ( diag == NULL ) || ( diag_re == NULL ) || ( off == NULL ) || ( col == NULL ) ) {
+    free( degree );
+    free( diag );
+    free( diag_re );
+    free( off );
+    free( col );
+    if ( a != A )
+      free_matrix( a );
+    return -2;
+  }
+
+  // by row: everything but the mirrored entries of one stored triangle,
+  // which land in other rows (the entry's column)
+  size_t lower = 0, upper = 0, profile = 0, diagonal = 0;
+  const size_t nz = ( a->nz == 0 ) ? 0 : a->ii[m] - b;
+#ifdef _OPENMP
+  const int nthreads = _threads( nz );
+  #pragma omp parallel for schedule(guided) num_threads( nthreads ) if( nthreads > 1 ) \
+    reduction( max:lower, upper ) reduction( +:profile, diagonal )
+#endif
+  for ( size_t i = 0; i < m; i++ ) {
+    if ( nz == 0 )
+      continue;
+    size_t first = i;
+    int has_diag = 0;
+    size_t row_degree = 0;
+    double row_off = 0.0;
+    for ( size_t k = a->ii[i] - b; k < a->ii[i + 1] - b; k++ ) {
+      const size_t j = a->jj[k] - b;
+      double re, im;
+      _entry( a->dd, k, t, &re, &im );
+      const double v = (( re < 0 ) ? -re : re ) + (( im < 0 ) ? -im : im );  // CABS1
+      row_degree++;
+      if ( j == i ) {
+        diag[i] += v;
+        diag_re[i] += re;
+        has_diag = 1;
+      }
+      else
+        row_off += v;
+      first = ( j < first ) ? j : first;
+      lower = (( i > j ) && ( i - j > lower ) ) ? i - j : lower;
+      upper = (( j > i ) && ( j - i > upper ) ) ? j - i : upper;
+#ifdef _OPENMP
+      #pragma omp atomic write
+#endif
+      col[j] = 1;
+      if ( half && ( j != i ) ) {  // the mirror, a(j,i)
+#ifdef _OPENMP
+        #pragma omp atomic
+#endif
+        degree[j]++;
+#ifdef _OPENMP
+        #pragma omp atomic
+#endif
+        off[j] += v;
+#ifdef _OPENMP
+        #pragma omp atomic write
+#endif
+        col[i] = 1;
+      }
+    }
+    // other rows' mirrored entries may be adding to this row too: every
+    // update of a shared row is atomic
+    if ( half ) {
+#ifdef _OPENMP
+      #pragma omp atomic
+#endif
+      degree[i] += row_degree;
+#ifdef _OPENMP
+      #pragma omp atomic
+#endif
+      off[i] += row_off;
+    }
+    else {
+      degree[i] = row_degree;
+      off[i] = row_off;
+    }
+    profile += i - first;
+    diagonal += has_diag;
+  }
+  if ( half ) {  // one triangle, lower (see _csr()): the upper is its mirror
+    upper = ( upper > lower ) ? upper : lower;
+    lower = upper;
+  }
+  s->lower_bandwidth = lower;
+  s->upper_bandwidth = upper;
+  s->profile = profile;
+  s->diagonal = diagonal;
+
+  // by row again, now the degrees are complete
+  size_t total = 0, min_degree = SIZE_MAX, max_degree = 0, empty_rows = 0, positive = 0, dominant = 0, dense = 0;
+  size_t empty_cols = 0;
+#ifdef _OPENMP
+  #pragma omp parallel num_threads( nthreads ) if( nthreads > 1 )
+#endif
+  {
+    size_t hist[MC_STATS_DEGREE_BINS] = { 0 };
+#ifdef _OPENMP
+    #pragma omp for schedule(static) reduction( +:total, empty_rows, positive, dominant, dense ) \
+      reduction( min:min_degree ) reduction( max:max_degree ) nowait
+#endif
+    for ( size_t i = 0; i < m; i++ ) {
+      const size_t d = degree[i];
+      total += d;
+      min_degree = ( d < min_degree ) ? d : min_degree;
+      max_degree = ( d > max_degree ) ? d : max_degree;
+      hist[_bin( d )]++;
+      empty_rows += ( d == 0 );
+      positive += ( diag_re[i] > 0.0 );
+      dominant += ( t != SM_PATTERN ) && ( d != 0 ) && ( diag[i] >= off[i] );
+      dense += ( d >= MC_STATS_DENSE_ROW_MIN ) && ( d * d > 100 * n );  // d > 10 sqrt(n)
+    }
+#ifdef _OPENMP
+    #pragma omp for schedule(static) reduction( +:empty_cols )
+#endif
+    for ( size_t j = 0; j < n; j++ )
+      empty_cols += ( col[j] == 0 );
+#ifdef _OPENMP
+    #pragma omp critical
+#endif
+    for ( unsigned int k = 0; k < MC_STATS_DEGREE_BINS; k++ )
+      s->degree_histogram[k] += hist[k];
+  }
+  s->nz = total;
+  s->min_degree = min_degree;
+  s->max_degree = max_degree;
+  s->empty_rows = empty_rows;
+  s->empty_cols = empty_cols;
+  s->positive_diagonal = positive;
+  s->dominant_rows = dominant;
+  s->dense_rows = dense;
+  s->block_size = detect_matrix_block_size( a );
+
+  free( degree );
+  free( diag );
+  free( diag_re );
+  free( off );
+  free( col );
+  if ( a != A )
+    free_matrix( a );
+  return 0;
+}
+
+int matrix_stats_definite( struct matrix_stats_t const* s ) {
+  if (( s->m != s->n ) || ( s->positive_diagonal != s->m ) )
+    return -1;
+  if ((( s->sym == SM_SYMMETRIC ) || ( s->sym == SM_HERMITIAN ) ) && ( s->dominant_rows == s->m ) )
+    return 1;  // Gershgorin: the eigenvalues are real and none is negative
+  return 0;
+}
+
+void matrix_stats_printf( struct matrix_stats_t const* s ) {
+  printf( "        Structure: bandwidth %zu lower, %zu upper, profile %zu\n", s->lower_bandwidth, s->upper_bandwidth,
+          s->profile );
+  printf( "      Row entries: %zu-%zu, mean %.1f, %zu dense row%s\n", s->min_degree, s->max_degree,
+          ( s->m == 0 ) ? 0.0 : ( double ) s->nz / s->m, s->dense_rows, ( s->dense_rows == 1 ) ? "" : "s" );
+  printf( "                  " );
+  for ( unsigned int k = 0; k < MC_STATS_DEGREE_BINS; k++ ) {
+    if ( s->degree_histogram[k] == 0 )
+      continue;
+    if ( k < 2 )
+      printf( " [%u]=%zu", k, s->degree_histogram[k] );
+    else if ( k == MC_STATS_DEGREE_BINS - 1 )
+      printf( " [%zu+]=%zu", ( size_t ) 1 << ( k - 1 ), s->degree_histogram[k] );
+    else
+      printf( " [%zu-%zu]=%zu", ( size_t ) 1 << ( k - 1 ), (( size_t ) 1 << k ) - 1, s->degree_histogram[k] );
+  }
+  printf( "\n" );
+  printf( "    Empty row/col: %zu / %zu\n", s->empty_rows, s->empty_cols );
+  printf( "         Diagonal: %zu of %zu rows, %zu positive, %zu diagonally dominant\n", s->diagonal,
+          ( s->m < s->n ) ? s->m : s->n, s->positive_diagonal, s->dominant_rows );
+  printf( "       Block size: %u\n", s->block_size );
+}
+
+void matrix_stats_printf_csv_header() {
+  printf( "nz, lower bandwidth, upper bandwidth, profile, min. degree, max. degree, empty rows, empty cols, "
+          "diagonal, positive diagonal, dominant rows, dense rows, block size, " );
+}
+
+void matrix_stats_printf_csv_body( struct matrix_stats_t const* s ) {
+  printf( "%zu, %zu, %zu, %zu, %zu, %zu, %zu, %zu, %zu, %zu, %zu, %zu, %u, ", s->nz, s->lower_bandwidth,
+          s->upper_bandwidth, s->profile, s->min_degree, s->max_degree, s->empty_rows, s->empty_cols, s->diagonal,
+          s->positive_diagonal, s->dominant_rows, s->dense_rows, s->block_size );
+}
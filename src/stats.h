@@ -0,0 +1,70 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _STATS_H_
+#define _STATS_H_
+
+#include "config.h"
+#include "matrix.h"
+
+#define MC_STATS_DEGREE_BINS 16
+
+// structural statistics of a matrix: what a solver's cost depends on besides
+// its size, for choosing a solver and for the reports
+//
+// a symmetric matrix stored as one triangle is described as the whole
+// matrix (its off-diagonal entries count twice); repeated entries each count
+// |a| is |re| + |im| for complex values, as LAPACK's CABS1
+struct matrix_stats_t {
+  size_t m, n;
+  enum matrix_symmetry_t sym; // A's
+  size_t nz;                 // entries of the whole matrix
+  size_t lower_bandwidth;    // largest i - j of an entry
+  size_t upper_bandwidth;    // largest j - i of an entry
+  size_t profile;            // envelope below the diagonal: sum over rows of i - (first column, if before i)
+  size_t min_degree;         // fewest entries in a row
+  size_t max_degree;         // most entries in a row
+  size_t degree_histogram[MC_STATS_DEGREE_BINS]; // rows with 0, 1, 2-3, 4-7, ... entries, the last bin has the rest
+  size_t empty_rows;
+  size_t empty_cols;
+  size_t diagonal;           // rows with a diagonal entry
+  size_t positive_diagonal;  // rows with a diagonal entry of positive real part (none for pattern matrices)
+  size_t dominant_rows;      // rows with |a(i,i)| >= sum over j != i of |a(i,j)| (none for pattern matrices)
+  size_t dense_rows;         // rows with more than 10 sqrt(n) entries, and at least MC_STATS_DENSE_ROW_MIN
+  unsigned int block_size;   // detect_matrix_block_size()
+};
+#define MC_STATS_DENSE_ROW_MIN 16
+
+// one pass over the entries, O(nz), shared out between OpenMP threads by rows;
+// works on a CSR copy of A (lower triangle, if one triangle is stored) if A
+// isn't already CSR with 32-bit indices
+// returns: non-zero on failure (-1 invalid matrix, -2 malloc failure)
+int matrix_stats( matrix_t* A, struct matrix_stats_t* s );
+
+// can A be positive definite? no if a diagonal entry isn't positive; yes
+// if it is also symmetric (hermitian) and diagonally dominant
+// returns: 1 surely, 0 perhaps, -1 no
+int matrix_stats_definite( struct matrix_stats_t const* s );
+
+// the statistics as a block of text (verbose output), and as columns of the
+// timing CSV: a header line and the matching values, each followed by ", "
+void matrix_stats_printf( struct matrix_stats_t const* s );
+void matrix_stats_printf_csv_header();
+void matrix_stats_printf_csv_body( struct matrix_stats_t const* s );
+
+#endif
@@ -0,0 +1,610 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <assert.h>
+#ifdef HAVE_PTHREAD
+#include <pthread.h>
+#endif
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#include "stream.h"
+
+#define MC_STREAM_IN ( 1 << 18 ) // compressed bytes read at a time
+#define MC_TAR_BLOCK 512
+#define MC_TAR_NAME_MAX ( 1 << 16 ) // longest (GNU or pax) member name we'll take
+
+struct mc_stream_t {
+  int fd;
+  enum mc_compression_t compression;
+  unsigned int flags;
+  // compressed input
+  unsigned char* in;
+  size_t in_len, in_pos;
+  int in_eof;
+  int raw_eof; // all the data has been decompressed
+#ifdef HAVE_ZLIB
+  z_stream z;
+#endif
+#ifdef HAVE_ZSTD
+  ZSTD_DStream* zstd;
+  size_t zstd_hint; // 0 at the end of a frame
+#endif
+#ifdef HAVE_LZMA
+  lzma_stream xz;
+#endif
+  int decoder; // the decoder was initialized (released on close)
+  // tar archives: -1 not known yet, 0 no, 1 yes
+  int tar;
+  unsigned char head[MC_TAR_BLOCK]; // the first bytes: a tar header, or data if not a tar
+  size_t head_len, head_pos;
+  int in_member;
+  uint64_t member_left; // bytes of the chosen member still to come
+  char* name;           // a long member name (GNU 'L' or pax 'x' header) for the next header
+  unsigned char* scratch;
+  // blocks, handed to the caller in turn
+  int blocks;
+  char* block[MC_STREAM_BLOCKS];
+  size_t len[MC_STREAM_BLOCKS];
+  int ret[MC_STREAM_BLOCKS]; // 0: more to come, 1: the end, <0: failed after len bytes
+  int full[MC_STREAM_BLOCKS];
+  int next;  // the block the caller gets next
+  int held;  // the block the caller has, -1 none
+  int done;  // 0, or what mc_stream_next() returns from now on
+#ifdef HAVE_PTHREAD
+  int threaded;
+  int stop;
+  pthread_t thread;
+  pthread_mutex_t lock;
+  pthread_cond_t cond;
+#endif
+};
+
+int mc_stream_detect( char const* filename, int* tar ) {
+  unsigned char h[MC_TAR_BLOCK];
+  const int fd = open( filename, O_RDONLY );
+  if ( fd < 0 )
+    return -2;
+  size_t len = 0;
+  ssize_t r;
+  while (( len < sizeof( h ) ) && (( r = read( fd, h + len, sizeof( h ) - len ) ) > 0 ) )
+    len += r;
+  close( fd );
+
+  *tar = ( len == MC_TAR_BLOCK ) && ( memcmp( h + 257, "ustar", 5 ) == 0 );
+  if (( len >= 2 ) && ( h[0] == 0x1f ) && ( h[1] == 0x8b ) )
+    return MC_GZIP;
+  if (( len >= 4 ) && ( memcmp( h, "\x28\xb5\x2f\xfd", 4 ) == 0 ) )
+    return MC_ZSTD;
+  if (( len >= 6 ) && ( memcmp( h, "\xfd" "7zXZ\0", 6 ) == 0 ) )
+    return MC_XZ;
+  return MC_UNCOMPRESSED;
+}
+
+// refill the compressed input, once it has all been used
+static int _input( struct mc_stream_t* s ) {
+  if (( s->in_pos < s->in_len ) || s->in_eof )
+    return 0;
+  const ssize_t r = read( s->fd, s->in, MC_STREAM_IN );
+  if ( r < 0 )
+    return -2;
+  s->in_eof = ( r == 0 );
+  s->in_len = r;
+  s->in_pos = 0;
+  return 0;
+}
+
+// decompress up to n bytes into buf
+// returns the bytes, 0 at the end of the data, <0 on failure
+static long _raw_read( struct mc_stream_t* s, unsigned char* buf, const size_t n ) {
+  if ( s->raw_eof )
+    return 0;
+  switch ( s->compression ) {
+    case MC_UNCOMPRESSED:
+      if ( s->in_pos < s->in_len ) {  // what was read to find the compression
+        const size_t c = ( s->in_len - s->in_pos < n ) ? s->in_len - s->in_pos : n;
+        memcpy( buf, s->in + s->in_pos, c );
+        s->in_pos += c;
+        return c;
+      }
+      {
+        const ssize_t r = read( s->fd, buf, n );
+        if ( r < 0 )
+          return -2;
+        s->raw_eof = ( r == 0 );
+        return r;
+      }
+#ifdef HAVE_ZLIB
+    case MC_GZIP:
+    {
+      int ret;
+      s->z.next_out = buf;
+      s->z.avail_out = ( n > UINT32_MAX ) ? UINT32_MAX : n;
+      const uInt avail = s->z.avail_out;
+      while ( s->z.avail_out == avail ) {
+        if (( ret = _input( s ) ) != 0 )
+          return ret;
+        s->z.next_in = s->in + s->in_pos;
+        s->z.avail_in = s->in_len - s->in_pos;
+        const int r = inflate( &( s->z ), Z_NO_FLUSH );
+        s->in_pos = s->in_len - s->z.avail_in;
+        if ( r == Z_STREAM_END ) {
+          // the end of a gzip member: another may follow (concatenated files)
+          if (( ret = _input( s ) ) != 0 )
+            return ret;
+          if ( s->in_pos == s->in_len ) {
+            s->raw_eof = 1;
+            break;
+          }
+          inflateReset( &( s->z ) );
+        }
+        else if (( r != Z_OK ) && ( r != Z_BUF_ERROR ) ) {
+          return -13;
+        }
+        else if (( s->in_pos == s->in_len ) && s->in_eof && ( s->z.avail_out == avail ) ) {
+          return -13;  // truncated
+        }
+      }
+      return avail - s->z.avail_out;
+    }
+#endif
+#ifdef HAVE_ZSTD
+    case MC_ZSTD:
+    {
+      int ret;
+      ZSTD_outBuffer o = { buf, n, 0 };
+      for ( ;; ) {
+        ZSTD_inBuffer i = { s->in + s->in_pos, s->in_len - s->in_pos, 0 };
+        const size_t r = ZSTD_decompressStream( s->zstd, &o, &i );
+        if ( ZSTD_isError( r ) )
+          return -13;
+        s->in_pos += i.pos;
+        if (( i.pos > 0 ) || ( o.pos > 0 ) )
+          s->zstd_hint = r;  // 0 at the end of a frame (an idle call asks for the next one)
+        if ( o.pos > 0 )
+          return o.pos;
+        if (( s->in_pos == s->in_len ) && s->in_eof ) {
+          if ( s->zstd_hint != 0 )
+            return -13;  // truncated
+          s->raw_eof = 1;
+          return 0;
+        }
+        if (( ret = _input( s ) ) != 0 )
+          return ret;
+      }
+    }
+#endif
+#ifdef HAVE_LZMA
+    case MC_XZ:
+    {
+      int ret;
+      s->xz.next_out = buf;
+      s->xz.avail_out = n;
+      for ( ;; ) {
+        if (( ret = _input( s ) ) != 0 )
+          return ret;
+        s->xz.next_in = s->in + s->in_pos;
+        s->xz.avail_in = s->in_len - s->in_pos;
+        const lzma_ret r = lzma_code( &( s->xz ), s->in_eof ? LZMA_FINISH : LZMA_RUN );
+        s->in_pos = s->in_len - s->xz.avail_in;
+        if ( r == LZMA_STREAM_END ) {
+          s->raw_eof = 1;
+          return n - s->xz.avail_out;
+        }
+        if ( r != LZMA_OK )
+          return -13;  // corrupt, or truncated (LZMA_BUF_ERROR)
+        if ( s->xz.avail_out < n )
+          return n - s->xz.avail_out;
+      }
+    }
+#endif
+    default:
+      return -15;
+  }
+}
+
+// exactly n bytes, fewer only at the end of the data
+static long _raw_fill( struct mc_stream_t* s, unsigned char* buf, const size_t n ) {
+  size_t got = 0;
+  while ( got < n ) {
+    const long r = _raw_read( s, buf + got, n - got );
+    if ( r < 0 )
+      return r;
+    if ( r == 0 )
+      break;
+    got += r;
+  }
+  return got;
+}
+
+// size field of a tar header: octal, or base-256 for large members
+static uint64_t _tar_size( unsigned char const* f ) {
+  uint64_t x = 0;
+  if ( f[0] & 0x80 ) {
+    for ( int i = 1; i < 12; i++ )
+      x = ( x << 8 ) | f[i];
+    return x;
+  }
+  int i = 0;
+  while (( i < 12 ) && ( f[i] == ' ' ) )
+    i++;
+  for ( ; ( i < 12 ) && ( f[i] >= '0' ) && ( f[i] <= '7' ); i++ )
+    x = x * 8 + ( f[i] - '0' );
+  return x;
+}
+
+// SuiteSparse puts the matrix in "Name/Name.mtx", beside "Name/Name_b.mtx"
+// and others; with MC_STREAM_ANY_MTX any "*.mtx" is taken
+static int _tar_select( char const* name, const unsigned int flags ) {
+  const size_t len = strlen( name );
+  if (( len < 5 ) || ( strcmp( name + len - 4, ".mtx" ) != 0 ) )
+    return 0;
+  if ( flags & MC_STREAM_ANY_MTX )
+    return 1;
+  char const* const base = strrchr( name, '/' );
+  if ( base == NULL )
+    return 0;
+  char const* dir = base;
+  while (( dir > name ) && ( dir[-1] != '/' ) )
+    dir--;
+  const size_t n = name + len - 4 - ( base + 1 );
+  return (( size_t )( base - dir ) == n ) && ( strncmp( dir, base + 1, n ) == 0 );
+}
+
+// skip n bytes of the archive
+static int _tar_skip( struct mc_stream_t* s, uint64_t n ) {
+  while ( n > 0 ) {
+    const long r = _raw_read( s, s->scratch, ( n < MC_STREAM_IN ) ? n : MC_STREAM_IN );
+    if ( r <= 0 )
+      return ( r < 0 ) ? r : -13;  // truncated
+    n -= r;
+  }
+  return 0;
+}
+
+// move on to the next member we want
+// returns 0 on success, -14 if there are no more, <0 on failure
+static int _tar_next( struct mc_stream_t* s ) {
+  int ret;
+  for ( ;; ) {
+    unsigned char* const h = s->head;
+    if ( s->head_len == 0 ) {
+      const long r = _raw_fill( s, h, MC_TAR_BLOCK );
+      if ( r < 0 )
+        return r;
+      if ( r < MC_TAR_BLOCK )
+        return -14;
+    }
+    s->head_len = 0;  // used now
+    int zero = 1;
+    for ( int i = 0; zero && ( i < MC_TAR_BLOCK ); i++ )
+      zero = ( h[i] == 0 );
+    if ( zero )
+      return -14;  // the end of the archive
+
+    const uint64_t size = _tar_size( h + 124 );
+    const uint64_t padded = ( size + MC_TAR_BLOCK - 1 ) / MC_TAR_BLOCK * MC_TAR_BLOCK;
+    const char type = h[156];
+    if ((( type == 'L' ) || ( type == 'x' ) ) && ( size < MC_TAR_NAME_MAX ) ) {
+      // a long name for the next member: GNU, or a pax "<len> path=<name>\n" record
+      char* const t = malloc( padded + 1 );
+      if ( t == NULL )
+        return -1;
+      const long r = _raw_fill( s, ( unsigned char* ) t, padded );
+      if ( r != ( long ) padded ) {
+        free( t );
+        return ( r < 0 ) ? r : -13;
+      }
+      t[size] = '\0';
+      char* name = t;
+      if ( type == 'x' ) {
+        char* const path = strstr( t, " path=" );
+        name = NULL;
+        if ( path != NULL ) {
+          name = path + 6;
+          name[strcspn( name, "\n" )] = '\0';
+        }
+      }
+      if ( name != NULL ) {
+        free( s->name );
+        s->name = strdup( name );
+      }
+      free( t );
+      continue;
+    }
+
+    // "prefix/name" (ustar), unless a long name came before
+    char name[257]; // 155 + "/" + 100 + NUL
+    if ( s->name == NULL ) {
+      if ( h[345] != '\0' )
+        snprintf( name, sizeof( name ), "%.155s/%.100s", ( char* )( h + 345 ), ( char* ) h );
+      else
+        snprintf( name, sizeof( name ), "%.100s", ( char* ) h );
+    }
+    const int want = (( type == '0' ) || ( type == '\0' ) || ( type == '7' ) ) &&
+                     _tar_select(( s->name != NULL ) ? s->name : name, s->flags );
+    free( s->name );
+    s->name = NULL;
+    if ( want ) {
+      s->in_member = 1;
+      s->member_left = size;
+      return 0;
+    }
+    if (( ret = _tar_skip( s, padded ) ) != 0 )
+      return ret;
+  }
+}
+
+// read up to n bytes of the data: the file, or the member of the archive
+// returns the bytes, 0 at the end of the data, <0 on failure
+static long _read( struct mc_stream_t* s, char* buf, const size_t n ) {
+  if ( s->tar < 0 ) {
+    const long r = _raw_fill( s, s->head, MC_TAR_BLOCK );
+    if ( r < 0 )
+      return r;
+    s->head_len = r;
+    s->head_pos = 0;
+    s->tar = ( r == MC_TAR_BLOCK ) && ( memcmp( s->head + 257, "ustar", 5 ) == 0 );
+    if ( s->tar ) {
+      s->scratch = malloc( MC_STREAM_IN );
+      if ( s->scratch == NULL )
+        return -1;
+    }
+  }
+  if ( !s->tar ) {
+    if ( s->head_pos < s->head_len ) {
+      const size_t c = ( s->head_len - s->head_pos < n ) ? s->head_len - s->head_pos : n;
+      memcpy( buf, s->head + s->head_pos, c );
+      s->head_pos += c;
+      return c;
+    }
+    return _raw_read( s, ( unsigned char* ) buf, n );
+  }
+
+  if ( !s->in_member ) {
+    const int ret = _tar_next( s );
+    if ( ret != 0 )
+      return ret;
+  }
+  if ( s->member_left == 0 )
+    return 0;
+  const long r = _raw_read( s, ( unsigned char* ) buf, ( n < s->member_left ) ? n : s->member_left );
+  if ( r == 0 )
+    return -13;  // truncated
+  if ( r > 0 )
+    s->member_left -= r;
+  return r;
+}
+
+// fill block b: as much as fits, or up to the end of the data
+static void _fill_block( struct mc_stream_t* s, const int b ) {
+  size_t len = 0;
+  int ret = 0;
+  while ( len < MC_STREAM_BLOCK ) {
+    const long r = _read( s, s->block[b] + len, MC_STREAM_BLOCK - len );
+    if ( r <= 0 ) {
+      ret = ( r < 0 ) ? r : 1;
+      break;
+    }
+    len += r;
+  }
+  s->len[b] = len;
+  s->ret[b] = ret;
+}
+
+#ifdef HAVE_PTHREAD
+// the reader thread: fills the blocks in turn, as the caller hands them back
+static void* _reader( void* arg ) {
+  struct mc_stream_t* const s = arg;
+  for ( int b = 0; ; b = ( b + 1 ) % s->blocks ) {
+    pthread_mutex_lock( &( s->lock ) );
+    while ( s->full[b] && !s->stop )
+      pthread_cond_wait( &( s->cond ), &( s->lock ) );
+    const int stop = s->stop;
+    pthread_mutex_unlock( &( s->lock ) );
+    if ( stop )
+      break;
+
+    _fill_block( s, b );
+
+    pthread_mutex_lock( &( s->lock ) );
+    s->full[b] = 1;
+    pthread_cond_broadcast( &( s->cond ) );
+    pthread_mutex_unlock( &( s->lock ) );
+    if ( s->ret[b] != 0 )
+      break;
+  }
+  return NULL;
+}
+#endif
+
+int mc_stream_open( char const* filename, unsigned int flags, struct mc_stream_t** out ) {
+  *out = NULL;
+  struct mc_stream_t* const s = calloc( 1, sizeof( struct mc_stream_t ) );
+  if ( s == NULL )
+    return -1;
+  s->flags = flags;
+  s->tar = -1;
+  s->held = -1;
+  s->fd = open( filename, O_RDONLY );
+  if ( s->fd < 0 ) {
+    free( s );
+    return -2;
+  }
+  int ret = (( s->in = malloc( MC_STREAM_IN ) ) == NULL ) ? -1 : _input( s );
+
+  // what it is, from the first bytes
+  unsigned char const* const m = s->in;
+  const size_t len = s->in_len;
+  if ( ret != 0 )
+    s->compression = MC_UNCOMPRESSED;
+  else if (( len >= 2 ) && ( m[0] == 0x1f ) && ( m[1] == 0x8b ) )
+    s->compression = MC_GZIP;
+  else if (( len >= 4 ) && ( memcmp( m, "\x28\xb5\x2f\xfd", 4 ) == 0 ) )
+    s->compression = MC_ZSTD;
+  else if (( len >= 6 ) && ( memcmp( m, "\xfd" "7zXZ\0", 6 ) == 0 ) )
+    s->compression = MC_XZ;
+  else
+    s->compression = MC_UNCOMPRESSED;
+
+  if ( ret == 0 ) {
+    switch ( s->compression ) {
+      case MC_UNCOMPRESSED:
+        break;
+#ifdef HAVE_ZLIB
+      case MC_GZIP:
+        // 15 + 32: the largest window, and a gzip (or zlib) header
+        ret = ( inflateInit2( &( s->z ), 15 + 32 ) == Z_OK ) ? 0 : -1;
+        break;
+#endif
+#ifdef HAVE_ZSTD
+      case MC_ZSTD:
+        s->zstd = ZSTD_createDStream();
+        ret = (( s->zstd != NULL ) && !ZSTD_isError( ZSTD_initDStream( s->zstd ) ) ) ? 0 : -1;
+        s->zstd_hint = 1;
+        break;
+#endif
+#ifdef HAVE_LZMA
+      case MC_XZ:
+      {
+        const lzma_stream init = LZMA_STREAM_INIT;
+        s->xz = init;
+        ret = ( lzma_stream_decoder( &( s->xz ), UINT64_MAX, LZMA_CONCATENATED ) == LZMA_OK ) ? 0 : -1;
+        break;
+      }
+#endif
+      default:
+        ret = -15;  // not built with this library
+    }
+    s->decoder = ( ret == 0 );
+  }
+
+  s->blocks = 1;
+#ifdef HAVE_PTHREAD
+  s->blocks = MC_STREAM_BLOCKS;
+#endif
+  for ( int b = 0; ( ret == 0 ) && ( b < s->blocks ); b++ ) {
+    if (( s->block[b] = malloc( MC_STREAM_BLOCK ) ) == NULL )
+      ret = -1;
+  }
+#ifdef HAVE_PTHREAD
+  if ( ret == 0 ) {
+    pthread_mutex_init( &( s->lock ), NULL );
+    pthread_cond_init( &( s->cond ), NULL );
+    s->threaded = ( pthread_create( &( s->thread ), NULL, _reader, s ) == 0 );
+    if ( !s->threaded ) {  // read in this thread then
+      pthread_mutex_destroy( &( s->lock ) );
+      pthread_cond_destroy( &( s->cond ) );
+    }
+  }
+#endif
+  if ( ret != 0 ) {
+    mc_stream_close( s );
+    return ret;
+  }
+  *out = s;
+  return 0;
+}
+
+int mc_stream_next( struct mc_stream_t* s, char const** p, size_t* len ) {
+  if ( s->done != 0 )
+    return s->done;
+  const int b = s->next;
+#ifdef HAVE_PTHREAD
+  if ( s->threaded ) {
+    pthread_mutex_lock( &( s->lock ) );
+    if ( s->held >= 0 ) {  // hand the last one back
+      s->full[s->held] = 0;
+      pthread_cond_broadcast( &( s->cond ) );
+    }
+    while ( !s->full[b] )
+      pthread_cond_wait( &( s->cond ), &( s->lock ) );
+    pthread_mutex_unlock( &( s->lock ) );
+  }
+  else
+#endif
+    _fill_block( s, b );
+  s->held = b;
+  s->next = ( b + 1 ) % s->blocks;
+
+  if ( s->ret[b] < 0 )
+    return s->done = s->ret[b];
+  s->done = s->ret[b];  // the end comes after this block's data
+  if ( s->len[b] == 0 )
+    return 1;
+  *p = s->block[b];
+  *len = s->len[b];
+  return 0;
+}
+
+void mc_stream_close( struct mc_stream_t* s ) {
+  if ( s == NULL )
+    return;
+#ifdef HAVE_PTHREAD
+  if ( s->threaded ) {
+    pthread_mutex_lock( &( s->lock ) );
+    s->stop = 1;
+    pthread_cond_broadcast( &( s->cond ) );
+    pthread_mutex_unlock( &( s->lock ) );
+    pthread_join( s->thread, NULL );
+    pthread_mutex_destroy( &( s->lock ) );
+    pthread_cond_destroy( &( s->cond ) );
+  }
+#endif
+  if ( s->decoder ) {
+    switch ( s->compression ) {
+#ifdef HAVE_ZLIB
+      case MC_GZIP:
+        inflateEnd( &( s->z ) );
+        break;
+#endif
+#ifdef HAVE_ZSTD
+      case MC_ZSTD:
+        ZSTD_freeDStream( s->zstd );
+        break;
+#endif
+#ifdef HAVE_LZMA
+      case MC_XZ:
+        lzma_end( &( s->xz ) );
+        break;
+#endif
+      default:
+        break;
+    }
+  }
+  for ( int b = 0; b < MC_STREAM_BLOCKS; b++ )
+    free( s->block[b] );
+  free( s->in );
+  free( s->scratch );
+  free( s->name );
+  close( s->fd );
+  free( s );
+}
@@ -0,0 +1,62 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _STREAM_H_
+#define _STREAM_H_
+
+#include "config.h"
+#include <stddef.h>
+
+// decompressing file reader, for matrices that are kept compressed
+//
+// gzip (.gz, .tgz), zstd (.zst) and xz (.xz) are recognized from the first
+// bytes of the file, whatever its name, when the library is available
+// (HAVE_ZLIB, HAVE_ZSTD, HAVE_LZMA)
+// a tar archive (compressed or not) is recognized too, and only one member
+// is read from it: a SuiteSparse archive's matrix, "Name/Name.mtx", or with
+// MC_STREAM_ANY_MTX the first "*.mtx"
+//
+// the data comes out in large blocks; with pthreads a reader thread
+// decompresses the next blocks while the caller works on this one
+
+#define MC_STREAM_BLOCK ( 4 << 20 ) // bytes per block
+#define MC_STREAM_BLOCKS 3          // blocks in flight (with the reader thread)
+
+enum mc_compression_t { MC_UNCOMPRESSED = 0, MC_GZIP, MC_ZSTD, MC_XZ };
+enum mc_stream_flags_t { MC_STREAM_ANY_MTX = 1 };
+
+struct mc_stream_t;
+
+// what the file's first bytes say it is
+// returns the compression (mc_compression_t) and sets *tar if it is an
+// (uncompressed) tar archive, -2 if the file can't be read
+int mc_stream_detect( char const* filename, int* tar );
+
+// returns 0 on success, -1 malloc failure, -2 can't open the file,
+//   -15 the compression isn't supported by this build
+int mc_stream_open( char const* filename, unsigned int flags, struct mc_stream_t** s );
+
+// the next block of data: '*p' holds '*len' bytes, until the next call
+// returns 0 on success, 1 at the end of the data, <0 on failure
+//   (-1 malloc failure, -2 read error, -13 corrupt or truncated compressed
+//   data, -14 no matching member in the archive)
+int mc_stream_next( struct mc_stream_t* s, char const** p, size_t* len );
+
+void mc_stream_close( struct mc_stream_t* s );
+
+#endif
@@ -68,8 +68,10 @@ int get_omp_num_threads()
 
 /** \brief Print configuration
  *
+ * \param stats structure of A (see matrix_stats()), not shown if NULL
  */
-void print_verbose_output(struct parse_args* args, matrix_t* A, matrix_t* b, matrix_t* expected, int c_mpi, int c_omp) {
+void print_verbose_output(struct parse_args* args, matrix_t* A, struct matrix_stats_t const* stats, matrix_t* b,
+                          matrix_t* expected, int c_mpi, int c_omp) {
   const int false = 0;
   assert(A != NULL);
   int ierr = convert_matrix(A, SM_COO, FIRST_INDEX_ZERO);
@@ -134,6 +136,8 @@ void print_verbose_output(struct parse_args* args, matrix_t* A, matrix_t* b, mat
 //             c_mpi == 1 ? "" : "s", c_omp, c_omp == 1 ? "" : "s");
   printf("\n====================== Configuration ======================\n");
   printf("                A: %zu x %zu, nz=%zu, %s%s, %s\n", A->m, A->n, A->nz, sym, location, type);
+  if (stats != NULL)
+    matrix_stats_printf(stats);
   printf("                b: %zu x %zu, nz=%zu\n", b->m, b->n, b->nz);
   if (expected->format != INVALID)
   {
@@ -30,6 +30,7 @@
 //#include "perftimer.h"
 //#include "file.h"
 #include "matrix.h"
+#include "stats.h"
 //#include "solvers.h"
 
 
@@ -54,7 +55,9 @@ int get_omp_num_threads();
 
 /** \brief Print configuration
  *
+ * \param stats structure of A (see matrix_stats()), not shown if NULL
  */
-void print_verbose_output(struct parse_args* args, matrix_t* A, matrix_t* b, matrix_t* expected, int c_mpi, int c_omp);
+void print_verbose_output(struct parse_args* args, matrix_t* A, struct matrix_stats_t const* stats, matrix_t* b,
+                          matrix_t* expected, int c_mpi, int c_omp);
 
 #endif /* SRC_UTIL_H_ */
@@ -0,0 +1,285 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// micro-benchmark for the sparse format conversions (COO <-> CSR <-> CSC)
+//
+// compares the native counting-sort conversions in matrix.c against the
+// BeBOP round-trip they replaced (kept here as a reference implementation)
+//
+// usage: bench-convert [rows] [non-zeros per row] [repetitions] [base: 0/1]
+//
+// reported "bytes" are the sizes of the input and output arrays (ii, jj, dd),
+// the minimum traffic any conversion has to do, so GB/s is an effective
+// bandwidth that can be compared between the two implementations
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include "matrix.h"
+
+#include <bebop/util/enumerations.h>
+#include <bebop/smc/sparse_matrix.h>
+#include <bebop/smc/sparse_matrix_ops.h>
+#include <bebop/smc/coo_matrix.h>
+#include <bebop/smc/csr_matrix.h>
+#include <bebop/smc/csc_matrix.h>
+
+static double now();
+static size_t matrix_bytes( matrix_t const* m );
+static matrix_t* build_random_coo( size_t rows, size_t k, enum matrix_base_t base );
+static int bebop_convert( matrix_t* m, enum matrix_format_t f );
+
+static double now() {
+  struct timespec t;
+  clock_gettime( CLOCK_MONOTONIC, &t );
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// bytes held in ii, jj, dd for the current format
+static size_t matrix_bytes( matrix_t const* m ) {
+  const size_t dd = m->nz * _data_width( m->data_type );
+  const size_t idx = sizeof( unsigned int );
+  switch ( m->format ) {
+    case SM_COO:
+      return dd + 2 * m->nz * idx;
+    case SM_CSR:
+      return dd + ( m->nz + m->m + 1 ) * idx;
+    case SM_CSC:
+      return dd + ( m->nz + m->n + 1 ) * idx;
+    default:
+      return dd;
+  }
+}
+
+// square matrix, 'k' entries per row at pseudo-random columns,
+// entries shuffled so the COO input is unsorted
+static matrix_t* build_random_coo( size_t rows, size_t k, enum matrix_base_t base ) {
+  matrix_t* m = malloc_matrix();
+  assert( m != NULL );
+  *m = ( matrix_t ) {
+    0
+  };
+  m->m = m->n = rows;
+  m->nz = rows * k;
+  m->base = base;
+  m->format = SM_COO;
+  m->data_type = REAL_DOUBLE;
+  m->ii = malloc( m->nz * sizeof( unsigned int ) );
+  m->jj = malloc( m->nz * sizeof( unsigned int ) );
+  m->dd = malloc( m->nz * sizeof( double ) );
+  assert(( m->ii != NULL ) && ( m->jj != NULL ) && ( m->dd != NULL ) );
+
+  unsigned long long s = 12345;
+  double* d = m->dd;
+  for ( size_t i = 0; i < rows; i++ ) {
+    for ( size_t j = 0; j < k; j++ ) {
+      s = s * 6364136223846793005ULL + 1442695040888963407ULL;
+      // spread columns across the row without repeats: stride by rows/k
+      const size_t c = ( j * ( rows / k ) + ( s >> 33 ) % ( rows / k ) ) % rows;
+      m->ii[i * k + j] = i + base;
+      m->jj[i * k + j] = c + base;
+      d[i * k + j] = ( double )( s >> 40 );
+    }
+  }
+  // Fisher-Yates shuffle
+  for ( size_t i = m->nz - 1; i > 0; i-- ) {
+    s = s * 6364136223846793005ULL + 1442695040888963407ULL;
+    const size_t j = ( s >> 33 ) % ( i + 1 );
+    unsigned int t = m->ii[i];
+    m->ii[i] = m->ii[j];
+    m->ii[j] = t;
+    t = m->jj[i];
+    m->jj[i] = m->jj[j];
+    m->jj[j] = t;
+    const double td = d[i];
+    d[i] = d[j];
+    d[j] = td;
+  }
+  return m;
+}
+
+// the BeBOP round-trip that matrix.c used before the native conversions:
+// shift to base zero, wrap, sparse_matrix_convert(), unwrap, shift back
+static int bebop_convert( matrix_t* m, enum matrix_format_t f ) {
+  const enum matrix_base_t old_base = m->base;
+  int ret = convert_matrix( m, m->format, FIRST_INDEX_ZERO );
+  assert( ret == 0 );
+
+  struct sparse_matrix_t A;
+  switch ( m->format ) {
+    case SM_COO:
+    {
+      struct coo_matrix_t* p = calloc( 1, sizeof( struct coo_matrix_t ) );
+      A.format = COO;
+      A.repr = p;
+      p->m = m->m;
+      p->n = m->n;
+      p->nnz = m->nz;
+      p->val = m->dd;
+      p->II = ( int* ) m->ii;
+      p->JJ = ( int* ) m->jj;
+      p->index_base = ZERO;
+      p->symmetry_type = UNSYMMETRIC;
+      p->value_type = REAL;
+      p->ownership = USER_DEALLOCATES;
+      break;
+    }
+    case SM_CSR:
+    {
+      struct csr_matrix_t* p = calloc( 1, sizeof( struct csr_matrix_t ) );
+      A.format = CSR;
+      A.repr = p;
+      p->m = m->m;
+      p->n = m->n;
+      p->nnz = m->nz;
+      p->values = m->dd;
+      p->rowptr = ( int* ) m->ii;
+      p->colidx = ( int* ) m->jj;
+      p->symmetry_type = UNSYMMETRIC;
+      p->value_type = REAL;
+      p->ownership = USER_DEALLOCATES;
+      break;
+    }
+    case SM_CSC:
+    {
+      struct csc_matrix_t* p = calloc( 1, sizeof( struct csc_matrix_t ) );
+      A.format = CSC;
+      A.repr = p;
+      p->m = m->m;
+      p->n = m->n;
+      p->nnz = m->nz;
+      p->values = m->dd;
+      p->rowidx = ( int* ) m->ii;
+      p->colptr = ( int* ) m->jj;
+      p->symmetry_type = UNSYMMETRIC;
+      p->value_type = REAL;
+      p->ownership = USER_DEALLOCATES;
+      break;
+    }
+    default:
+      assert( 0 ); // only sparse formats are benchmarked
+  }
+
+  void* dd_old = m->dd;
+  void* ii_old = m->ii;
+  void* jj_old = m->jj;
+  int ierr = sparse_matrix_convert( &A, ( f == SM_COO ) ? COO : (( f == SM_CSR ) ? CSR : CSC ) );
+  assert( ierr == 0 );
+
+  switch ( f ) {
+    case SM_COO:
+    {
+      struct coo_matrix_t* p = A.repr;
+      m->ii = ( unsigned int* ) p->II;
+      m->jj = ( unsigned int* ) p->JJ;
+      m->dd = p->val;
+      break;
+    }
+    case SM_CSR:
+    {
+      struct csr_matrix_t* p = A.repr;
+      m->ii = ( unsigned int* ) p->rowptr;
+      m->jj = ( unsigned int* ) p->colidx;
+      m->dd = p->values;
+      break;
+    }
+    case SM_CSC:
+    {
+      struct csc_matrix_t* p = A.repr;
+      m->ii = ( unsigned int* ) p->rowidx;
+      m->jj = ( unsigned int* ) p->colptr;
+      m->dd = p->values;
+      break;
+    }
+    default:
+      assert( 0 );
+  }
+  m->format = f;
+  free( A.repr );
+  free( dd_old );
+  free( ii_old );
+  free( jj_old );
+
+  ret = convert_matrix( m, m->format, old_base );
+  assert( ret == 0 );
+  return 0;
+}
+
+struct bench_case_t {
+  const char* name;
+  enum matrix_format_t from;
+  enum matrix_format_t to;
+};
+
+int main( int argc, char **argv ) {
+  const size_t rows = ( argc > 1 ) ? strtoul( argv[1], NULL, 10 ) : 1000000;
+  const size_t k = ( argc > 2 ) ? strtoul( argv[2], NULL, 10 ) : 16;
+  const int reps = ( argc > 3 ) ? atoi( argv[3] ) : 5;
+  const enum matrix_base_t base = ( argc > 4 ) ? atoi( argv[4] ) : FIRST_INDEX_ONE;
+  assert(( rows >= k ) && ( k > 0 ) && ( reps > 0 ) );
+
+  const struct bench_case_t cases[] = {
+    { "COO -> CSR", SM_COO, SM_CSR },
+    { "COO -> CSC", SM_COO, SM_CSC },
+    { "CSR -> COO", SM_CSR, SM_COO },
+    { "CSC -> COO", SM_CSC, SM_COO },
+    { "CSR -> CSC", SM_CSR, SM_CSC },
+    { "CSC -> CSR", SM_CSC, SM_CSR },
+    { NULL }
+  };
+
+  matrix_t* a = build_random_coo( rows, k, base );
+  printf( "%zux%zu, nz=%zu, base %d, best of %d\n", a->m, a->n, a->nz, base, reps );
+  printf( "%-12s %-8s %12s %12s %10s\n", "conversion", "path", "time (ms)", "bytes (MB)", "GB/s" );
+
+  for ( int c = 0; cases[c].name != NULL; c++ ) {
+    matrix_t* src = copy_matrix( a );
+    assert( src != NULL );
+    int ret = convert_matrix( src, cases[c].from, base );
+    assert( ret == 0 );
+
+    for ( int path = 0; path < 2; path++ ) {
+      double best = -1.0;
+      size_t bytes = 0;
+      for ( int r = 0; r < reps; r++ ) {
+        matrix_t* m = copy_matrix( src );
+        assert( m != NULL );
+        bytes = matrix_bytes( m );
+        const double t0 = now();
+        if ( path == 0 )
+          ret = convert_matrix( m, cases[c].to, base );
+        else
+          ret = bebop_convert( m, cases[c].to );
+        const double t = now() - t0;
+        assert( ret == 0 );
+        bytes += matrix_bytes( m );
+        if (( best < 0.0 ) || ( t < best ) )
+          best = t;
+        free_matrix( m );
+      }
+      printf( "%-12s %-8s %12.3f %12.1f %10.2f\n", cases[c].name, ( path == 0 ) ? "native" : "bebop",
+              best * 1e3, bytes / 1e6, bytes / best / 1e9 );
+    }
+    free_matrix( src );
+  }
+
+  free_matrix( a );
+  return 0;
+}
@@ -0,0 +1,213 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// micro-benchmark for the MatrixMarket reader
+//
+// compares readmm() (mmap-ed file, hand-rolled number parsing) against the
+// fgets()/sscanf() reader it replaced (kept here as a reference
+// implementation), and checks that both give the same values, bit for bit
+//
+// usage: bench-readmm [rows] [non-zeros per row] [repetitions] [printf format]
+//        bench-readmm file.mtx [repetitions]
+//
+// without a file, a random real general matrix is written to a temporary
+// file first, values printed with the given format (default "%.17g")
+// MB/s is the file size over the best time; the file is read once first, so
+// it is in the page cache and what's measured is the parsing
+// with OpenMP, readmm() is timed with 1, 2, 4, ... OMP_NUM_THREADS threads
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <assert.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "matrix.h"
+#include "readmm.h"
+
+static double now();
+static void write_random_mtx( const char* filename, size_t rows, size_t k, const char* format );
+static int reference_readmm( const char* filename, matrix_t* A );
+
+static double now() {
+  struct timespec t;
+  clock_gettime( CLOCK_MONOTONIC, &t );
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// square, 'k' entries per row at pseudo-random columns, values spread over
+// many magnitudes
+static void write_random_mtx( const char* filename, size_t rows, size_t k, const char* format ) {
+  FILE* f = fopen( filename, "w" );
+  assert( f != NULL );
+  fprintf( f, "%%%%MatrixMarket matrix coordinate real general\n" );
+  fprintf( f, "%% bench-readmm: %zu rows, %zu per row, '%s'\n", rows, k, format );
+  fprintf( f, "%zu %zu %zu\n", rows, rows, rows * k );
+  unsigned long long s = 12345;
+  for ( size_t i = 0; i < rows; i++ ) {
+    for ( size_t j = 0; j < k; j++ ) {
+      s = s * 6364136223846793005ULL + 1442695040888963407ULL;
+      const size_t c = ( s >> 33 ) % rows;
+      const double v = (( double )( s >> 11 ) / ( 1ULL << 53 ) - 0.5 ) * ( 1ULL << ( s % 40 ) );
+      fprintf( f, "%zu %zu ", i + 1, c + 1 );
+      fprintf( f, format, v );
+      fprintf( f, "\n" );
+    }
+  }
+  fclose( f );
+}
+
+// the fgets()/sscanf() reader readmm() replaced, for real general
+// coordinate files: 1024 character lines, each token checked by hand and then
+// converted by sscanf()
+static int reference_readmm( const char* filename, matrix_t* A ) {
+  FILE* f = fopen( filename, "r" );
+  if ( f == NULL )
+    return -2;
+  char line[1025];
+  do {
+    if ( fgets( line, sizeof( line ), f ) == NULL ) {
+      fclose( f );
+      return -11;
+    }
+  }
+  while ( line[0] == '%' );
+  int rows, cols, nz;
+  if ( sscanf( line, "%d %d %d", &rows, &cols, &nz ) != 3 ) {
+    fclose( f );
+    return -12;
+  }
+  clear_matrix( A );
+  A->m = rows;
+  A->n = cols;
+  A->nz = nz;
+  A->base = FIRST_INDEX_ONE;
+  A->format = SM_COO;
+  A->data_type = REAL_DOUBLE;
+  A->ii = malloc( nz * sizeof( unsigned int ) );
+  A->jj = malloc( nz * sizeof( unsigned int ) );
+  A->dd = malloc( nz * sizeof( double ) );
+  assert(( A->ii != NULL ) && ( A->jj != NULL ) && ( A->dd != NULL ) );
+  double* d = A->dd;
+  for ( int k = 0; k < nz; k++ ) {
+    if ( fgets( line, sizeof( line ), f ) == NULL ) {
+      fclose( f );
+      return -6;
+    }
+    char* p = line;
+    int* const out[] = { ( int* ) A->ii + k, ( int* ) A->jj + k };
+    for ( int t = 0; t < 3; t++ ) {
+      while (( *p == ' ' ) || ( *p == '\t' ) )
+        p++;
+      char* const s = p;
+      while (( *p >= '0' && *p <= '9' ) || ( *p == '.' ) || ( *p == 'e' ) || ( *p == 'E' ) || ( *p == '-' ) || ( *p == '+' ) )
+        p++;
+      if (( p == s ) || (( t < 2 ) ? sscanf( s, "%d", out[t] ) : sscanf( s, "%lg", d + k ) ) != 1 ) {
+        fclose( f );
+        return -21;
+      }
+    }
+  }
+  fclose( f );
+  return 0;
+}
+
+int main( int argc, char **argv ) {
+  const char* filename;
+  char tmp[] = "bench-readmm.XXXXXX";
+  int reps;
+  if (( argc > 1 ) && ( strstr( argv[1], ".mtx" ) != NULL ) ) {
+    filename = argv[1];
+    reps = ( argc > 2 ) ? atoi( argv[2] ) : 3;
+  }
+  else {
+    const size_t rows = ( argc > 1 ) ? strtoul( argv[1], NULL, 10 ) : 200000;
+    const size_t k = ( argc > 2 ) ? strtoul( argv[2], NULL, 10 ) : 16;
+    reps = ( argc > 3 ) ? atoi( argv[3] ) : 3;
+    const char* format = ( argc > 4 ) ? argv[4] : "%.17g";
+    const int fd = mkstemp( tmp );
+    assert( fd >= 0 );
+    close( fd );
+    filename = tmp;
+    write_random_mtx( filename, rows, k, format );
+  }
+  assert( reps > 0 );
+
+  struct stat st;
+  int ret = stat( filename, &st );
+  assert( ret == 0 );
+  const double mb = st.st_size / 1e6;
+
+  matrix_t* A = malloc_matrix();
+  matrix_t* B = malloc_matrix();
+  assert(( A != NULL ) && ( B != NULL ) );
+  ret = readmm( filename, A, NULL );  // warm up the page cache
+  if ( ret != 0 ) {
+    fprintf( stderr, "%s: %s\n", filename, readmm_strerror( ret ) );
+    return 1;
+  }
+  printf( "%s: %.1f MB, %zux%zu, nz=%zu, best of %d\n", filename, mb, A->m, A->n, A->nz, reps );
+  printf( "%-16s %8s %12s %10s\n", "reader", "threads", "time (ms)", "MB/s" );
+
+  int max_threads = 1;
+#ifdef _OPENMP
+  max_threads = omp_get_max_threads();
+#endif
+  const int have_reference = ( A->format == SM_COO ) && ( A->data_type == REAL_DOUBLE );
+  for ( int threads = 1; threads <= 2 * max_threads; threads *= 2 ) {
+    // readmm() with 1, 2, 4, ... threads and max_threads, then the reference
+    const int path = ( threads > max_threads ) ? 1 : 0;
+    if (( path == 1 ) && !have_reference )
+      break;
+    if (( path == 0 ) && ( threads * 2 > max_threads ) )
+      threads = max_threads;
+#ifdef _OPENMP
+    omp_set_num_threads( threads );
+#endif
+    double best = -1.0;
+    for ( int r = 0; r < reps; r++ ) {
+      const double t0 = now();
+      ret = ( path == 0 ) ? readmm( filename, A, NULL ) : reference_readmm( filename, B );
+      const double t = now() - t0;
+      assert( ret == 0 );
+      if (( best < 0.0 ) || ( t < best ) )
+        best = t;
+    }
+    printf( "%-16s %8d %12.3f %10.1f\n", ( path == 0 ) ? "readmm (mmap)" : "fgets/sscanf", ( path == 0 ) ? threads : 1,
+            best * 1e3, mb / best );
+  }
+
+  if ( have_reference ) {
+    const int same = ( A->nz == B->nz ) &&
+                     ( memcmp( A->ii, B->ii, A->nz * sizeof( unsigned int ) ) == 0 ) &&
+                     ( memcmp( A->jj, B->jj, A->nz * sizeof( unsigned int ) ) == 0 ) &&
+                     ( memcmp( A->dd, B->dd, A->nz * sizeof( double ) ) == 0 );
+    printf( "identical to the reference: %s\n", same ? "yes" : "NO" );
+    ret = !same;
+  }
+
+  free_matrix( A );
+  free_matrix( B );
+  if ( filename == tmp )
+    unlink( tmp );
+  return ret;
+}
@@ -0,0 +1,174 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+// micro-benchmark for the sparse matrix-vector products (spmv.c)
+//
+// times y = A*x for each storage format and each kernel this CPU can run,
+// on a FEM-like matrix: 'dof' unknowns per node, each node coupled to
+// 'k' pseudo-random nodes (dense dof x dof blocks, so BCSR has something
+// to find)
+//
+// usage: bench-spmv [nodes] [coupled nodes per node] [dof] [right-hand sides] [repetitions]
+//
+// GFLOP/s counts 2 flops per stored entry (zero fill included for BCSR) and
+// right-hand side; "bytes" are A's arrays plus x and y read/written once, the
+// minimum traffic, so GB/s is an effective bandwidth
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <assert.h>
+#include "matrix.h"
+#include "spmv.h"
+
+static double now();
+static size_t matrix_bytes( matrix_t const* m );
+static matrix_t* build_fem_coo( size_t nodes, size_t k, size_t dof );
+static matrix_t* build_dense( size_t m, size_t nrhs );
+
+static double now() {
+  struct timespec t;
+  clock_gettime( CLOCK_MONOTONIC, &t );
+  return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// bytes held in ii, jj, dd for the current format
+static size_t matrix_bytes( matrix_t const* m ) {
+  const size_t dd = m->nz * _data_width( m->data_type );
+  const size_t idx = sizeof( unsigned int );
+  switch ( m->format ) {
+    case SM_COO:
+      return dd + 2 * m->nz * idx;
+    case SM_CSR:
+      return dd + ( m->nz + m->m + 1 ) * idx;
+    case SM_CSC:
+      return dd + ( m->nz + m->n + 1 ) * idx;
+    case SM_BCSR: {
+      const size_t bs = m->block_size;
+      return dd + ( m->nz / ( bs * bs ) + ( m->m + bs - 1 ) / bs + 1 ) * idx;
+    }
+    default:
+      return dd;
+  }
+}
+
+static matrix_t* build_fem_coo( size_t nodes, size_t k, size_t dof ) {
+  matrix_t* m = malloc_matrix();
+  assert( m != NULL );
+  *m = ( matrix_t ) {
+    0
+  };
+  m->m = m->n = nodes * dof;
+  m->nz = nodes * k * dof * dof;
+  m->format = SM_COO;
+  m->data_type = REAL_DOUBLE;
+  m->ii = malloc( m->nz * sizeof( unsigned int ) );
+  m->jj = malloc( m->nz * sizeof( unsigned int ) );
+  m->dd = malloc( m->nz * sizeof( double ) );
+  assert(( m->ii != NULL ) && ( m->jj != NULL ) && ( m->dd != NULL ) );
+
+  unsigned long long s = 12345;
+  double* d = m->dd;
+  size_t e = 0;
+  for ( size_t i = 0; i < nodes; i++ ) {
+    for ( size_t j = 0; j < k; j++ ) {
+      s = s * 6364136223846793005ULL + 1442695040888963407ULL;
+      // the node itself, then neighbours spread along the diagonal band, without repeats
+      const size_t c = ( j == 0 ) ? i : ( i + j * ( nodes / k ) + ( s >> 33 ) % ( nodes / k ) ) % nodes;
+      for ( size_t r = 0; r < dof * dof; r++ ) {
+        m->ii[e] = i * dof + r / dof;
+        m->jj[e] = c * dof + r % dof;
+        d[e] = 1.0 + ( double )(( s >> 40 ) % 100 ) / 10.0;
+        e++;
+      }
+    }
+  }
+  assert( e == m->nz );
+  assert( merge_duplicate_entries( m ) == 0 );  // neighbours can collide with the node itself
+  return m;
+}
+
+static matrix_t* build_dense( size_t m, size_t nrhs ) {
+  matrix_t* x = malloc_matrix();
+  assert( x != NULL );
+  *x = ( matrix_t ) {
+    0
+  };
+  x->m = m;
+  x->n = nrhs;
+  x->nz = m * nrhs;
+  x->format = DCOL;
+  x->data_type = REAL_DOUBLE;
+  x->dd = malloc( m * nrhs * sizeof( double ) );
+  assert( x->dd != NULL );
+  for ( size_t i = 0; i < m * nrhs; i++ )
+    (( double* ) x->dd )[i] = 1.0 / ( 1.0 + i % 17 );
+  return x;
+}
+
+int main( int argc, char **argv ) {
+  const size_t nodes = ( argc > 1 ) ? strtoul( argv[1], NULL, 10 ) : 200000;
+  const size_t k = ( argc > 2 ) ? strtoul( argv[2], NULL, 10 ) : 9;
+  const size_t dof = ( argc > 3 ) ? strtoul( argv[3], NULL, 10 ) : 3;
+  const size_t nrhs = ( argc > 4 ) ? strtoul( argv[4], NULL, 10 ) : 1;
+  const int reps = ( argc > 5 ) ? atoi( argv[5] ) : 10;
+  assert(( nodes >= k ) && ( k > 0 ) && ( dof > 0 ) && ( nrhs > 0 ) && ( reps > 0 ) );
+
+  const enum matrix_format_t formats[] = { SM_CSR, SM_BCSR, SM_CSC, SM_COO };
+  const char* format_names[] = { "CSR", "BCSR", "CSC", "COO" };
+  const enum spmv_kernel_t kernels[] = { SPMV_SCALAR, SPMV_AVX2, SPMV_AVX512 };
+
+  matrix_t* a = build_fem_coo( nodes, k, dof );
+  matrix_t* x = build_dense( a->n, nrhs );
+  matrix_t* y = build_dense( a->m, nrhs );
+  printf( "%zux%zu, nz=%zu, %zu right-hand side(s), detected block size %u, best of %d\n",
+          a->m, a->n, a->nz, nrhs, detect_matrix_block_size( a ), reps );
+  printf( "%-6s %-8s %12s %10s %10s\n", "format", "kernel", "time (ms)", "GFLOP/s", "GB/s" );
+
+  for ( int f = 0; f < 4; f++ ) {
+    matrix_t* m = copy_matrix( a );
+    assert( m != NULL );
+    assert( convert_matrix( m, formats[f], FIRST_INDEX_ZERO ) == 0 );
+    const size_t bytes = matrix_bytes( m ) + ( m->n + m->m ) * nrhs * sizeof( double );
+    for ( int kern = 0; kern < 3; kern++ ) {
+      if ( spmv_set_kernel( kernels[kern] ) != 0 )
+        continue;  // not on this CPU
+      if (( kern > 0 ) && ( formats[f] != SM_CSR ) )
+        continue;  // only the CSR path uses the SIMD kernels
+      double best = -1.0;
+      for ( int r = 0; r < reps; r++ ) {
+        const double t0 = now();
+        const int ret = spmv( m, x, y, 1.0, 0.0 );
+        const double t = now() - t0;
+        assert( ret == 0 );
+        if (( best < 0.0 ) || ( t < best ) )
+          best = t;
+      }
+      printf( "%-6s %-8s %12.3f %10.2f %10.2f\n", format_names[f],
+              ( formats[f] == SM_CSR ) ? spmv_kernel_name( kernels[kern] ) : "-",
+              best * 1e3, 2.0 * m->nz * nrhs / best / 1e9, bytes / best / 1e9 );
+    }
+    free_matrix( m );
+  }
+
+  free_matrix( a );
+  free_matrix( x );
+  free_matrix( y );
+  return 0;
+}
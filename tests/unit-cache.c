@@ -0,0 +1,220 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include "matrix.h"
+#include "stats.h"
+#include "cache.h"
+#include "unit-common.h"
+
+void check_same( matrix_t const* a, matrix_t const* b );
+void round_trip( matrix_t* a, const char* name );
+void test_formats();
+void test_errors();
+void test_paths();
+
+static const char* cache = "unit-cache.mcb";
+
+// the same matrix, stored the same way
+void check_same( matrix_t const* a, matrix_t const* b ) {
+  assert(( a->m == b->m ) && ( a->n == b->n ) && ( a->nz == b->nz ) && ( a->base == b->base ) );
+  assert(( a->format == b->format ) && ( a->sym == b->sym ) && ( a->location == b->location ) );
+  assert(( a->data_type == b->data_type ) && ( a->index_width == b->index_width ) );
+  assert(( a->complex_storage == b->complex_storage ) && ( a->flags == b->flags ) && ( a->block_size == b->block_size ) );
+  size_t ni, nj;
+  _index_lengths( a, &ni, &nj );
+  const size_t entries = (( a->format == DROW ) || ( a->format == DCOL ) ) ? a->m * a->n : a->nz;
+  const size_t dbytes = ( a->dd == NULL ) ? 0 : entries * _data_width( a->data_type );
+  assert(( dbytes == 0 ) || ( memcmp( a->dd, b->dd, dbytes ) == 0 ) );
+  if ( a->index_width == MC_INDEX_64 ) {
+    assert(( ni == 0 ) || ( memcmp( a->ii64, b->ii64, ni * sizeof( uint64_t ) ) == 0 ) );
+    assert(( nj == 0 ) || ( memcmp( a->jj64, b->jj64, nj * sizeof( uint64_t ) ) == 0 ) );
+  }
+  else {
+    assert(( ni == 0 ) || ( memcmp( a->ii, b->ii, ni * sizeof( unsigned int ) ) == 0 ) );
+    assert(( nj == 0 ) || ( memcmp( a->jj, b->jj, nj * sizeof( unsigned int ) ) == 0 ) );
+  }
+}
+
+// write, read back: the same matrix, in the file's memory, with its statistics
+void round_trip( matrix_t* a, const char* name ) {
+  struct matrix_stats_t s, t;
+  assert( matrix_stats( a, &s ) == 0 );
+  const int ret = matrix_cache_write( cache, a, NULL, NULL );
+  if ( ret != 0 )
+    printf( "%s: %s\n", name, matrix_cache_strerror( ret ) );
+  assert( ret == 0 );
+
+  matrix_t* b = malloc_matrix();
+  assert( b != NULL );
+  assert( matrix_cache_read( cache, b, &t, NULL ) == 0 );
+  assert( b->owner == MC_OWN_BORROWED );
+  check_same( a, b );
+  assert( memcmp( &s, &t, sizeof( s ) ) == 0 );
+  // the arrays are aligned in the mapping
+  assert((( size_t ) b->dd % 64 == 0 ) && (( size_t ) b->ii % 64 == 0 ) && (( size_t ) b->jj % 64 == 0 ) );
+  assert((( size_t ) b->ii64 % 64 == 0 ) && (( size_t ) b->jj64 % 64 == 0 ) );
+
+  // converting borrowed arrays copies them: the same answer as the original
+  if (( a->format != DROW ) && ( a->format != DCOL ) && ( a->nz > 0 ) ) {
+    matrix_t* c = copy_matrix( a );
+    assert( c != NULL );
+    const enum matrix_format_t f = ( a->format == SM_CSC ) ? SM_CSR : SM_CSC;
+    assert( convert_matrix( c, f, FIRST_INDEX_ZERO ) == 0 );
+    assert( convert_matrix( b, f, FIRST_INDEX_ZERO ) == 0 );
+    assert( b->owner == MC_OWN_MALLOC );
+    check_same( c, b );
+    free_matrix( c );
+  }
+  free_matrix( b );
+  unlink( cache );
+}
+
+void test_formats() {
+  matrix_t* a = random_coo( 300, 200, 2000, REAL_DOUBLE, 0 );
+  round_trip( a, "COO" );
+  assert( detect_matrix_flags( a ) == 0 );
+  assert( merge_duplicate_entries( a ) == 0 );
+  assert( a->flags != 0 );
+  round_trip( a, "COO, merged" );
+  assert( convert_matrix( a, SM_CSR, FIRST_INDEX_ONE ) == 0 );
+  round_trip( a, "CSR, base one" );
+  assert( convert_matrix( a, SM_CSC, FIRST_INDEX_ZERO ) == 0 );
+  round_trip( a, "CSC" );
+  assert( convert_matrix_index_width( a, MC_INDEX_64 ) == 0 );
+  round_trip( a, "CSC, 64-bit" );
+  assert( convert_matrix_index_width( a, MC_INDEX_32 ) == 0 );
+  a->block_size = 3;
+  assert( convert_matrix( a, SM_BCSR, FIRST_INDEX_ZERO ) == 0 );
+  round_trip( a, "BCSR" );
+  assert( convert_matrix( a, SM_COO, FIRST_INDEX_ZERO ) == 0 );
+  assert( convert_matrix_data_type( a, COMPLEX_DOUBLE ) == 0 );
+  assert( convert_matrix_complex_storage( a, MC_COMPLEX_SPLIT ) == 0 );
+  round_trip( a, "COO, complex split" );
+  assert( convert_matrix( a, DCOL, FIRST_INDEX_ZERO ) == 0 );
+  round_trip( a, "DCOL, complex" );
+  free_matrix( a );
+
+  // symmetric, lower triangle stored, single precision
+  a = random_coo( 50, 50, 400, REAL_DOUBLE, 0 );
+  for ( size_t k = 0; k < a->nz; k++ ) {
+    if ( a->ii[k] < a->jj[k] ) {
+      const unsigned int t = a->ii[k];
+      a->ii[k] = a->jj[k];
+      a->jj[k] = t;
+    }
+  }
+  a->sym = SM_SYMMETRIC;
+  a->location = LOWER_TRIANGULAR;
+  assert( convert_matrix_data_type( a, REAL_SINGLE ) == 0 );
+  round_trip( a, "COO, symmetric, single" );
+  free_matrix( a );
+
+  a = random_coo( 10, 10, 0, REAL_DOUBLE, 0 );
+  round_trip( a, "empty" );
+  free_matrix( a );
+}
+
+void test_errors() {
+  matrix_t* a = random_coo( 100, 100, 500, REAL_DOUBLE, 0 );
+  matrix_t* b = malloc_matrix();
+  assert( b != NULL );
+  *b = ( matrix_t ) {
+    0
+  };
+  struct matrix_cache_key_t key = { 1234, 5678, 2, 9, 10 }, other = key;
+
+  assert( matrix_cache_read( "no-such-file.mcb", b, NULL, NULL ) == -2 );
+  assert( matrix_cache_write( cache, a, NULL, &key ) == 0 );
+  assert( matrix_cache_read( cache, b, NULL, &key ) == 0 );
+  clear_matrix( b );
+  other.source_mtime++;
+  assert( matrix_cache_read( cache, b, NULL, &other ) == -5 );
+  other = key;
+  other.load_flags = 0;
+  assert( matrix_cache_read( cache, b, NULL, &other ) == -5 );
+  other = key;
+  other.source_ino++;  // another file, of the same name, size and time
+  assert( matrix_cache_read( cache, b, NULL, &other ) == -5 );
+  assert( b->format == INVALID );  // untouched
+
+  // flip a byte of the values, then of the header
+  FILE* f = fopen( cache, "r+b" );
+  assert( f != NULL );
+  assert( fseek( f, -2000, SEEK_END ) == 0 );
+  const int c = fgetc( f );
+  assert( fseek( f, -2000, SEEK_END ) == 0 );
+  fputc( c ^ 1, f );
+  fclose( f );
+  assert( matrix_cache_read( cache, b, NULL, NULL ) == -6 );
+  f = fopen( cache, "r+b" );
+  assert( f != NULL );
+  assert( fseek( f, 40, SEEK_SET ) == 0 );
+  fputc( 0xff, f );
+  fclose( f );
+  assert( matrix_cache_read( cache, b, NULL, NULL ) == -6 );
+
+  // truncated: sizes no longer fit
+  assert( matrix_cache_write( cache, a, NULL, NULL ) == 0 );
+  int ret = truncate( cache, 1000 );  // not inside assert(): NDEBUG would skip it
+  assert( ret == 0 );
+  assert( matrix_cache_read( cache, b, NULL, NULL ) == -6 );
+  ret = truncate( cache, 10 );
+  assert( ret == 0 );
+  assert( matrix_cache_read( cache, b, NULL, NULL ) == -4 );
+
+  // not a cache at all
+  f = fopen( cache, "w" );
+  assert( f != NULL );
+  for ( int i = 0; i < 100; i++ )
+    fprintf( f, "%%%%MatrixMarket matrix coordinate real general\n" );
+  fclose( f );
+  assert( matrix_cache_read( cache, b, NULL, NULL ) == -4 );
+  assert( b->format == INVALID );
+  unlink( cache );
+
+  a->format = INVALID;
+  assert( matrix_cache_write( cache, a, NULL, NULL ) == -3 );
+  a->format = SM_COO;
+  free_matrix( a );
+  free_matrix( b );
+}
+
+void test_paths() {
+  char* p = matrix_cache_path( "dir/sub/A.mtx", NULL );
+  assert(( p != NULL ) && ( strcmp( p, "dir/sub/A.mtx.mcb" ) == 0 ) );
+  free( p );
+  p = matrix_cache_path( "dir/sub/A.mtx", "/tmp/cache" );
+  assert(( p != NULL ) && ( strcmp( p, "/tmp/cache/A.mtx.mcb" ) == 0 ) );
+  free( p );
+  assert( is_matrix_cache_file( "A.mtx.mcb" ) );
+  assert( !is_matrix_cache_file( "A.mtx" ) );
+  assert( !is_matrix_cache_file( ".mcb" ) );
+}
+
+int main( int argc, char **argv ) {
+  test_formats();
+  test_errors();
+  test_paths();
+  return 0;
+}
@@ -0,0 +1,90 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <complex.h>
+#include <assert.h>
+#include "unit-common.h"
+
+static unsigned long long seed = 12345;
+
+unsigned long long rnd64() {
+  seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+  return seed;
+}
+
+unsigned int rnd() {
+  return rnd64() >> 33;
+}
+
+matrix_t* new_coo( size_t m, size_t n, size_t nz, enum matrix_data_type_t t ) {
+  matrix_t* a = malloc_matrix();
+  assert( a != NULL );
+  *a = ( matrix_t ) {
+    0
+  };
+  a->m = m;
+  a->n = n;
+  a->nz = nz;
+  a->base = FIRST_INDEX_ZERO;
+  a->format = SM_COO;
+  a->data_type = t;
+  a->ii = malloc( nz * sizeof( unsigned int ) );
+  a->jj = malloc( nz * sizeof( unsigned int ) );
+  if ( t != SM_PATTERN )
+    a->dd = malloc( nz * _data_width( t ) );
+  assert(( a->ii != NULL ) && ( a->jj != NULL ) && (( t == SM_PATTERN ) || ( a->dd != NULL ) ) );
+  return a;
+}
+
+matrix_t* random_coo( size_t m, size_t n, size_t nz, enum matrix_data_type_t t, int lower ) {
+  assert(( t == REAL_DOUBLE ) || ( t == COMPLEX_DOUBLE ) );
+  matrix_t* a = new_coo( m, n, nz, t );
+  for ( size_t k = 0; k < nz; k++ ) {
+    unsigned int i = rnd() % m, j = rnd() % n;
+    if ( lower && ( i < j ) ) {
+      const unsigned int s = i;
+      i = j;
+      j = s;
+    }
+    a->ii[k] = i;
+    a->jj[k] = j;
+    if ( t == COMPLEX_DOUBLE )
+      (( double complex* ) a->dd )[k] = ( rnd() % 1000 ) / 100.0 - 5.0 + I * (( rnd() % 1000 ) / 100.0 - 5.0 );
+    else
+      (( double* ) a->dd )[k] = ( rnd() % 1000 ) / 100.0 - 5.0;
+  }
+  return a;
+}
+
+char* write_temp( const char* prefix, const void* data, const size_t len ) {
+  const size_t n = strlen( prefix ) + 8;
+  char* const name = malloc( n );
+  assert( name != NULL );
+  snprintf( name, n, "%s.XXXXXX", prefix );
+  const int fd = mkstemp( name );
+  assert( fd >= 0 );
+  const ssize_t wrote = ( len == 0 ) ? 0 : write( fd, data, len );
+  assert( wrote == ( ssize_t ) len );
+  close( fd );
+  return name;
+}
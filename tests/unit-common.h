@@ -0,0 +1,44 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef _UNIT_COMMON_H_
+#define _UNIT_COMMON_H_
+
+#include "matrix.h"
+
+// shared by the unit tests: reproducible random numbers, and the matrices
+// made from them
+
+// a 64-bit linear congruential generator, the same sequence every run
+unsigned long long rnd64();
+// its top 31 bits (the low bits of an LCG are the least random)
+unsigned int rnd();
+
+// an m x n COO matrix (base zero) with room for nz entries of type t, none set
+// (a pattern matrix has no values)
+matrix_t* new_coo( size_t m, size_t n, size_t nz, enum matrix_data_type_t t );
+// COO, unsorted, with some repeated entries, values in [-5, 5) (both parts of
+// a complex value); 'lower': only i >= j (square)
+matrix_t* random_coo( size_t m, size_t n, size_t nz, enum matrix_data_type_t t, int lower );
+
+// a new file in the current directory, "prefix.XXXXXX", holding 'len' bytes
+// of 'data' (none: empty)
+// returns its malloc-ed name, for the caller to unlink() and free()
+char* write_temp( const char* prefix, const void* data, const size_t len );
+
+#endif
@@ -0,0 +1,405 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#include "matrix.h"
+#include "hb.h"
+#include "unit-common.h"
+
+int load( const char* text, matrix_t* A, matrix_t* B, matrix_t* X );
+void test_readhb();
+void test_readhb_fields();
+void test_readhb_rhs();
+void test_readhb_errors();
+void test_writehb();
+
+// write 'text' to a file and read it back with readhb()
+int load( const char* text, matrix_t* A, matrix_t* B, matrix_t* X ) {
+  char* const name = write_temp( "unit-hb", text, strlen( text ) );
+  const int ret = readhb( name, A, B, X );
+  unlink( name );
+  free( name );
+  return ret;
+}
+
+void test_readhb() {
+  matrix_t* A = malloc_matrix();
+  assert( A != NULL );
+
+  // tests/test.hb: fixed width fields
+  const char* hb =
+    "Title                                                                   Key     \n"
+    "             5             1             1             3             0\n"
+    "RUA                        5             5            13             0\n"
+    "(6I3)           (13I3)          (5E15.8)            (5E15.8)            \n"
+    "  1  4  7  8 11 14\n"
+    "  1  3  5  2  3  5  3  1  3  4  3  4  5\n"
+    "11.0           31.0           51.0           22.0           32.0\n"
+    "52.0           33.0           14.0           34.0           44.0\n"
+    "35.0           45.0           55.0\n";
+  assert( load( hb, A, NULL, NULL ) == 0 );
+  assert(( A->m == 5 ) && ( A->n == 5 ) && ( A->nz == 13 ) );
+  assert(( A->format == SM_CSC ) && ( A->base == FIRST_INDEX_ONE ) );
+  assert(( A->sym == SM_UNSYMMETRIC ) && ( A->location == MC_STORE_BOTH ) );
+  assert( A->data_type == REAL_DOUBLE );
+  const unsigned int jj[] = { 1, 4, 7, 8, 11, 14 };
+  const unsigned int ii[] = { 1, 3, 5, 2, 3, 5, 3, 1, 3, 4, 3, 4, 5 };
+  const double dd[] = { 11, 31, 51, 22, 32, 52, 33, 14, 34, 44, 35, 45, 55 };
+  assert( memcmp( A->jj, jj, sizeof( jj ) ) == 0 );
+  assert( memcmp( A->ii, ii, sizeof( ii ) ) == 0 );
+  assert( memcmp( A->dd, dd, sizeof( dd ) ) == 0 );
+
+  // tests/test.rb: the pointers aren't in their format (3I6), but are
+  // separated by blanks; no newline at the end, DOS line endings
+  const char* rb =
+    "Small general matrix used as Example 1                                  EXAMPLE1\r\n"
+    "             5             1             1             3             0\r\n"
+    "rua                        5             5            11\r\n"
+    "(3I6)           (11I3)          (5E15.8)           \r\n"
+    "  1  4  6  8 10 12\r\n"
+    "  1  3  5  1  4  2  5  1  4  2  5\r\n"
+    " 1.0            2.0            3.0           -4.0            5.0\r\n"
+    "-6.0           -7.0           -8.0           -9.0            10.0\r\n"
+    "11.0";
+  assert( load( rb, A, NULL, NULL ) == 0 );
+  assert(( A->m == 5 ) && ( A->n == 5 ) && ( A->nz == 11 ) );
+  const unsigned int jj2[] = { 1, 4, 6, 8, 10, 12 };
+  const unsigned int ii2[] = { 1, 3, 5, 1, 4, 2, 5, 1, 4, 2, 5 };
+  const double dd2[] = { 1, 2, 3, -4, 5, -6, -7, -8, -9, 10, 11 };
+  assert( memcmp( A->jj, jj2, sizeof( jj2 ) ) == 0 );
+  assert( memcmp( A->ii, ii2, sizeof( ii2 ) ) == 0 );
+  assert( memcmp( A->dd, dd2, sizeof( dd2 ) ) == 0 );
+
+  // a symmetric pattern, lower triangle, Rutherford-Boeing header (four
+  // counts, no value format); fields run together with no blanks
+  const char* psa =
+    "pattern                                                                 PSA\n"
+    "             2             1             1             0\n"
+    "psa                        3             3             4             0\n"
+    "(4I1)           (4I1)\n"
+    "1345\n"
+    "1233\n";
+  assert( load( psa, A, NULL, NULL ) == 0 );
+  assert(( A->data_type == SM_PATTERN ) && ( A->dd == NULL ) );
+  assert(( A->sym == SM_SYMMETRIC ) && ( A->location == LOWER_TRIANGULAR ) );
+  const unsigned int jj3[] = { 1, 3, 4, 5 };
+  const unsigned int ii3[] = { 1, 2, 3, 3 };
+  assert( memcmp( A->jj, jj3, sizeof( jj3 ) ) == 0 );
+  assert( memcmp( A->ii, ii3, sizeof( ii3 ) ) == 0 );
+  assert( validate_matrix( A ) == 0 );
+
+  free_matrix( A );
+}
+
+// Fortran's number formats: D exponents, exponents with no letter, implied
+// decimal places, scale factors, blanks inside a field, blank fields
+void test_readhb_fields() {
+  matrix_t* A = malloc_matrix();
+  assert( A != NULL );
+  const char* f =
+    "fields\n"
+    "             5             1             1             3\n"
+    "RUA                        1             7             7\n"
+    "(8I2)           (7I2)           (1P3E10.3)\n"
+    " 1 2 3 4 5 6 7 8\n"
+    " 1 1 1 1 1 1 1\n"
+    " 1.5D+02  -2.5-001       1 5  \n"
+    "  12345      1.5e1   -1.25\n"
+    "          \n";
+  assert( load( f, A, NULL, NULL ) == 0 );
+  assert(( A->m == 1 ) && ( A->n == 7 ) && ( A->nz == 7 ) );
+  // 1.5D+02, 2.5-001 (E-001), "1 5" (15, 3 implied decimals, 1P: 0.0015),
+  // 12345 (12.345, 1P: 1.2345), 1.5e1 (an exponent: no scaling),
+  // -1.25 (a decimal point: -0.125), blank (zero)
+  const double dd[] = { 150, -0.25, 0.0015, 1.2345, 15, -0.125, 0 };
+  for ( int i = 0; i < 7; i++ ) {
+    if ( (( double* ) A->dd )[i] != dd[i] )
+      printf( "value %d: read %.17g, expected %.17g\n", i, (( double* ) A->dd )[i], dd[i] );
+    assert( (( double* ) A->dd )[i] == dd[i] );
+  }
+  free_matrix( A );
+}
+
+// a complex Hermitian matrix with right-hand sides, starting guesses and
+// solutions ("FGX")
+void test_readhb_rhs() {
+  matrix_t* A = malloc_matrix();
+  matrix_t* B = malloc_matrix();
+  matrix_t* X = malloc_matrix();
+  assert(( A != NULL ) && ( B != NULL ) && ( X != NULL ) );
+  const char* c =
+    "complex with right-hand sides                                           CHA\n"
+    "            10             1             1             2             6\n"
+    "CHA                        2             2             3             0\n"
+    "(3I2)           (3I2)           (4E12.4)            (4F8.2)\n"
+    "FGX                        2             0\n"
+    " 1 3 4\n"
+    " 1 2 2\n"
+    "  2.0000E+00  0.0000E+00  1.0000E+00 -1.0000E+00\n"
+    "  3.0000E+00  0.0000E+00\n"
+    "    1.00    2.00    3.00    4.00\n"
+    "    5.00    6.00    7.00    8.00\n"
+    "    9.00    9.00    9.00    9.00\n"
+    "    9.00    9.00    9.00    9.00\n"
+    "   -1.00   -2.00   -3.00   -4.00\n"
+    "   -5.00   -6.00   -7.00   -8.00\n";
+  assert( load( c, A, B, X ) == 0 );
+  assert(( A->data_type == COMPLEX_DOUBLE ) && ( A->sym == SM_HERMITIAN ) && ( A->location == LOWER_TRIANGULAR ) );
+  const double dd[] = { 2, 0, 1, -1, 3, 0 };
+  assert( memcmp( A->dd, dd, sizeof( dd ) ) == 0 );
+  assert(( B->format == DCOL ) && ( B->m == 2 ) && ( B->n == 2 ) && ( B->data_type == COMPLEX_DOUBLE ) );
+  assert(( X->format == DCOL ) && ( X->m == 2 ) && ( X->n == 2 ) && ( X->data_type == COMPLEX_DOUBLE ) );
+  for ( int i = 0; i < 8; i++ ) {
+    assert( (( double* ) B->dd )[i] == i + 1 );
+    assert( (( double* ) X->dd )[i] == -( i + 1 ) );
+  }
+
+  // without asking for them, the right-hand sides don't matter
+  assert( load( c, A, NULL, NULL ) == 0 );
+  assert( A->nz == 3 );
+
+  // no right-hand sides: B, X cleared
+  const char* none =
+    "no right-hand sides\n"
+    "             3             1             1             1             0\n"
+    "RUA                        1             1             1             0\n"
+    "(2I2)           (1I2)           (1E8.1)\n"
+    " 1 2\n"
+    " 1\n"
+    "     4.0\n";
+  assert( load( none, A, B, X ) == 0 );
+  assert(( B->m == 0 ) && ( B->n == 0 ) && ( B->dd == NULL ) );
+  assert(( X->m == 0 ) && ( X->n == 0 ) && ( X->dd == NULL ) );
+  assert( (( double* ) A->dd )[0] == 4.0 );
+
+  free_matrix( A );
+  free_matrix( B );
+  free_matrix( X );
+}
+
+void test_readhb_errors() {
+  matrix_t* A = malloc_matrix();
+  matrix_t* B = malloc_matrix();
+  assert(( A != NULL ) && ( B != NULL ) );
+  const char* header =
+    "t\n"
+    "             3             1             1             1             0\n";
+  char s[1024];
+
+  struct {
+    const char* text;
+    int ret;
+  } cases[] = {
+    { "", -11 },
+    { "t\n 3 1 1 1 0\nRUA 1 1 1\n", -11 },
+    { "t\n 3 1\nRUA 1 1 1\n(2I2)\n", -12 },               // counts
+    { "t\n 3 1 1 1 0\nXUA 1 1 1\n(2I2)\n", -12 },         // type
+    { "t\n 3 1 1 1 0\nRU 1 1 1\n(2I2)\n", -12 },          // type
+    { "t\n 3 1 1 1 0\nRUA 1 1\n(2I2)\n", -12 },           // sizes
+    { "t\n 3 1 1 1 0\nRUA 1 1 2\n(2I2)\n", -12 },         // nz > m n
+    { "t\n 3 1 1 1 0\nRUE 1 1 1\n(2I2)\n", -13 },         // elemental
+    { NULL, 0 }
+  };
+  for ( int i = 0; cases[i].text != NULL; i++ ) {
+    const int ret = load( cases[i].text, A, NULL, NULL );
+    if ( ret != cases[i].ret )
+      printf( "case %d: returned %d (%s), expected %d\n", i, ret, hb_strerror( ret ), cases[i].ret );
+    assert( ret == cases[i].ret );
+  }
+
+  // the body of a 2x2 real matrix with 2 entries
+  struct {
+    const char* body;
+    int ret;
+  } body[] = {
+    { " 1 2 3\n 1 2\n 1.0 2.0\n", 0 },
+    { " 1 2 3\n 1 2\n 1.0\n", 0 },          // a short line: blank fields are zero
+    { " 1 2 3\n 1 2\n", -6 },               // no values
+    { "", -6 },                             // no pointers
+    { " 1 2 3\n 1 3\n 1.0 2.0\n", -22 },    // row out of range
+    { " 1 2 3\n 0 1\n 1.0 2.0\n", -22 },    // row 0
+    { " 1 2 3\n 1 x\n 1.0 2.0\n", -21 },    // not a number
+    { " 1 2 3\n 1 2\n 1.0 1.x\n", -22 },    // malformed
+    { " 1 3 2\n 1 2\n 1.0 2.0\n", -23 },    // pointers out of order
+    { " 2 2 3\n 1 2\n 1.0 2.0\n", -23 },    // not from 1
+    { " 1 2 2\n 1 2\n 1.0 2.0\n", -23 },    // not to nz+1
+    { NULL, 0 }
+  };
+  for ( int i = 0; body[i].body != NULL; i++ ) {
+    snprintf( s, sizeof( s ), "%sRUA                        2             2             2\n"
+              "(3I2)           (2I2)           (2E4.1)\n%s", header, body[i].body );
+    const int ret = load( s, A, NULL, NULL );
+    if ( ret != body[i].ret )
+      printf( "body %d: returned %d (%s), expected %d\n", i, ret, hb_strerror( ret ), body[i].ret );
+    assert( ret == body[i].ret );
+  }
+
+  // sparse right-hand sides
+  const char* m =
+    "t\n"
+    "             4             1             1             1             1\n"
+    "RUA                        1             1             1             0\n"
+    "(2I2)           (1I2)           (1E8.1)             (1E8.1)\n"
+    "MGX                        1             1\n"
+    " 1 2\n"
+    " 1\n"
+    "     4.0\n"
+    "     1.0\n";
+  assert( load( m, A, B, NULL ) == -14 );
+  assert( load( m, A, NULL, NULL ) == 0 );
+
+  assert( readhb( "unit-hb.does-not-exist", A, NULL, NULL ) == -2 );
+  for ( int i = -30; i <= 0; i++ )
+    assert( hb_strerror( i ) != NULL );
+  free_matrix( A );
+  free_matrix( B );
+}
+
+// a random m x n matrix in COO, 'k' entries per column
+static matrix_t* random_matrix( size_t m, size_t n, size_t k, enum matrix_data_type_t t ) {
+  matrix_t* A = new_coo( m, n, n * k, t );
+  const size_t values = ( t == COMPLEX_DOUBLE ) ? 2 : 1;
+  for ( size_t j = 0; j < n; j++ ) {
+    for ( size_t e = 0; e < k; e++ ) {
+      A->ii[j * k + e] = ( j + e * ( m / k ) ) % m;  // k different rows
+      A->jj[j * k + e] = j;
+    }
+  }
+  for ( size_t i = 0; ( t != SM_PATTERN ) && ( i < A->nz * values ); i++ ) {
+    double x;
+    const unsigned long long bits = rnd64() & 0xbfffffffffffffffULL;  // finite
+    memcpy( &x, &bits, sizeof( double ) );
+    (( double* ) A->dd )[i] = ( i % 3 == 0 ) ? x : ( double )( rnd64() >> 11 ) / ( 1ULL << ( rnd64() % 64 ) ) - 1e3;
+  }
+  return A;
+}
+
+// write A, B, X and read them back: bit for bit the same
+static void round_trip( matrix_t* A, matrix_t* B, matrix_t* X, int rutherford ) {
+  char* const name = write_temp( "unit-hb", NULL, 0 );
+  int ret = writehb( name, A, B, X, "a title that is much too long for the seventy-two columns a title may have",
+                     "KEY", rutherford );
+  if ( ret != 0 )
+    printf( "writehb: %s\n", hb_strerror( ret ) );
+  assert( ret == 0 );
+  assert(( A->format == SM_CSC ) && ( A->base == FIRST_INDEX_ONE ) );
+
+  // every line fits in 80 columns
+  FILE* f = fopen( name, "r" );
+  assert( f != NULL );
+  char line[256];
+  while ( fgets( line, sizeof( line ), f ) != NULL )
+    assert( strlen( line ) <= 81 );
+  fclose( f );
+
+  matrix_t* A2 = malloc_matrix();
+  matrix_t* B2 = malloc_matrix();
+  matrix_t* X2 = malloc_matrix();
+  assert(( A2 != NULL ) && ( B2 != NULL ) && ( X2 != NULL ) );
+  ret = readhb( name, A2, B2, X2 );
+  if ( ret != 0 )
+    printf( "readhb: %s\n", hb_strerror( ret ) );
+  assert( ret == 0 );
+  unlink( name );
+  free( name );
+
+  assert(( A2->m == A->m ) && ( A2->n == A->n ) && ( A2->nz == A->nz ) );
+  assert(( A2->sym == A->sym ) && ( A2->data_type == A->data_type ) );
+  if ( A->sym != SM_UNSYMMETRIC )
+    assert( A2->location == LOWER_TRIANGULAR );
+  assert( memcmp( A2->jj, A->jj, ( A->n + 1 ) * sizeof( unsigned int ) ) == 0 );
+  assert( memcmp( A2->ii, A->ii, A->nz * sizeof( unsigned int ) ) == 0 );
+  if ( A->data_type != SM_PATTERN )
+    assert( memcmp( A2->dd, A->dd, A->nz * _data_width( A->data_type ) ) == 0 );
+  for ( int i = 0; i < 2; i++ ) {
+    matrix_t* const M = ( i == 0 ) ? B : X;
+    matrix_t* const M2 = ( i == 0 ) ? B2 : X2;
+    if ( M == NULL ) {
+      assert( M2->dd == NULL );
+      continue;
+    }
+    assert(( M2->format == DCOL ) && ( M2->m == M->m ) && ( M2->n == M->n ) );
+    assert( memcmp( M2->dd, M->dd, M->m * M->n * _data_width( M->data_type ) ) == 0 );
+  }
+  free_matrix( A2 );
+  free_matrix( B2 );
+  free_matrix( X2 );
+}
+
+void test_writehb() {
+  const enum matrix_data_type_t types[] = { REAL_DOUBLE, COMPLEX_DOUBLE, SM_PATTERN };
+  for ( int t = 0; t < 3; t++ ) {
+    for ( int rutherford = 0; rutherford < 2; rutherford++ ) {
+      // unsymmetric, rectangular, and big enough for wide indices
+      matrix_t* A = random_matrix( 20, 20, 3, types[t] );
+      round_trip( A, NULL, NULL, rutherford );
+      free_matrix( A );
+      A = random_matrix( 123457, 50, 7, types[t] );
+      round_trip( A, NULL, NULL, rutherford );
+      free_matrix( A );
+
+      // symmetric: stored as the lower triangle, whichever was given
+      A = random_matrix( 30, 30, 4, types[t] );
+      for ( size_t i = 0; i < A->nz; i++ ) {
+        if ( A->ii[i] < A->jj[i] ) {  // upper triangle
+          const unsigned int r = A->ii[i];
+          A->ii[i] = A->jj[i];
+          A->jj[i] = r;
+        }
+      }
+      A->sym = ( types[t] == COMPLEX_DOUBLE ) ? SM_HERMITIAN : SM_SYMMETRIC;
+      A->location = LOWER_TRIANGULAR;
+      assert( convert_matrix_symmetry( A, UPPER_TRIANGULAR ) == 0 );
+      round_trip( A, NULL, NULL, rutherford );
+      free_matrix( A );
+    }
+  }
+
+  // right-hand sides and solutions (Harwell-Boeing only)
+  for ( int t = 0; t < 2; t++ ) {
+    matrix_t* A = random_matrix( 10, 10, 2, types[t] );
+    matrix_t* B = random_matrix( 10, 3, 10, types[t] );
+    matrix_t* X = random_matrix( 10, 3, 10, types[t] );
+    assert( convert_matrix( B, DCOL, FIRST_INDEX_ZERO ) == 0 );
+    round_trip( A, B, NULL, 0 );
+    round_trip( A, B, X, 0 );
+    assert( writehb( "unit-hb.never", A, B, X, NULL, NULL, 1 ) == -3 );
+    free_matrix( A );
+    free_matrix( B );
+    free_matrix( X );
+  }
+  matrix_t* A = random_matrix( 10, 10, 2, REAL_DOUBLE );
+  matrix_t* B = random_matrix( 9, 1, 9, REAL_DOUBLE );
+  assert( writehb( "unit-hb.never", A, B, NULL, NULL, NULL, 0 ) == -3 );  // rows don't match
+  free_matrix( A );
+  free_matrix( B );
+}
+
+int main( int argc, char **argv ) {
+  test_readhb();
+  test_readhb_fields();
+  test_readhb_rhs();
+  test_readhb_errors();
+  test_writehb();
+  return 0;
+}
@@ -18,8 +18,14 @@
  */
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
 #include <assert.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
 #include "matrix.h"
+#include "mempool.h"
 
 
 // prototypes
@@ -51,9 +57,48 @@ void print_matrix( matrix_t* a );
 void test_formats( matrix_t* a );
 void test_symmetry( matrix_t* a );
 void test_copy( matrix_t* a );
+void test_sparse_conversions();
+void test_transpose();
+void test_sort();
+void test_symmetry_detection();
+void test_merge_duplicates();
+void test_flags();
+void test_dense_conversions();
+void test_block_format();
+void test_symmetry_expand();
+void test_symmetry_triangles();
+void test_index_width();
+void test_single_precision();
+void test_complex();
+void test_ownership( matrix_t* a );
+matrix_t* build_coo( size_t n, size_t nz, const unsigned int* ii, const unsigned int* jj, const double* dd, enum matrix_data_type_t t );
 void test_basic();
 void build_test_matrix( matrix_t** m, int i );
+// internal to matrix.c
+int _compressed_transpose( matrix_t* m, const enum matrix_base_t b_new, int nthreads );
+int _sort_coo( matrix_t* m, const int by_col, int nthreads );
+int small_team( matrix_t* m, int what, int arg, int nthreads );
 
+// _sort_coo() (what = 0, arg = by_col) or _compressed_transpose() (what = 1,
+// arg = b_new) asking for 'nthreads' but given a team of one, as under
+// OMP_THREAD_LIMIT or OMP_DYNAMIC: nested in an active parallel region with
+// nesting off
+int small_team( matrix_t* m, int what, int arg, int nthreads ) {
+  int ret = -1;
+#ifdef _OPENMP
+  const int levels = omp_get_max_active_levels();
+  omp_set_max_active_levels( 1 );
+  #pragma omp parallel num_threads( 2 )
+  {
+    #pragma omp single
+    ret = ( what == 0 ) ? _sort_coo( m, arg, nthreads ) : _compressed_transpose( m, arg, nthreads );
+  }
+  omp_set_max_active_levels( levels );
+#else
+  ret = ( what == 0 ) ? _sort_coo( m, arg, nthreads ) : _compressed_transpose( m, arg, nthreads );
+#endif
+  return ret;
+}
 
 void print_matrix( matrix_t* a ) {
   printf( "    %zux%zu (nz:%zu) %s%s%s%s %s %s%d\n",
@@ -208,6 +253,1023 @@ void test_formats( matrix_t* a ) {
   }
   free_matrix( b );
 }
+// check the sparse conversions produce sorted rows/columns
+// starting from unsorted COO entries, in base one
+void test_sparse_conversions() {
+  printf( "sparse conversion test\n" );
+  const unsigned int ii[] = { 2, 1, 3, 1, 2 };
+  const unsigned int jj[] = { 3, 4, 1, 2, 1 };
+  const double dd[] = { 1.0, 2.0, 3.0, 4.0, 5.0 };
+  const unsigned int csr_ii[] = { 1, 3, 5, 6 };
+  const unsigned int csr_jj[] = { 2, 4, 1, 3, 1 };
+  const double csr_dd[] = { 4.0, 2.0, 5.0, 1.0, 3.0 };
+  const unsigned int csc_ii[] = { 2, 3, 1, 2, 1 };
+  const unsigned int csc_jj[] = { 1, 3, 4, 5, 6 };
+  const double csc_dd[] = { 5.0, 3.0, 4.0, 1.0, 2.0 };
+  int i;
+
+  matrix_t* a = malloc_matrix();
+  assert( a != NULL );
+  *a = ( matrix_t ) {
+    0
+  };
+  a->m = 3;
+  a->n = 4;
+  a->nz = 5;
+  a->base = FIRST_INDEX_ONE;
+  a->format = SM_COO;
+  a->data_type = REAL_DOUBLE;
+  a->ii = malloc( sizeof( ii ) );
+  a->jj = malloc( sizeof( jj ) );
+  a->dd = malloc( sizeof( dd ) );
+  assert(( a->ii != NULL ) && ( a->jj != NULL ) && ( a->dd != NULL ) );
+  memcpy( a->ii, ii, sizeof( ii ) );
+  memcpy( a->jj, jj, sizeof( jj ) );
+  memcpy( a->dd, dd, sizeof( dd ) );
+
+  matrix_t* b = copy_matrix( a );
+  assert( b != NULL );
+  assert( convert_matrix( b, SM_CSR, FIRST_INDEX_ONE ) == 0 );
+  assert( validate_matrix( b ) == 0 );
+  assert( memcmp( b->ii, csr_ii, sizeof( csr_ii ) ) == 0 );
+  assert( memcmp( b->jj, csr_jj, sizeof( csr_jj ) ) == 0 );
+  assert( memcmp( b->dd, csr_dd, sizeof( csr_dd ) ) == 0 );
+
+  // back to COO: comes out sorted by row
+  assert( convert_matrix( b, SM_COO, FIRST_INDEX_ONE ) == 0 );
+  for ( i = 0; i < 5; i++ ) {
+    assert( b->jj[i] == csr_jj[i] );
+    assert((( double* ) b->dd )[i] == csr_dd[i] );
+  }
+  assert(( b->ii[0] == 1 ) && ( b->ii[1] == 1 ) && ( b->ii[2] == 2 ) && ( b->ii[3] == 2 ) && ( b->ii[4] == 3 ) );
+  free_matrix( b );
+
+  b = copy_matrix( a );
+  assert( b != NULL );
+  assert( convert_matrix( b, SM_CSC, FIRST_INDEX_ONE ) == 0 );
+  assert( validate_matrix( b ) == 0 );
+  assert( memcmp( b->ii, csc_ii, sizeof( csc_ii ) ) == 0 );
+  assert( memcmp( b->jj, csc_jj, sizeof( csc_jj ) ) == 0 );
+  assert( memcmp( b->dd, csc_dd, sizeof( csc_dd ) ) == 0 );
+  free_matrix( b );
+
+  // base change folded into the conversion: base one COO -> base zero CSR -> base one COO
+  b = copy_matrix( a );
+  assert( b != NULL );
+  assert( convert_matrix( b, SM_CSR, FIRST_INDEX_ZERO ) == 0 );
+  assert( b->base == FIRST_INDEX_ZERO );
+  assert( validate_matrix( b ) == 0 );
+  for ( i = 0; i < 5; i++ ) {
+    assert( b->jj[i] == csr_jj[i] - 1 );
+    assert((( double* ) b->dd )[i] == csr_dd[i] );
+  }
+  for ( i = 0; i < 4; i++ )
+    assert( b->ii[i] == csr_ii[i] - 1 );
+  assert( convert_matrix( b, SM_COO, FIRST_INDEX_ONE ) == 0 );
+  assert( b->base == FIRST_INDEX_ONE );
+  for ( i = 0; i < 5; i++ )
+    assert( b->jj[i] == csr_jj[i] );
+  assert(( b->ii[0] == 1 ) && ( b->ii[1] == 1 ) && ( b->ii[2] == 2 ) && ( b->ii[3] == 2 ) && ( b->ii[4] == 3 ) );
+  // base change only
+  assert( convert_matrix( b, SM_COO, FIRST_INDEX_ZERO ) == 0 );
+  assert(( b->base == FIRST_INDEX_ZERO ) && ( b->ii[4] == 2 ) && ( b->jj[4] == 0 ) );
+  free_matrix( b );
+
+  free_matrix( a );
+}
+
+// the direct CSR <-> CSC transpose (serial and threaded) must give the same
+// arrays as going through COO, including the base shift
+void test_transpose() {
+  printf( "transpose test\n" );
+  const size_t m = 37, n = 23;
+  int i, t;
+
+  // scattered entries, some empty rows and columns
+  matrix_t* a = malloc_matrix();
+  assert( a != NULL );
+  *a = ( matrix_t ) {
+    0
+  };
+  a->m = m;
+  a->n = n;
+  a->base = FIRST_INDEX_ZERO;
+  a->format = SM_COO;
+  a->data_type = REAL_DOUBLE;
+  a->ii = malloc( m * n * sizeof( unsigned int ) );
+  a->jj = malloc( m * n * sizeof( unsigned int ) );
+  a->dd = malloc( m * n * sizeof( double ) );
+  assert(( a->ii != NULL ) && ( a->jj != NULL ) && ( a->dd != NULL ) );
+  for ( i = 0; i < m * n; i++ ) {
+    if (( i * 7919 ) % 5 == 0 && ( i / n ) % 4 != 3 ) {
+      a->ii[a->nz] = i / n;
+      a->jj[a->nz] = i % n;
+      (( double* ) a->dd )[a->nz] = ( double ) i;
+      a->nz++;
+    }
+  }
+
+  matrix_t* csr = copy_matrix( a );
+  matrix_t* csc = copy_matrix( a );
+  assert(( csr != NULL ) && ( csc != NULL ) );
+  assert( convert_matrix( csr, SM_CSR, FIRST_INDEX_ZERO ) == 0 );
+  assert( convert_matrix( csc, SM_CSC, FIRST_INDEX_ONE ) == 0 );
+
+  for ( t = 1; t <= 4; t++ ) {  // 4: asks for 3 threads, gets one
+    matrix_t* b = copy_matrix( csr );
+    assert( b != NULL );
+    if ( t == 4 )
+      assert( small_team( b, 1, FIRST_INDEX_ONE, 3 ) == 0 );
+    else
+      assert( _compressed_transpose( b, FIRST_INDEX_ONE, t ) == 0 );
+    assert( validate_matrix( b ) == 0 );
+    assert(( b->format == SM_CSC ) && ( b->base == FIRST_INDEX_ONE ) );
+    assert( memcmp( b->ii, csc->ii, a->nz * sizeof( unsigned int ) ) == 0 );
+    assert( memcmp( b->jj, csc->jj, ( n + 1 ) * sizeof( unsigned int ) ) == 0 );
+    assert( memcmp( b->dd, csc->dd, a->nz * sizeof( double ) ) == 0 );
+
+    // and back again
+    if ( t == 4 )
+      assert( small_team( b, 1, FIRST_INDEX_ZERO, 3 ) == 0 );
+    else
+      assert( _compressed_transpose( b, FIRST_INDEX_ZERO, t ) == 0 );
+    assert( validate_matrix( b ) == 0 );
+    assert(( b->format == SM_CSR ) && ( b->base == FIRST_INDEX_ZERO ) );
+    assert( memcmp( b->ii, csr->ii, ( m + 1 ) * sizeof( unsigned int ) ) == 0 );
+    assert( memcmp( b->jj, csr->jj, a->nz * sizeof( unsigned int ) ) == 0 );
+    assert( memcmp( b->dd, csr->dd, a->nz * sizeof( double ) ) == 0 );
+    free_matrix( b );
+  }
+
+  // through convert_matrix()
+  assert( convert_matrix( csc, SM_CSR, FIRST_INDEX_ZERO ) == 0 );
+  assert( memcmp( csc->ii, csr->ii, ( m + 1 ) * sizeof( unsigned int ) ) == 0 );
+  assert( memcmp( csc->jj, csr->jj, a->nz * sizeof( unsigned int ) ) == 0 );
+
+  free_matrix( csc );
+  free_matrix( csr );
+  free_matrix( a );
+}
+
+// the radix sort of COO entries must be ordered and stable (duplicates keep
+// their order), and threaded must match serial
+void test_sort() {
+  printf( "COO sort test\n" );
+  const size_t m = 300, n = 5000, nz = 4000;
+  unsigned int* ii = malloc( nz * sizeof( unsigned int ) );
+  unsigned int* jj = malloc( nz * sizeof( unsigned int ) );
+  assert(( ii != NULL ) && ( jj != NULL ) );
+  unsigned long long s = 1;
+  size_t k;
+  int by_col, t;
+  for ( k = 0; k < nz; k++ ) {
+    s = s * 6364136223846793005ULL + 1442695040888963407ULL;
+    ii[k] = ( s >> 33 ) % m + 1;
+    jj[k] = ( s >> 45 ) % 50 * 100 + 1; // lots of duplicate entries
+  }
+
+  for ( by_col = 0; by_col < 2; by_col++ ) {
+    matrix_t* ref = NULL;
+    for ( t = 1; t <= 4; t++ ) {  // 4: asks for 3 threads, gets one
+      matrix_t* a = malloc_matrix();
+      assert( a != NULL );
+      *a = ( matrix_t ) {
+        0
+      };
+      a->m = m;
+      a->n = n;
+      a->nz = nz;
+      a->base = FIRST_INDEX_ONE;
+      a->format = SM_COO;
+      a->data_type = REAL_DOUBLE;
+      a->ii = malloc( nz * sizeof( unsigned int ) );
+      a->jj = malloc( nz * sizeof( unsigned int ) );
+      a->dd = malloc( nz * sizeof( double ) );
+      assert(( a->ii != NULL ) && ( a->jj != NULL ) && ( a->dd != NULL ) );
+      memcpy( a->ii, ii, nz * sizeof( unsigned int ) );
+      memcpy( a->jj, jj, nz * sizeof( unsigned int ) );
+      for ( k = 0; k < nz; k++ )
+        (( double* ) a->dd )[k] = k; // original position
+
+      if ( t == 4 )
+        assert( small_team( a, 0, by_col, 3 ) == 0 );
+      else
+        assert( _sort_coo( a, by_col, t ) == 0 );
+      assert( validate_matrix( a ) == 0 );
+      const unsigned int* major = by_col ? a->jj : a->ii;
+      const unsigned int* minor = by_col ? a->ii : a->jj;
+      const double* d = a->dd;
+      for ( k = 0; k < nz; k++ ) {
+        const size_t o = d[k];
+        assert(( a->ii[k] == ii[o] ) && ( a->jj[k] == jj[o] ) );
+        if ( k > 0 ) {
+          assert( major[k - 1] <= major[k] );
+          if ( major[k - 1] == major[k] ) {
+            assert( minor[k - 1] <= minor[k] );
+            if ( minor[k - 1] == minor[k] )
+              assert( d[k - 1] < d[k] );
+          }
+        }
+      }
+
+      if ( ref == NULL ) {
+        ref = a;
+      }
+      else {
+        assert( memcmp( a->ii, ref->ii, nz * sizeof( unsigned int ) ) == 0 );
+        assert( memcmp( a->jj, ref->jj, nz * sizeof( unsigned int ) ) == 0 );
+        assert( memcmp( a->dd, ref->dd, nz * sizeof( double ) ) == 0 );
+        free_matrix( a );
+      }
+    }
+    free_matrix( ref );
+  }
+  free( ii );
+  free( jj );
+}
+
+// square nxn COO matrix, base zero, from the given entries
+// (complex: dd holds (real, imag) pairs, pattern: dd is ignored)
+matrix_t* build_coo( size_t n, size_t nz, const unsigned int* ii, const unsigned int* jj, const double* dd, enum matrix_data_type_t t ) {
+  matrix_t* a = malloc_matrix();
+  assert( a != NULL );
+  *a = ( matrix_t ) {
+    0
+  };
+  a->m = a->n = n;
+  a->nz = nz;
+  a->format = SM_COO;
+  a->data_type = t;
+  a->ii = malloc( nz * sizeof( unsigned int ) );
+  a->jj = malloc( nz * sizeof( unsigned int ) );
+  assert(( a->ii != NULL ) && ( a->jj != NULL ) );
+  memcpy( a->ii, ii, nz * sizeof( unsigned int ) );
+  memcpy( a->jj, jj, nz * sizeof( unsigned int ) );
+  if ( t != SM_PATTERN ) {
+    const size_t w = ( t == COMPLEX_DOUBLE ) ? 2 : 1;
+    assert(( t == REAL_DOUBLE ) || ( t == COMPLEX_DOUBLE ) );
+    a->dd = malloc( nz * w * sizeof( double ) );
+    assert( a->dd != NULL );
+    memcpy( a->dd, dd, nz * w * sizeof( double ) );
+  }
+  return a;
+}
+
+// pattern and value symmetry are reported separately, for every format
+void test_symmetry_detection() {
+  printf( "symmetry detection test\n" );
+  struct matrix_symmetry_info_t info;
+  matrix_t* a;
+  int f;
+
+  // symmetric, unsorted, (0,2) is split over two duplicate entries
+  {
+    const unsigned int ii[] = { 2, 0, 1, 0, 1, 0 };
+    const unsigned int jj[] = { 0, 2, 1, 0, 0, 1 };
+    const double dd[] = { 3.0, 1.0, 5.0, 4.0, 7.0, 7.0 };
+    const unsigned int ii2[] = { 0 };
+    const unsigned int jj2[] = { 2 };
+    const double dd2[] = { 2.0 };
+    a = build_coo( 3, 6, ii, jj, dd, REAL_DOUBLE );
+    matrix_t* d = build_coo( 3, 1, ii2, jj2, dd2, REAL_DOUBLE );
+    // append the duplicate
+    a->ii = realloc( a->ii, 7 * sizeof( unsigned int ) );
+    a->jj = realloc( a->jj, 7 * sizeof( unsigned int ) );
+    a->dd = realloc( a->dd, 7 * sizeof( double ) );
+    assert(( a->ii != NULL ) && ( a->jj != NULL ) && ( a->dd != NULL ) );
+    a->ii[6] = d->ii[0];
+    a->jj[6] = d->jj[0];
+    (( double* ) a->dd )[6] = (( double* ) d->dd )[0];
+    a->nz = 7;
+    free_matrix( d );
+
+    for ( f = SM_COO; f <= SM_CSR; f++ ) { // the dense conversions don't sum duplicates
+      matrix_t* b = copy_matrix( a );
+      assert( b != NULL );
+      assert( convert_matrix( b, f, FIRST_INDEX_ONE ) == 0 );
+      assert( analyse_matrix_symmetry( b, &info ) == 0 );
+      printf( "  %s: pattern=%d sym=%d skew=%d herm=%d offdiag=%zu matched=%zu\n", enum2format[f].s,
+              info.pattern, info.symmetric, info.skew_symmetric, info.hermitian, info.nz_offdiag, info.nz_matched );
+      assert( info.pattern && info.symmetric && !info.skew_symmetric && !info.hermitian );
+      assert(( info.nz_offdiag == 4 ) && ( info.nz_matched == 4 ) );
+      assert( detect_matrix_symmetry( b ) == 0 );
+      assert(( b->sym == SM_SYMMETRIC ) && ( b->location == MC_STORE_BOTH ) );
+      assert( b->format == f );
+      free_matrix( b );
+    }
+
+    // break the value symmetry, not the pattern
+    (( double* ) a->dd )[4] = 6.0;
+    assert( analyse_matrix_symmetry( a, &info ) == 0 );
+    assert( info.pattern && !info.symmetric && !info.skew_symmetric );
+    assert( detect_matrix_symmetry( a ) == 0 );
+    assert( a->sym == SM_UNSYMMETRIC );
+    free_matrix( a );
+  }
+
+  // skew-symmetric
+  {
+    const unsigned int ii[] = { 0, 1, 2, 1 };
+    const unsigned int jj[] = { 1, 0, 1, 2 };
+    const double dd[] = { 2.0, -2.0, 3.0, -3.0 };
+    a = build_coo( 3, 4, ii, jj, dd, REAL_DOUBLE );
+    for ( f = DROW; f <= SM_CSR; f++ ) {
+      matrix_t* b = copy_matrix( a );
+      assert( b != NULL );
+      assert( convert_matrix( b, f, FIRST_INDEX_ZERO ) == 0 );
+      assert( analyse_matrix_symmetry( b, &info ) == 0 );
+      assert( info.pattern && !info.symmetric && info.skew_symmetric && !info.hermitian );
+      assert( detect_matrix_symmetry( b ) == 0 );
+      assert(( b->sym == SM_SKEW_SYMMETRIC ) && ( b->location == MC_STORE_BOTH ) );
+      free_matrix( b );
+    }
+    free_matrix( a );
+  }
+
+  // unsymmetric pattern, but an explicit zero without a partner is still symmetric in value
+  {
+    const unsigned int ii[] = { 0, 2, 1 };
+    const unsigned int jj[] = { 1, 2, 2 };
+    const double dd[] = { 0.0, 1.0, 5.0 };
+    a = build_coo( 3, 3, ii, jj, dd, REAL_DOUBLE );
+    assert( analyse_matrix_symmetry( a, &info ) == 0 );
+    assert( !info.pattern && !info.symmetric );
+    assert(( info.nz_offdiag == 2 ) && ( info.nz_matched == 0 ) );
+    (( double* ) a->dd )[2] = 0.0;
+    assert( analyse_matrix_symmetry( a, &info ) == 0 );
+    assert( !info.pattern && info.symmetric );
+    free_matrix( a );
+
+    a = build_coo( 3, 3, ii, jj, NULL, SM_PATTERN );
+    assert( analyse_matrix_symmetry( a, &info ) == 0 );
+    assert( !info.pattern && !info.symmetric && !info.skew_symmetric );
+    free_matrix( a );
+  }
+
+  // hermitian
+  {
+    const unsigned int ii[] = { 0, 1, 0, 1 };
+    const unsigned int jj[] = { 1, 0, 0, 1 };
+    const double dd[] = { 1.0, 2.0, 1.0, -2.0, 3.0, 0.0, 4.0, 0.0 };
+    a = build_coo( 2, 4, ii, jj, dd, COMPLEX_DOUBLE );
+    assert( analyse_matrix_symmetry( a, &info ) == 0 );
+    assert( info.pattern && !info.symmetric && !info.skew_symmetric && info.hermitian );
+    assert( detect_matrix_symmetry( a ) == 0 );
+    assert( a->sym == SM_HERMITIAN );
+    free_matrix( a );
+  }
+
+  // not square
+  {
+    const unsigned int ii[] = { 0 };
+    const unsigned int jj[] = { 0 };
+    const double dd[] = { 1.0 };
+    a = build_coo( 2, 1, ii, jj, dd, REAL_DOUBLE );
+    a->n = 3;
+    assert( analyse_matrix_symmetry( a, &info ) == 0 );
+    assert( !info.pattern && !info.symmetric );
+    free_matrix( a );
+  }
+}
+
+// duplicates are summed, in every sparse format and for pattern matrices
+void test_merge_duplicates() {
+  printf( "merge duplicates test\n" );
+  const unsigned int ii[] = { 2, 0, 1, 2, 0, 2, 0 };
+  const unsigned int jj[] = { 1, 0, 1, 1, 2, 1, 0 };
+  const double dd[] = { 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0 };
+  const unsigned int m_ii[] = { 0, 0, 1, 2 };
+  const unsigned int m_jj[] = { 0, 2, 1, 1 };
+  const double m_dd[] = { 9.0, 5.0, 3.0, 11.0 };
+  int f;
+
+  for ( f = SM_COO; f <= SM_CSR; f++ ) {
+    matrix_t* a = build_coo( 3, 7, ii, jj, dd, REAL_DOUBLE );
+    assert( convert_matrix( a, f, FIRST_INDEX_ONE ) == 0 );
+    assert( merge_duplicate_entries( a ) == 0 );
+    assert( validate_matrix( a ) == 0 );
+    assert(( a->format == f ) && ( a->base == FIRST_INDEX_ONE ) && ( a->nz == 4 ) );
+    // via CSR so the entries are in row order
+    assert( convert_matrix( a, SM_CSR, FIRST_INDEX_ZERO ) == 0 );
+    assert( convert_matrix( a, SM_COO, FIRST_INDEX_ZERO ) == 0 );
+    assert( memcmp( a->ii, m_ii, sizeof( m_ii ) ) == 0 );
+    assert( memcmp( a->jj, m_jj, sizeof( m_jj ) ) == 0 );
+    assert( memcmp( a->dd, m_dd, sizeof( m_dd ) ) == 0 );
+    free_matrix( a );
+  }
+
+  matrix_t* a = build_coo( 3, 7, ii, jj, NULL, SM_PATTERN );
+  assert( merge_duplicate_entries( a ) == 0 );
+  assert( validate_matrix( a ) == 0 );
+  assert(( a->nz == 4 ) && ( a->dd == NULL ) );
+  assert( memcmp( a->ii, m_ii, sizeof( m_ii ) ) == 0 );
+  assert( memcmp( a->jj, m_jj, sizeof( m_jj ) ) == 0 );
+
+  // nothing to merge: unchanged
+  assert( merge_duplicate_entries( a ) == 0 );
+  assert( a->nz == 4 );
+  free_matrix( a );
+}
+
+// the flags follow the entries through the conversions, a merged matrix
+// isn't merged again and validate_matrix() catches a false promise
+void test_flags() {
+  printf( "flags test\n" );
+  const unsigned int ii[] = { 2, 0, 1, 2, 0, 2, 0 };
+  const unsigned int jj[] = { 1, 0, 1, 1, 2, 1, 0 };
+  const double dd[] = { 1.0, 2.0, 3.0, 4.0, 5.0, 6.0, 7.0 };
+  const unsigned int d_ii[] = { 0, 0, 1, 2, 2 };
+  const unsigned int d_jj[] = { 0, 2, 1, 1, 2 };
+  const double d_dd[] = { 1.0, 2.0, 3.0, 4.0, 5.0 };
+
+  matrix_t* a = build_coo( 3, 7, ii, jj, dd, REAL_DOUBLE );
+  assert( detect_matrix_flags( a ) == 0 );
+  assert( a->flags == 0 ); // unsorted: duplicates can't be seen
+  assert( _sort_coo( a, 0, 1 ) == 0 );
+  assert( a->flags == MC_SORTED_BY_ROW );
+  assert( detect_matrix_flags( a ) == 0 );
+  assert( a->flags == MC_SORTED_BY_ROW ); // duplicates
+  assert( merge_duplicate_entries( a ) == 0 );
+  assert( a->flags == ( MC_SORTED_BY_ROW | MC_MERGED ) );
+  assert( validate_matrix( a ) == 0 );
+
+  assert( convert_matrix( a, SM_CSC, FIRST_INDEX_ONE ) == 0 );
+  assert( a->flags == ( MC_SORTED_BY_COL | MC_MERGED ) );
+  assert( validate_matrix( a ) == 0 );
+  assert( convert_matrix( a, SM_COO, FIRST_INDEX_ZERO ) == 0 );
+  assert( a->flags == ( MC_SORTED_BY_COL | MC_MERGED ) );
+  assert( validate_matrix( a ) == 0 );
+  assert( convert_matrix( a, SM_CSR, FIRST_INDEX_ZERO ) == 0 );
+  assert( a->flags == ( MC_SORTED_BY_ROW | MC_MERGED ) );
+  assert( validate_matrix( a ) == 0 );
+  assert( convert_matrix( a, DROW, FIRST_INDEX_ZERO ) == 0 );
+  assert( a->flags == 0 );
+  assert( convert_matrix( a, SM_COO, FIRST_INDEX_ZERO ) == 0 );
+  assert( a->flags == ( MC_SORTED_BY_ROW | MC_MERGED ) );
+
+  // (2,2) is missing: a false promise
+  a->flags |= MC_DIAGONAL;
+  assert( validate_matrix( a ) == -5 );
+  a->flags = MC_SORTED_BY_COL;
+  assert( validate_matrix( a ) == -5 );
+  a->flags = 0;
+  assert( validate_matrix( a ) == 0 );
+  free_matrix( a );
+
+  // a full diagonal, in every sparse format
+  int f;
+  for ( f = SM_COO; f <= SM_CSR; f++ ) {
+    a = build_coo( 3, 5, d_ii, d_jj, d_dd, REAL_DOUBLE );
+    assert( convert_matrix( a, f, FIRST_INDEX_ONE ) == 0 );
+    assert( detect_matrix_flags( a ) == 0 );
+    assert( a->flags & MC_MERGED );
+    assert( a->flags & MC_DIAGONAL );
+    assert( validate_matrix( a ) == 0 );
+    free_matrix( a );
+  }
+
+  // flagged as merged: the merge is skipped
+  a = build_coo( 3, 7, ii, jj, dd, REAL_DOUBLE );
+  assert( convert_matrix( a, SM_CSR, FIRST_INDEX_ZERO ) == 0 );
+  a->flags |= MC_MERGED;
+  assert( merge_duplicate_entries( a ) == 0 );
+  assert( a->nz == 7 );
+  free_matrix( a );
+}
+
+// dense <-> dense and dense <-> COO, large enough to be threaded and to span
+// several transpose tiles (with ragged edges), for each value width
+void test_dense_conversions() {
+  printf( "dense conversions test\n" );
+  const size_t rows = 301, cols = 257;
+  const enum matrix_data_type_t t[] = { REAL_DOUBLE, REAL_SINGLE, COMPLEX_DOUBLE };
+  int k;
+  for ( k = 0; k < 3; k++ ) {
+    matrix_t* a = malloc_matrix();
+    assert( a != NULL );
+    *a = ( matrix_t ) {
+      0
+    };
+    a->m = rows;
+    a->n = cols;
+    a->nz = rows * cols;
+    a->format = DROW;
+    a->data_type = REAL_DOUBLE;
+    a->dd = malloc( rows * cols * sizeof( double ) );
+    assert( a->dd != NULL );
+    size_t i, nz = 0;
+    for ( i = 0; i < rows * cols; i++ ) {
+      const int keep = ( i % 7 == 0 ) || ( i % 11 == 3 );
+      (( double* ) a->dd )[i] = keep ? ( double )( i + 1 ) : 0.0;
+      nz += keep;
+    }
+    assert( convert_matrix_data_type( a, t[k] ) == 0 );
+
+    matrix_t* b = copy_matrix( a );
+    assert( b != NULL );
+    assert( convert_matrix( b, DCOL, FIRST_INDEX_ZERO ) == 0 );
+    assert( validate_matrix( b ) == 0 );
+    for ( i = 0; i < rows; i += 13 ) {
+      size_t j;
+      for ( j = 0; j < cols; j += 5 ) {
+        const size_t w = _data_width( t[k] );
+        assert( memcmp(( char* ) a->dd + ( i * cols + j ) * w, ( char* ) b->dd + ( j * rows + i ) * w, w ) == 0 );
+      }
+    }
+    assert( convert_matrix( b, DROW, FIRST_INDEX_ZERO ) == 0 );
+    assert( cmp_matrix( a, b ) == 0 );
+
+    assert( convert_matrix( b, SM_COO, FIRST_INDEX_ONE ) == 0 );
+    assert( validate_matrix( b ) == 0 );
+    assert( b->nz == nz );
+    assert( b->flags == ( MC_SORTED_BY_ROW | MC_MERGED ) );
+    assert(( b->ii[0] == 1 ) && ( b->jj[0] == 1 ) );
+    assert( convert_matrix( b, DCOL, FIRST_INDEX_ZERO ) == 0 );
+    assert( convert_matrix( b, DROW, FIRST_INDEX_ZERO ) == 0 );
+    assert( cmp_matrix( a, b ) == 0 );
+    free_matrix( b );
+    free_matrix( a );
+  }
+}
+
+// BCSR: a FEM-like matrix with 3 unknowns per node (a chain of 7 nodes, each
+// coupled to its neighbours), blocked at the detected size and at a size
+// that doesn't divide it
+void test_block_format() {
+  printf( "block format test\n" );
+  const size_t nodes = 7, dof = 3, n = nodes * dof;
+  const size_t nzb = nodes + 2 * ( nodes - 1 );
+  matrix_t* a = malloc_matrix();
+  assert( a != NULL );
+  *a = ( matrix_t ) {
+    0
+  };
+  a->m = a->n = n;
+  a->nz = nzb * dof * dof;
+  a->format = SM_COO;
+  a->data_type = REAL_DOUBLE;
+  a->ii = malloc( a->nz * sizeof( unsigned int ) );
+  a->jj = malloc( a->nz * sizeof( unsigned int ) );
+  a->dd = malloc( a->nz * sizeof( double ) );
+  assert(( a->ii != NULL ) && ( a->jj != NULL ) && ( a->dd != NULL ) );
+  size_t i, j, k = 0;
+  for ( j = 0; j < n; j++ ) {  // column-major, so the conversion has to sort
+    for ( i = 0; i < n; i++ ) {
+      const size_t ni = i / dof, nj = j / dof;
+      if (( ni + 1 >= nj ) && ( nj + 1 >= ni ) ) {
+        a->ii[k] = i;
+        a->jj[k] = j;
+        (( double* ) a->dd )[k] = 1.0 + i * n + j;
+        k++;
+      }
+    }
+  }
+  assert( k == a->nz );
+  assert( detect_matrix_block_size( a ) == dof );
+
+  // auto-detected block size
+  matrix_t* b = copy_matrix( a );
+  assert( b != NULL );
+  assert( convert_matrix( b, SM_BCSR, FIRST_INDEX_ONE ) == 0 );
+  assert( validate_matrix( b ) == 0 );
+  assert( b->block_size == dof );
+  assert( b->nz == nzb * dof * dof );
+  assert(( b->ii[0] == 1 ) && ( b->ii[nodes] == nzb + 1 ) );  // one index per block
+  assert(( b->jj[0] == 1 ) && ( b->jj[1] == 2 ) && ( b->jj[2] == 1 ) );
+  assert(( b->flags & MC_SORTED_BY_ROW ) && ( b->flags & MC_MERGED ) );
+  assert( detect_matrix_flags( b ) == 0 );
+  assert( b->flags == ( MC_SORTED_BY_ROW | MC_MERGED | MC_DIAGONAL ) );
+  assert( cmp_matrix( b, a ) == 0 );
+  assert( convert_matrix( b, SM_BCSR, FIRST_INDEX_ZERO ) == 0 );
+  assert(( b->ii[0] == 0 ) && ( b->jj[0] == 0 ) );
+  assert( convert_matrix( b, SM_COO, FIRST_INDEX_ZERO ) == 0 );
+  assert( validate_matrix( b ) == 0 );
+  assert( b->nz == a->nz );
+  assert( cmp_matrix( a, b ) == 0 );
+  free_matrix( b );
+
+  // 2x2 blocks: zero filled, the last block row/column overhangs the edge
+  b = copy_matrix( a );
+  assert( b != NULL );
+  b->block_size = 2;
+  assert( convert_matrix( b, SM_BCSR, FIRST_INDEX_ZERO ) == 0 );
+  assert( validate_matrix( b ) == 0 );
+  assert( b->block_size == 2 );
+  assert( b->nz > a->nz );
+  matrix_t* c = copy_matrix( b );
+  assert( c != NULL );
+  assert( cmp_matrix( b, c ) == 0 );
+  assert( convert_matrix( c, SM_CSC, FIRST_INDEX_ONE ) == 0 );
+  assert( validate_matrix( c ) == 0 );
+  assert( c->nz == a->nz );
+  assert( cmp_matrix( a, c ) == 0 );
+  free_matrix( c );
+  // compared at a's block size: re-blocked
+  c = copy_matrix( a );
+  assert( c != NULL );
+  c->block_size = dof;
+  assert( convert_matrix( c, SM_BCSR, FIRST_INDEX_ZERO ) == 0 );
+  assert( cmp_matrix( c, b ) == 0 );
+  free_matrix( c );
+  assert( convert_matrix( b, DROW, FIRST_INDEX_ZERO ) == 0 );
+  assert( convert_matrix( b, SM_BCSR, FIRST_INDEX_ZERO ) == 0 );  // keeps its block size
+  assert( b->block_size == 2 );
+  assert( cmp_matrix( b, a ) == 0 );
+  free_matrix( b );
+
+  // a stored zero can't be told from the fill: it is dropped on the way back
+  b = copy_matrix( a );
+  assert( b != NULL );
+  (( double* ) b->dd )[5] = 0.0;
+  b->block_size = dof;
+  assert( convert_matrix( b, SM_BCSR, FIRST_INDEX_ZERO ) == 0 );
+  assert( b->nz == nzb * dof * dof );
+  assert( convert_matrix( b, SM_CSR, FIRST_INDEX_ZERO ) == 0 );
+  assert( validate_matrix( b ) == 0 );
+  assert( b->nz == a->nz - 1 );
+  free_matrix( b );
+
+  // too many entries, zero fill included, for 32-bit indices
+  b = copy_matrix( a );
+  assert( b != NULL );
+  b->block_size = 70000;  // one block, 70000^2 entries
+  assert( convert_matrix( b, SM_BCSR, FIRST_INDEX_ZERO ) != 0 );
+  free_matrix( b );
+
+  // a pattern has no zeros to fill the blocks with
+  b = copy_matrix( a );
+  assert( b != NULL );
+  free( b->dd );
+  b->dd = NULL;
+  b->data_type = SM_PATTERN;
+  assert( detect_matrix_block_size( b ) == 1 );
+  b->block_size = dof;
+  assert( convert_matrix( b, SM_BCSR, FIRST_INDEX_ZERO ) != 0 );
+  free_matrix( b );
+  free_matrix( a );
+}
+
+// expanding a stored triangle to both, in each sparse format
+// (CSR/CSC come out sorted without going through COO)
+void test_symmetry_expand() {
+  printf( "symmetry expansion test\n" );
+  // lower triangle, unsorted, one empty diagonal entry (1,1)
+  const unsigned int ii[] = { 3, 0, 2, 3, 2, 3 };
+  const unsigned int jj[] = { 0, 0, 0, 3, 1, 2 };
+  const double dd[] = { 4.0, 1.0, 3.0, 9.0, 5.0, 6.0 };
+  // full matrix, CSR
+  const unsigned int full_ptr[] = { 0, 3, 4, 8, 11 };
+  const unsigned int full_idx[] = { 0, 2, 3, 2, 0, 1, 2, 3, 0, 2, 3 };
+  const double full_dd[] = { 1.0, 3.0, 4.0, 5.0, 3.0, 5.0, 0.5, 6.0, 4.0, 6.0, 9.0 };
+  int f, loc;
+
+  for ( loc = UPPER_TRIANGULAR; loc <= LOWER_TRIANGULAR; loc++ ) {
+    for ( f = SM_COO; f <= SM_CSR; f++ ) {
+      matrix_t* a = build_coo( 4, 6, ii, jj, dd, REAL_DOUBLE );
+      // add a diagonal entry (2,2)
+      a->ii = realloc( a->ii, 7 * sizeof( unsigned int ) );
+      a->jj = realloc( a->jj, 7 * sizeof( unsigned int ) );
+      a->dd = realloc( a->dd, 7 * sizeof( double ) );
+      assert(( a->ii != NULL ) && ( a->jj != NULL ) && ( a->dd != NULL ) );
+      a->ii[6] = a->jj[6] = 2;
+      (( double* ) a->dd )[6] = 0.5;
+      a->nz = 7;
+      a->sym = SM_SYMMETRIC;
+      a->location = LOWER_TRIANGULAR;
+      if ( loc == UPPER_TRIANGULAR )
+        assert( convert_matrix_symmetry( a, UPPER_TRIANGULAR ) == 0 );
+      assert( convert_matrix( a, f, FIRST_INDEX_ONE ) == 0 );
+
+      assert( convert_matrix_symmetry( a, MC_STORE_BOTH ) == 0 );
+      assert( validate_matrix( a ) == 0 );
+      assert(( a->format == f ) && ( a->location == MC_STORE_BOTH ) && ( a->nz == 11 ) );
+      if ( f == SM_COO )
+        assert( convert_matrix( a, SM_CSR, FIRST_INDEX_ONE ) == 0 );
+      // symmetric: CSC arrays are the same as CSR
+      const unsigned int* ptr = ( f == SM_CSC ) ? a->jj : a->ii;
+      const unsigned int* idx = ( f == SM_CSC ) ? a->ii : a->jj;
+      int k;
+      for ( k = 0; k < 5; k++ )
+        assert( ptr[k] == full_ptr[k] + 1 );
+      for ( k = 0; k < 11; k++ ) {
+        assert( idx[k] == full_idx[k] + 1 );
+        assert((( double* ) a->dd )[k] == full_dd[k] );
+      }
+      free_matrix( a );
+    }
+  }
+}
+
+// moving between stored triangles on CSR/CSC keeps the format and
+// matches the COO result
+void test_symmetry_triangles() {
+  printf( "symmetry triangle conversion test\n" );
+  // full symmetric matrix, COO
+  const unsigned int ii[] = { 0, 0, 0, 1, 2, 2, 2, 2, 3, 3, 3 };
+  const unsigned int jj[] = { 0, 2, 3, 2, 0, 1, 2, 3, 0, 2, 3 };
+  const double dd[] = { 1.0, 3.0, 4.0, 5.0, 3.0, 5.0, 0.5, 6.0, 4.0, 6.0, 9.0 };
+  const enum matrix_symmetric_storage_t seq[] = {
+    LOWER_TRIANGULAR, UPPER_TRIANGULAR, LOWER_TRIANGULAR, MC_STORE_BOTH,
+    UPPER_TRIANGULAR, LOWER_TRIANGULAR, UPPER_TRIANGULAR, MC_STORE_BOTH
+  };
+  int f, s, k;
+
+  for ( f = SM_CSC; f <= SM_CSR; f++ ) {
+    matrix_t* a = build_coo( 4, 11, ii, jj, dd, REAL_DOUBLE );
+    a->sym = SM_SYMMETRIC;
+    a->location = MC_STORE_BOTH;
+    matrix_t* ref = copy_matrix( a );
+    assert( ref != NULL );
+    assert( convert_matrix( a, f, FIRST_INDEX_ONE ) == 0 );
+
+    for ( s = 0; s < sizeof( seq ) / sizeof( seq[0] ); s++ ) {
+      assert( convert_matrix_symmetry( a, seq[s] ) == 0 );
+      assert( convert_matrix_symmetry( ref, seq[s] ) == 0 );
+      assert( validate_matrix( a ) == 0 );
+      assert(( a->format == f ) && ( a->location == seq[s] ) && ( a->base == FIRST_INDEX_ONE ) );
+      assert( a->nz == (( seq[s] == MC_STORE_BOTH ) ? 11 : 7 ) );
+
+      // every entry is in the stored triangle, and sorted
+      const unsigned int* ptr = ( f == SM_CSC ) ? a->jj : a->ii;
+      const unsigned int* idx = ( f == SM_CSC ) ? a->ii : a->jj;
+      unsigned int r;
+      for ( r = 0; r < 4; r++ ) {
+        for ( k = ptr[r] - 1; k < ptr[r + 1] - 1; k++ ) {
+          const unsigned int c = idx[k] - 1;
+          const unsigned int row = ( f == SM_CSR ) ? r : c;
+          const unsigned int col = ( f == SM_CSR ) ? c : r;
+          if ( seq[s] == LOWER_TRIANGULAR )
+            assert( row >= col );
+          else if ( seq[s] == UPPER_TRIANGULAR )
+            assert( row <= col );
+          if ( k > ptr[r] - 1 )
+            assert( idx[k - 1] < idx[k] );
+        }
+      }
+
+      matrix_t* b = copy_matrix( a );
+      assert( b != NULL );
+      assert( convert_matrix( b, SM_COO, FIRST_INDEX_ZERO ) == 0 );
+      assert( cmp_matrix( ref, b ) == 0 );
+      free_matrix( b );
+    }
+    free_matrix( ref );
+    free_matrix( a );
+  }
+}
+
+// 32 <-> 64-bit indices: round trip, and the kernels narrow when they can
+void test_index_width() {
+  printf( "index width test\n" );
+  const unsigned int ii[] = { 2, 0, 1, 2 };
+  const unsigned int jj[] = { 0, 1, 2, 2 };
+  const double dd[] = { 3.0, 1.0, 2.0, 4.0 };
+  int f;
+
+  for ( f = SM_COO; f <= SM_CSR; f++ ) {
+    matrix_t* a = build_coo( 3, 4, ii, jj, dd, REAL_DOUBLE );
+    assert( convert_matrix( a, f, FIRST_INDEX_ONE ) == 0 );
+    matrix_t* ref = copy_matrix( a );
+    assert( ref != NULL );
+    assert( matrix_index_width_required( a ) == MC_INDEX_32 );
+
+    assert( convert_matrix_index_width( a, MC_INDEX_64 ) == 0 );
+    assert(( a->index_width == MC_INDEX_64 ) && ( a->ii == NULL ) && ( a->jj == NULL ) );
+    assert(( a->ii64 != NULL ) && ( a->jj64 != NULL ) );
+    assert( validate_matrix( a ) == 0 );
+    // same format and base: stays wide
+    assert( convert_matrix( a, f, FIRST_INDEX_ONE ) == 0 );
+    assert( a->index_width == MC_INDEX_64 );
+
+    matrix_t* b = copy_matrix( a );
+    assert( b != NULL );
+    assert(( b->index_width == MC_INDEX_64 ) && ( b->ii64 != a->ii64 ) );
+    assert( validate_matrix( b ) == 0 );
+    assert( convert_matrix_index_width( b, MC_INDEX_32 ) == 0 );
+    assert(( b->ii64 == NULL ) && ( b->jj64 == NULL ) );
+    assert( cmp_matrix( ref, b ) == 0 );
+    free_matrix( b );
+
+    // converting narrows it
+    assert( convert_matrix( a, SM_COO, FIRST_INDEX_ZERO ) == 0 );
+    assert( a->index_width == MC_INDEX_32 );
+    assert( validate_matrix( a ) == 0 );
+    assert( cmp_matrix( ref, a ) == 0 );
+    free_matrix( ref );
+    free_matrix( a );
+  }
+
+  // too large to narrow: the row count needs 64-bit indices
+  matrix_t* a = malloc_matrix();
+  assert( a != NULL );
+  *a = ( matrix_t ) {
+    0
+  };
+  a->m = ( size_t ) UINT_MAX + 1;
+  a->n = 1;
+  a->nz = 1;
+  a->format = SM_COO;
+  a->data_type = SM_PATTERN;
+  a->index_width = MC_INDEX_64;
+  a->ii64 = malloc( sizeof( uint64_t ) );
+  a->jj64 = malloc( sizeof( uint64_t ) );
+  assert(( a->ii64 != NULL ) && ( a->jj64 != NULL ) );
+  a->ii64[0] = UINT_MAX;
+  a->jj64[0] = 0;
+  assert( matrix_index_width_required( a ) == MC_INDEX_64 );
+  assert( validate_matrix( a ) == 0 );
+  assert( convert_matrix_index_width( a, MC_INDEX_32 ) == -1 );
+  assert( convert_matrix( a, SM_CSR, FIRST_INDEX_ZERO ) != 0 );
+  assert(( a->index_width == MC_INDEX_64 ) && ( a->ii64[0] == UINT_MAX ) );
+  a->m = UINT_MAX; // fits with base zero...
+  assert( matrix_index_width_required( a ) == MC_INDEX_32 );
+  a->base = FIRST_INDEX_ONE; // ...but not base one
+  assert( matrix_index_width_required( a ) == MC_INDEX_64 );
+  free_matrix( a );
+}
+
+// single precision through the conversions, and mixed precision comparisons
+void test_single_precision() {
+  printf( "single precision test\n" );
+  // symmetric, with a duplicate (0,1) entry and a zero
+  const unsigned int ii[] = { 0, 1, 0, 2, 1, 0, 2 };
+  const unsigned int jj[] = { 0, 0, 1, 2, 1, 1, 1 };
+  const double dd[] = { 1.5, 2.0, 1.0, 0.25, -3.0, 1.0, 0.0 };
+  int f;
+
+  matrix_t* a = build_coo( 3, 7, ii, jj, dd, REAL_DOUBLE );
+  assert( convert_matrix_data_type( a, REAL_SINGLE ) == 0 );
+  assert(( a->data_type == REAL_SINGLE ) && ( _data_width( a->data_type ) == sizeof( float ) ) );
+  assert((( float* ) a->dd )[0] == 1.5f );
+  assert( merge_duplicate_entries( a ) == 0 );
+  assert( a->nz == 6 );
+  assert( detect_matrix_symmetry( a ) == 0 );
+  assert( a->sym == SM_SYMMETRIC );
+
+  // round trip through every format, values survive exactly
+  matrix_t* ref = copy_matrix( a );
+  assert( ref != NULL );
+  for ( f = DROW; f <= SM_CSR; f++ ) {
+    matrix_t* b = copy_matrix( a );
+    assert( b != NULL );
+    assert( convert_matrix( b, f, FIRST_INDEX_ONE ) == 0 );
+    assert( b->data_type == REAL_SINGLE );
+    assert( validate_matrix( b ) == 0 );
+    assert( convert_matrix( b, SM_COO, FIRST_INDEX_ZERO ) == 0 );
+    if (( f == DROW ) || ( f == DCOL ) )
+      assert( b->nz == 5 ); // the explicit zero is dropped
+    else
+      assert( cmp_matrix( ref, b ) == 0 );
+    free_matrix( b );
+  }
+
+  // a wrong value is caught
+  matrix_t* b = copy_matrix( a );
+  assert( b != NULL );
+  (( float* ) b->dd )[1] += 0.5f;
+  assert( cmp_matrix( ref, b ) != 0 );
+  free_matrix( b );
+
+  // mixed precision: single vs double answers
+  b = copy_matrix( a );
+  assert( b != NULL );
+  assert( convert_matrix_data_type( b, REAL_DOUBLE ) == 0 );
+  assert( b->data_type == REAL_DOUBLE );
+  assert( results_match( b, a, 1e-6 ) == 1 );
+  (( double* ) b->dd )[0] += 1e-3;
+  assert( results_match( b, a, 1e-6 ) == 0 );
+  free_matrix( b );
+
+  free_matrix( ref );
+  free_matrix( a );
+}
+
+// complex values: hermitian/skew-symmetric triangles, split ("zomplex") storage, widening
+void test_complex() {
+  printf( "complex test\n" );
+  int f;
+
+  // hermitian, lower triangle stored
+  const unsigned int ii[] = { 0, 1, 2, 2 };
+  const unsigned int jj[] = { 0, 0, 1, 2 };
+  const double dd[] = { 2.0, 0.0, 1.0, 2.0, 3.0, -1.0, 4.0, 0.0 };
+  // ... both triangles
+  const unsigned int ii_both[] = { 0, 1, 0, 2, 1, 2 };
+  const unsigned int jj_both[] = { 0, 0, 1, 1, 2, 2 };
+  const double dd_both[] = { 2.0, 0.0, 1.0, 2.0, 1.0, -2.0, 3.0, -1.0, 3.0, 1.0, 4.0, 0.0 };
+  // ... upper triangle
+  const unsigned int ii_upper[] = { 0, 0, 1, 2 };
+  const unsigned int jj_upper[] = { 0, 1, 2, 2 };
+  const double dd_upper[] = { 2.0, 0.0, 1.0, -2.0, 3.0, 1.0, 4.0, 0.0 };
+
+  matrix_t* a = build_coo( 3, 4, ii, jj, dd, COMPLEX_DOUBLE );
+  a->sym = SM_HERMITIAN;
+  a->location = LOWER_TRIANGULAR;
+  matrix_t* both = build_coo( 3, 6, ii_both, jj_both, dd_both, COMPLEX_DOUBLE );
+  matrix_t* upper = build_coo( 3, 4, ii_upper, jj_upper, dd_upper, COMPLEX_DOUBLE );
+  upper->sym = SM_HERMITIAN;
+  upper->location = UPPER_TRIANGULAR;
+  for ( f = SM_COO; f <= SM_CSR; f++ ) {
+    matrix_t* b = copy_matrix( a );
+    assert( b != NULL );
+    assert( convert_matrix( b, f, FIRST_INDEX_ZERO ) == 0 );
+    assert( convert_matrix_symmetry( b, MC_STORE_BOTH ) == 0 );
+    assert( validate_matrix( b ) == 0 );
+    b->sym = SM_UNSYMMETRIC;
+    assert( cmp_matrix( both, b ) == 0 );
+    free_matrix( b );
+
+    b = copy_matrix( a );
+    assert( b != NULL );
+    assert( convert_matrix( b, f, FIRST_INDEX_ONE ) == 0 );
+    assert( convert_matrix_symmetry( b, UPPER_TRIANGULAR ) == 0 );
+    assert( cmp_matrix( upper, b ) == 0 );
+    free_matrix( b );
+  }
+  free_matrix( upper );
+
+  // skew-symmetric: the mirrored entries are negated
+  {
+    const unsigned int ii_skew[] = { 1 };
+    const unsigned int jj_skew[] = { 0 };
+    const double dd_skew[] = { 5.0 };
+    const unsigned int ii_skew_both[] = { 1, 0 };
+    const unsigned int jj_skew_both[] = { 0, 1 };
+    const double dd_skew_both[] = { 5.0, -5.0 };
+    matrix_t* s = build_coo( 2, 1, ii_skew, jj_skew, dd_skew, REAL_DOUBLE );
+    s->sym = SM_SKEW_SYMMETRIC;
+    s->location = LOWER_TRIANGULAR;
+    matrix_t* s_both = build_coo( 2, 2, ii_skew_both, jj_skew_both, dd_skew_both, REAL_DOUBLE );
+    for ( f = SM_COO; f <= SM_CSR; f++ ) {
+      matrix_t* b = copy_matrix( s );
+      assert( b != NULL );
+      assert( convert_matrix( b, f, FIRST_INDEX_ZERO ) == 0 );
+      assert( convert_matrix_symmetry( b, MC_STORE_BOTH ) == 0 );
+      b->sym = SM_UNSYMMETRIC;
+      assert( cmp_matrix( s_both, b ) == 0 );
+      free_matrix( b );
+    }
+    free_matrix( s_both );
+    free_matrix( s );
+  }
+
+  // split storage: real parts then imaginary parts, paired again for the conversions
+  matrix_t* z = build_coo( 3, 6, ii_both, jj_both, dd_both, COMPLEX_DOUBLE );
+  assert( convert_matrix_complex_storage( z, MC_COMPLEX_SPLIT ) == 0 );
+  assert( z->complex_storage == MC_COMPLEX_SPLIT );
+  assert( validate_matrix( z ) == 0 );
+  assert((( double* ) z->dd )[1] == 1.0 ); // re(1,0)
+  assert((( double* ) z->dd )[6 + 1] == 2.0 ); // im(1,0)
+  assert( convert_matrix_complex_storage( z, MC_COMPLEX_PAIRED ) == 0 );
+  assert( memcmp( z->dd, dd_both, 6 * 2 * sizeof( double ) ) == 0 );
+  assert( convert_matrix_complex_storage( z, MC_COMPLEX_SPLIT ) == 0 );
+  assert( cmp_matrix( both, z ) == 0 );
+  assert( z->complex_storage == MC_COMPLEX_PAIRED );
+  for ( f = DROW; f <= SM_CSR; f++ ) {
+    matrix_t* b = copy_matrix( both );
+    assert( b != NULL );
+    assert( convert_matrix_complex_storage( b, MC_COMPLEX_SPLIT ) == 0 );
+    assert( convert_matrix( b, f, FIRST_INDEX_ONE ) == 0 );
+    assert( validate_matrix( b ) == 0 );
+    assert( cmp_matrix( both, b ) == 0 );
+    free_matrix( b );
+  }
+  // split vectors compare against paired answers
+  z->format = DCOL;
+  z->m = 6;
+  z->n = 1;
+  free( z->ii );
+  free( z->jj );
+  z->ii = z->jj = NULL;
+  matrix_t* zz = copy_matrix( z );
+  assert( zz != NULL );
+  assert( convert_matrix_complex_storage( zz, MC_COMPLEX_SPLIT ) == 0 );
+  assert( results_match( z, zz, 1e-15 ) == 1 );
+  (( double* ) zz->dd )[6] += 1e-3; // im(0)
+  assert( results_match( z, zz, 1e-6 ) == 0 );
+  free_matrix( zz );
+  free_matrix( z );
+
+  // widen real to complex, but never drop the imaginary part
+  {
+    const double dr[] = { 1.5, -2.0, 0.25, 3.0 };
+    matrix_t* r = build_coo( 3, 4, ii, jj, dr, REAL_DOUBLE );
+    assert( convert_matrix_data_type( r, COMPLEX_SINGLE ) == 0 );
+    assert( r->data_type == COMPLEX_SINGLE );
+    assert((( float* ) r->dd )[2] == -2.0f );
+    assert((( float* ) r->dd )[3] == 0.0f );
+    assert( convert_matrix_data_type( r, REAL_SINGLE ) == -1 );
+    assert( convert_matrix_complex_storage( a, MC_COMPLEX_SPLIT ) == 0 );
+    assert( convert_matrix_data_type( a, COMPLEX_SINGLE ) == 0 ); // precision, still split
+    assert( a->complex_storage == MC_COMPLEX_SPLIT );
+    assert((( float* ) a->dd )[4 + 1] == 2.0f ); // im(1,0)
+    free_matrix( r );
+  }
+
+  free_matrix( both );
+  free_matrix( a );
+}
+
 // TODO check that if it starts as invalid, it stays invalid type
 // TODO check that if it isn't invalid, it fails when asking to become invalid type
 
@@ -243,6 +1305,23 @@ void test_basic() {
   build_test_matrix( &c, 0 );
   test_copy( c );
 
+  test_sparse_conversions();
+  test_transpose();
+  test_sort();
+  test_symmetry_detection();
+  test_merge_duplicates();
+  test_flags();
+  test_dense_conversions();
+  test_block_format();
+  test_symmetry_expand();
+  test_symmetry_triangles();
+  test_index_width();
+  test_single_precision();
+  test_complex();
+
+  build_test_matrix( &c, 0 );
+  test_ownership( c );
+
 
   // TODO do some cmp_matrix's that are supposed to fail in different ways
 
@@ -250,6 +1329,69 @@ void test_basic() {
   free_matrix( c );
 }
 
+// pooled matrices convert like malloc-ed ones (and reuse the pool's buffers),
+// borrowed arrays are copied rather than changed or released
+void test_ownership( matrix_t* a ) {
+  printf( "ownership test\n" );
+  const enum matrix_format_t f[] = { SM_CSR, SM_CSC, DROW, SM_COO, DCOL, SM_CSC, SM_COO };
+  const int nf = sizeof( f ) / sizeof( f[0] );
+  int i;
+
+  matrix_t* p = copy_matrix( a );
+  assert( p != NULL );
+  assert( p->owner == MC_OWN_MALLOC );
+  assert( convert_matrix_ownership( p, MC_OWN_POOL ) == 0 );
+  assert( p->owner == MC_OWN_POOL );
+  assert( cmp_matrix( a, p ) == 0 );
+  struct mempool_stats_t st;
+  for ( int r = 0; r < 2; r++ ) {
+    for ( i = 0; i < nf; i++ ) {
+      assert( convert_matrix( p, f[i], ( enum matrix_base_t )(( i + r ) % 2 ) ) == 0 );
+      assert( validate_matrix( p ) == 0 );
+      matrix_t* q = copy_matrix( p );
+      assert(( q != NULL ) && ( q->owner == MC_OWN_POOL ) );
+      assert( cmp_matrix( a, q ) == 0 );
+      free_matrix( q );
+    }
+  }
+  mempool_stats( &st );
+  assert( st.hits > 0 ); // the second round reused the first round's buffers
+  assert( convert_matrix_ownership( p, MC_OWN_MALLOC ) == 0 );
+  assert( p->owner == MC_OWN_MALLOC );
+  assert( cmp_matrix( a, p ) == 0 );
+  free_matrix( p );
+
+  // a borrowed (shallow) copy of a CSR matrix
+  matrix_t* o = copy_matrix( a );
+  assert( o != NULL );
+  assert( convert_matrix( o, SM_CSR, FIRST_INDEX_ZERO ) == 0 );
+  matrix_t* saved = copy_matrix( o );
+  assert( saved != NULL );
+  matrix_t* v = malloc_matrix();
+  assert( v != NULL );
+  *v = *o;
+  assert( convert_matrix_ownership( v, MC_OWN_BORROWED ) == 0 );
+  assert( convert_matrix( v, SM_CSR, FIRST_INDEX_ZERO ) == 0 ); // nothing to do: still borrowed
+  assert(( v->owner == MC_OWN_BORROWED ) && ( v->ii == o->ii ) );
+  free_matrix( v ); // doesn't release o's arrays
+
+  v = malloc_matrix();
+  assert( v != NULL );
+  *v = *o;
+  v->owner = MC_OWN_BORROWED;
+  assert( convert_matrix( v, SM_CSC, FIRST_INDEX_ONE ) == 0 );
+  assert( v->owner == MC_OWN_MALLOC );
+  assert(( v->ii != o->ii ) && ( v->jj != o->jj ) && ( v->dd != o->dd ) );
+  // o is untouched
+  assert( memcmp( o->ii, saved->ii, ( o->m + 1 ) * sizeof( unsigned int ) ) == 0 );
+  assert( memcmp( o->jj, saved->jj, o->nz * sizeof( unsigned int ) ) == 0 );
+  assert( memcmp( o->dd, saved->dd, o->nz * _data_width( o->data_type ) ) == 0 );
+  assert( cmp_matrix( saved, v ) == 0 );
+  free_matrix( v );
+  free_matrix( saved );
+  free_matrix( o );
+}
+
 void build_test_matrix( matrix_t** m, int i ) {
   assert( m != NULL );
   free_matrix( *m );
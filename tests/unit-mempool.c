@@ -0,0 +1,141 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+#include "mempool.h"
+
+void test_reuse();
+void test_reuse() {
+  struct mempool_stats_t st;
+  mempool_trim();
+  mempool_stats( &st );
+  const size_t misses = st.misses;
+  const size_t hits = st.hits;
+
+  // released buffers are handed out again, for the same size class
+  char* p = mempool_malloc( 1000 );
+  assert( p != NULL );
+  assert((( uintptr_t ) p % MEMPOOL_ALIGN ) == 0 );
+  memset( p, 1, 1000 );
+  mempool_free( p );
+  mempool_stats( &st );
+  assert( st.cached > 0 );
+  assert( st.in_use == 0 );
+  char* q = mempool_malloc( 1010 );
+  assert( q == p );
+  mempool_stats( &st );
+  assert( st.misses == misses + 1 );
+  assert( st.hits == hits + 1 );
+  assert( st.cached == 0 );
+
+  // but not for a much larger request
+  char* r = mempool_malloc( 4000 );
+  assert(( r != NULL ) && ( r != q ) );
+  mempool_free( r );
+  mempool_free( q );
+
+  // calloc
+  int* z = mempool_calloc( 1000, sizeof( int ) );
+  assert( z != NULL );
+  for ( int i = 0; i < 1000; i++ )
+    assert( z[i] == 0 );
+  mempool_free( z );
+  mempool_free( NULL ); // no-op
+
+  mempool_trim();
+  mempool_stats( &st );
+  assert( st.cached == 0 );
+  printf( "hits %zu, misses %zu\n", st.hits, st.misses );
+}
+
+void test_realloc();
+void test_realloc() {
+  int* p = mempool_realloc( NULL, 100 * sizeof( int ) );
+  assert( p != NULL );
+  for ( int i = 0; i < 100; i++ )
+    p[i] = i;
+  // shrinking a little stays in place
+  int* q = mempool_realloc( p, 90 * sizeof( int ) );
+  assert( q == p );
+  // growing moves, keeping the contents
+  q = mempool_realloc( q, 10000 * sizeof( int ) );
+  assert( q != NULL );
+  for ( int i = 0; i < 90; i++ )
+    assert( q[i] == i );
+  // shrinking a lot moves too (gives the memory back)
+  p = mempool_realloc( q, 10 * sizeof( int ) );
+  assert(( p != NULL ) && ( p != q ) );
+  for ( int i = 0; i < 10; i++ )
+    assert( p[i] == i );
+  assert( mempool_realloc( p, 0 ) == NULL ); // free
+  mempool_trim();
+}
+
+void test_huge();
+void test_huge() {
+  struct mempool_stats_t st;
+  mempool_stats( &st );
+  const size_t huge = st.huge;
+
+  // large buffers sit on huge page boundaries (after the header)
+  char* p = mempool_malloc( 3 * MEMPOOL_HUGE_PAGE );
+  assert( p != NULL );
+  assert(((( uintptr_t ) p - MEMPOOL_ALIGN ) % MEMPOOL_HUGE_PAGE ) == 0 );
+  memset( p, 0, 3 * MEMPOOL_HUGE_PAGE );
+  mempool_stats( &st );
+  assert( st.huge == huge + 1 );
+  mempool_free( p );
+  char* q = mempool_malloc( 3 * MEMPOOL_HUGE_PAGE + 1000 ); // same size class
+  assert( q == p );
+  mempool_free( q );
+
+  // a lower limit only frees what doesn't fit, the largest buffers first
+  mempool_trim();
+  p = mempool_malloc( 1000 );
+  q = mempool_malloc( 100000 );
+  mempool_free( p );
+  mempool_free( q );
+  mempool_stats( &st );
+  const size_t both = st.cached;
+  mempool_set_limit( both - 1 );
+  mempool_stats( &st );
+  assert(( st.cached > 0 ) && ( st.cached < 2000 ) );
+  assert( mempool_malloc( 1000 ) == p );  // still cached
+  mempool_free( p );
+
+  // above the limit, released buffers go straight back to the system
+  mempool_set_limit( 0 );
+  mempool_stats( &st );
+  assert( st.cached == 0 );
+  p = mempool_malloc( 1000 );
+  mempool_free( p );
+  mempool_stats( &st );
+  assert( st.cached == 0 );
+  mempool_set_limit( MEMPOOL_DEFAULT_LIMIT );
+}
+
+int main( int argc, char **argv ) {
+  test_reuse();
+  test_realloc();
+  test_huge();
+  return 0;
+}
@@ -0,0 +1,275 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+#include "matrix.h"
+#include "readmm.h"
+#include "unit-common.h"
+
+void check_double( const char* s );
+void test_parse_double();
+void test_parse_uint();
+int load( const char* text, matrix_t* A, char** comments );
+void test_readmm();
+void test_readmm_errors();
+void test_readmm_large();
+
+// the parser must give strtod()'s answer, bit for bit
+void check_double( const char* s ) {
+  double a, b = strtod( s, NULL );
+  const size_t len = strlen( s );
+  char const* p = mm_parse_double( s, s + len, &a );
+  if (( p != s + len ) || ( memcmp( &a, &b, sizeof( double ) ) != 0 ) ) {
+    printf( "%s: parsed %.17g, strtod %.17g\n", s, a, b );
+    assert( 0 );
+  }
+}
+
+void test_parse_double() {
+  const char* tricky[] = {
+    "0", "-0", "+0", "0.0", "-0.0e10", "1", "-1", "1.5", ".5", "5.", "+.5e+1", "1e22", "1e23", "-1e-22",
+    "0.1", "0.3", "9007199254740992", "9007199254740993", "9007199254740993.0000000001",
+    "1234567890123456789", "12345678901234567890", "123456789012345678901234567890",
+    "0.000000000000000000000000000000000000001234", "2.2250738585072011e-308",
+    "2.2250738585072014e-308", "4.9e-324", "2.4703282292062327e-324", "1e-400", "1e400",
+    "1.7976931348623157e308", "1.7976931348623158e308", "1.7976931348623159e308",
+    "00000000000000000000000000000000000012.5", "1E5", "3.14159265358979323846264338327950288",
+    "1.00000000000000011102230246251565404236316680908203125",
+    "1.00000000000000011102230246251565404236316680908203124", "7.038531e-26", "1e99999999999",
+    NULL
+  };
+  for ( int i = 0; tricky[i] != NULL; i++ )
+    check_double( tricky[i] );
+
+  // random doubles, printed as they usually are in .mtx files
+  const char* formats[] = { "%.17g", "%.16e", "%.15g", "%.6g", "%g", "%.3f", "%.20e" };
+  char s[64];
+  for ( int i = 0; i < 200000; i++ ) {
+    double x;
+    do {
+      const unsigned long long bits = rnd64();
+      memcpy( &x, &bits, sizeof( double ) );
+    }
+    while ( x != x || x - x != 0.0 );  // not nan or inf
+    if ( i % 2 )  // and more of a typical size
+      x = ( double )( rnd64() >> 11 ) / ( 1ULL << ( rnd64() % 64 ) ) - 1e3;
+    snprintf( s, sizeof( s ), formats[i % 7], x );
+    check_double( s );
+  }
+
+  // not numbers, or not followed by white space
+  const char* bad[] = { "", "-", "+", ".", "e5", "1e", "1e+", "1.2.3", "1x", "--1", "inf", "nan", "0x10", "1,5", NULL };
+  double v;
+  for ( int i = 0; bad[i] != NULL; i++ )
+    assert( mm_parse_double( bad[i], bad[i] + strlen( bad[i] ), &v ) == NULL );
+
+  // the buffer doesn't need to be terminated: stop at 'end'
+  const char* s2 = "12.5e3 7";
+  assert( mm_parse_double( s2, s2 + 4, &v ) == s2 + 4 );
+  assert( v == 12.5 );
+  assert( mm_parse_double( s2, s2 + 6, &v ) == s2 + 6 );
+  assert( v == 12.5e3 );
+}
+
+void test_parse_uint() {
+  unsigned long long v;
+  const char* s = "0 123\n4294967295 4294967296 12a -1";
+  char const* const end = s + strlen( s );
+  char const* p = mm_parse_uint( s, end, 100, &v );
+  assert(( p == s + 1 ) && ( v == 0 ) );
+  p = mm_parse_uint( p + 1, end, 123, &v );
+  assert(( p == s + 5 ) && ( v == 123 ) );
+  assert( mm_parse_uint( s + 2, end, 122, &v ) == NULL );  // > max
+  p = mm_parse_uint( p + 1, end, 4294967295ULL, &v );
+  assert(( p == s + 16 ) && ( v == 4294967295ULL ) );
+  assert( mm_parse_uint( p + 1, end, 4294967295ULL, &v ) == NULL );
+  assert( mm_parse_uint( s + 28, end, 1000, &v ) == NULL );  // "12a"
+  assert( mm_parse_uint( s + 32, end, 1000, &v ) == NULL );  // "-1"
+  assert( mm_parse_uint( s + 2, s + 4, 1000, &v ) == s + 4 );  // "12" at the end of the buffer
+  assert( v == 12 );
+}
+
+// write 'text' to a file and read it back with readmm()
+int load( const char* text, matrix_t* A, char** comments ) {
+  char* const name = write_temp( "unit-readmm", text, strlen( text ) );
+  const int ret = readmm( name, A, comments );
+  unlink( name );
+  free( name );
+  return ret;
+}
+
+void test_readmm() {
+  matrix_t* A = malloc_matrix();
+  assert( A != NULL );
+  char* comments = NULL;
+
+  // comments, blank lines, DOS line endings, and no newline at the end
+  const char* coo =
+    "%%MatrixMarket matrix coordinate real general\n"
+    "% a comment\n"
+    "\n"
+    "%another\r\n"
+    "  3 4 3  \n"
+    "1 1 1.5\r\n"
+    "\n"
+    "3\t4  -2e-3\n"
+    "  2 1 7";
+  assert( load( coo, A, &comments ) == 0 );
+  assert( strcmp( comments, "% a comment\n%another\r\n" ) == 0 );
+  free( comments );
+  assert(( A->m == 3 ) && ( A->n == 4 ) && ( A->nz == 3 ) );
+  assert(( A->format == SM_COO ) && ( A->base == FIRST_INDEX_ONE ) && ( A->data_type == REAL_DOUBLE ) );
+  assert( A->sym == SM_UNSYMMETRIC );
+  double const* d = A->dd;
+  assert(( A->ii[0] == 1 ) && ( A->jj[0] == 1 ) && ( d[0] == 1.5 ) );
+  assert(( A->ii[1] == 3 ) && ( A->jj[1] == 4 ) && ( d[1] == -2e-3 ) );
+  assert(( A->ii[2] == 2 ) && ( A->jj[2] == 1 ) && ( d[2] == 7.0 ) );
+
+  // much longer than the 1024 characters the format promises
+  char* longline = malloc( 4096 );
+  assert( longline != NULL );
+  int n = sprintf( longline, "%%%%MatrixMarket MATRIX Coordinate complex Hermitian\n2 2 2\n2 1 0." );
+  for ( int i = 0; i < 2000; i++ )
+    longline[n++] = '3';
+  sprintf( longline + n, " -0.25\n1 1 4 0\n" );
+  assert( load( longline, A, NULL ) == 0 );
+  free( longline );
+  assert(( A->data_type == COMPLEX_DOUBLE ) && ( A->sym == SM_HERMITIAN ) && ( A->nz == 2 ) );
+  d = A->dd;
+  assert(( A->ii[0] == 2 ) && ( A->jj[0] == 1 ) && ( d[0] == 1.0 / 3.0 ) && ( d[1] == -0.25 ) );
+  assert(( A->ii[1] == 1 ) && ( A->jj[1] == 1 ) && ( d[2] == 4.0 ) && ( d[3] == 0.0 ) );
+
+  // dense, column major; integer data is read as real
+  const char* dense =
+    "%%MatrixMarket matrix array integer general\n"
+    "2 3\n"
+    "1\n2\n3\n4\n5\n-6\n";
+  assert( load( dense, A, NULL ) == 0 );
+  assert(( A->format == DCOL ) && ( A->m == 2 ) && ( A->n == 3 ) && ( A->data_type == REAL_DOUBLE ) );
+  d = A->dd;
+  for ( int i = 0; i < 5; i++ )
+    assert( d[i] == i + 1 );
+  assert( d[5] == -6.0 );
+
+  // symmetric, empty
+  assert( load( "%%MatrixMarket matrix coordinate real symmetric\n5 5 0\n", A, NULL ) == 0 );
+  assert(( A->sym == SM_SYMMETRIC ) && ( A->nz == 0 ) && ( A->m == 5 ) );
+
+  free_matrix( A );
+}
+
+void test_readmm_errors() {
+  matrix_t* A = malloc_matrix();
+  assert( A != NULL );
+  const char* h = "%%MatrixMarket matrix coordinate real general\n";
+  char s[256];
+
+  assert( readmm( "no-such-file.mtx", A, NULL ) == -2 );
+  assert( load( "", A, NULL ) == -11 );
+  assert( load( "%%MatrixMarket matrix coordinate real\n2 2 1\n1 1 1\n", A, NULL ) == -12 );
+  assert( load( "%%MatrixMarket vector coordinate real general\n2 2 1\n1 1 1\n", A, NULL ) == -12 );
+  assert( load( "%%MatrixMarket matrix coordinate real general\n2 2\n1 1 1\n", A, NULL ) == -12 );
+  assert( load( "%%MatrixMarket matrix coordinate pattern general\n2 2 1\n1 1\n", A, NULL ) == -5 );
+  assert( load( "%%MatrixMarket matrix array real symmetric\n2 2\n1\n2\n3\n", A, NULL ) == -8 );
+  // more values than could be allocated: rejected, not overflowed
+  assert( load( "%%MatrixMarket matrix array complex general\n2147483647 2147483647\n1 0\n", A, NULL ) == -12 );
+  snprintf( s, sizeof( s ), "%s2 2 2\n1 1 1\n", h );
+  assert( load( s, A, NULL ) == -6 );  // truncated
+  snprintf( s, sizeof( s ), "%s2 2 1\n1 1 1 2\n", h );
+  assert( load( s, A, NULL ) == -7 );  // complex values
+  snprintf( s, sizeof( s ), "%s2 2 1\n1 1\n", h );
+  assert( load( s, A, NULL ) == -7 );  // no value
+  snprintf( s, sizeof( s ), "%s2 2 1\n1 1 x\n", h );
+  assert( load( s, A, NULL ) == -21 );
+  snprintf( s, sizeof( s ), "%s2 2 1\n1 1 1.0.0\n", h );
+  assert( load( s, A, NULL ) == -22 );
+  snprintf( s, sizeof( s ), "%s2 2 1\n3 1 1\n", h );
+  assert( load( s, A, NULL ) == -22 );  // row out of range
+  snprintf( s, sizeof( s ), "%s2 2 1\n1 0 1\n", h );
+  assert( load( s, A, NULL ) == -22 );  // indices start at one
+  snprintf( s, sizeof( s ), "%s2 2 1\n1\n1 1\n", h );
+  assert( load( s, A, NULL ) == -21 );  // an entry split over lines
+  free_matrix( A );
+}
+
+// big enough to be split between threads
+void test_readmm_large() {
+  const size_t nz = 200000;
+  const size_t size = 64 + nz * 48;
+  char* text = malloc( size );
+  double* dd = malloc( nz * sizeof( double ) );
+  assert(( text != NULL ) && ( dd != NULL ) );
+  size_t line[4] = { 0 };  // where entries 0, nz/4, 3nz/4 and nz-1 start
+  int len = sprintf( text, "%%%%MatrixMarket matrix coordinate real general\n1000 900 %zu\n", nz );
+  for ( size_t k = 0; k < nz; k++ ) {
+    const unsigned long long r = rnd64();
+    const double x = ( double )( r >> 11 ) / ( 1ULL << ( r % 50 ) ) - 1e5;
+    if (( k == nz / 4 ) || ( k == 3 * nz / 4 ) || ( k == nz - 1 ) )
+      line[( k == nz / 4 ) ? 1 : ( k == nz - 1 ) ? 3 : 2] = len;
+    const int l = snprintf( text + len, size - len, ( k % 3 ) ? "%zu %zu %.17g\n" : "%zu %zu %.6g\n\n", k % 1000 + 1, k % 900 + 1, x );
+    dd[k] = strtod( strrchr( text + len, ' ' ) + 1, NULL );
+    len += l;
+  }
+
+  matrix_t* A = malloc_matrix();
+  assert( A != NULL );
+  assert( load( text, A, NULL ) == 0 );
+  assert( A->nz == nz );
+  for ( size_t k = 0; k < nz; k++ )
+    assert(( A->ii[k] == k % 1000 + 1 ) && ( A->jj[k] == k % 900 + 1 ) );
+  assert( memcmp( A->dd, dd, nz * sizeof( double ) ) == 0 );
+
+  // one entry too many, one too few
+  strcpy( text + len, "1 1 1\n" );
+  assert( load( text, A, NULL ) == -9 );
+  text[len] = '\0';
+  const char c = text[line[3]];
+  text[line[3]] = '\0';
+  assert( load( text, A, NULL ) == -6 );
+  text[line[3]] = c;
+
+  // the first of several errors is the one reported
+  text[line[1]] = 'x';
+  text[line[2]] = '.';
+  assert( load( text, A, NULL ) == -21 );
+  text[line[1]] = '1';
+  assert( load( text, A, NULL ) == -22 );
+  free_matrix( A );
+  free( text );
+  free( dd );
+}
+
+int main( int argc, char **argv ) {
+#ifdef _OPENMP
+  omp_set_num_threads( 4 );  // even on one core
+#endif
+  test_parse_double();
+  test_parse_uint();
+  test_readmm();
+  test_readmm_errors();
+  test_readmm_large();
+  return 0;
+}
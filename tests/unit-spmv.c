@@ -0,0 +1,297 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <complex.h>
+#include <math.h>
+#include <assert.h>
+#include "matrix.h"
+#include "spmv.h"
+#include "unit-common.h"
+
+matrix_t* build_dense( size_t m, size_t k, enum matrix_format_t f, enum matrix_data_type_t t, unsigned int seed );
+void reference( matrix_t const* coo, matrix_t const* x, matrix_t* y, double alpha, double beta );
+int close_enough( matrix_t const* a, matrix_t const* b );
+void test_product( matrix_t const* coo, const char* name );
+void test_formats();
+void test_symmetric();
+void test_residual();
+void test_errors();
+
+matrix_t* build_dense( size_t m, size_t k, enum matrix_format_t f, enum matrix_data_type_t t, unsigned int s ) {
+  matrix_t* x = malloc_matrix();
+  assert( x != NULL );
+  *x = ( matrix_t ) {
+    0
+  };
+  x->m = m;
+  x->n = k;
+  x->nz = m * k;
+  x->format = f;
+  x->data_type = t;
+  x->dd = malloc( m * k * _data_width( t ) );
+  assert( x->dd != NULL );
+  for ( size_t i = 0; i < m * k; i++ ) {
+    const double v = (( i * 7 + s ) % 23 ) / 4.0 - 3.0;
+    if ( t == COMPLEX_DOUBLE )
+      (( double complex* ) x->dd )[i] = v - I * v / 2.0;
+    else
+      (( double* ) x->dd )[i] = v;
+  }
+  return x;
+}
+
+// y = alpha*A*x + beta*y straight from the COO entries (and their mirrors if one triangle is stored)
+void reference( matrix_t const* coo, matrix_t const* x, matrix_t* y, double alpha, double beta ) {
+  const int cplx = ( coo->data_type == COMPLEX_DOUBLE );
+  const int half = ( coo->sym != SM_UNSYMMETRIC ) && ( coo->location != MC_STORE_BOTH );
+  for ( size_t c = 0; c < x->n; c++ ) {
+    for ( size_t i = 0; i < y->m; i++ ) {
+      const size_t at = ( y->format == DCOL ) ? i + c * y->m : i * y->n + c;
+      if ( cplx )
+        (( double complex* ) y->dd )[at] *= beta;
+      else
+        (( double* ) y->dd )[at] *= beta;
+    }
+    for ( size_t k = 0; k < coo->nz; k++ ) {
+      for ( int mirror = 0; mirror < 1 + half; mirror++ ) {
+        const size_t i = mirror ? coo->jj[k] : coo->ii[k];
+        const size_t j = mirror ? coo->ii[k] : coo->jj[k];
+        if ( mirror && ( i == j ) )
+          continue;
+        const size_t yat = ( y->format == DCOL ) ? i + c * y->m : i * y->n + c;
+        const size_t xat = ( x->format == DCOL ) ? j + c * x->m : j * x->n + c;
+        if ( cplx ) {
+          double complex v = (( double complex* ) coo->dd )[k];
+          if ( mirror )
+            v = ( coo->sym == SM_SKEW_SYMMETRIC ) ? -v : (( coo->sym == SM_HERMITIAN ) ? conj( v ) : v );
+          (( double complex* ) y->dd )[yat] += alpha * v * (( double complex* ) x->dd )[xat];
+        }
+        else {
+          double v = (( double* ) coo->dd )[k];
+          if ( mirror && ( coo->sym == SM_SKEW_SYMMETRIC ) )
+            v = -v;
+          (( double* ) y->dd )[yat] += alpha * v * (( double* ) x->dd )[xat];
+        }
+      }
+    }
+  }
+}
+
+int close_enough( matrix_t const* a, matrix_t const* b ) {
+  const size_t w = ( a->data_type == COMPLEX_DOUBLE ) ? 2 : 1;
+  for ( size_t i = 0; i < a->m * a->n * w; i++ ) {
+    const double x = (( double* ) a->dd )[i], y = (( double* ) b->dd )[i];
+    if ( fabs( x - y ) > 1e-10 * ( 1.0 + fabs( x ) ) )
+      return 0;
+  }
+  return 1;
+}
+
+// every storage format, every kernel this CPU has, one and three right-hand
+// sides in both dense layouts
+void test_product( matrix_t const* coo, const char* name ) {
+  const enum matrix_format_t formats[] = { SM_COO, SM_CSR, SM_CSC, SM_BCSR };
+  const enum spmv_kernel_t kernels[] = { SPMV_SCALAR, SPMV_AVX2, SPMV_AVX512 };
+  const enum matrix_base_t bases[] = { FIRST_INDEX_ZERO, FIRST_INDEX_ONE };
+  for ( int f = 0; f < 4; f++ ) {
+    matrix_t* a = copy_matrix(( matrix_t* ) coo );
+    assert( a != NULL );
+    a->block_size = 3;
+    assert( convert_matrix( a, formats[f], bases[f % 2] ) == 0 );
+    for ( int kern = 0; kern < 3; kern++ ) {
+      if ( spmv_set_kernel( kernels[kern] ) != 0 )
+        continue;  // not on this CPU
+      for ( size_t k = 1; k <= 3; k += 2 ) {
+        for ( enum matrix_format_t layout = DROW; layout <= DCOL; layout++ ) {
+          matrix_t* x = build_dense( coo->n, k, layout, coo->data_type, 1 );
+          matrix_t* y = build_dense( coo->m, k, layout, coo->data_type, 2 );
+          matrix_t* expected = copy_matrix( y );
+          assert( expected != NULL );
+          reference( coo, x, expected, 2.0, 0.5 );
+          assert( spmv( a, x, y, 2.0, 0.5 ) == 0 );
+          assert( close_enough( expected, y ) );
+          // beta = 0: y is overwritten, even NaNs
+          memset( y->dd, 0xff, y->m * y->n * _data_width( y->data_type ) );
+          reference( coo, x, expected, -1.0, 0.0 );
+          assert( spmv( a, x, y, 1.0, 0.0 ) == 0 );
+          for ( size_t i = 0; i < y->m * y->n * (( y->data_type == COMPLEX_DOUBLE ) ? 2 : 1 ); i++ )  // expected = -y
+            (( double* ) y->dd )[i] = -(( double* ) y->dd )[i];
+          assert( close_enough( expected, y ) );
+          free_matrix( x );
+          free_matrix( y );
+          free_matrix( expected );
+        }
+      }
+    }
+    printf( "%s: format %d ok\n", name, formats[f] );
+    free_matrix( a );
+  }
+  assert( spmv_set_kernel( SPMV_AUTO ) == 0 );
+}
+
+void test_formats() {
+  printf( "formats test (kernel %s)\n", spmv_kernel_name( spmv_kernel() ) );
+  matrix_t* a = random_coo( 101, 67, 900, REAL_DOUBLE, 0 );
+  test_product( a, "real" );
+  free_matrix( a );
+  a = random_coo( 67, 101, 900, COMPLEX_DOUBLE, 0 );
+  test_product( a, "complex" );
+  free_matrix( a );
+  // big enough to be shared between threads
+  a = random_coo( 3000, 3000, 100000, REAL_DOUBLE, 0 );
+  test_product( a, "real, large" );
+  free_matrix( a );
+}
+
+// one stored triangle is multiplied as the whole matrix
+void test_symmetric() {
+  printf( "symmetric test\n" );
+  const enum matrix_symmetry_t sym[] = { SM_SYMMETRIC, SM_SKEW_SYMMETRIC, SM_HERMITIAN };
+  for ( int s = 0; s < 3; s++ ) {
+    matrix_t* a = random_coo( 80, 80, 600, ( sym[s] == SM_HERMITIAN ) ? COMPLEX_DOUBLE : REAL_DOUBLE, 1 );
+    a->sym = sym[s];
+    a->location = LOWER_TRIANGULAR;
+    if ( sym[s] != SM_SYMMETRIC ) {  // diagonal: zero (skew), real (hermitian)
+      for ( size_t k = 0; k < a->nz; k++ ) {
+        if ( a->ii[k] != a->jj[k] )
+          continue;
+        if ( sym[s] == SM_SKEW_SYMMETRIC )
+          (( double* ) a->dd )[k] = 0.0;
+        else
+          (( double complex* ) a->dd )[k] = creal((( double complex* ) a->dd )[k] );
+      }
+    }
+    test_product( a, "one triangle" );
+
+    // and the same as with both triangles stored
+    matrix_t* b = copy_matrix( a );
+    assert( b != NULL );
+    assert( convert_matrix_symmetry( b, MC_STORE_BOTH ) == 0 );
+    assert( convert_matrix( b, SM_CSR, FIRST_INDEX_ZERO ) == 0 );
+    matrix_t* x = build_dense( 80, 2, DCOL, a->data_type, 3 );
+    matrix_t* y = build_dense( 80, 2, DCOL, a->data_type, 4 );
+    matrix_t* z = copy_matrix( y );
+    assert( spmv( a, x, y, 1.0, 0.0 ) == 0 );
+    assert( spmv( b, x, z, 1.0, 0.0 ) == 0 );
+    assert( close_enough( y, z ) );
+    free_matrix( x );
+    free_matrix( y );
+    free_matrix( z );
+    free_matrix( b );
+    free_matrix( a );
+  }
+}
+
+// b = Ax gives a residual at rounding level; changing one entry of b by d
+// gives d / (||A|| ||x|| + ||b||) exactly (infinity norms)
+void test_residual() {
+  printf( "residual test\n" );
+  matrix_t* a = random_coo( 60, 60, 400, REAL_DOUBLE, 1 );
+  a->sym = SM_SYMMETRIC;
+  a->location = LOWER_TRIANGULAR;
+  assert( merge_duplicate_entries( a ) == 0 );  // a dense copy keeps one of each
+  matrix_t* x = build_dense( 60, 2, DROW, REAL_DOUBLE, 5 );
+  matrix_t* b = build_dense( 60, 2, DCOL, REAL_DOUBLE, 6 );
+  assert( spmv( a, x, b, 1.0, 0.0 ) == 0 );
+  double r[2];
+  assert( spmv_residual( a, x, b, r ) == 0 );
+  assert(( r[0] < 1e-15 ) && ( r[1] < 1e-15 ) );
+
+  // ||A||: largest row sum of both triangles
+  double row[60] = { 0 };
+  for ( size_t k = 0; k < a->nz; k++ ) {
+    row[a->ii[k]] += fabs((( double* ) a->dd )[k] );
+    if ( a->ii[k] != a->jj[k] )
+      row[a->jj[k]] += fabs((( double* ) a->dd )[k] );
+  }
+  double anorm = 0.0, xnorm = 0.0, bnorm = 0.0;
+  for ( size_t i = 0; i < 60; i++ ) {
+    anorm = ( row[i] > anorm ) ? row[i] : anorm;
+    const double v = fabs((( double* ) x->dd )[i * 2 + 1] );
+    xnorm = ( v > xnorm ) ? v : xnorm;
+  }
+  (( double* ) b->dd )[60 + 7] += 1e-3;
+  for ( size_t i = 0; i < 60; i++ ) {
+    const double v = fabs((( double* ) b->dd )[60 + i] );
+    bnorm = ( v > bnorm ) ? v : bnorm;
+  }
+  // any format or precision of A gives the same
+  const enum matrix_format_t formats[] = { SM_COO, SM_CSR, SM_CSC, SM_BCSR, DROW };
+  for ( int f = 0; f < 5; f++ ) {
+    matrix_t* c = copy_matrix( a );
+    assert( c != NULL );
+    c->block_size = 4;
+    assert( convert_matrix( c, formats[f], FIRST_INDEX_ONE ) == 0 );
+    assert( spmv_residual( c, x, b, r ) == 0 );
+    assert( r[0] < 1e-15 );
+    assert( fabs( r[1] - 1e-3 / ( anorm * xnorm + bnorm ) ) < 1e-3 * r[1] );
+    free_matrix( c );
+  }
+  matrix_t* c = copy_matrix( a );
+  assert( convert_matrix_data_type( c, REAL_SINGLE ) == 0 );
+  assert( spmv_residual( c, x, b, r ) == 0 );
+  assert(( r[0] < 1e-6 ) && ( r[1] > 1e-6 ) );
+  free_matrix( c );
+
+  // a complex solution of a real system
+  assert( convert_matrix_data_type( x, COMPLEX_DOUBLE ) == 0 );
+  assert( spmv_residual( a, x, b, r ) == 0 );
+  assert( r[0] < 1e-15 );
+  assert( spmv_residual( a, b, x, r ) == 0 );  // sizes match only because A is square
+  assert( r[0] > 1e-3 );
+
+  matrix_t* z = build_dense( 59, 2, DCOL, REAL_DOUBLE, 1 );
+  assert( spmv_residual( a, z, b, r ) == -1 );  // wrong size
+  free_matrix( z );
+  free_matrix( a );
+  free_matrix( x );
+  free_matrix( b );
+}
+
+void test_errors() {
+  printf( "errors test\n" );
+  matrix_t* a = random_coo( 10, 8, 20, REAL_DOUBLE, 0 );
+  matrix_t* x = build_dense( 8, 1, DCOL, REAL_DOUBLE, 1 );
+  matrix_t* y = build_dense( 10, 1, DCOL, REAL_DOUBLE, 2 );
+  matrix_t* z = build_dense( 8, 1, DCOL, REAL_DOUBLE, 2 );
+  assert( spmv( a, x, z, 1.0, 0.0 ) == -1 );  // wrong size
+  assert( spmv( a, y, y, 1.0, 0.0 ) == -1 );
+  assert( convert_matrix_data_type( a, REAL_SINGLE ) == 0 );
+  assert( spmv( a, x, y, 1.0, 0.0 ) == -1 );  // single precision
+  assert( convert_matrix( a, DROW, FIRST_INDEX_ZERO ) == 0 );
+  assert( spmv( a, x, y, 1.0, 0.0 ) == -1 );  // dense
+  assert( spmv_set_kernel( SPMV_SCALAR ) == 0 );
+  assert( spmv_kernel() == SPMV_SCALAR );
+  assert( spmv_set_kernel( SPMV_AUTO ) == 0 );
+  assert( spmv_kernel() != SPMV_AUTO );
+  free_matrix( a );
+  free_matrix( x );
+  free_matrix( y );
+  free_matrix( z );
+}
+
+int main( int argc, char **argv ) {
+  test_formats();
+  test_symmetric();
+  test_residual();
+  test_errors();
+  return 0;
+}
@@ -0,0 +1,251 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include "matrix.h"
+#include "stats.h"
+#include "unit-common.h"
+
+matrix_t* build_coo( size_t m, size_t n, size_t nz, unsigned int const* ii, unsigned int const* jj, double const* dd );
+matrix_t* build_random( size_t m, size_t nz, size_t dense, int lower );
+void reference( matrix_t const* coo, struct matrix_stats_t* s );
+void test_small();
+void test_formats( matrix_t const* coo, const char* name );
+void test_random();
+void test_symmetric();
+
+matrix_t* build_coo( size_t m, size_t n, size_t nz, unsigned int const* ii, unsigned int const* jj, double const* dd ) {
+  matrix_t* a = new_coo( m, n, nz, REAL_DOUBLE );
+  for ( size_t k = 0; k < nz; k++ ) {
+    a->ii[k] = ii[k];
+    a->jj[k] = jj[k];
+    (( double* ) a->dd )[k] = dd[k];
+  }
+  return a;
+}
+
+// square, no repeated entries; 'dense' rows of m/4 entries; 'lower': only i >= j
+matrix_t* build_random( size_t m, size_t nz, size_t dense, int lower ) {
+  const size_t total = nz + dense * ( m / 4 );
+  unsigned int* ii = malloc( total * sizeof( unsigned int ) );
+  unsigned int* jj = malloc( total * sizeof( unsigned int ) );
+  double* dd = malloc( total * sizeof( double ) );
+  assert(( ii != NULL ) && ( jj != NULL ) && ( dd != NULL ) );
+  for ( size_t k = 0; k < total; k++ ) {
+    unsigned int i = rnd() % m, j = rnd() % m;
+    if ( k >= nz ) {  // dense rows, at the top
+      i = ( k - nz ) / ( m / 4 );
+      j = m - 1 - ( k - nz ) % ( m / 4 );
+    }
+    if ( lower && ( i < j ) ) {
+      const unsigned int s = i;
+      i = j;
+      j = s;
+    }
+    ii[k] = i;
+    jj[k] = j;
+    dd[k] = ( rnd() % 1000 ) / 100.0 - 4.995 + (( i == j ) ? 50.0 : 0.0 );  // never zero: dense and BCSR copies drop zeros
+  }
+  matrix_t* a = build_coo( m, m, total, ii, jj, dd );
+  free( ii );
+  free( jj );
+  free( dd );
+  assert( merge_duplicate_entries( a ) == 0 );
+  return a;
+}
+
+// the statistics straight from the COO entries (and their mirrors)
+void reference( matrix_t const* coo, struct matrix_stats_t* s ) {
+  const int half = ( coo->sym != SM_UNSYMMETRIC ) && ( coo->location != MC_STORE_BOTH );
+  size_t* degree = calloc( coo->m, sizeof( size_t ) );
+  size_t* first = malloc( coo->m * sizeof( size_t ) );
+  double* diag = calloc( coo->m, sizeof( double ) );
+  double* diag_re = calloc( coo->m, sizeof( double ) );
+  double* off = calloc( coo->m, sizeof( double ) );
+  int* has_diag = calloc( coo->m, sizeof( int ) );
+  int* col = calloc( coo->n, sizeof( int ) );
+  *s = ( struct matrix_stats_t ) {
+    0
+  };
+  s->m = coo->m;
+  s->n = coo->n;
+  s->sym = coo->sym;
+  for ( size_t i = 0; i < coo->m; i++ )
+    first[i] = i;
+  for ( size_t k = 0; k < coo->nz; k++ ) {
+    for ( int mirror = 0; mirror < 1 + half; mirror++ ) {
+      const size_t i = mirror ? coo->jj[k] : coo->ii[k];
+      const size_t j = mirror ? coo->ii[k] : coo->jj[k];
+      if ( mirror && ( i == j ) )
+        continue;
+      const double v = ((( double* ) coo->dd )[k] < 0 ) ? -(( double* ) coo->dd )[k] : (( double* ) coo->dd )[k];
+      s->nz++;
+      degree[i]++;
+      col[j] = 1;
+      if ( i == j ) {
+        diag[i] += v;
+        diag_re[i] += (( double* ) coo->dd )[k];
+        has_diag[i] = 1;
+      }
+      else
+        off[i] += v;
+      if (( i > j ) && ( i - j > s->lower_bandwidth ) )
+        s->lower_bandwidth = i - j;
+      if (( j > i ) && ( j - i > s->upper_bandwidth ) )
+        s->upper_bandwidth = j - i;
+      if ( j < first[i] )
+        first[i] = j;
+    }
+  }
+  s->min_degree = coo->m;
+  for ( size_t i = 0; i < coo->m; i++ ) {
+    s->profile += i - first[i];
+    s->min_degree = ( degree[i] < s->min_degree ) ? degree[i] : s->min_degree;
+    s->max_degree = ( degree[i] > s->max_degree ) ? degree[i] : s->max_degree;
+    unsigned int b = 0;
+    for ( size_t d = degree[i]; ( d != 0 ) && ( b < MC_STATS_DEGREE_BINS - 1 ); d >>= 1 )
+      b++;
+    s->degree_histogram[b]++;
+    s->empty_rows += ( degree[i] == 0 );
+    s->diagonal += has_diag[i];
+    s->positive_diagonal += ( diag_re[i] > 0.0 );
+    s->dominant_rows += ( degree[i] != 0 ) && ( diag[i] >= off[i] );
+    s->dense_rows += ( degree[i] >= MC_STATS_DENSE_ROW_MIN ) && ( degree[i] * degree[i] > 100 * coo->n );
+  }
+  for ( size_t j = 0; j < coo->n; j++ )
+    s->empty_cols += ( col[j] == 0 );
+  free( degree );
+  free( first );
+  free( diag );
+  free( diag_re );
+  free( off );
+  free( has_diag );
+  free( col );
+}
+
+// the same statistics from every format (block size aside, which is compared to detect_matrix_block_size())
+void test_formats( matrix_t const* coo, const char* name ) {
+  const enum matrix_format_t formats[] = { SM_COO, SM_CSR, SM_CSC, SM_BCSR, DROW };
+  struct matrix_stats_t expected, s;
+  reference( coo, &expected );
+  for ( int f = 0; f < 5; f++ ) {
+    matrix_t* a = copy_matrix(( matrix_t* ) coo );
+    assert( a != NULL );
+    a->block_size = 2;
+    assert( convert_matrix( a, formats[f], ( f % 2 ) ? FIRST_INDEX_ONE : FIRST_INDEX_ZERO ) == 0 );
+    if ( formats[f] == SM_CSR )
+      assert( convert_matrix_index_width( a, MC_INDEX_64 ) == 0 );
+    assert( matrix_stats( a, &s ) == 0 );
+    expected.block_size = s.block_size;
+    assert( memcmp( &s, &expected, sizeof( s ) ) == 0 );
+    free_matrix( a );
+  }
+  printf( "%s: ok (bandwidth %zu/%zu, profile %zu, block size %u)\n", name, s.lower_bandwidth, s.upper_bandwidth,
+          s.profile, s.block_size );
+}
+
+void test_small() {
+  printf( "small test\n" );
+  const unsigned int ii[] = { 0, 0, 1, 2, 2, 2, 4, 4 };
+  const unsigned int jj[] = { 0, 1, 1, 0, 2, 3, 4, 0 };
+  const double dd[] = { 4.0, 1.0, 3.0, -1.0, 1.0, 2.0, 0.5, 1.0 };
+  matrix_t* a = build_coo( 5, 5, 8, ii, jj, dd );
+  struct matrix_stats_t s;
+  assert( matrix_stats( a, &s ) == 0 );
+  matrix_stats_printf( &s );
+  assert(( s.m == 5 ) && ( s.n == 5 ) && ( s.nz == 8 ) );
+  assert(( s.lower_bandwidth == 4 ) && ( s.upper_bandwidth == 1 ) );
+  assert( s.profile == 6 );  // rows 2 and 4
+  assert(( s.min_degree == 0 ) && ( s.max_degree == 3 ) );
+  assert(( s.degree_histogram[0] == 1 ) && ( s.degree_histogram[1] == 1 ) && ( s.degree_histogram[2] == 3 ) );
+  assert(( s.empty_rows == 1 ) && ( s.empty_cols == 0 ) );
+  assert(( s.diagonal == 4 ) && ( s.positive_diagonal == 4 ) && ( s.dominant_rows == 2 ) && ( s.dense_rows == 0 ) );
+  assert( matrix_stats_definite( &s ) == -1 );  // row 3 has no diagonal
+  test_formats( a, "small" );
+
+  // nothing stored
+  a->nz = 0;
+  assert( matrix_stats( a, &s ) == 0 );
+  assert(( s.empty_rows == 5 ) && ( s.empty_cols == 5 ) && ( s.degree_histogram[0] == 5 ) && ( s.profile == 0 ) );
+  free_matrix( a );
+}
+
+// big enough to be shared between threads
+void test_random() {
+  printf( "random test\n" );
+  matrix_t* a = build_random( 3000, 100000, 3, 0 );
+  test_formats( a, "unsymmetric" );
+  struct matrix_stats_t s;
+  assert( matrix_stats( a, &s ) == 0 );
+  assert( s.dense_rows == 3 );
+  free_matrix( a );
+}
+
+// one stored triangle is described as the whole matrix
+void test_symmetric() {
+  printf( "symmetric test\n" );
+  matrix_t* a = build_random( 2000, 80000, 2, 1 );
+  a->sym = SM_SYMMETRIC;
+  a->location = LOWER_TRIANGULAR;
+  test_formats( a, "lower" );
+  struct matrix_stats_t lower, s;
+  assert( matrix_stats( a, &lower ) == 0 );
+  assert( lower.lower_bandwidth == lower.upper_bandwidth );
+
+  matrix_t* b = copy_matrix( a );
+  assert( b != NULL );
+  assert( convert_matrix_symmetry( b, UPPER_TRIANGULAR ) == 0 );
+  assert( matrix_stats( b, &s ) == 0 );
+  assert( memcmp( &s, &lower, sizeof( s ) ) == 0 );
+  assert( convert_matrix_symmetry( b, MC_STORE_BOTH ) == 0 );
+  assert( matrix_stats( b, &s ) == 0 );
+  s.block_size = lower.block_size;  // found from a different set of entries
+  assert( memcmp( &s, &lower, sizeof( s ) ) == 0 );
+  free_matrix( b );
+  free_matrix( a );
+
+  // 2 on the diagonal, -1 either side: positive definite, and diagonal
+  // dominance shows it
+  const unsigned int ii[] = { 0, 1, 1, 2, 2 };
+  const unsigned int jj[] = { 0, 0, 1, 1, 2 };
+  const double dd[] = { 2.0, -1.0, 2.0, -1.0, 2.0 };
+  a = build_coo( 3, 3, 5, ii, jj, dd );
+  assert( matrix_stats( a, &s ) == 0 );
+  assert( matrix_stats_definite( &s ) == 0 );  // not known to be symmetric
+  a->sym = SM_SYMMETRIC;
+  a->location = LOWER_TRIANGULAR;
+  assert( matrix_stats( a, &s ) == 0 );
+  assert(( s.dominant_rows == 3 ) && ( matrix_stats_definite( &s ) == 1 ) );
+  (( double* ) a->dd )[2] = 1.0;
+  assert( matrix_stats( a, &s ) == 0 );
+  assert(( s.dominant_rows == 2 ) && ( matrix_stats_definite( &s ) == 0 ) );
+  (( double* ) a->dd )[2] = -2.0;
+  assert( matrix_stats( a, &s ) == 0 );
+  assert(( s.positive_diagonal == 2 ) && ( matrix_stats_definite( &s ) == -1 ) );
+  free_matrix( a );
+}
+
+int main( int argc, char **argv ) {
+  test_small();
+  test_random();
+  test_symmetric();
+  return 0;
+}
@@ -0,0 +1,463 @@
+/* Meagre-Crowd: A sparse distributed matrix solver testbench for performance benchmarking.
+ * Copyright (C) 2010 Alistair Boyle <alistair.js.boyle@gmail.com>
+ *
+ *     This file is part of Meagre-Crowd.
+ *
+ *     Meagre-Crowd program is free software: you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation, either version 3 of the License, or
+ *     (at your option) any later version.
+ *
+ *     This program is distributed in the hope that it will be useful,
+ *     but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *     MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *     GNU General Public License for more details.
+ *
+ *     You should have received a copy of the GNU General Public License
+ *     along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "config.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <assert.h>
+#ifdef HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+#ifdef HAVE_LZMA
+#include <lzma.h>
+#endif
+#include "matrix.h"
+#include "readmm.h"
+#include "stream.h"
+#include "unit-common.h"
+
+// an in-memory file
+struct buf_t {
+  char* p;
+  size_t len;
+  size_t cap;
+};
+
+void append( struct buf_t* b, const void* p, size_t len );
+void tar_member( struct buf_t* b, const char* name, char type, const void* p, size_t len );
+void tar_end( struct buf_t* b );
+struct buf_t pack( const struct buf_t* in, int c );
+int read_all( const char* name, unsigned int flags, struct buf_t* out );
+struct buf_t make_mtx( size_t nz );
+void test_detect();
+void test_compressed();
+void test_tar();
+void test_errors();
+void test_readmm_stream();
+
+void append( struct buf_t* b, const void* p, size_t len ) {
+  if ( b->len + len + 1 > b->cap ) {
+    b->cap = 2 * ( b->len + len + 1 );
+    b->p = realloc( b->p, b->cap );
+    assert( b->p != NULL );
+  }
+  memcpy( b->p + b->len, p, len );
+  b->len += len;
+  b->p[b->len] = '\0';
+}
+
+// a ustar header and the member's data, padded to 512 bytes
+void tar_member( struct buf_t* b, const char* name, char type, const void* p, size_t len ) {
+  char h[512] = { 0 };
+  strncpy( h, name, 100 );
+  strcpy( h + 100, "0000644" );
+  snprintf( h + 124, 12, "%011zo", len );
+  snprintf( h + 136, 12, "%011o", 0 );
+  h[156] = type;
+  memcpy( h + 257, "ustar\0" "00", 8 );
+  memset( h + 148, ' ', 8 );
+  unsigned int sum = 0;
+  for ( int i = 0; i < 512; i++ )
+    sum += ( unsigned char ) h[i];
+  snprintf( h + 148, 8, "%06o", sum );
+  append( b, h, 512 );
+  append( b, p, len );
+  const char zero[512] = { 0 };
+  append( b, zero, ( 512 - len % 512 ) % 512 );
+}
+
+void tar_end( struct buf_t* b ) {
+  const char zero[1024] = { 0 };
+  append( b, zero, sizeof( zero ) );
+}
+
+// c: an mc_compression_t
+struct buf_t pack( const struct buf_t* in, int c ) {
+  struct buf_t out = { NULL, 0, 0 };
+  switch ( c ) {
+#ifdef HAVE_ZLIB
+    case MC_GZIP:
+    {
+      z_stream z = { 0 };
+      assert( deflateInit2( &z, 1, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY ) == Z_OK );
+      out.len = deflateBound( &z, in->len );
+      out.p = malloc( out.len );
+      assert( out.p != NULL );
+      z.next_in = ( unsigned char* ) in->p;
+      z.avail_in = in->len;
+      z.next_out = ( unsigned char* ) out.p;
+      z.avail_out = out.len;
+      assert( deflate( &z, Z_FINISH ) == Z_STREAM_END );
+      out.len = z.total_out;
+      deflateEnd( &z );
+      break;
+    }
+#endif
+#ifdef HAVE_ZSTD
+    case MC_ZSTD:
+      out.len = ZSTD_compressBound( in->len );
+      out.p = malloc( out.len );
+      assert( out.p != NULL );
+      out.len = ZSTD_compress( out.p, out.len, in->p, in->len, 1 );
+      assert( !ZSTD_isError( out.len ) );
+      break;
+#endif
+#ifdef HAVE_LZMA
+    case MC_XZ:
+    {
+      size_t pos = 0;
+      out.len = lzma_stream_buffer_bound( in->len );
+      out.p = malloc( out.len );
+      assert( out.p != NULL );
+      assert( lzma_easy_buffer_encode( 0, LZMA_CHECK_CRC64, NULL, ( uint8_t* ) in->p, in->len,
+                                       ( uint8_t* ) out.p, &pos, out.len ) == LZMA_OK );
+      out.len = pos;
+      break;
+    }
+#endif
+    default:
+      append( &out, in->p, in->len );
+  }
+  return out;
+}
+
+// everything the stream gives, in 'out'
+int read_all( const char* name, unsigned int flags, struct buf_t* out ) {
+  struct mc_stream_t* s;
+  int ret = mc_stream_open( name, flags, &s );
+  if ( ret != 0 )
+    return ret;
+  *out = ( struct buf_t ) {
+    NULL, 0, 0
+  };
+  char const* p;
+  size_t len;
+  while (( ret = mc_stream_next( s, &p, &len ) ) == 0 ) {
+    assert(( len > 0 ) && ( len <= MC_STREAM_BLOCK ) );
+    append( out, p, len );
+  }
+  assert( mc_stream_next( s, &p, &len ) == ret );  // it stays at the end
+  mc_stream_close( s );
+  return ( ret == 1 ) ? 0 : ret;
+}
+
+// a random real matrix, with some blank lines
+struct buf_t make_mtx( size_t nz ) {
+  struct buf_t b = { NULL, 0, 0 };
+  char s[128];
+  int len = snprintf( s, sizeof( s ), "%%%%MatrixMarket matrix coordinate real general\n%% a comment\n1000 900 %zu\n", nz );
+  append( &b, s, len );
+  for ( size_t k = 0; k < nz; k++ ) {
+    const unsigned long long r = rnd64();
+    const double x = ( double )( r >> 11 ) / ( 1ULL << ( r % 50 ) ) - 1e5;
+    len = snprintf( s, sizeof( s ), ( k % 7 ) ? "%zu %zu %.17g\n" : "%zu %zu %.6g\n\n", k % 1000 + 1, k % 900 + 1, x );
+    append( &b, s, len );
+  }
+  return b;
+}
+
+void test_detect() {
+  struct buf_t b = { NULL, 0, 0 };
+  append( &b, "hello\n", 6 );
+  char* name = write_temp( "unit-stream", b.p, b.len );
+  int tar = -1;
+  assert( mc_stream_detect( name, &tar ) == MC_UNCOMPRESSED );
+  assert( tar == 0 );
+  unlink( name );
+  free( name );
+
+  tar_member( &b, "a/a.mtx", '0', "x", 1 );
+  tar_end( &b );
+  name = write_temp( "unit-stream", b.p, b.len );
+  assert( mc_stream_detect( name, &tar ) == MC_UNCOMPRESSED );
+  assert( tar == 0 );  // not at the start
+  unlink( name );
+  free( name );
+  assert( mc_stream_detect( "unit-stream.no-such-file", &tar ) == -2 );
+  free( b.p );
+}
+
+// larger than the blocks in flight, so they're all reused
+void test_compressed() {
+  struct buf_t in = { NULL, 0, 0 };
+  while ( in.len < ( MC_STREAM_BLOCKS + 2 ) * MC_STREAM_BLOCK + 1234 ) {
+    char s[32];
+    const int len = snprintf( s, sizeof( s ), "%llu\n", rnd64() >> ( rnd64() % 64 ) );
+    append( &in, s, len );
+  }
+  const int c[] = { MC_UNCOMPRESSED,
+#ifdef HAVE_ZLIB
+                    MC_GZIP,
+#endif
+#ifdef HAVE_ZSTD
+                    MC_ZSTD,
+#endif
+#ifdef HAVE_LZMA
+                    MC_XZ,
+#endif
+                  };
+  for ( size_t i = 0; i < sizeof( c ) / sizeof( c[0] ); i++ ) {
+    struct buf_t z = pack( &in, c[i] ), out;
+    char* name = write_temp( "unit-stream", z.p, z.len );
+    int tar = -1;
+    assert( mc_stream_detect( name, &tar ) == c[i] );
+    assert( read_all( name, 0, &out ) == 0 );
+    assert(( out.len == in.len ) && ( memcmp( out.p, in.p, in.len ) == 0 ) );
+    free( out.p );
+
+    // truncated
+    if ( c[i] != MC_UNCOMPRESSED ) {
+      const int ret = truncate( name, z.len / 2 );  // not inside assert(): NDEBUG would skip it
+      assert( ret == 0 );
+      assert( read_all( name, 0, &out ) == -13 );
+      free( out.p );
+    }
+    unlink( name );
+    free( name );
+
+    // concatenated files are one stream
+    if ( c[i] != MC_UNCOMPRESSED ) {
+      struct buf_t two = { NULL, 0, 0 };
+      append( &two, z.p, z.len );
+      append( &two, z.p, z.len );
+      name = write_temp( "unit-stream", two.p, two.len );
+      assert( read_all( name, 0, &out ) == 0 );
+      assert(( out.len == 2 * in.len ) && ( memcmp( out.p, in.p, in.len ) == 0 ) &&
+             ( memcmp( out.p + in.len, in.p, in.len ) == 0 ) );
+      free( out.p );
+      unlink( name );
+      free( name );
+      free( two.p );
+    }
+    free( z.p );
+  }
+  free( in.p );
+}
+
+void test_tar() {
+  struct buf_t big = make_mtx( 300000 );  // several blocks
+  const char* lng = "a-directory-with-a-rather-long-name-for-the-old-tar-format/"
+                    "a-directory-with-a-rather-long-name-for-the-old-tar-format.mtx";
+
+  // SuiteSparse: the matrix isn't necessarily first
+  struct buf_t t = { NULL, 0, 0 };
+  tar_member( &t, "Name/", '5', "", 0 );
+  tar_member( &t, "Name/Name_b.mtx", '0', "not this\n", 9 );
+  tar_member( &t, "Name/README", '0', big.p, 1000 );
+  tar_member( &t, "Name/Name.mtx", '0', big.p, big.len );
+  tar_member( &t, "Name/Name_x.mtx", '0', "nor this\n", 9 );
+  tar_end( &t );
+  // a GNU long name
+  struct buf_t l = { NULL, 0, 0 };
+  tar_member( &l, "././@LongLink", 'L', lng, strlen( lng ) + 1 );
+  tar_member( &l, "a-directory-with-a-rather-long-name-for-the-old-tar-format/a-directory-with-a", '0', "yes\n", 4 );
+  tar_end( &l );
+  // no SuiteSparse name: only with MC_STREAM_ANY_MTX
+  struct buf_t a = { NULL, 0, 0 };
+  tar_member( &a, "notes.txt", '0', "no\n", 3 );
+  tar_member( &a, "x/y.mtx", '0', "this\n", 5 );
+  tar_member( &a, "x/z.mtx", '0', "not this\n", 9 );
+  tar_end( &a );
+
+  for ( int c = MC_UNCOMPRESSED; c <= MC_XZ; c++ ) {
+#ifndef HAVE_ZLIB
+    if ( c == MC_GZIP )
+      continue;
+#endif
+#ifndef HAVE_ZSTD
+    if ( c == MC_ZSTD )
+      continue;
+#endif
+#ifndef HAVE_LZMA
+    if ( c == MC_XZ )
+      continue;
+#endif
+    struct buf_t z = pack( &t, c ), out;
+    char* name = write_temp( "unit-stream", z.p, z.len );
+    int tar = -1;
+    mc_stream_detect( name, &tar );
+    assert( tar == ( c == MC_UNCOMPRESSED ) );
+    assert( read_all( name, 0, &out ) == 0 );
+    assert(( out.len == big.len ) && ( memcmp( out.p, big.p, big.len ) == 0 ) );
+    free( out.p );
+    unlink( name );
+    free( name );
+    free( z.p );
+
+    z = pack( &l, c );
+    name = write_temp( "unit-stream", z.p, z.len );
+    assert( read_all( name, 0, &out ) == 0 );
+    assert(( out.len == 4 ) && ( memcmp( out.p, "yes\n", 4 ) == 0 ) );
+    free( out.p );
+    unlink( name );
+    free( name );
+    free( z.p );
+
+    z = pack( &a, c );
+    name = write_temp( "unit-stream", z.p, z.len );
+    assert( read_all( name, 0, &out ) == -14 );
+    free( out.p );
+    assert( read_all( name, MC_STREAM_ANY_MTX, &out ) == 0 );
+    assert(( out.len == 5 ) && ( memcmp( out.p, "this\n", 5 ) == 0 ) );
+    free( out.p );
+    unlink( name );
+    free( name );
+    free( z.p );
+  }
+  free( big.p );
+  free( t.p );
+  free( l.p );
+  free( a.p );
+}
+
+void test_errors() {
+  struct mc_stream_t* s = NULL;
+  assert( mc_stream_open( "unit-stream.no-such-file", 0, &s ) == -2 );
+  assert( s == NULL );
+  mc_stream_close( NULL );
+
+#ifndef HAVE_ZSTD
+  struct buf_t b = { NULL, 0, 0 };
+  append( &b, "\x28\xb5\x2f\xfd" "data", 8 );
+  char* name = write_temp( "unit-stream", b.p, b.len );
+  assert( mc_stream_open( name, 0, &s ) == -15 );
+  unlink( name );
+  free( name );
+  free( b.p );
+#endif
+
+  // an empty file is fine, and empty
+  struct buf_t e = { NULL, 0, 0 }, out;
+  append( &e, "", 0 );
+  char* ename = write_temp( "unit-stream", e.p, e.len );
+  assert( read_all( ename, 0, &out ) == 0 );
+  assert( out.len == 0 );
+  unlink( ename );
+  free( ename );
+  free( e.p );
+
+  // a tar archive that stops in the middle of the member
+  struct buf_t t = { NULL, 0, 0 };
+  tar_member( &t, "M/M.mtx", '0', "0123456789", 10 );
+  t.len = 512 + 5;
+  ename = write_temp( "unit-stream", t.p, t.len );
+  assert( read_all( ename, 0, &out ) == -13 );
+  free( out.p );
+  unlink( ename );
+  free( ename );
+  free( t.p );
+}
+
+// readmm() gives the same matrix from a compressed file or an archive
+void test_readmm_stream() {
+  struct buf_t mtx = make_mtx( 400000 );
+  char* plain = write_temp( "unit-stream", mtx.p, mtx.len );
+  matrix_t* A = malloc_matrix();
+  matrix_t* B = malloc_matrix();
+  assert(( A != NULL ) && ( B != NULL ) );
+  char* comments = NULL;
+  assert( readmm( plain, A, &comments ) == 0 );
+  assert( strcmp( comments, "% a comment\n" ) == 0 );
+  free( comments );
+  unlink( plain );
+  free( plain );
+
+  struct buf_t t = { NULL, 0, 0 };
+  const char* rhs = "%%MatrixMarket matrix array real general\n1 1\n1\n";
+  tar_member( &t, "Big/Big_b.mtx", '0', rhs, strlen( rhs ) );
+  tar_member( &t, "Big/Big.mtx", '0', mtx.p, mtx.len );
+  tar_end( &t );
+  for ( int c = MC_UNCOMPRESSED; c <= MC_XZ; c++ ) {
+#ifndef HAVE_ZLIB
+    if ( c == MC_GZIP )
+      continue;
+#endif
+#ifndef HAVE_ZSTD
+    if ( c == MC_ZSTD )
+      continue;
+#endif
+#ifndef HAVE_LZMA
+    if ( c == MC_XZ )
+      continue;
+#endif
+    for ( int archive = ( c == MC_UNCOMPRESSED ); archive < 2; archive++ ) {
+      struct buf_t z = pack( archive ? &t : &mtx, c );
+      char* name = write_temp( "unit-stream", z.p, z.len );
+      comments = NULL;
+      assert( readmm( name, B, &comments ) == 0 );
+      assert( strcmp( comments, "% a comment\n" ) == 0 );
+      free( comments );
+      assert(( B->m == A->m ) && ( B->n == A->n ) && ( B->nz == A->nz ) && ( B->format == SM_COO ) );
+      assert( memcmp( B->ii, A->ii, A->nz * sizeof( unsigned int ) ) == 0 );
+      assert( memcmp( B->jj, A->jj, A->nz * sizeof( unsigned int ) ) == 0 );
+      assert( memcmp( B->dd, A->dd, A->nz * sizeof( double ) ) == 0 );
+      unlink( name );
+      free( name );
+      free( z.p );
+    }
+  }
+
+  // not a MatrixMarket file
+  struct buf_t bad = { NULL, 0, 0 };
+  append( &bad, "some text\n", 10 );
+  append( &bad, mtx.p, mtx.len );
+  struct buf_t z = pack( &bad, MC_GZIP );
+  char* name = write_temp( "unit-stream", z.p, z.len );
+  assert( readmm( name, B, NULL ) == -12 );
+  unlink( name );
+  free( name );
+  free( z.p );
+  free( bad.p );
+
+  // an entry too many, or too few, and one split from its newline
+  const char* h = "%%MatrixMarket matrix coordinate real general\n2 2 1\n";
+  const char* tails[] = { "1 1 1\n2 2 2\n", "", "1 1 1" };
+  const int expect[] = { -9, -6, 0 };
+  for ( int i = 0; i < 3; i++ ) {
+    struct buf_t m = { NULL, 0, 0 }, a = { NULL, 0, 0 };
+    append( &m, h, strlen( h ) );
+    append( &m, tails[i], strlen( tails[i] ) );
+    tar_member( &a, "M/M.mtx", '0', m.p, m.len );
+    tar_end( &a );
+    name = write_temp( "unit-stream", a.p, a.len );
+    assert( readmm( name, B, NULL ) == expect[i] );
+    unlink( name );
+    free( name );
+    free( m.p );
+    free( a.p );
+  }
+
+  free_matrix( A );
+  free_matrix( B );
+  free( mtx.p );
+  free( t.p );
+}
+
+int main( int argc, char **argv ) {
+  test_detect();
+  test_compressed();
+  test_tar();
+  test_errors();
+  test_readmm_stream();
+  return 0;
+}